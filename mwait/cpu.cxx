@@ -0,0 +1,227 @@
+#include "include.hpp"
+
+namespace
+{
+    constexpr auto LOG_SUBSYSTEM = mw::LogCpu;
+
+    bool IsMwaitHintSupported( const mw::CPU_FEATURES& Features, const ULONG Hint )
+    {
+        const auto CState = ( Hint >> 4 ) + 1;
+        const auto SubState = Hint & 0xf;
+
+        /* Processors that don't enumerate sub-states (most AMD parts) only guarantee C1. */
+        if ( Features.MwaitSubstates == 0 )
+        {
+            return Hint == 0;
+        }
+
+        return ( ( Features.MwaitSubstates >> ( CState * 4 ) ) & 0xf ) > SubState;
+    }
+
+    /* Nobody ever writes to it, only a working wait instruction can keep us parked on it. */
+    alignas( 64 ) volatile ULONG64 ProbeLine = 0llu;
+
+    /*
+     * Runs at DISPATCH_LEVEL so monitor and wait happen on the same processor, with interrupts enabled so a wait that
+     * does park is ended by the next one. Any single attempt may be cut short by an interrupt, only the longest counts.
+     */
+    template < typename WAIT >
+    bool Parks( const mw::CPU_FEATURES& Features, const WAIT& Wait )
+    {
+        const auto Line = const_cast< ULONG64* >( &ProbeLine );
+
+        ULONG64 Longest = 0llu;
+
+        for ( ULONG i = 0; i < mw::PARK_PROBE_ATTEMPTS; i++ )
+        {
+            KIRQL Irql;
+            KeRaiseIrql( DISPATCH_LEVEL, &Irql );
+
+            const auto Start = __rdtsc ( );
+
+            Wait( Line, Start );
+
+            const auto Elapsed = __rdtsc ( ) - Start;
+
+            KeLowerIrql( Irql );
+
+            Longest = max( Longest, Elapsed );
+        }
+
+        return Longest >= mw::PARK_PROBE_MIN_NS * Features.TscPerMicrosecond / 1000llu;
+    }
+}
+
+VOID mw::QueryCpuFeatures( CPU_FEATURES& Features )
+{
+    int Regs[ 4 ] = { };
+
+    memset( &Features, 0, sizeof( Features ) );
+
+    __cpuid( Regs, 0 );
+
+    const auto MaxLeaf = static_cast< ULONG >( Regs[ 0 ] );
+
+    __cpuid( Regs, 1 );
+
+    Features.Monitor = ( Regs[ 2 ] & ( 1 << 3 ) ) != 0;
+    Features.Hypervisor = ( Regs[ 2 ] & ( 1 << 31 ) ) != 0;
+
+    if ( Features.Hypervisor )
+    {
+        __cpuid( Regs, 0x40000000 );
+
+        memcpy( &Features.HypervisorVendor[ 0 ], &Regs[ 1 ], 4 );
+        memcpy( &Features.HypervisorVendor[ 4 ], &Regs[ 2 ], 4 );
+        memcpy( &Features.HypervisorVendor[ 8 ], &Regs[ 3 ], 4 );
+    }
+
+    if ( MaxLeaf >= 5 && Features.Monitor )
+    {
+        __cpuid( Regs, 5 );
+
+        Features.SmallestMonitorLine = Regs[ 0 ] & 0xffff;
+        Features.LargestMonitorLine = Regs[ 1 ] & 0xffff;
+        Features.MwaitSubstates = static_cast< ULONG >( Regs[ 3 ] );
+    }
+
+    if ( MaxLeaf >= 6 )
+    {
+        __cpuid( Regs, 6 );
+
+        Features.Aperfmperf = ( Regs[ 2 ] & ( 1 << 0 ) ) != 0;
+    }
+
+    if ( MaxLeaf >= 7 )
+    {
+        __cpuidex( Regs, 7, 0 );
+
+        Features.Waitpkg = ( Regs[ 2 ] & ( 1 << 5 ) ) != 0;
+    }
+
+    __cpuid( Regs, 0x80000000 );
+
+    if ( static_cast< ULONG >( Regs[ 0 ] ) >= 0x80000001lu )
+    {
+        __cpuid( Regs, 0x80000001 );
+
+        Features.Monitorx = ( Regs[ 2 ] & ( 1 << 29 ) ) != 0;
+    }
+
+    LARGE_INTEGER Frequency = { };
+
+    const auto QpcStart = KeQueryPerformanceCounter( &Frequency );
+    const auto TscStart = __rdtsc ( );
+
+    KeStallExecutionProcessor( 1000lu );
+
+    const auto TscEnd = __rdtsc ( );
+    const auto QpcEnd = KeQueryPerformanceCounter( nullptr );
+
+    const auto ElapsedUs = ( QpcEnd.QuadPart - QpcStart.QuadPart ) * 1000000ll / Frequency.QuadPart;
+
+    Features.TscPerMicrosecond = ( TscEnd - TscStart ) / ( ElapsedUs > 0 ? ElapsedUs : 1 );
+
+    if ( Features.Monitor )
+    {
+        Features.MwaitParks = Parks( Features, []( ULONG64* Line, ULONG64 ) {
+            _mm_monitor( Line, 0lu, 0lu );
+            _mm_mwait( 0lu, 0lu );
+        } );
+    }
+
+    if ( Features.Waitpkg )
+    {
+        const auto Deadline = PARK_PROBE_DEADLINE_NS * Features.TscPerMicrosecond / 1000llu;
+
+        Features.UmwaitParks = Parks( Features, [ Deadline ]( ULONG64* Line, ULONG64 Start ) {
+            _umonitor( Line );
+            _umwait( 1lu, Start + Deadline );
+        } );
+    }
+
+    if ( Features.Monitorx )
+    {
+        Features.MwaitxParks = Parks( Features, []( ULONG64* Line, ULONG64 ) {
+            _mm_monitorx( Line, 0lu, 0lu );
+            _mm_mwaitx( 0lu, 0lu, 0lu );
+        } );
+    }
+
+    logmsg( "monitor: %d waitpkg: %d monitorx: %d aperfmperf: %d line: %lu-%lu substates: 0x%08lx tsc/us: %llu\n",
+            Features.Monitor,
+            Features.Waitpkg,
+            Features.Monitorx,
+            Features.Aperfmperf,
+            Features.SmallestMonitorLine,
+            Features.LargestMonitorLine,
+            Features.MwaitSubstates,
+            Features.TscPerMicrosecond
+    );
+
+    logmsg( "hypervisor: %d '%s' parks: mwait %d umwait %d mwaitx %d\n",
+            Features.Hypervisor,
+            Features.HypervisorVendor,
+            Features.MwaitParks,
+            Features.UmwaitParks,
+            Features.MwaitxParks
+    );
+}
+
+VOID mw::BuildWaitStates( const CPU_FEATURES& Features, gov::STATE_TABLE& Table )
+{
+    memset( &Table, 0, sizeof( Table ) );
+
+    for ( const auto& Template : gov::WAIT_STATE_TEMPLATES )
+    {
+        switch ( Template.Kind )
+        {
+            case gov::WAIT_KIND::Umwait:
+                if ( !Features.UmwaitParks )
+                    continue;
+                break;
+
+            case gov::WAIT_KIND::Mwait:
+                if ( !Features.MwaitParks || !IsMwaitHintSupported( Features, Template.Hint ) )
+                    continue;
+                break;
+
+            default:
+                break;
+        }
+
+        gov::AddState( Table, Template, NsToCycles( Template.ExitLatencyNs ), NsToCycles( Template.TargetResidencyNs ) );
+    }
+}
+
+ULONG mw::SupportedBackends( const CPU_FEATURES& Features )
+{
+    ULONG Backends = ( 1lu << BackendGovernor ) | ( 1lu << BackendSpin ) | ( 1lu << BackendEvent ) | ( 1lu << BackendBackoff );
+
+    if ( Features.MwaitParks )
+    {
+        Backends |= 1lu << BackendMwait;
+    }
+
+    if ( Features.UmwaitParks )
+    {
+        Backends |= 1lu << BackendUmwait;
+    }
+
+    if ( Features.MwaitxParks )
+    {
+        Backends |= 1lu << BackendMwaitx;
+    }
+
+    return Backends;
+}
+
+mw::BACKEND mw::DefaultBackend( const CPU_FEATURES& Features )
+{
+    if ( Features.MwaitParks )
+    {
+        return BackendGovernor;
+    }
+
+    return Features.UmwaitParks ? BackendUmwait : BackendBackoff;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <ntifs.h>
+#include <intrin.h>
+
+#include "governor.hpp"
+#include "shared.hpp"
+
+namespace mw
+{
+    struct CPU_FEATURES
+    {
+        /* CPUID.01H:ECX[3] */
+        bool Monitor;
+
+        /* CPUID.(07H,0):ECX[5], `umonitor`/`umwait`/`tpause`. */
+        bool Waitpkg;
+
+        /* CPUID.80000001H:ECX[29], `monitorx`/`mwaitx`. */
+        bool Monitorx;
+
+        /* CPUID.06H:ECX[0], `IA32_MPERF` and `IA32_APERF`. */
+        bool Aperfmperf;
+
+        /* CPUID.01H:ECX[31], and the vendor signature from CPUID.40000000H:EBX-EDX. */
+        bool Hypervisor;
+        char HypervisorVendor[ 13 ];
+
+        /*
+         * Whether each wait instruction actually parks the processor. Hypervisors commonly intercept them and turn them
+         * into no-ops even though CPUID still advertises them, which would leave watchers in a busy loop.
+         */
+        bool MwaitParks;
+        bool UmwaitParks;
+        bool MwaitxParks;
+
+        /* CPUID.05H, in bytes. */
+        ULONG SmallestMonitorLine;
+        ULONG LargestMonitorLine;
+
+        /* CPUID.05H:EDX, number of `mwait` sub-states per C-state, one nibble each starting at C0. */
+        ULONG MwaitSubstates;
+
+        ULONG64 TscPerMicrosecond;
+    };
+
+    inline CPU_FEATURES Cpu = { };
+
+    /*
+     * Must run at PASSIVE_LEVEL. It stalls the calling processor for about a millisecond to calibrate the TSC, then
+     * tries each wait instruction a few times, which can take up to a few timer ticks each.
+     */
+    VOID QueryCpuFeatures( _Out_ CPU_FEATURES& Features );
+
+    /*
+     * Fills `Table` with the wait states usable on this processor, ordered from shallowest to deepest.
+     */
+    VOID BuildWaitStates( _In_ const CPU_FEATURES& Features, _Out_ gov::STATE_TABLE& Table );
+
+    /*
+     * A bit per `BACKEND` usable on this processor.
+     */
+    ULONG SupportedBackends( _In_ const CPU_FEATURES& Features );
+
+    /*
+     * The governor wherever `mwait` parks. Otherwise, typically in a VM, a forced `umwait` if that parks, and the
+     * backoff backend failing that, so watchers never poll flat out.
+     */
+    BACKEND DefaultBackend( _In_ const CPU_FEATURES& Features );
+
+    inline ULONG64 NsToCycles( const ULONG64 Nanoseconds )
+    {
+        return Nanoseconds * Cpu.TscPerMicrosecond / 1000llu;
+    }
+}
@@ -0,0 +1,288 @@
+#pragma once
+
+/*
+ * Predictive selection of how deep a watcher parks, modelled on the TEO cpuidle governor.
+ *
+ * Each watch keeps a decaying histogram of the intervals between detected writes. Before parking, the governor takes
+ * the median of that distribution conditioned on the time already elapsed since the last write, and picks the deepest
+ * wait state whose target residency fits the predicted idle time and whose exit latency fits the latency budget.
+ *
+ * This header deliberately has no kernel or compiler-specific dependencies so the exact same code can be driven from
+ * recorded traces in user mode (including on Linux).
+ */
+
+namespace mw::gov
+{
+    using u32 = unsigned int;
+    using u64 = unsigned long long;
+
+    enum class WAIT_KIND : u32
+    {
+        Spin,
+        Mwait,
+        Umwait,
+
+        /* Never in a governor table, only used when a backend is forced. */
+        Mwaitx
+    };
+
+    struct WAIT_STATE
+    {
+        WAIT_KIND Kind;
+
+        /* `mwait` EAX hint, or the `umwait` control word (0 = C0.2, 1 = C0.1). */
+        u32 Hint;
+
+        /* Both in TSC cycles. */
+        u64 ExitLatency;
+        u64 TargetResidency;
+    };
+
+    constexpr u32 MAX_STATES = 8;
+
+    /*
+     * Ordered from shallowest to deepest. `Default` is used until a watch has any history.
+     */
+    struct STATE_TABLE
+    {
+        WAIT_STATE States[ MAX_STATES ];
+        u32 Count;
+        u32 Default;
+    };
+
+    /*
+     * Exit latency and target residency, in nanoseconds. These are deliberately conservative, loosely based on
+     * the tables `intel_idle` uses for client parts; the governor only needs their relative ordering to be right.
+     * The driver keeps those the processor supports, `mwbench` scores the governor against all of them.
+     */
+    struct WAIT_STATE_TEMPLATE
+    {
+        WAIT_KIND Kind;
+        u32 Hint;
+        u64 ExitLatencyNs;
+        u64 TargetResidencyNs;
+    };
+
+    constexpr WAIT_STATE_TEMPLATE WAIT_STATE_TEMPLATES[ ] =
+    {
+        { WAIT_KIND::Spin, 0u, 0llu, 0llu },
+        { WAIT_KIND::Umwait, 1u, 100llu, 300llu },
+        { WAIT_KIND::Umwait, 0u, 300llu, 1000llu },
+        { WAIT_KIND::Mwait, 0x00u, 1000llu, 2000llu },
+        { WAIT_KIND::Mwait, 0x01u, 10000llu, 20000llu },
+        { WAIT_KIND::Mwait, 0x10u, 50000llu, 150000llu },
+    };
+
+    /*
+     * The governor never picks a wait state with a longer exit latency than this.
+     */
+    constexpr u64 LATENCY_BUDGET_NS = 20000llu;
+
+    /*
+     * Appends the state `Template` describes, its latencies already converted to TSC cycles.
+     */
+    inline void AddState( STATE_TABLE& Table, const WAIT_STATE_TEMPLATE& Template, const u64 ExitLatency, const u64 TargetResidency )
+    {
+        auto& State = Table.States[ Table.Count ];
+
+        State.Kind = Template.Kind;
+        State.Hint = Template.Hint;
+        State.ExitLatency = ExitLatency;
+        State.TargetResidency = TargetResidency;
+
+        /* Start out where this driver always used to park, `mwait` C1, or in the shallowest state that parks at all. */
+        if ( ( State.Kind == WAIT_KIND::Mwait && State.Hint == 0 ) ||
+             ( State.Kind != WAIT_KIND::Spin && Table.Default == 0 ) )
+        {
+            Table.Default = Table.Count;
+        }
+
+        Table.Count++;
+    }
+
+    /*
+     * Bin `i` covers intervals in [2^(i + MIN_SHIFT), 2^(i + MIN_SHIFT + 1)) cycles; the first and last bins are open-ended.
+     */
+    constexpr u32 BINS = 28;
+    constexpr u32 MIN_SHIFT = 8;
+
+    /* Every observation decays the existing weights by 1/2^DECAY_SHIFT. */
+    constexpr u32 DECAY_SHIFT = 3;
+    constexpr u64 WEIGHT = 1024;
+
+    struct PREDICTION
+    {
+        u32 State;
+        u64 Idle;
+    };
+
+    struct ACCURACY
+    {
+        /*
+         * Predictions resolved by a detected write, each one exactly one of the three below. A prediction superseded by
+         * a wake-up that saw no write isn't counted, it says nothing about how well the governor predicts writes.
+         */
+        u64 Predictions;
+
+        /* The chosen state was the deepest one the actual idle time would have allowed. */
+        u64 Hits;
+
+        /* The write arrived before the chosen state's target residency. */
+        u64 TooDeep;
+
+        /* A deeper state would have fit. */
+        u64 TooShallow;
+
+        u64 Selections[ MAX_STATES ];
+    };
+
+    inline u32 BinOf( const u64 Interval )
+    {
+        u32 Log2 = 0;
+
+        for ( auto v = Interval; v > 1; v >>= 1 )
+        {
+            Log2++;
+        }
+
+        if ( Log2 < MIN_SHIFT )
+        {
+            return 0;
+        }
+
+        return ( Log2 - MIN_SHIFT < BINS ) ? ( Log2 - MIN_SHIFT ) : ( BINS - 1 );
+    }
+
+    /*
+     * Midpoint of a bin, used as the representative interval for it.
+     */
+    inline u64 BinMid( const u32 Bin )
+    {
+        return ( 3llu << ( Bin + MIN_SHIFT ) ) >> 1;
+    }
+
+    /*
+     * Deepest state with `TargetResidency <= Idle` and `ExitLatency <= Budget`. Falls back to the shallowest state.
+     */
+    inline u32 DeepestFitting( const STATE_TABLE& Table, const u64 Idle, const u64 Budget )
+    {
+        u32 Choice = 0;
+
+        for ( u32 i = 0; i < Table.Count; i++ )
+        {
+            const auto& State = Table.States[ i ];
+
+            if ( State.TargetResidency <= Idle && State.ExitLatency <= Budget )
+            {
+                Choice = i;
+            }
+        }
+
+        return Choice;
+    }
+
+    struct GOVERNOR
+    {
+        u64 Bins[ BINS ];
+        u64 Total;
+
+        /* Outstanding prediction, resolved by the next `Observe`. */
+        PREDICTION Last;
+        u64 LastBudget;
+        bool Pending;
+
+        ACCURACY Accuracy;
+
+        void Reset( )
+        {
+            *this = { };
+        }
+
+        PREDICTION Predict( const STATE_TABLE& Table, const u64 Budget, const u64 Elapsed )
+        {
+            PREDICTION Prediction = { Table.Default, 0 };
+
+            if ( Total != 0 )
+            {
+                /*
+                 * Only intervals at least as long as the time already elapsed are still possible,
+                 * so take the median of what's left.
+                 */
+                const auto First = BinOf( Elapsed );
+
+                u64 Remaining = 0;
+
+                for ( u32 i = First; i < BINS; i++ )
+                {
+                    Remaining += Bins[ i ];
+                }
+
+                u64 Cumulative = 0;
+                u32 Median = BINS - 1;
+
+                for ( u32 i = First; i < BINS && Remaining != 0; i++ )
+                {
+                    Cumulative += Bins[ i ];
+
+                    if ( Cumulative * 2 >= Remaining )
+                    {
+                        Median = i;
+                        break;
+                    }
+                }
+
+                const auto Interval = BinMid( Median );
+
+                Prediction.Idle = ( Interval > Elapsed ) ? ( Interval - Elapsed ) : 0;
+                Prediction.State = DeepestFitting( Table, Prediction.Idle, Budget );
+            }
+
+            Last = Prediction;
+            LastBudget = Budget;
+            Pending = true;
+
+            Accuracy.Selections[ Prediction.State ]++;
+
+            return Prediction;
+        }
+
+        /*
+         * `Interval` is the time since the previous detected write, `Idle` the time actually spent parked before this one.
+         */
+        void Observe( const STATE_TABLE& Table, const u64 Interval, const u64 Idle )
+        {
+            if ( Pending )
+            {
+                const auto Ideal = DeepestFitting( Table, Idle, LastBudget );
+
+                Accuracy.Predictions++;
+
+                if ( Ideal == Last.State )
+                {
+                    Accuracy.Hits++;
+                }
+                else if ( Ideal < Last.State )
+                {
+                    Accuracy.TooDeep++;
+                }
+                else
+                {
+                    Accuracy.TooShallow++;
+                }
+
+                Pending = false;
+            }
+
+            Total = 0;
+
+            for ( u32 i = 0; i < BINS; i++ )
+            {
+                Bins[ i ] -= Bins[ i ] >> DECAY_SHIFT;
+                Total += Bins[ i ];
+            }
+
+            Bins[ BinOf( Interval ) ] += WEIGHT;
+            Total += WEIGHT;
+        }
+    };
+}
@@ -3,7 +3,26 @@
 #include <ntifs.h>
 #include <intrin.h>
 
-#define logmsg(...) DbgPrintEx(DPFLTR_IHVDRIVER_ID, DPFLTR_MASK | DPFLTR_INFO_LEVEL, "[" __FUNCTION__ "] " ##__VA_ARGS__)
+#include "stats.hpp"
+#include "cpu.hpp"
+
+/*
+ * Every source file that logs names its subsystem in a `LOG_SUBSYSTEM` constant. A message more verbose than its subsystem's
+ * current level costs a load of `LogLevels` and a branch, one above `LOG_COMPILED_LEVEL` isn't compiled in at all.
+ */
+#define logat(Level, ...) \
+    do \
+    { \
+        if ( mw::LogEnabled( LOG_SUBSYSTEM, Level ) ) [[unlikely]] \
+        { \
+            DbgPrintEx(DPFLTR_IHVDRIVER_ID, DPFLTR_MASK | DPFLTR_INFO_LEVEL, "[" __FUNCTION__ "] " ##__VA_ARGS__); \
+        } \
+    } \
+    while ( false )
+
+#define logerr(...) logat( mw::LogError, __VA_ARGS__ )
+#define logmsg(...) logat( mw::LogInfo, __VA_ARGS__ )
+#define logdbg(...) logat( mw::LogVerbose, __VA_ARGS__ )
 
 namespace mw
 {
@@ -13,18 +32,573 @@ namespace mw
     inline LARGE_INTEGER Sleep = { .QuadPart = -( 1 * 100 * 1000 ) };
     inline LARGE_INTEGER NoSleep = { .QuadPart = 0 };
 
-    inline ULONG64 TestVariable = 0llu;
+    /*
+     * Watchers are only ever placed on these processors, and at most `WATCHER_CORE_BUDGET` of them run at once.
+     * The worker producing test writes stays outside of this set.
+     */
+    constexpr KAFFINITY WATCHER_CPU_AFFINITY = 0x0b;
+    constexpr KAFFINITY WORKER_THREAD_CPU_AFFINITY = 4;
+    constexpr ULONG WATCHER_CORE_BUDGET = 3lu;
+
+    /*
+     * Processors hot-added while the driver is loaded are eligible for watchers if they fall in this set,
+     * and each one raises the core budget by one.
+     */
+    constexpr KAFFINITY WATCHER_HOTPLUG_AFFINITY = ~WORKER_THREAD_CPU_AFFINITY;
+
+    /*
+     * How long the power callback waits for watchers to leave their wait states before letting a sleep transition
+     * go ahead, in `Sleep` periods.
+     */
+    constexpr ULONG SUSPEND_PARK_ATTEMPTS = 50lu;
+
+    constexpr ULONG MAX_WATCHERS = 16lu;
+    constexpr ULONG MAX_WATCHES = 64lu;
+    constexpr ULONG MAX_WATCHES_PER_WATCHER = 16lu;
+
+    /*
+     * How often the pool manager samples event rates and resizes the pool.
+     */
+    inline LARGE_INTEGER ManagerPeriod = { .QuadPart = -( 250 * 10 * 1000 ) };
+
+    /*
+     * Event-rate watermarks, in detected writes per manager period. A watcher above `GROW_EVENT_RATE`
+     * (or missing writes) sheds watches onto a new core; one below `SHRINK_EVENT_RATE` for
+     * `SHRINK_AFTER_TICKS` periods hands its watches to a peer and gives its core back.
+     */
+    constexpr ULONG64 GROW_EVENT_RATE = 64llu;
+    constexpr ULONG64 SHRINK_EVENT_RATE = 4llu;
+    constexpr ULONG SHRINK_AFTER_TICKS = 8lu;
+
+    /*
+     * Background watches earn 1/2^BACKGROUND_POLL_SHIFT of their session's share on a polling watcher, so they're
+     * read, and their changes reported, on one pass in four of those the normal watches next to them get.
+     */
+    constexpr ULONG BACKGROUND_POLL_SHIFT = 2lu;
+
+    /*
+     * Every `REBALANCE_PERIODS` manager periods, groups of watches are moved between running watchers to bring the
+     * peak per-watcher event rate down. A move has to cut the peak by at least 1/2^REBALANCE_MIN_GAIN_SHIFT of it,
+     * and at most `REBALANCE_MAX_MOVES` groups move per pass.
+     */
+    constexpr ULONG REBALANCE_PERIODS = 4lu;
+    constexpr ULONG REBALANCE_MAX_MOVES = 4lu;
+    constexpr ULONG REBALANCE_MIN_GAIN_SHIFT = 3lu;
+
+    /*
+     * The watchdog looks at watcher heartbeats every `WATCHDOG_PERIODS` manager periods. A watcher that made no progress
+     * over one look gets kicked, which wakes any healthy watcher however idle its lines are. If it still hasn't moved
+     * by the next look it's declared stalled and its watches are placed elsewhere.
+     */
+    constexpr ULONG WATCHDOG_PERIODS = 8lu;
+
+    /*
+     * Watches in the same group are always placed on and moved between watchers together. `NO_GROUP` opts out.
+     */
+    constexpr ULONG NO_GROUP = 0lu;
+
+    /*
+     * Critical watches can be replicated onto up to `MAX_REPLICAS` watchers, each on a different core. Replica `k` holds
+     * back its read by `k * REPLICA_STAGGER_NS` after waking up, so the replicas never re-arm at the same moment and a
+     * store landing in one replica's re-arm window is still caught by another.
+     */
+    constexpr ULONG MAX_FAN_INS = 8lu;
+    constexpr ULONG64 REPLICA_STAGGER_NS = 200llu;
+
+    constexpr ULONG TEST_WATCH_COUNT = 4lu;
+
+    /* The first test slot is watched as a critical watch with this many replicas. */
+    constexpr ULONG TEST_CRITICAL_REPLICAS = 2lu;
+
+    /* Payload slots of the load generator's publish channel, updated in bursts. */
+    constexpr ULONG TEST_CHANNEL_SLOTS = 8lu;
+
+    /*
+     * Watch targets are handed out by a slot pool, see slots.cxx. Each slot starts a stride of its own, at least as large
+     * and aligned as the largest monitor line CPUID leaf 5 reports, so nothing else can ever share a slot's line.
+     */
+    constexpr ULONG SLOT_PAGES = 4lu;
+    constexpr ULONG SLOT_MIN_STRIDE = 64lu;
+    constexpr ULONG MAX_SLOTS = SLOT_PAGES * PAGE_SIZE / SLOT_MIN_STRIDE;
+
+    struct SLOT_POOL
+    {
+        /* `SLOT_PAGES` pages of nonpaged memory, page aligned. */
+        PUCHAR Base;
+        ULONG Stride;
+        ULONG Capacity;
+
+        /* A set bit per slot handed out. */
+        RTL_BITMAP Map;
+        ULONG MapBits[ MAX_SLOTS / 32 ];
+        FAST_MUTEX Lock;
+    };
+
+    struct TEST_SLOT
+    {
+        volatile ULONG64* Value;
+
+        /* A slot of its own, so counting a write doesn't wake the watcher a second time. */
+        volatile LONG64* Writes;
+    };
+
+    /* Filled in once at load. */
+    inline TEST_SLOT TestSlots[ TEST_WATCH_COUNT ] = { };
+
+    /*
+     * Writes queued through `IOCTL_REPLAY`, must be a power of two.
+     */
+    constexpr ULONG REPLAY_QUEUE_SIZE = 1lu << 16;
+
+    static_assert( ( REPLAY_QUEUE_SIZE & ( REPLAY_QUEUE_SIZE - 1 ) ) == 0 );
+
+    /*
+     * The worker spins for replayed writes due within this long and sleeps otherwise. It has to cover a `Sleep` period
+     * plus the clock tick `KeDelayExecutionThread` rounds up to, or writes due right after a sleep would be late.
+     */
+    constexpr ULONG64 REPLAY_SPIN_NS = 40llu * 1000 * 1000;
+
+    /*
+     * One-way latency probes, see probe.cxx. A probe is a single store to a test slot, so the watcher can never see half
+     * of one: the low `PROBE_TSC_BITS` of the writer's TSC, a sequence number, the writer's slot in `ProbeWriters` and
+     * two flags. Every `PROBE_ECHO_EVERY`th probe asks the watcher to store its own TSC, its index and the sequence
+     * number back to `ProbeEcho`, which the writer waits on for up to `PROBE_ECHO_TIMEOUT_NS`.
+     */
+    constexpr ULONG PROBE_MAX_WRITERS = 4lu;
+    constexpr ULONG PROBE_ECHO_EVERY = 16lu;
+    constexpr ULONG64 PROBE_ECHO_TIMEOUT_NS = 1000llu * 1000;
+
+    constexpr ULONG PROBE_TSC_BITS = 48lu;
+    constexpr ULONG PROBE_SEQUENCE_SHIFT = 48lu;
+    constexpr ULONG PROBE_WRITER_SHIFT = 60lu;
+    constexpr ULONG64 PROBE_SEQUENCE_MASK = 0xfffllu;
+    constexpr ULONG64 PROBE_ECHO = 1llu << 62;
+    constexpr ULONG64 PROBE_MARKER = 1llu << 63;
+
+    constexpr ULONG ECHO_TSC_BITS = 44lu;
+    constexpr ULONG ECHO_WATCHER_SHIFT = 44lu;
+    constexpr ULONG ECHO_SEQUENCE_SHIFT = 52lu;
+
+    static_assert( PROBE_MAX_WRITERS <= 4 && MAX_WATCHERS <= 256 );
+
+    /*
+     * Instrumentation toggles. Everything behind these is compiled out when disabled.
+     */
+    constexpr bool CYCLE_ACCOUNTING = false;
+    constexpr bool IRQ_PROFILING = false;
+
+    /*
+     * Messages above this level are compiled out. The levels in effect start at `LogInfo` and are changed through
+     * `IOCTL_SET_LOG_LEVEL`; they're read on every message and written about never, so they get a line of their own.
+     */
+    constexpr LOG_LEVEL LOG_COMPILED_LEVEL = LogVerbose;
+
+    struct alignas( 64 ) LOG_LEVEL_TABLE
+    {
+        volatile LONG Levels[ LogSubsystemCount ];
+    };
+
+    inline LOG_LEVEL_TABLE LogLevels = { { LogInfo, LogInfo, LogInfo, LogInfo, LogInfo } };
+
+    static_assert( LogSubsystemCount == 5 );
+
+    inline bool LogEnabled( const LOG_SUBSYSTEM Subsystem, const LOG_LEVEL Level )
+    {
+        return Level <= LOG_COMPILED_LEVEL && ReadNoFence( &LogLevels.Levels[ Subsystem ] ) >= static_cast< LONG >( Level );
+    }
+
+    /*
+     * Default interrupt-off window considered too long, roughly 10us on a 3GHz TSC.
+     * Adjustable at runtime through `IOCTL_SET_IRQ_THRESHOLD`.
+     */
+    constexpr ULONG64 IRQ_OFF_THRESHOLD_CYCLES = 30000llu;
+
+    /*
+     * Upper bound on a single spin wait, after which the iteration ends and interrupts get a chance to run.
+     */
+    constexpr ULONG64 SPIN_LIMIT_NS = 50000llu;
+
+    /*
+     * `umwait` deadline used when the governor has no idle prediction yet.
+     */
+    constexpr ULONG64 UMWAIT_DEFAULT_DEADLINE_NS = 100000llu;
+
+    /*
+     * `BackendBackoff` starts each wait polling `BACKOFF_FLOOR_NS` apart and doubles the gap after every poll that saw
+     * nothing, up to the ceiling. Gaps of at least `TPAUSE_MIN_NS` are slept out in C0.1 with `tpause` when available,
+     * shorter ones aren't worth its wake-up latency and spin on `pause`.
+     */
+    constexpr ULONG64 BACKOFF_FLOOR_NS = 50llu;
+    constexpr ULONG64 BACKOFF_CEILING_NS = 2000llu;
+    constexpr ULONG64 BACKOFF_MAX_CEILING_NS = 1000000llu;
+    constexpr ULONG64 TPAUSE_MIN_NS = 500llu;
+
+    /*
+     * Each wait instruction is tried `PARK_PROBE_ATTEMPTS` times at startup on a line nobody writes to. It's taken to
+     * park if at least one attempt lasted `PARK_PROBE_MIN_NS`; an intercepted one returns after a VM exit, a microsecond
+     * or two. `umwait` is given a deadline of `PARK_PROBE_DEADLINE_NS`, the others wait for the next interrupt.
+     */
+    constexpr ULONG PARK_PROBE_ATTEMPTS = 4lu;
+    constexpr ULONG64 PARK_PROBE_MIN_NS = 5000llu;
+    constexpr ULONG64 PARK_PROBE_DEADLINE_NS = 50000llu;
+
+    /*
+     * Per watcher, must be a power of two.
+     */
+    constexpr ULONG EVENT_RING_SIZE = 1024lu;
+
+    static_assert( ( EVENT_RING_SIZE & ( EVENT_RING_SIZE - 1 ) ) == 0 );
+
+    static_assert( gov::MAX_STATES == MAX_WAIT_STATES );
+
+    inline gov::STATE_TABLE WaitStates = { };
+
+    /*
+     * Merges the detections of all replicas of a critical watch, so every store is reported once no matter how many of
+     * them saw it.
+     */
+    struct FAN_IN
+    {
+        /*
+         * Value and TSC of the last detection let through, `Last[ 0 ]` and `Last[ 1 ]` respectively.
+         * Replaced together with a 128-bit compare-exchange so racing replicas agree on which one reports a store.
+         */
+        alignas( 16 ) volatile LONG64 Last[ 2 ];
+
+        ULONG Replicas;
+
+        /* Detections let through, and the ones dropped because another replica already reported that value. */
+        volatile LONG64 Accepted;
+        volatile LONG64 Duplicates;
+
+        /*
+         * Detections older than the last one let through. Without a history it can't be told whether some replica reported
+         * them already, so they are dropped as well.
+         */
+        volatile LONG64 Late;
+
+        /* Indexed by replica, tells which replica reported first. */
+        volatile LONG64 AcceptedBy[ MAX_REPLICAS ];
+    };
+
+    /*
+     * Writer side of the publish API. Producers update payload slots and mark them dirty; only the first update after the
+     * watcher last drained the channel rings the doorbell, the one line actually watched, so a burst of updates costs a
+     * single wake. `Pending` and `Dirty` live away from the doorbell, touching them must not wake anybody.
+     */
+    constexpr ULONG MAX_CHANNELS = 8lu;
+
+    struct CHANNEL_SLOT
+    {
+        volatile ULONG64 Value;
+        volatile LONG64 Version;
+    };
+
+    struct CHANNEL
+    {
+        ULONG Index;
+        ULONG Slots;
+        ULONG Session;
+
+        /* A slot from the slot pool, bumped on every ring. */
+        volatile LONG64* Doorbell;
+
+        /* Set by the producer that rings, cleared by the watcher before it drains `Dirty`. */
+        alignas( 64 ) volatile LONG Pending;
+        volatile LONG64 Dirty;
+
+        alignas( 64 ) volatile LONG64 Published;
+        volatile LONG64 Rung;
+
+        alignas( 64 ) CHANNEL_SLOT Payload[ MAX_CHANNEL_SLOTS ];
+    };
+
+    /* The load generator's channel, created once at load. */
+    inline CHANNEL* TestChannel = nullptr;
+
+    struct WATCH
+    {
+        /* Links the watch into a watcher's inbox while it's being handed over. */
+        SLIST_ENTRY HandOff;
 
-    constexpr ULONG MONITOR_THREAD_CPU_AFFINITY = 1;
-    constexpr ULONG WORKER_THREAD_CPU_AFFINITY = 4;
+        ULONG Id;
+        ULONG Group;
+        ULONG_PTR Address;
 
-    constexpr ULONG64 MAGIC = 0xEEFFEEFFEEFFEEFF;
-    constexpr ULONG THREAD_COUNT = 2lu;
+        /* Optional count of stores kept by the producer, lets the pool tell how many writes went unnoticed. */
+        volatile LONG64* WriteCount;
+
+        /* Only touched by the owning watcher; they travel with the watch on hand-off. */
+        ULONG64 LastValue;
+        ULONG64 LastWrite;
+        gov::GOVERNOR Governor;
+
+        ULONG64 Events;
+
+        /* Set on every replica of a critical watch. Only replica 0 carries the group and the producer's write count. */
+        FAN_IN* FanIn;
+        ULONG Replica;
+
+        /* Set on the doorbell watch of a publish channel. */
+        CHANNEL* Channel;
+
+        ULONG Session;
+
+        /* A `WATCH_PRIORITY`, changed by `IOCTL_SET_PRIORITY` at any time. */
+        volatile LONG Priority;
+
+        /* Only touched by the owning watcher: polls earned on a shared watcher, see `SESSION::Share`. */
+        ULONG Credit;
+
+        /* Only touched by the owning watcher: a poll came due since the watch was last checked. */
+        bool Due;
+
+        /* In TSC cycles. */
+        ULONG64 Stagger;
+
+        /* Index of the owning watcher and of the one it's being handed to, -1 when unset. */
+        volatile LONG Owner;
+        volatile LONG MigrateTo;
+
+        /* Pool manager bookkeeping. */
+        ULONG64 EventsAtTick;
+        ULONG64 Rate;
+        ULONG64 Missed;
+
+        /* Writes replica 0 missed on its own, compared against `Missed` to tell what the replicas bought. */
+        ULONG64 MissedAlone;
+    };
+
+    enum WATCHER_STATE : LONG
+    {
+        WatcherFree,
+        WatcherRunning,
+        WatcherDraining,
+        WatcherStopping
+    };
+
+    struct POOL;
 
     struct MONITOR_CONTEXT
     {
-        ULONG_PTR MonitoredAddress;
-        KEVENT MonitorExit;
+        /* Watches handed to this watcher, drained whenever `Pending` is set. */
+        SLIST_HEADER Inbox;
+
+        POOL* Pool;
+        ULONG Index;
+        ULONG Processor;
+
+        HANDLE ThreadHandle;
+        CLIENT_ID Cid;
+        PETHREAD Thread;
+
+        volatile LONG State;
+        volatile LONG Stop;
+
+        /*
+         * Set by `KickWatcher` whenever there's something for the watcher to look at besides its watches.
+         * `Armed` is the line it is currently parked on, storing to it is how a parked watcher gets woken up.
+         */
+        volatile LONG Pending;
+        PVOID volatile Armed;
+
+        /* Set while the watcher waits out a sleep transition with interrupts enabled, or once it has exited. */
+        volatile LONG Parked;
+
+        /*
+         * Set by the watchdog once the watcher's watches have been taken away from it. A stalled watcher that comes back
+         * must not touch any watch or its inbox again, it just exits.
+         */
+        volatile LONG Stalled;
+
+        /* TSC of the last wake-up or deadline, the watchdog only checks that it moves. */
+        volatile ULONG64 Heartbeat;
+
+        /* Signalled to wake the watcher while it has nothing to watch. */
+        KEVENT Wake;
+
+        /* Only touched by the watcher thread. */
+        WATCH* Watches[ MAX_WATCHES_PER_WATCHER ];
+        ULONG WatchCount;
+
+        /* Pool manager bookkeeping. A watcher owning realtime watches is meant to serve them alone. */
+        ULONG OwnedWatches;
+        ULONG RealtimeWatches;
+        ULONG IdleTicks;
+        ULONG64 LastHeartbeat;
+        bool Probed;
+        ULONG64 Load;
+        ULONG64 MissRate;
+
+        /*
+         * Written by the watcher thread only, read by `IOCTL_QUERY_STATS` without synchronisation.
+         */
+        ULONG64 Iterations;
+        ULONG64 Writes;
+
+        CYCLE_ACCOUNT< CYCLE_ACCOUNTING > Cycles;
+        IRQ_PROFILE< IRQ_PROFILING > IrqProfile;
+
+        /* Only counted while `POOL::MeasureResidency` is set, see `WATCHER_STATS`. */
+        ULONG64 WaitCycles;
+        ULONG64 WaitActiveCycles;
+
+        /* In TSC cycles. */
+        ULONG64 LatencyBudget;
+    };
+
+    /*
+     * Single producer (the watcher with the same index), single consumer (`ReadEvents`, serialised by `ReadLock`).
+     * Rings belong to the pool rather than to the watcher so events survive a watcher stopping before they're read.
+     * Events are also counted per session on both sides, what a session has in the rings is the difference.
+     */
+    struct EVENT_RING
+    {
+        /* Written by the producer only. */
+        alignas( 64 ) volatile LONG64 Head;
+        ULONG64 Dropped;
+        ULONG64 Pushed[ MAX_SESSIONS ];
+        ULONG64 OverQuota[ MAX_SESSIONS ];
+
+        /* Written by the consumer only. */
+        alignas( 64 ) volatile LONG64 Tail;
+        ULONG64 Read[ MAX_SESSIONS ];
+
+        alignas( 64 ) EVENT Events[ EVENT_RING_SIZE ];
+    };
+
+    /*
+     * Owner of a set of watches, see `SESSION_QUOTA`. Sessions are created along with the pool's first watches and
+     * stay for as long as the pool does.
+     */
+    constexpr ULONG DRIVER_SESSION = 0lu;
+
+    struct SESSION
+    {
+        char Name[ 16 ];
+
+        /* Replaced whole by `IOCTL_SET_SESSION`, read field by field. */
+        volatile LONG Weight;
+        SESSION_QUOTA Quota;
+
+        /*
+         * Recomputed by the pool manager every period, read by watchers on every pass and every event. Summing the
+         * rings on every event would cost the detection path a line from every other watcher, so a session can run
+         * past `MaxRingEvents` by up to a period's worth of events before its events get dropped.
+         */
+        volatile LONG Share;
+        volatile LONG OverRingQuota;
+
+        ULONG Watches;
+        ULONG RejectedWatches;
+
+        /* Pool manager bookkeeping. */
+        ULONG64 Events;
+        ULONG64 Rate;
+        ULONG64 ThrottledPeriods;
+        bool Throttled;
+    };
+
+    /*
+     * Allocated from nonpaged pool rather than living in the device extension, `SLIST_HEADER` needs 16 byte alignment.
+     */
+    struct POOL
+    {
+        MONITOR_CONTEXT Watchers[ MAX_WATCHERS ];
+
+        WATCH Watches[ MAX_WATCHES ];
+        ULONG WatchCount;
+
+        FAN_IN FanIns[ MAX_FAN_INS ];
+        ULONG FanInCount;
+
+        CHANNEL Channels[ MAX_CHANNELS ];
+        ULONG ChannelCount;
+
+        SESSION Sessions[ MAX_SESSIONS ];
+        ULONG SessionCount;
+
+        EVENT_RING Rings[ MAX_WATCHERS ];
+
+        /* Next ring `ReadEvents` starts from, so a small buffer doesn't always favour the first watchers. */
+        ULONG NextRing;
+        FAST_MUTEX ReadLock;
+
+        ULONG ActiveWatchers;
+        ULONG Ticks;
+
+        /* Processors currently hosting a watcher. A stalled watcher keeps its processor until its thread exits. */
+        KAFFINITY Busy;
+
+        /* Watchers declared stalled by the watchdog. */
+        ULONG Stalls;
+
+        /*
+         * Processors watchers may be started on, and how many of them may be used at once.
+         * Both only grow, from the processor change callback.
+         */
+        volatile LONG64 Eligible;
+        volatile LONG CoreBudget;
+
+        /* Set between the system leaving S0 and coming back, watchers stay parked with interrupts enabled meanwhile. */
+        volatile LONG Suspended;
+
+        PVOID ProcessorCallback;
+        PCALLBACK_OBJECT PowerObject;
+        PVOID PowerCallback;
+
+        ULONG64 IrqOffThreshold;
+
+        /* A `BACKEND`, set through `IOCTL_SET_BACKEND` and picked up by each watcher on its next iteration. */
+        volatile LONG Backend;
+        volatile LONG MeasureResidency;
+
+        /* `BackendBackoff` settings, the ceiling in TSC cycles. */
+        volatile LONG64 BackoffCeiling;
+        volatile LONG BackoffTpause;
+
+        /*
+         * One-way latency probes, see probe.cxx. A writer slot holds its processor number plus one. Within a pair the
+         * one-way figures are written by the watcher only and the round-trip ones by the writer only.
+         */
+        volatile LONG Probing;
+        volatile LONG ProbeWriters[ PROBE_MAX_WRITERS ];
+        volatile LONG64* ProbeEcho;
+        ULONG64 ProbeSequence;
+        ULONG64 Probes;
+        ULONG64 EchoTimeouts;
+        PROBE_PAIR_STATS ProbePairs[ PROBE_MAX_WRITERS ][ MAX_WATCHERS ];
+    };
+
+    /*
+     * Single producer (`QueueReplay`, serialised by `Lock`), single consumer (the worker). Starting or stopping a replay
+     * can't touch `Tail`, so the producer publishes how far to skip in `Discard` and bumps `Generation`, and the worker
+     * catches up the next time it looks.
+     */
+    struct REPLAY
+    {
+        /* Written by the producer only. */
+        alignas( 64 ) volatile LONG64 Head;
+        volatile LONG64 Discard;
+        volatile LONG Generation;
+        volatile LONG Active;
+        FAST_MUTEX Lock;
+
+        /* Written by the worker only, read by `IOCTL_REPLAY` without synchronisation. */
+        alignas( 64 ) volatile LONG64 Tail;
+        LONG Seen;
+
+        /* TSC the timeline started at, 0 until the first write after a start is played. */
+        ULONG64 Base;
+
+        ULONG64 Played;
+        ULONG64 LatenessSum;
+        ULONG64 LatenessMax;
+        ULONG64 LastDue;
+        ULONG64 LastPlayed;
+        ULONG64 Lateness[ REPLAY_LATENESS_BUCKETS ];
+
+        alignas( 64 ) REPLAY_WRITE Writes[ REPLAY_QUEUE_SIZE ];
     };
 
     struct MWDEVICE_EXTENSION
@@ -32,12 +606,14 @@ namespace mw
         HANDLE WorkerHandle;
         CLIENT_ID WorkerCid;
 
-        HANDLE MonitorThreadHandle;
-        CLIENT_ID MonitorCid;
+        HANDLE ManagerHandle;
+        CLIENT_ID ManagerCid;
 
         PDEVICE_OBJECT Self;
         KEVENT Unload;
 
-        MONITOR_CONTEXT MonitorContext;
+        POOL* Pool;
+        REPLAY* Replay;
+        SLOT_POOL* Slots;
     };
 }
@@ -1,213 +1,580 @@
-﻿#include "include.hpp"
+﻿#include "pool.hpp"
 
-struct INTERRUPT_GUARD
+namespace
 {
-    INTERRUPT_GUARD( )
-    {
-        _disable ( );
-    }
+    constexpr auto LOG_SUBSYSTEM = mw::LogDriver;
+}
 
-    ~INTERRUPT_GUARD( )
+/*
+ * Waits for a thread created with `PsCreateSystemThread` to exit and releases its handle.
+ */
+VOID JoinThread( _In_ HANDLE Handle, _In_ const CLIENT_ID& Cid )
+{
+    PETHREAD ThreadObject = nullptr;
+    const auto Status = PsLookupThreadByThreadId( Cid.UniqueThread, &ThreadObject );
+
+    if ( NT_SUCCESS( Status ) )
     {
-        _enable ( );
-    }
-};
+        KeWaitForSingleObject(
+            ThreadObject,
+            Executive,
+            KernelMode,
+            false,
+            nullptr
+        );
 
-VOID Monitor( _In_ VOID *Context )
-{
-    ULONG64 MostRecentRead = 0llu;
+        /*
+         * Reference acquired by `PsLookupThreadByThreadId`.
+         */
+        ObfDereferenceObject( ThreadObject );
+    }
 
     /*
-     * `_mm_mwait` will halt execution, therefore we don't want this thread running on the same CPU as the 'manager'.
-     *  Ideally, we should check for IRQL before calling this, as it is only guaranteed the thread will migrate
-     *  to (one) of the target CPUs if at <= APC_LEVEL.
+     * This handle was opened by PsCreateSystemThread.
      */
-    KeSetSystemAffinityThread( mw::MONITOR_THREAD_CPU_AFFINITY );
-
-    NT_ASSERT( KeGetCurrentProcessorNumber( ) != mw::MONITOR_THREAD_CPU_AFFINITY );
-
-    ULONG64 CountIdentifiedWrites = 0llu;
+    ZwClose( Handle );
+}
 
-    alignas(64) const auto Address = static_cast< mw::MONITOR_CONTEXT* >(
+VOID Worker( _In_ VOID *Context )
+{
+    const auto Ext = static_cast< mw::MWDEVICE_EXTENSION* >(
         Context
-    )->MonitoredAddress;
+    );
+
+    /* `_mm_mwait` will halt execution, hence we don't want this thread running on the same CPU as any watcher. */
+    KeSetSystemAffinityThread( mw::WORKER_THREAD_CPU_AFFINITY );
 
     for ( ;; )
     {
-        volatile INTERRUPT_GUARD _ { };
+        const auto IsExiting = (
+            KeWaitForSingleObject( &Ext->Unload, Executive, KernelMode, false, &mw::NoSleep ) == STATUS_SUCCESS
+        );
 
-        const auto Start = __rdtsc ( );
+        if ( IsExiting )
+        {
+            break;
+        }
 
-        /*
-        * According to the manual: "MONITOR performs the same segmentation and paging checks as a 1-byte read."
-        * Therefore, an attempt to monitor an invalid address will raise an exception.
-        * We are also dereferencing the monitored address in order to retrieve the data, which is always risky.
-        * However, since we disabled interrupts earlier faulting here would lead to BugCheck even with exception handling.
-        *
-        * Finally, the correct way of using this requires checking the caching policy for the monitored address/page.
-        * The manual is very pedantic about the fact we must only monitor addresses using the *write-back* policy type.
-        * But seeing as we haven't bothered with the `cpuid` compatibility check either perhaps two wrongs do make a right...
-        */
-        _mm_monitor(
-            reinterpret_cast< void* >( Address ),
-            0lu,
-            0lu
-        );
+        /* While a trace is being replayed the slots only see its writes. */
+        if ( ReadAcquire( &Ext->Replay->Active ) )
+        {
+            const auto Busy = mw::PlayReplay( Ext->Pool, Ext->Replay );
 
-        /*
-         * Wait for it to trigger whenever some instruction writes to `Context->MonitoredAddress`.
-         * Note: `mwait` behaves very much like the halt instruction (`hlt`) as far as I can see. I am not aware of any way to distinguish between them.
-         * This also means that the CPU we pinned this thread to will be unusable for the duration of the waiting as it will transition to a low-power state.
-         *
-         * Further, the waiting state may also exit early due to a variety of reasons, such as:
-         *  1) Reset signal;
-         *  2) Any unmasked interrupt including INTR, NMI, SMI, INIT; and
-         *  3) Others not directly specified by the manual but alluded to by the wording.
-         *
-         * Reason 2) is why we disabled interrupts before arming the monitor hardware.
-        */
-        _mm_mwait( 0lu, 0lu );
+            KeDelayExecutionThread( KernelMode, false, Busy ? &mw::NoSleep : &mw::Sleep );
+            continue;
+        }
 
-        /*
-         * If we get here then one of two things happened:
-         *
-         *  1) A store occurred to the monitored address; or
-         *  2) The waiting state exited early.
-         *
-         *  Per the documentation there doesn't seem to be any way to identify what caused
-         *  the wait to expire. Due to this fact, we have to manually check whether the store occurred or not.
-         *
-         *  This implementation does not account for the fact that the same value may have been written to the monitored address.
-         *
-         *  I've only tested the previous assumptions on an AMD Ryzen 3 systems.
-         *
-         *  Interestingly, Intel with the instruction `umwait` appears to behave differently:
-         *
-         *  "By executing the umwait instruction, the core enters a light-weight sleep
-         *  mode, typically C0.1 or C0.2 [34]. There are now two cases
-         *  to distinguish: Core #X transiently writing or not writing to
-         *  the monitored cache line. If Core #X transiently writes to the
-         *  monitored shared cache line, Core #Y wakes up and contin-
-         *  ues execution with a cleared carry flag (CF = 0). If Core #X
-         *  does not write to the monitored shared cache line, Core #Y
-         *  sleeps until the maximum sleep time defined by the OS is
-         *  reached (cf. Section 3.3). In this case, the carry flag is set (CF
-         *  = 1) when Core #Y wakes up. Hence, with the carry flag, an
-         *  attacker has the architectural information whether there was
-         *  a microarchitectural event, i.e., a transient write."
-         */
+        if ( ReadAcquire( &Ext->Pool->Probing ) )
+        {
+            mw::WriteProbes( Ext->Pool );
+
+            KeDelayExecutionThread( KernelMode, false, &mw::Sleep );
+            continue;
+        }
 
-        const ULONG64 Previous = MostRecentRead;
-        MostRecentRead = *reinterpret_cast< ULONG_PTR* >( Address );
+        // Occasionally write to the slots, each one a few times less often than the previous so the pool has something to balance.
+        const auto TimeStamp = __rdtsc ( );
 
-        if ( Previous != MostRecentRead )
+        for ( ULONG i = 0; i < mw::TEST_WATCH_COUNT; i++ )
         {
-            CountIdentifiedWrites++;
-            logmsg( "[%lx] Store detected on %p: 0x%llx != 0x%llx | delta: %llu\n",
-                    KeGetCurrentProcessorNumber( ),
-                    Address,
-                    Previous,
-                    MostRecentRead,
-                    __rdtsc ( ) - Start
-            );
+            const auto Mask = ( 1llu << ( 2 * i + 1 ) ) - 1;
+
+            if ( ( ( TimeStamp >> 4 ) & Mask ) == 0 )
+            {
+                mw::WriteTestSlot( Ext->Pool, i, TimeStamp );
+            }
         }
 
-        /* 🤭 */
-        if ( MostRecentRead == mw::MAGIC )
+        /* Now and then a burst through the publish channel, which should cost its watcher a single wake. */
+        if ( ( ( TimeStamp >> 4 ) & 7 ) == 0 )
         {
-            break;
+            for ( ULONG i = 0; i < mw::TEST_CHANNEL_SLOTS; i++ )
+            {
+                mw::Publish( Ext->Pool, mw::TestChannel, i, __rdtsc ( ) );
+            }
         }
-    }
 
-    logmsg( "Count identified writes: %llu\n", CountIdentifiedWrites );
+        KeDelayExecutionThread( KernelMode, false, &mw::Sleep );
+    }
 }
 
-
-VOID Worker( _In_ VOID *Context )
+/*
+ * Owns the watcher pool: places new watches and resizes the pool once per `ManagerPeriod`.
+ */
+VOID Manager( _In_ VOID *Context )
 {
     const auto Ext = static_cast< mw::MWDEVICE_EXTENSION* >(
         Context
     );
 
-    /* `_mm_mwait` will halt execution, hence we don't want this thread running on the same CPU as the worker.*/
+    /* Watchers run with interrupts disabled, we'd never get scheduled on one of their processors. */
     KeSetSystemAffinityThread( mw::WORKER_THREAD_CPU_AFFINITY );
 
-    NT_ASSERT( KeGetCurrentProcessorNumber( ) != mw::WORKER_THREAD_CPU_AFFINITY );
+    for ( ;; )
+    {
+        mw::ScalePool( Ext->Pool );
+
+        const auto IsExiting = (
+            KeWaitForSingleObject( &Ext->Unload, Executive, KernelMode, false, &mw::ManagerPeriod ) == STATUS_SUCCESS
+        );
 
-    auto Status = PsCreateSystemThread(
-        &Ext->MonitorThreadHandle,
-        THREAD_ALL_ACCESS,
-        nullptr,
-        NtCurrentProcess ( ),
-        &Ext->MonitorCid,
-        Monitor,
-        &Ext->MonitorContext
-    );
+        if ( IsExiting )
+        {
+            break;
+        }
+    }
+}
 
-    if ( !NT_SUCCESS( Status ) )
+NTSTATUS DrvCreateClose( PDEVICE_OBJECT DeviceObject, PIRP Irp )
+{
+    UNREFERENCED_PARAMETER( DeviceObject );
+
+    Irp->IoStatus.Information = 0;
+    Irp->IoStatus.Status = STATUS_SUCCESS;
+
+    IoCompleteRequest( Irp, IO_NO_INCREMENT );
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS DrvQueryStats( mw::MWDEVICE_EXTENSION *Ext, PIRP Irp, ULONG OutputLength )
+{
+    if ( OutputLength < FIELD_OFFSET( mw::STATS, Watchers ) )
     {
-        logmsg( "Unable to create thread: 0x%08x\n", Status );
-        return;
+        return STATUS_BUFFER_TOO_SMALL;
     }
 
-    for ( ;; )
+    memset( Irp->AssociatedIrp.SystemBuffer, 0, FIELD_OFFSET( mw::STATS, Watchers ) );
+
+    const auto Pool = Ext->Pool;
+    const auto Stats = static_cast< mw::STATS* >( Irp->AssociatedIrp.SystemBuffer );
+
+    ULONG WatcherCount = 0lu;
+
+    for ( const auto& Watcher : Pool->Watchers )
     {
-        const auto IsExiting = (
-            KeWaitForSingleObject( &Ext->Unload, Executive, KernelMode, false, &mw::NoSleep ) == STATUS_SUCCESS
-        );
+        if ( Watcher.State != mw::WatcherFree )
+        {
+            WatcherCount++;
+        }
+    }
 
-        if ( IsExiting )
+    Stats->Flags = ( mw::CYCLE_ACCOUNTING ? mw::STATS_FLAG_CYCLE_ACCOUNTING : 0lu ) |
+                   ( mw::IRQ_PROFILING ? mw::STATS_FLAG_IRQ_PROFILING : 0lu ) |
+                   ( mw::Cpu.Hypervisor ? mw::STATS_FLAG_HYPERVISOR : 0lu );
+    Stats->WatcherCount = WatcherCount;
+    Stats->WatchCount = min( Pool->WatchCount, mw::MAX_WATCHES );
+    Stats->Stalls = Pool->Stalls;
+    Stats->TscPerMicrosecond = mw::Cpu.TscPerMicrosecond;
+    Stats->WaitStateCount = mw::WaitStates.Count;
+    Stats->Backend = static_cast< ULONG >( Pool->Backend );
+    Stats->Backends = mw::SupportedBackends( mw::Cpu );
+    Stats->DefaultBackend = mw::DefaultBackend( mw::Cpu );
+    Stats->SlotStride = Ext->Slots->Stride;
+    Stats->SlotsPerPage = PAGE_SIZE / Ext->Slots->Stride;
+    Stats->SlotCapacity = Ext->Slots->Capacity;
+    Stats->SlotsUsed = RtlNumberOfSetBits( &Ext->Slots->Map );
+
+    memcpy( Stats->Hypervisor, mw::Cpu.HypervisorVendor, sizeof( mw::Cpu.HypervisorVendor ) );
+
+    Stats->SessionCount = Pool->SessionCount;
+
+    for ( ULONG i = 0; i < Pool->SessionCount; i++ )
+    {
+        const auto& Session = Pool->Sessions[ i ];
+        auto& Out = Stats->Sessions[ i ];
+
+        memcpy( Out.Name, Session.Name, sizeof( Session.Name ) );
+
+        Out.Weight = static_cast< ULONG >( Session.Weight );
+        Out.Share = static_cast< ULONG >( Session.Share );
+        Out.Quota = Session.Quota;
+        Out.Watches = Session.Watches;
+        Out.RejectedWatches = Session.RejectedWatches;
+        Out.Events = Session.Events;
+        Out.Rate = Session.Rate;
+        Out.ThrottledPeriods = Session.ThrottledPeriods;
+        Out.RingEvents = 0llu;
+        Out.RingDropped = 0llu;
+
+        for ( const auto& Ring : Pool->Rings )
+        {
+            Out.RingEvents += Ring.Pushed[ i ] - Ring.Read[ i ];
+            Out.RingDropped += Ring.OverQuota[ i ];
+        }
+    }
+
+    for ( ULONG i = 0; i < mw::WaitStates.Count; i++ )
+    {
+        const auto& State = mw::WaitStates.States[ i ];
+
+        Stats->WaitStates[ i ].Kind = static_cast< ULONG >( State.Kind );
+        Stats->WaitStates[ i ].Hint = State.Hint;
+        Stats->WaitStates[ i ].ExitLatency = State.ExitLatency;
+        Stats->WaitStates[ i ].TargetResidency = State.TargetResidency;
+    }
+
+    const auto Required = mw::StatsSize( Stats->WatcherCount, Stats->WatchCount );
+
+    if ( OutputLength < Required )
+    {
+        Irp->IoStatus.Information = FIELD_OFFSET( mw::STATS, Watchers );
+        return STATUS_SUCCESS;
+    }
+
+    memset( Stats->Watchers, 0, Required - FIELD_OFFSET( mw::STATS, Watchers ) );
+
+    auto Watcher = Stats->Watchers;
+
+    /*
+     * Nothing stops the pool manager from starting a watcher since they were counted, the buffer was only sized for
+     * `WatcherCount` of them. One started meanwhile waits for the next query.
+     */
+    for ( const auto& Context : Pool->Watchers )
+    {
+        if ( Watcher == &Stats->Watchers[ Stats->WatcherCount ] )
         {
-            *reinterpret_cast< ULONG_PTR* >( Ext->MonitorContext.MonitoredAddress ) = mw::MAGIC;
             break;
         }
 
-        // Occasionally write to the pointer.
-        const auto TimeStamp = __rdtsc ( );
+        if ( Context.State == mw::WatcherFree )
+        {
+            continue;
+        }
+
+        Watcher->Index = Context.Index;
+        Watcher->Processor = Context.Processor;
+        Watcher->State = Context.State;
+        Watcher->WatchCount = Context.OwnedWatches;
+        Watcher->Stalled = static_cast< ULONG >( Context.Stalled );
+        Watcher->Heartbeat = Context.Heartbeat;
+        Watcher->Load = Context.Load;
+        Watcher->MissRate = Context.MissRate;
+        Watcher->Iterations = Context.Iterations;
+        Watcher->Writes = Context.Writes;
+        Watcher->EventsDropped = Pool->Rings[ Context.Index ].Dropped;
+        Watcher->WaitCycles = Context.WaitCycles;
+        Watcher->WaitActiveCycles = Context.WaitActiveCycles;
+
+        Context.Cycles.Export( *Watcher );
+        Context.IrqProfile.Export( *Watcher );
+
+        Watcher++;
+    }
+
+    const auto Watches = mw::GetWatchStats( Stats );
 
-        if ( ( TimeStamp & 0xff ) == 0 )
+    /* Bounded by the count the buffer was sized for, not by `Pool->WatchCount` as it reads now. */
+    for ( ULONG i = 0; i < Stats->WatchCount; i++ )
+    {
+        const auto& Watch = Pool->Watches[ i ];
+        const auto& Accuracy = Watch.Governor.Accuracy;
+
+        Watches[ i ].Id = Watch.Id;
+        Watches[ i ].Group = Watch.Group;
+        Watches[ i ].Owner = Watch.Owner;
+        Watches[ i ].Replica = Watch.Replica;
+        Watches[ i ].Session = Watch.Session;
+        Watches[ i ].Priority = static_cast< ULONG >( Watch.Priority );
+        Watches[ i ].Events = Watch.Events;
+        Watches[ i ].Missed = Watch.Missed;
+        Watches[ i ].Rate = Watch.Rate;
+        Watches[ i ].Predictions = Accuracy.Predictions;
+        Watches[ i ].PredictionHits = Accuracy.Hits;
+        Watches[ i ].PredictedTooDeep = Accuracy.TooDeep;
+        Watches[ i ].PredictedTooShallow = Accuracy.TooShallow;
+
+        for ( ULONG j = 0; j < mw::MAX_WAIT_STATES; j++ )
         {
-            *reinterpret_cast< ULONG_PTR* >( Ext->MonitorContext.MonitoredAddress ) = TimeStamp;
+            Watches[ i ].StateSelections[ j ] = Accuracy.Selections[ j ];
         }
 
-        KeDelayExecutionThread( KernelMode, false, &mw::Sleep );
+        if ( Watch.Channel )
+        {
+            Watches[ i ].Published = Watch.Channel->Published;
+            Watches[ i ].DoorbellsAvoided = Watch.Channel->Published - Watch.Channel->Rung;
+        }
+
+        if ( Watch.FanIn && Watch.Replica == 0 )
+        {
+            const auto& FanIn = *Watch.FanIn;
+
+            Watches[ i ].Replicas = FanIn.Replicas;
+            Watches[ i ].MissedAlone = Watch.MissedAlone;
+            Watches[ i ].FanInAccepted = FanIn.Accepted;
+            Watches[ i ].FanInDuplicates = FanIn.Duplicates;
+            Watches[ i ].FanInLate = FanIn.Late;
+
+            for ( ULONG j = 0; j < mw::MAX_REPLICAS; j++ )
+            {
+                Watches[ i ].ReportedBy[ j ] = FanIn.AcceptedBy[ j ];
+            }
+        }
+    }
+
+    Irp->IoStatus.Information = Required;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS DrvReadEvents( mw::MWDEVICE_EXTENSION *Ext, PIRP Irp, ULONG OutputLength )
+{
+    const auto Capacity = static_cast< ULONG >( OutputLength / sizeof( mw::EVENT ) );
+
+    if ( Capacity == 0 )
+    {
+        return STATUS_BUFFER_TOO_SMALL;
     }
 
-    PETHREAD MonitorThreadObject = nullptr;
-    Status = PsLookupThreadByThreadId( Ext->MonitorCid.UniqueThread, &MonitorThreadObject );
+    const auto Events = static_cast< mw::EVENT* >( Irp->AssociatedIrp.SystemBuffer );
+    const auto Count = mw::ReadEvents( Ext->Pool, Events, Capacity );
+
+    Irp->IoStatus.Information = Count * sizeof( mw::EVENT );
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS DrvReplay( mw::MWDEVICE_EXTENSION *Ext, PIRP Irp, ULONG InputLength, ULONG OutputLength )
+{
+    if ( InputLength < FIELD_OFFSET( mw::REPLAY_REQUEST, Writes ) || OutputLength < sizeof( mw::REPLAY_STATUS ) )
+    {
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    const auto Request = static_cast< const mw::REPLAY_REQUEST* >( Irp->AssociatedIrp.SystemBuffer );
+    const auto Fits = ( InputLength - FIELD_OFFSET( mw::REPLAY_REQUEST, Writes ) ) / sizeof( mw::REPLAY_WRITE );
+
+    if ( Request->Count > Fits )
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    /* Input and output share the system buffer, the status can only be written once the writes are queued. */
+    mw::REPLAY_STATUS Status;
+
+    const auto Result = mw::QueueReplay( Ext->Replay, Request->Flags, Request->Writes, Request->Count, Status );
+
+    if ( NT_SUCCESS( Result ) )
+    {
+        memcpy( Irp->AssociatedIrp.SystemBuffer, &Status, sizeof( Status ) );
+
+        Irp->IoStatus.Information = sizeof( Status );
+    }
+
+    return Result;
+}
+
+NTSTATUS DrvSetBackend( mw::MWDEVICE_EXTENSION *Ext, PIRP Irp, ULONG InputLength )
+{
+    if ( InputLength < sizeof( mw::BACKEND_REQUEST ) )
+    {
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    const auto Request = static_cast< const mw::BACKEND_REQUEST* >( Irp->AssociatedIrp.SystemBuffer );
+
+    if ( Request->Backend >= mw::BackendCount || ( mw::SupportedBackends( mw::Cpu ) & ( 1lu << Request->Backend ) ) == 0 )
+    {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    if ( Request->BackoffCeilingNs > mw::BACKOFF_MAX_CEILING_NS )
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    const auto Pool = Ext->Pool;
+    const auto Ceiling = Request->BackoffCeilingNs ? Request->BackoffCeilingNs : mw::BACKOFF_CEILING_NS;
+
+    InterlockedExchange64( &Pool->BackoffCeiling, static_cast< LONG64 >( mw::NsToCycles( Ceiling ) ) );
+    InterlockedExchange( &Pool->BackoffTpause, !( Request->Flags & mw::BACKEND_FLAG_NO_TPAUSE ) && mw::Cpu.UmwaitParks );
+    InterlockedExchange( &Pool->MeasureResidency, ( Request->Flags & mw::BACKEND_FLAG_RESIDENCY ) && mw::Cpu.Aperfmperf );
+    InterlockedExchange( &Pool->Backend, static_cast< LONG >( Request->Backend ) );
+
+    /* Get parked watchers out of their current wait so the switch doesn't wait for the next store. */
+    for ( auto& Watcher : Pool->Watchers )
+    {
+        if ( Watcher.State != mw::WatcherFree )
+        {
+            mw::KickWatcher( &Watcher );
+        }
+    }
+
+    logmsg( "Backend set to %lu\n", Request->Backend );
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS DrvProbe( mw::MWDEVICE_EXTENSION *Ext, PIRP Irp, ULONG InputLength, ULONG OutputLength )
+{
+    if ( InputLength < sizeof( mw::PROBE_REQUEST ) || OutputLength < FIELD_OFFSET( mw::PROBE_REPORT, Pair ) )
+    {
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    const auto Request = static_cast< const mw::PROBE_REQUEST* >( Irp->AssociatedIrp.SystemBuffer );
+
+    mw::ControlProbes( Ext->Pool, Request->Flags );
+
+    Irp->IoStatus.Information = mw::ReportProbes(
+        Ext->Pool,
+        static_cast< mw::PROBE_REPORT* >( Irp->AssociatedIrp.SystemBuffer ),
+        OutputLength
+    );
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS DrvSetLogLevel( PIRP Irp, ULONG InputLength, ULONG OutputLength )
+{
+    if ( InputLength != 0 )
+    {
+        if ( InputLength < sizeof( mw::LOG_REQUEST ) )
+        {
+            return STATUS_BUFFER_TOO_SMALL;
+        }
+
+        const auto Request = static_cast< const mw::LOG_REQUEST* >( Irp->AssociatedIrp.SystemBuffer );
+        const auto All = Request->Subsystem == mw::LOG_ALL_SUBSYSTEMS;
+
+        if ( ( !All && Request->Subsystem >= mw::LogSubsystemCount ) || Request->Level > mw::LogVerbose )
+        {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        for ( ULONG i = 0; i < mw::LogSubsystemCount; i++ )
+        {
+            if ( All || i == Request->Subsystem )
+            {
+                InterlockedExchange( &mw::LogLevels.Levels[ i ], static_cast< LONG >( Request->Level ) );
+            }
+        }
+    }
+
+    if ( OutputLength >= sizeof( mw::LOG_LEVELS ) )
+    {
+        const auto Levels = static_cast< mw::LOG_LEVELS* >( Irp->AssociatedIrp.SystemBuffer );
+
+        for ( ULONG i = 0; i < mw::LogSubsystemCount; i++ )
+        {
+            Levels->Levels[ i ] = static_cast< ULONG >( ReadNoFence( &mw::LogLevels.Levels[ i ] ) );
+        }
+
+        Irp->IoStatus.Information = sizeof( mw::LOG_LEVELS );
+    }
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS DrvSetSession( mw::MWDEVICE_EXTENSION *Ext, PIRP Irp, ULONG InputLength )
+{
+    if ( InputLength < sizeof( mw::SESSION_REQUEST ) )
+    {
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    const auto Request = static_cast< const mw::SESSION_REQUEST* >( Irp->AssociatedIrp.SystemBuffer );
+    const auto Status = mw::SetSession( Ext->Pool, *Request );
 
     if ( NT_SUCCESS( Status ) )
     {
-        KeWaitForSingleObject(
-            MonitorThreadObject,
-            Executive,
-            KernelMode,
-            false,
-            nullptr
-        );
+        logmsg( "Session %lu set to weight %lu\n", Request->Session, Request->Weight );
+    }
 
-        /*
-         * This handle was opened by PsCreateSystemThread.
-         */
-        ZwClose( Ext->MonitorThreadHandle );
+    return Status;
+}
 
-        /*
-         * Reference acquired by `PsLookupThreadByThreadId`.
-         */
-        ObfDereferenceObject( MonitorThreadObject );
+NTSTATUS DrvSetPriority( mw::MWDEVICE_EXTENSION *Ext, PIRP Irp, ULONG InputLength )
+{
+    if ( InputLength < sizeof( mw::PRIORITY_REQUEST ) )
+    {
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    const auto Request = static_cast< const mw::PRIORITY_REQUEST* >( Irp->AssociatedIrp.SystemBuffer );
+    const auto Status = mw::SetWatchPriority( Ext->Pool, *Request );
+
+    if ( NT_SUCCESS( Status ) )
+    {
+        logmsg( "Watch %lu set to priority %lu\n", Request->Watch, Request->Priority );
     }
+
+    return Status;
 }
 
-NTSTATUS DrvCreateClose( PDEVICE_OBJECT DeviceObject, PIRP Irp )
+NTSTATUS DrvDeviceControl( PDEVICE_OBJECT DeviceObject, PIRP Irp )
 {
-    UNREFERENCED_PARAMETER( DeviceObject );
+    const auto Ext = static_cast< mw::MWDEVICE_EXTENSION* >(
+        DeviceObject->DeviceExtension
+    );
+
+    const auto Stack = IoGetCurrentIrpStackLocation( Irp );
+    const auto& Parameters = Stack->Parameters.DeviceIoControl;
+
+    NTSTATUS Status = STATUS_INVALID_DEVICE_REQUEST;
 
     Irp->IoStatus.Information = 0;
-    Irp->IoStatus.Status = STATUS_SUCCESS;
+
+    switch ( Parameters.IoControlCode )
+    {
+        case mw::IOCTL_QUERY_STATS:
+            Status = DrvQueryStats( Ext, Irp, Parameters.OutputBufferLength );
+            break;
+
+        case mw::IOCTL_READ_EVENTS:
+            Status = DrvReadEvents( Ext, Irp, Parameters.OutputBufferLength );
+            break;
+
+        case mw::IOCTL_REPLAY:
+            Status = DrvReplay( Ext, Irp, Parameters.InputBufferLength, Parameters.OutputBufferLength );
+            break;
+
+        case mw::IOCTL_SET_BACKEND:
+            Status = DrvSetBackend( Ext, Irp, Parameters.InputBufferLength );
+            break;
+
+        case mw::IOCTL_PROBE:
+            Status = DrvProbe( Ext, Irp, Parameters.InputBufferLength, Parameters.OutputBufferLength );
+            break;
+
+        case mw::IOCTL_SET_LOG_LEVEL:
+            Status = DrvSetLogLevel( Irp, Parameters.InputBufferLength, Parameters.OutputBufferLength );
+            break;
+
+        case mw::IOCTL_SET_SESSION:
+            Status = DrvSetSession( Ext, Irp, Parameters.InputBufferLength );
+            break;
+
+        case mw::IOCTL_SET_PRIORITY:
+            Status = DrvSetPriority( Ext, Irp, Parameters.InputBufferLength );
+            break;
+
+        case mw::IOCTL_SET_IRQ_THRESHOLD:
+            if ( Parameters.InputBufferLength < sizeof( ULONG64 ) )
+            {
+                Status = STATUS_BUFFER_TOO_SMALL;
+                break;
+            }
+
+            Ext->Pool->IrqOffThreshold = *static_cast< ULONG64* >( Irp->AssociatedIrp.SystemBuffer );
+
+            for ( auto& Watcher : Ext->Pool->Watchers )
+            {
+                Watcher.IrqProfile.SetThreshold( Ext->Pool->IrqOffThreshold );
+            }
+
+            Status = STATUS_SUCCESS;
+            break;
+
+        default:
+            break;
+    }
+
+    Irp->IoStatus.Status = Status;
 
     IoCompleteRequest( Irp, IO_NO_INCREMENT );
 
-    return STATUS_SUCCESS;
+    return Status;
 }
 
 VOID DriverUnload( PDRIVER_OBJECT DriverObject )
@@ -220,32 +587,23 @@ VOID DriverUnload( PDRIVER_OBJECT DriverObject )
 
     KeSetEvent( &Ext->Unload, 0, false );
 
+    JoinThread( Ext->WorkerHandle, Ext->WorkerCid );
 
-    PETHREAD WorkerObject = nullptr;
-    const auto Status = PsLookupThreadByThreadId( Ext->WorkerCid.UniqueThread, &WorkerObject );
-
-    if ( NT_SUCCESS( Status ) )
-    {
-        KeWaitForSingleObject(
-            WorkerObject,
-            Executive,
-            KernelMode,
-            false,
-            nullptr
-        );
+    logmsg( "Worker thread exited\n" );
 
-        logmsg( "Worker thread exited\n" );
+    JoinThread( Ext->ManagerHandle, Ext->ManagerCid );
 
-        /* This handle was opened by PsCreateSystemThread */
-        ZwClose( Ext->WorkerHandle );
+    mw::UnregisterSystemCallbacks( Ext->Pool );
+    mw::DestroyPool( Ext->Pool );
+    mw::DestroyReplay( Ext->Replay );
 
-        ObfDereferenceObject( WorkerObject );
-    }
+    /* Only once no watcher or worker can touch a slot any more. */
+    mw::DestroySlots( Ext->Slots );
 
     IoDeleteSymbolicLink( &mw::SYMLINK_NAME );
     IoDeleteDevice( Device );
 
-    logmsg( "Bye from %p\n", WorkerObject );
+    logmsg( "Bye\n" );
 }
 
 EXTERN_C NTSTATUS DriverEntry( PDRIVER_OBJECT DriverObject, PUNICODE_STRING RegistryPath )
@@ -274,7 +632,7 @@ EXTERN_C NTSTATUS DriverEntry( PDRIVER_OBJECT DriverObject, PUNICODE_STRING Regi
 
         if ( !NT_SUCCESS( Status ) )
         {
-            logmsg( "Unable to create device: 0x%08x\n", Status );
+            logerr( "Unable to create device: 0x%08x\n", Status );
             break;
         }
 
@@ -287,7 +645,7 @@ EXTERN_C NTSTATUS DriverEntry( PDRIVER_OBJECT DriverObject, PUNICODE_STRING Regi
 
         if ( !CreatedSymbolicLink )
         {
-            logmsg( "Unable to create symbolic link: 0x%08x\n", Status );
+            logerr( "Unable to create symbolic link: 0x%08x\n", Status );
             break;
         }
     }
@@ -316,30 +674,143 @@ EXTERN_C NTSTATUS DriverEntry( PDRIVER_OBJECT DriverObject, PUNICODE_STRING Regi
 
     DriverObject->MajorFunction[ IRP_MJ_CREATE ] =
             DriverObject->MajorFunction[ IRP_MJ_CLOSE ] = DrvCreateClose;
+    DriverObject->MajorFunction[ IRP_MJ_DEVICE_CONTROL ] = DrvDeviceControl;
     DriverObject->DriverUnload = DriverUnload;
 
     DeviceObject->Flags |= DO_BUFFERED_IO;
 
-    Ext->MonitorContext.MonitoredAddress = reinterpret_cast< ULONG_PTR >(
-        &mw::TestVariable
-    );
+    mw::QueryCpuFeatures( mw::Cpu );
+    mw::BuildWaitStates( mw::Cpu, mw::WaitStates );
 
-    Status = PsCreateSystemThread(
-        &Ext->WorkerHandle,
-        THREAD_ALL_ACCESS,
-        nullptr,
-        NtCurrentProcess ( ),
-        &Ext->WorkerCid,
-        Worker,
-        Ext
-    );
+    do
+    {
+        Status = mw::CreatePool( Ext->Pool );
+
+        if ( !NT_SUCCESS( Status ) )
+        {
+            logerr( "Unable to allocate watcher pool: 0x%08x\n", Status );
+            break;
+        }
+
+        Status = mw::CreateReplay( Ext->Replay );
+
+        if ( !NT_SUCCESS( Status ) )
+        {
+            logerr( "Unable to allocate replay queue: 0x%08x\n", Status );
+            break;
+        }
+
+        Status = mw::CreateSlots( Ext->Slots );
+
+        if ( !NT_SUCCESS( Status ) )
+        {
+            logerr( "Unable to allocate watch slots: 0x%08x\n", Status );
+            break;
+        }
+
+        for ( auto& Slot : mw::TestSlots )
+        {
+            Slot.Value = static_cast< volatile ULONG64* >( mw::AllocateSlot( Ext->Slots ) );
+            Slot.Writes = static_cast< volatile LONG64* >( mw::AllocateSlot( Ext->Slots ) );
+
+            if ( !Slot.Value || !Slot.Writes )
+            {
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+
+            const auto Address = reinterpret_cast< ULONG_PTR >( Slot.Value );
+
+            const auto Watch = ( &Slot == &mw::TestSlots[ 0 ] )
+                ? mw::AddReplicatedWatch( Ext->Pool, mw::DRIVER_SESSION, Address, 0lu, Slot.Writes, mw::TEST_CRITICAL_REPLICAS )
+                : mw::AddWatch( Ext->Pool, mw::DRIVER_SESSION, Address, 0lu, Slot.Writes );
+
+            /* Refused if the pool is full or the driver's session is at its watch quota. */
+            if ( !Watch )
+            {
+                logerr( "Unable to add test watch %lu\n", static_cast< ULONG >( &Slot - mw::TestSlots ) );
+
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+        }
+
+        mw::TestChannel = NT_SUCCESS( Status ) ? mw::AddChannel( Ext->Pool, Ext->Slots, mw::DRIVER_SESSION, 0lu, mw::TEST_CHANNEL_SLOTS ) : nullptr;
+        Ext->Pool->ProbeEcho = static_cast< volatile LONG64* >( mw::AllocateSlot( Ext->Slots ) );
+
+        if ( !mw::TestChannel || !Ext->Pool->ProbeEcho )
+        {
+            logerr( "Unable to allocate test slots\n" );
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+
+        Status = mw::RegisterSystemCallbacks( Ext->Pool );
+
+        if ( !NT_SUCCESS( Status ) )
+        {
+            break;
+        }
+
+        Status = PsCreateSystemThread(
+            &Ext->ManagerHandle,
+            THREAD_ALL_ACCESS,
+            nullptr,
+            NtCurrentProcess ( ),
+            &Ext->ManagerCid,
+            Manager,
+            Ext
+        );
+
+        if ( !NT_SUCCESS( Status ) )
+        {
+            logerr( "Unable to create manager thread: 0x%08x\n", Status );
+            break;
+        }
+
+        Status = PsCreateSystemThread(
+            &Ext->WorkerHandle,
+            THREAD_ALL_ACCESS,
+            nullptr,
+            NtCurrentProcess ( ),
+            &Ext->WorkerCid,
+            Worker,
+            Ext
+        );
+
+        if ( !NT_SUCCESS( Status ) )
+        {
+            logerr( "Unable to create system thread: 0x%08x\n", Status );
+
+            KeSetEvent( &Ext->Unload, 0, false );
+            JoinThread( Ext->ManagerHandle, Ext->ManagerCid );
+            break;
+        }
+    }
+    while ( false );
 
     if ( !NT_SUCCESS( Status ) )
     {
-        logmsg( "Unable to create system thread: 0x%08x\n", Status );
+        if ( Ext->Pool )
+        {
+            mw::UnregisterSystemCallbacks( Ext->Pool );
+            mw::DestroyPool( Ext->Pool );
+        }
+
+        if ( Ext->Replay )
+        {
+            mw::DestroyReplay( Ext->Replay );
+        }
+
+        if ( Ext->Slots )
+        {
+            mw::DestroySlots( Ext->Slots );
+        }
 
         IoDeleteSymbolicLink( &mw::SYMLINK_NAME );
         IoDeleteDevice( DeviceObject );
+
+        return Status;
     }
 
     return STATUS_SUCCESS;
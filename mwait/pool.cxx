@@ -0,0 +1,1471 @@
+#include "pool.hpp"
+
+namespace
+{
+    constexpr auto LOG_SUBSYSTEM = mw::LogPool;
+
+    constexpr ULONG POOL_TAG = 'lPwM';
+
+    /*
+     * Starts a watcher on the first eligible processor that isn't hosting one yet.
+     */
+    NTSTATUS StartWatcher( mw::POOL* Pool, mw::MONITOR_CONTEXT*& Started )
+    {
+        Started = nullptr;
+
+        if ( Pool->ActiveWatchers >= static_cast< ULONG >( ReadNoFence( &Pool->CoreBudget ) ) )
+        {
+            return STATUS_QUOTA_EXCEEDED;
+        }
+
+        const auto Candidates = static_cast< KAFFINITY >( ReadNoFence64( &Pool->Eligible ) ) &
+                                KeQueryActiveProcessors( ) & ~Pool->Busy;
+
+        ULONG Processor = 0lu;
+
+        if ( !_BitScanForward64( &Processor, Candidates ) )
+        {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        mw::MONITOR_CONTEXT* Watcher = nullptr;
+
+        for ( auto& Candidate : Pool->Watchers )
+        {
+            if ( Candidate.State == mw::WatcherFree )
+            {
+                Watcher = &Candidate;
+                break;
+            }
+        }
+
+        if ( !Watcher )
+        {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        const auto Index = static_cast< ULONG >( Watcher - Pool->Watchers );
+
+        memset( Watcher, 0, sizeof( *Watcher ) );
+
+        /* Probe figures are per processor pair, none of the slot's previous processor may carry over to this one. */
+        for ( auto& Writer : Pool->ProbePairs )
+        {
+            memset( &Writer[ Index ], 0, sizeof( Writer[ Index ] ) );
+        }
+
+        InitializeSListHead( &Watcher->Inbox );
+        KeInitializeEvent( &Watcher->Wake, SynchronizationEvent, false );
+
+        Watcher->Pool = Pool;
+        Watcher->Index = Index;
+        Watcher->Processor = Processor;
+        Watcher->LatencyBudget = mw::NsToCycles( mw::gov::LATENCY_BUDGET_NS );
+        Watcher->IrqProfile.SetThreshold( Pool->IrqOffThreshold );
+        Watcher->State = mw::WatcherRunning;
+
+        auto Status = PsCreateSystemThread(
+            &Watcher->ThreadHandle,
+            THREAD_ALL_ACCESS,
+            nullptr,
+            NtCurrentProcess ( ),
+            &Watcher->Cid,
+            mw::Monitor,
+            Watcher
+        );
+
+        if ( !NT_SUCCESS( Status ) )
+        {
+            logerr( "Unable to create watcher thread: 0x%08x\n", Status );
+
+            Watcher->State = mw::WatcherFree;
+            return Status;
+        }
+
+        Status = PsLookupThreadByThreadId( Watcher->Cid.UniqueThread, &Watcher->Thread );
+
+        NT_ASSERT( NT_SUCCESS( Status ) );
+
+        Pool->Busy |= AFFINITY_MASK( Processor );
+        Pool->ActiveWatchers++;
+
+        logmsg( "Watcher %lu started on processor %lu (%lu active)\n", Index, Processor, Pool->ActiveWatchers );
+
+        Started = Watcher;
+
+        return STATUS_SUCCESS;
+    }
+
+    VOID StopWatcher( mw::MONITOR_CONTEXT* Watcher )
+    {
+        Watcher->State = mw::WatcherStopping;
+
+        InterlockedExchange( &Watcher->Stop, 1 );
+        mw::KickWatcher( Watcher );
+    }
+
+    /*
+     * Releases the thread and core of every watcher that has finished stopping. `Wait` blocks until they have.
+     */
+    VOID ReapWatchers( mw::POOL* Pool, const bool Wait )
+    {
+        for ( auto& Watcher : Pool->Watchers )
+        {
+            if ( Watcher.State != mw::WatcherStopping )
+            {
+                continue;
+            }
+
+            const auto Status = KeWaitForSingleObject(
+                Watcher.Thread,
+                Executive,
+                KernelMode,
+                false,
+                Wait ? nullptr : &mw::NoSleep
+            );
+
+            if ( Status != STATUS_SUCCESS )
+            {
+                continue;
+            }
+
+            /* This handle was opened by PsCreateSystemThread. */
+            ZwClose( Watcher.ThreadHandle );
+
+            /* Reference acquired by `PsLookupThreadByThreadId`. */
+            ObfDereferenceObject( Watcher.Thread );
+
+            Pool->Busy &= ~AFFINITY_MASK( Watcher.Processor );
+
+            /* Stalled watchers stopped counting against the budget when they were declared stalled. */
+            if ( Watcher.Stalled == 0 )
+            {
+                Pool->ActiveWatchers--;
+            }
+
+            Watcher.State = mw::WatcherFree;
+
+            logmsg( "Watcher %lu released processor %lu (%lu active)\n",
+                    Watcher.Index,
+                    Watcher.Processor,
+                    Pool->ActiveWatchers
+            );
+        }
+    }
+
+    /*
+     * Refreshes per-watch event rates and rolls them up into per-watcher load.
+     */
+    VOID SampleRates( mw::POOL* Pool )
+    {
+        for ( auto& Watcher : Pool->Watchers )
+        {
+            Watcher.OwnedWatches = 0lu;
+            Watcher.RealtimeWatches = 0lu;
+            Watcher.Load = 0llu;
+            Watcher.MissRate = 0llu;
+        }
+
+        for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+        {
+            auto& Watch = Pool->Watches[ i ];
+
+            const auto Events = ReadULong64NoFence( &Watch.Events );
+            const auto Delta = Events - Watch.EventsAtTick;
+
+            Watch.EventsAtTick = Events;
+            Watch.Rate = ( Watch.Rate + Delta ) / 2;
+
+            ULONG64 MissDelta = 0llu;
+
+            if ( Watch.WriteCount )
+            {
+                const auto Writes = static_cast< ULONG64 >( ReadNoFence64( Watch.WriteCount ) );
+
+                /* A critical watch only misses what none of its replicas saw. */
+                const auto Reported = Watch.FanIn ? static_cast< ULONG64 >( ReadNoFence64( &Watch.FanIn->Accepted ) )
+                                                  : Events;
+
+                const auto Missed = ( Writes > Reported ) ? ( Writes - Reported ) : 0llu;
+
+                MissDelta = ( Missed > Watch.Missed ) ? ( Missed - Watch.Missed ) : 0llu;
+                Watch.Missed = Missed;
+                Watch.MissedAlone = ( Writes > Events ) ? ( Writes - Events ) : 0llu;
+            }
+
+            const auto Owner = ReadNoFence( &Watch.Owner );
+
+            if ( Owner >= 0 )
+            {
+                auto& Watcher = Pool->Watchers[ Owner ];
+
+                Watcher.OwnedWatches++;
+                Watcher.RealtimeWatches += ( ReadNoFence( &Watch.Priority ) == mw::PriorityRealtime ) ? 1lu : 0lu;
+                Watcher.Load += Watch.Rate;
+                Watcher.MissRate += MissDelta;
+            }
+        }
+    }
+
+    /*
+     * Flags the sessions holding at least `MaxRingEvents` in the rings, rolls watch rates up into their sessions,
+     * throttles the ones past their event rate quota and works out what share of the polls on a shared watcher each
+     * session gets: its weight, scaled down by how far it's over quota, relative to the heaviest session's.
+     */
+    VOID ShareSessions( mw::POOL* Pool )
+    {
+        ULONG64 Effective[ mw::MAX_SESSIONS ] = { };
+        ULONG64 Heaviest = 1llu;
+
+        for ( ULONG s = 0; s < Pool->SessionCount; s++ )
+        {
+            auto& Session = Pool->Sessions[ s ];
+
+            Session.Events = 0llu;
+            Session.Rate = 0llu;
+
+            const auto Limit = Session.Quota.MaxRingEvents;
+
+            ULONG64 Queued = 0llu;
+
+            for ( auto& Ring : Pool->Rings )
+            {
+                Queued += ReadULong64NoFence( &Ring.Pushed[ s ] ) - ReadULong64NoFence( &Ring.Read[ s ] );
+            }
+
+            InterlockedExchange( &Session.OverRingQuota, ( Limit != 0 && Queued >= Limit ) ? 1 : 0 );
+        }
+
+        for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+        {
+            const auto& Watch = Pool->Watches[ i ];
+            auto& Session = Pool->Sessions[ Watch.Session ];
+
+            Session.Events += Watch.Events;
+            Session.Rate += Watch.Rate;
+        }
+
+        for ( ULONG s = 0; s < Pool->SessionCount; s++ )
+        {
+            auto& Session = Pool->Sessions[ s ];
+
+            const auto Limit = Session.Quota.MaxEventRate;
+
+            Effective[ s ] = static_cast< ULONG64 >( ReadNoFence( &Session.Weight ) );
+            Session.Throttled = Limit != 0 && Session.Rate > Limit;
+
+            if ( Session.Throttled )
+            {
+                Effective[ s ] = max( Effective[ s ] * Limit / Session.Rate, 1llu );
+                Session.ThrottledPeriods++;
+            }
+
+            if ( Session.Watches != 0 )
+            {
+                Heaviest = max( Heaviest, Effective[ s ] );
+            }
+        }
+
+        for ( ULONG s = 0; s < Pool->SessionCount; s++ )
+        {
+            const auto Share = max( Effective[ s ] * mw::SESSION_SHARE_FULL / Heaviest, 1llu );
+
+            InterlockedExchange( &Pool->Sessions[ s ].Share, static_cast< LONG >( min( Share, mw::SESSION_SHARE_FULL ) ) );
+        }
+    }
+
+    /*
+     * Whether `Session` may take `Count` more watches, counting the refusal if not.
+     */
+    bool AdmitWatches( mw::SESSION& Session, const ULONG Count )
+    {
+        const auto Limit = Session.Quota.MaxWatches;
+
+        if ( Limit != 0 && Session.Watches + Count > Limit )
+        {
+            Session.RejectedWatches += Count;
+            return false;
+        }
+
+        return true;
+    }
+
+    /*
+     * Session an event was charged to when it was pushed.
+     */
+    ULONG SessionOf( const mw::POOL* Pool, const mw::EVENT& Event )
+    {
+        if ( Event.Flags & mw::EVENT_FLAG_CHANNEL )
+        {
+            return Pool->Channels[ ( Event.Watch & ~mw::CHANNEL_WATCH_BASE ) >> 8 ].Session;
+        }
+
+        return Pool->Watches[ Event.Watch ].Session;
+    }
+
+    /*
+     * Whether `Watcher` holds, or is about to receive, another replica of the same critical watch.
+     */
+    bool HostsReplica( mw::POOL* Pool, const mw::WATCH& Watch, const mw::MONITOR_CONTEXT& Watcher )
+    {
+        if ( !Watch.FanIn )
+        {
+            return false;
+        }
+
+        const auto Index = static_cast< LONG >( Watcher.Index );
+
+        for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+        {
+            const auto& Sibling = Pool->Watches[ i ];
+
+            if ( &Sibling == &Watch || Sibling.FanIn != Watch.FanIn )
+            {
+                continue;
+            }
+
+            if ( ReadNoFence( &Sibling.Owner ) == Index || ReadNoFence( &Sibling.MigrateTo ) == Index )
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /*
+     * Least loaded running watcher with room for `Count` more watches, other than `Exclude`.
+     * When `Watch` is given, watchers already holding one of its replicas are skipped. So are watchers serving realtime
+     * watches, unless `Realtime` is set.
+     */
+    mw::MONITOR_CONTEXT* LeastLoaded(
+        mw::POOL* Pool,
+        const ULONG Count,
+        const mw::MONITOR_CONTEXT* Exclude,
+        const mw::WATCH* Watch = nullptr,
+        const bool Realtime = false
+    )
+    {
+        mw::MONITOR_CONTEXT* Best = nullptr;
+
+        for ( auto& Watcher : Pool->Watchers )
+        {
+            if ( Watcher.State != mw::WatcherRunning || &Watcher == Exclude )
+            {
+                continue;
+            }
+
+            if ( Watcher.RealtimeWatches != 0 && !Realtime )
+            {
+                continue;
+            }
+
+            if ( Watch && HostsReplica( Pool, *Watch, Watcher ) )
+            {
+                continue;
+            }
+
+            if ( Watcher.OwnedWatches + Count > mw::MAX_WATCHES_PER_WATCHER )
+            {
+                continue;
+            }
+
+            if ( !Best || Watcher.Load < Best->Load )
+            {
+                Best = &Watcher;
+            }
+        }
+
+        return Best;
+    }
+
+    /*
+     * Running watcher already holding another member of the watch's group, if it has room for one more.
+     */
+    mw::MONITOR_CONTEXT* GroupOwner( mw::POOL* Pool, const mw::WATCH& Watch )
+    {
+        if ( Watch.Group == mw::NO_GROUP )
+        {
+            return nullptr;
+        }
+
+        for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+        {
+            const auto& Member = Pool->Watches[ i ];
+            const auto Owner = ReadNoFence( &Member.Owner );
+
+            if ( &Member == &Watch || Member.Group != Watch.Group || Owner < 0 )
+            {
+                continue;
+            }
+
+            auto& Watcher = Pool->Watchers[ Owner ];
+
+            if ( Watcher.State == mw::WatcherRunning && Watcher.OwnedWatches < mw::MAX_WATCHES_PER_WATCHER &&
+                 !HostsReplica( Pool, Watch, Watcher ) )
+            {
+                return &Watcher;
+            }
+        }
+
+        return nullptr;
+    }
+
+    VOID AssignWatch( mw::WATCH* Watch, mw::MONITOR_CONTEXT* Watcher )
+    {
+        InterlockedExchange( &Watch->Owner, static_cast< LONG >( Watcher->Index ) );
+        InterlockedPushEntrySList( &Watcher->Inbox, &Watch->HandOff );
+
+        Watcher->OwnedWatches++;
+        Watcher->RealtimeWatches += ( ReadNoFence( &Watch->Priority ) == mw::PriorityRealtime ) ? 1lu : 0lu;
+        Watcher->Load += Watch->Rate;
+
+        mw::KickWatcher( Watcher );
+    }
+
+    /*
+     * New watches (and ones orphaned by an exiting watcher) join the rest of their group if it's already placed.
+     * Otherwise a realtime watch gets a core of its own if there's budget for one, and other watches go to the least
+     * loaded watcher not serving a realtime watch, unless that one is already busy and there's budget for another core.
+     * Sharing a realtime watch's watcher is the last resort, `Grow` splits them up again once it can.
+     * Replicas of a critical watch never share a watcher, if no eligible one is left the replica waits for a core.
+     */
+    VOID PlaceWatches( mw::POOL* Pool )
+    {
+        for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+        {
+            auto& Watch = Pool->Watches[ i ];
+
+            if ( ReadNoFence( &Watch.Owner ) >= 0 )
+            {
+                continue;
+            }
+
+            auto Target = GroupOwner( Pool, Watch );
+
+            if ( Target )
+            {
+                AssignWatch( &Watch, Target );
+                continue;
+            }
+
+            const auto Priority = ReadNoFence( &Watch.Priority );
+
+            if ( Priority == mw::PriorityRealtime )
+            {
+                mw::MONITOR_CONTEXT* Started = nullptr;
+
+                Target = NT_SUCCESS( StartWatcher( Pool, Started ) ) ? Started : LeastLoaded( Pool, 1lu, nullptr, &Watch );
+            }
+            else
+            {
+                Target = LeastLoaded( Pool, 1lu, nullptr, &Watch );
+
+                /* Background watches, and sessions past their event rate quota, make do with the watchers there are. */
+                const auto Crowded = Target && Target->OwnedWatches != 0 && Target->Load >= mw::GROW_EVENT_RATE;
+                const auto MayGrow = Priority == mw::PriorityNormal && !Pool->Sessions[ Watch.Session ].Throttled;
+
+                if ( !Target || ( Crowded && MayGrow ) )
+                {
+                    mw::MONITOR_CONTEXT* Started = nullptr;
+
+                    if ( NT_SUCCESS( StartWatcher( Pool, Started ) ) )
+                    {
+                        Target = Started;
+                    }
+                }
+            }
+
+            if ( !Target )
+            {
+                Target = LeastLoaded( Pool, 1lu, nullptr, &Watch, true );
+            }
+
+            if ( !Target )
+            {
+                logmsg( "No watcher available for watch %lu\n", Watch.Id );
+
+                if ( Watch.FanIn )
+                {
+                    continue;
+                }
+
+                break;
+            }
+
+            AssignWatch( &Watch, Target );
+        }
+    }
+
+    /*
+     * Watches of the same group always move together. Ungrouped watches form a unit of their own. A unit's priority is
+     * that of its most urgent watch.
+     */
+    struct UNIT
+    {
+        ULONG Group;
+        ULONG Watch;
+        LONG Owner;
+        ULONG Count;
+        ULONG64 Rate;
+        LONG Priority;
+    };
+
+    bool InUnit( const mw::WATCH& Watch, const UNIT& Unit )
+    {
+        if ( ReadNoFence( &Watch.Owner ) != Unit.Owner )
+        {
+            return false;
+        }
+
+        return ( Watch.Group == mw::NO_GROUP ) ? ( Unit.Group == mw::NO_GROUP && Unit.Watch == Watch.Id )
+                                               : ( Unit.Group == Watch.Group );
+    }
+
+    /*
+     * Builds the units currently owned by running watchers, leaving out watches that are already on the move.
+     */
+    ULONG CollectUnits( mw::POOL* Pool, UNIT ( &Units )[ mw::MAX_WATCHES ] )
+    {
+        ULONG Count = 0lu;
+
+        for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+        {
+            const auto& Watch = Pool->Watches[ i ];
+            const auto Owner = ReadNoFence( &Watch.Owner );
+
+            if ( Owner < 0 || ReadNoFence( &Watch.MigrateTo ) >= 0 ||
+                 Pool->Watchers[ Owner ].State != mw::WatcherRunning )
+            {
+                continue;
+            }
+
+            UNIT* Unit = nullptr;
+
+            for ( ULONG j = 0; j < Count && Watch.Group != mw::NO_GROUP; j++ )
+            {
+                if ( InUnit( Watch, Units[ j ] ) )
+                {
+                    Unit = &Units[ j ];
+                    break;
+                }
+            }
+
+            if ( !Unit )
+            {
+                Unit = &Units[ Count++ ];
+                *Unit = { Watch.Group, Watch.Id, Owner, 0lu, 0llu, mw::PriorityCount };
+            }
+
+            Unit->Count++;
+            Unit->Rate += Watch.Rate;
+            Unit->Priority = min( Unit->Priority, ReadNoFence( &Watch.Priority ) );
+        }
+
+        return Count;
+    }
+
+    /*
+     * Moving the unit onto `Watcher` would put two replicas of a critical watch on the same core.
+     */
+    bool UnitConflicts( mw::POOL* Pool, const UNIT& Unit, const mw::MONITOR_CONTEXT& Watcher )
+    {
+        for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+        {
+            const auto& Watch = Pool->Watches[ i ];
+
+            if ( InUnit( Watch, Unit ) && HostsReplica( Pool, Watch, Watcher ) )
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    VOID MoveUnit( mw::POOL* Pool, UNIT& Unit, const ULONG To )
+    {
+        for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+        {
+            auto& Watch = Pool->Watches[ i ];
+
+            if ( InUnit( Watch, Unit ) )
+            {
+                mw::MigrateWatch( Pool, &Watch, To );
+            }
+        }
+
+        Unit.Owner = static_cast< LONG >( To );
+    }
+
+    /*
+     * Moves every unit that isn't realtime off a watcher serving realtime watches, onto the least loaded shared watchers.
+     * For when there's no core to give the realtime unit instead.
+     */
+    VOID Evacuate( mw::POOL* Pool, UNIT* Units, const ULONG Count, const mw::MONITOR_CONTEXT& Watcher )
+    {
+        for ( ULONG i = 0; i < Count; i++ )
+        {
+            auto& Unit = Units[ i ];
+
+            if ( Unit.Owner != static_cast< LONG >( Watcher.Index ) || Unit.Priority == mw::PriorityRealtime )
+            {
+                continue;
+            }
+
+            const auto Target = LeastLoaded( Pool, Unit.Count, &Watcher );
+
+            if ( !Target || UnitConflicts( Pool, Unit, *Target ) )
+            {
+                continue;
+            }
+
+            logmsg( "Moving %lu watch(es) off realtime watcher %lu to watcher %lu\n",
+                    Unit.Count,
+                    Watcher.Index,
+                    Target->Index
+            );
+
+            MoveUnit( Pool, Unit, Target->Index );
+        }
+    }
+
+    /*
+     * Gives a realtime unit that shares its watcher a core of its own, or failing that moves everything else off that
+     * watcher. Otherwise moves the hottest unit off the most loaded shared watcher onto a fresh core. Background units
+     * and sessions past their event rate quota never get a core of their own.
+     */
+    VOID Grow( mw::POOL* Pool )
+    {
+        UNIT Units[ mw::MAX_WATCHES ];
+
+        const auto Count = CollectUnits( Pool, Units );
+
+        ULONG UnitsOn[ mw::MAX_WATCHERS ] = { };
+
+        for ( ULONG i = 0; i < Count; i++ )
+        {
+            UnitsOn[ Units[ i ].Owner ]++;
+        }
+
+        mw::MONITOR_CONTEXT* Overloaded = nullptr;
+
+        for ( auto& Watcher : Pool->Watchers )
+        {
+            /* A single unit can't be split, a new core wouldn't help. */
+            if ( Watcher.State != mw::WatcherRunning || UnitsOn[ Watcher.Index ] < 2 )
+            {
+                continue;
+            }
+
+            const auto SharedRealtime = Watcher.RealtimeWatches != 0;
+
+            if ( !SharedRealtime && Watcher.Load < mw::GROW_EVENT_RATE && Watcher.MissRate == 0 )
+            {
+                continue;
+            }
+
+            /* A realtime watch sharing its watcher comes first, however quiet. */
+            if ( Overloaded && ( Overloaded->RealtimeWatches != 0 ) != SharedRealtime )
+            {
+                Overloaded = SharedRealtime ? &Watcher : Overloaded;
+                continue;
+            }
+
+            if ( !Overloaded || Watcher.Load > Overloaded->Load )
+            {
+                Overloaded = &Watcher;
+            }
+        }
+
+        if ( !Overloaded )
+        {
+            return;
+        }
+
+        UNIT* Hottest = nullptr;
+
+        for ( ULONG i = 0; i < Count; i++ )
+        {
+            const auto& Unit = Units[ i ];
+
+            if ( Unit.Owner != static_cast< LONG >( Overloaded->Index ) || Unit.Priority == mw::PriorityBackground )
+            {
+                continue;
+            }
+
+            if ( Pool->Sessions[ Pool->Watches[ Unit.Watch ].Session ].Throttled )
+            {
+                continue;
+            }
+
+            /* Realtime units before anything else, the hottest of them. */
+            if ( !Hottest || Unit.Priority < Hottest->Priority ||
+                 ( Unit.Priority == Hottest->Priority && Unit.Rate > Hottest->Rate ) )
+            {
+                Hottest = &Units[ i ];
+            }
+        }
+
+        mw::MONITOR_CONTEXT* Started = nullptr;
+
+        if ( !Hottest || !NT_SUCCESS( StartWatcher( Pool, Started ) ) )
+        {
+            if ( Overloaded->RealtimeWatches != 0 )
+            {
+                Evacuate( Pool, Units, Count, *Overloaded );
+            }
+
+            return;
+        }
+
+        logmsg( "Watcher %lu overloaded (load %llu, missed %llu, realtime %lu), moving %lu watch(es) to watcher %lu\n",
+                Overloaded->Index,
+                Overloaded->Load,
+                Overloaded->MissRate,
+                Overloaded->RealtimeWatches,
+                Hottest->Count,
+                Started->Index
+        );
+
+        MoveUnit( Pool, *Hottest, Started->Index );
+    }
+
+    /*
+     * Stops drained watchers, and starts draining one that has been quiet for long enough if a peer can absorb it.
+     */
+    VOID Shrink( mw::POOL* Pool )
+    {
+        ULONG Running = 0lu;
+
+        for ( auto& Watcher : Pool->Watchers )
+        {
+            if ( Watcher.State == mw::WatcherDraining && Watcher.OwnedWatches == 0 )
+            {
+                StopWatcher( &Watcher );
+                continue;
+            }
+
+            if ( Watcher.State != mw::WatcherRunning )
+            {
+                continue;
+            }
+
+            Running++;
+
+            Watcher.IdleTicks = ( Watcher.Load < mw::SHRINK_EVENT_RATE && Watcher.MissRate == 0 )
+                                    ? Watcher.IdleTicks + 1
+                                    : 0lu;
+        }
+
+        mw::MONITOR_CONTEXT* Quiet = nullptr;
+
+        for ( auto& Watcher : Pool->Watchers )
+        {
+            /* Realtime watches are allowed to be quiet, that's no reason to take their core away. */
+            if ( Watcher.State != mw::WatcherRunning || Watcher.IdleTicks < mw::SHRINK_AFTER_TICKS ||
+                 Watcher.RealtimeWatches != 0 )
+            {
+                continue;
+            }
+
+            if ( !Quiet || Watcher.Load < Quiet->Load )
+            {
+                Quiet = &Watcher;
+            }
+        }
+
+        if ( !Quiet )
+        {
+            return;
+        }
+
+        /* A watcher with nothing left to watch just goes away. */
+        if ( Quiet->OwnedWatches == 0 )
+        {
+            StopWatcher( Quiet );
+            return;
+        }
+
+        if ( Running < 2 )
+        {
+            return;
+        }
+
+        const auto Target = LeastLoaded( Pool, Quiet->OwnedWatches, Quiet );
+
+        if ( !Target || Target->Load + Quiet->Load >= mw::GROW_EVENT_RATE )
+        {
+            return;
+        }
+
+        for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+        {
+            const auto& Watch = Pool->Watches[ i ];
+
+            if ( ReadNoFence( &Watch.Owner ) == static_cast< LONG >( Quiet->Index ) &&
+                 HostsReplica( Pool, Watch, *Target ) )
+            {
+                return;
+            }
+        }
+
+        logmsg( "Watcher %lu idle for %lu periods, draining it into watcher %lu\n",
+                Quiet->Index,
+                Quiet->IdleTicks,
+                Target->Index
+        );
+
+        for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+        {
+            auto& Watch = Pool->Watches[ i ];
+
+            if ( ReadNoFence( &Watch.Owner ) == static_cast< LONG >( Quiet->Index ) )
+            {
+                mw::MigrateWatch( Pool, &Watch, Target->Index );
+            }
+        }
+
+        Quiet->State = mw::WatcherDraining;
+    }
+
+    /*
+     * Brings groups split across watchers (placement before the group was complete, or an earlier partial move)
+     * back together on the owner of their busiest part.
+     */
+    VOID Consolidate( mw::POOL* Pool, UNIT* Units, const ULONG Count )
+    {
+        for ( ULONG i = 0; i < Count; i++ )
+        {
+            auto& Part = Units[ i ];
+
+            if ( Part.Group == mw::NO_GROUP )
+            {
+                continue;
+            }
+
+            for ( ULONG j = 0; j < Count; j++ )
+            {
+                const auto& Main = Units[ j ];
+
+                if ( i == j || Main.Group != Part.Group || Main.Owner == Part.Owner )
+                {
+                    continue;
+                }
+
+                if ( Main.Rate < Part.Rate || ( Main.Rate == Part.Rate && Main.Count < Part.Count ) )
+                {
+                    continue;
+                }
+
+                const auto& Target = Pool->Watchers[ Main.Owner ];
+
+                if ( Target.OwnedWatches + Part.Count <= mw::MAX_WATCHES_PER_WATCHER &&
+                     !UnitConflicts( Pool, Part, Target ) )
+                {
+                    MoveUnit( Pool, Part, Target.Index );
+                    Part.Count = 0lu;
+                    Part.Rate = 0llu;
+                }
+
+                break;
+            }
+        }
+    }
+
+    /*
+     * Takes every watch away from a stalled watcher so `PlaceWatches` puts them somewhere else. The inbox is flushed
+     * and dropped without touching the watches in it, they're found by owner instead; repeated on every watchdog pass
+     * until the thread exits, in case a hand-off to it was already under way.
+     */
+    VOID Evict( mw::POOL* Pool, mw::MONITOR_CONTEXT& Watcher )
+    {
+        const auto Index = static_cast< LONG >( Watcher.Index );
+
+        InterlockedFlushSList( &Watcher.Inbox );
+
+        for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+        {
+            auto& Watch = Pool->Watches[ i ];
+
+            InterlockedCompareExchange( &Watch.MigrateTo, -1, Index );
+
+            if ( InterlockedCompareExchange( &Watch.Owner, -1, Index ) == Index )
+            {
+                logmsg( "Watch %lu taken away from stalled watcher %lu\n", Watch.Id, Watcher.Index );
+            }
+        }
+
+        Watcher.OwnedWatches = 0lu;
+        Watcher.Load = 0llu;
+    }
+
+    /*
+     * A watcher owning watches whose heartbeat didn't move since the last look is kicked; if it still hasn't moved by
+     * the next look it's stalled (or starved of its processor), since a kick wakes a healthy watcher from any wait state.
+     */
+    VOID Watchdog( mw::POOL* Pool )
+    {
+        for ( auto& Watcher : Pool->Watchers )
+        {
+            if ( Watcher.Stalled != 0 )
+            {
+                if ( Watcher.State == mw::WatcherStopping )
+                {
+                    Evict( Pool, Watcher );
+                }
+
+                continue;
+            }
+
+            if ( ( Watcher.State != mw::WatcherRunning && Watcher.State != mw::WatcherDraining ) ||
+                 Watcher.OwnedWatches == 0 )
+            {
+                Watcher.Probed = false;
+                continue;
+            }
+
+            const auto Heartbeat = ReadULong64NoFence( &Watcher.Heartbeat );
+
+            if ( Heartbeat != Watcher.LastHeartbeat )
+            {
+                Watcher.LastHeartbeat = Heartbeat;
+                Watcher.Probed = false;
+                continue;
+            }
+
+            if ( !Watcher.Probed )
+            {
+                Watcher.Probed = true;
+                mw::KickWatcher( &Watcher );
+                continue;
+            }
+
+            Pool->Stalls++;
+            Pool->ActiveWatchers--;
+
+            logmsg( "Watcher %lu on processor %lu made no progress since TSC %llu, taking its %lu watch(es) away\n",
+                    Watcher.Index,
+                    Watcher.Processor,
+                    Heartbeat,
+                    Watcher.OwnedWatches
+            );
+
+            InterlockedExchange( &Watcher.Stalled, 1 );
+            StopWatcher( &Watcher );
+            Evict( Pool, Watcher );
+        }
+    }
+
+    /*
+     * Greedily lowers the peak per-watcher event rate: repeatedly take the most loaded running watcher and move the unit
+     * that best evens it out with the least loaded one. Only moves that cut the peak by a meaningful fraction are made,
+     * so watches don't bounce back and forth on noise.
+     */
+    VOID Rebalance( mw::POOL* Pool )
+    {
+        UNIT Units[ mw::MAX_WATCHES ];
+
+        const auto Count = CollectUnits( Pool, Units );
+
+        Consolidate( Pool, Units, Count );
+
+        for ( ULONG Moves = 0; Moves < mw::REBALANCE_MAX_MOVES; Moves++ )
+        {
+            mw::MONITOR_CONTEXT* Busiest = nullptr;
+            mw::MONITOR_CONTEXT* Quietest = nullptr;
+
+            for ( auto& Watcher : Pool->Watchers )
+            {
+                /* Realtime watchers are sized by `Grow`, not by load. */
+                if ( Watcher.State != mw::WatcherRunning || Watcher.RealtimeWatches != 0 )
+                {
+                    continue;
+                }
+
+                if ( !Busiest || Watcher.Load > Busiest->Load )
+                {
+                    Busiest = &Watcher;
+                }
+
+                if ( !Quietest || Watcher.Load < Quietest->Load )
+                {
+                    Quietest = &Watcher;
+                }
+            }
+
+            if ( !Busiest || Busiest == Quietest )
+            {
+                return;
+            }
+
+            const auto Peak = Busiest->Load;
+            const auto MinGain = ( Peak >> mw::REBALANCE_MIN_GAIN_SHIFT ) + 1;
+
+            UNIT* Best = nullptr;
+            ULONG64 BestPeak = Peak;
+
+            for ( ULONG i = 0; i < Count; i++ )
+            {
+                auto& Unit = Units[ i ];
+
+                if ( Unit.Owner != static_cast< LONG >( Busiest->Index ) || Unit.Rate == 0 )
+                {
+                    continue;
+                }
+
+                if ( Quietest->OwnedWatches + Unit.Count > mw::MAX_WATCHES_PER_WATCHER ||
+                     UnitConflicts( Pool, Unit, *Quietest ) )
+                {
+                    continue;
+                }
+
+                const auto Left = Peak - Unit.Rate;
+                const auto Right = Quietest->Load + Unit.Rate;
+                const auto NewPeak = ( Left > Right ) ? Left : Right;
+
+                if ( NewPeak + MinGain <= BestPeak )
+                {
+                    Best = &Unit;
+                    BestPeak = NewPeak;
+                }
+            }
+
+            if ( !Best )
+            {
+                return;
+            }
+
+            logmsg( "Moving %lu watch(es) at %llu events/period from watcher %lu to %lu, peak %llu -> %llu\n",
+                    Best->Count,
+                    Best->Rate,
+                    Busiest->Index,
+                    Quietest->Index,
+                    Peak,
+                    BestPeak
+            );
+
+            MoveUnit( Pool, *Best, Quietest->Index );
+        }
+    }
+
+    /*
+     * With `BackendEvent` watchers don't see a store until told about it. Every watch on the address gets signalled,
+     * replicas of a critical watch included.
+     */
+    VOID SignalWatchers( mw::POOL* Pool, const ULONG_PTR Address )
+    {
+        if ( ReadNoFence( &Pool->Backend ) != mw::BackendEvent )
+        {
+            return;
+        }
+
+        for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+        {
+            const auto& Watch = Pool->Watches[ i ];
+            const auto Owner = ReadNoFence( &Watch.Owner );
+
+            if ( Watch.Address == Address && Owner >= 0 )
+            {
+                KeSetEvent( &Pool->Watchers[ Owner ].Wake, IO_NO_INCREMENT, false );
+            }
+        }
+    }
+}
+
+NTSTATUS mw::CreatePool( POOL*& Pool )
+{
+    Pool = static_cast< POOL* >( ExAllocatePool2( POOL_FLAG_NON_PAGED, sizeof( POOL ), POOL_TAG ) );
+
+    if ( !Pool )
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    ExInitializeFastMutex( &Pool->ReadLock );
+
+    Pool->IrqOffThreshold = IRQ_OFF_THRESHOLD_CYCLES;
+    Pool->Eligible = static_cast< LONG64 >( WATCHER_CPU_AFFINITY & KeQueryActiveProcessors( ) );
+    Pool->CoreBudget = static_cast< LONG >( WATCHER_CORE_BUDGET );
+    Pool->BackoffCeiling = static_cast< LONG64 >( NsToCycles( BACKOFF_CEILING_NS ) );
+    Pool->BackoffTpause = Cpu.UmwaitParks;
+    Pool->Backend = DefaultBackend( Cpu );
+
+    AddSession( Pool, "driver" );
+
+    return STATUS_SUCCESS;
+}
+
+VOID mw::DestroyPool( POOL* Pool )
+{
+    for ( auto& Watcher : Pool->Watchers )
+    {
+        if ( Watcher.State != WatcherFree )
+        {
+            StopWatcher( &Watcher );
+        }
+    }
+
+    ReapWatchers( Pool, true );
+
+    ExFreePoolWithTag( Pool, POOL_TAG );
+}
+
+LONG mw::AddSession( POOL* Pool, const char* Name )
+{
+    if ( Pool->SessionCount >= MAX_SESSIONS )
+    {
+        return -1;
+    }
+
+    auto& Session = Pool->Sessions[ Pool->SessionCount ];
+
+    memset( &Session, 0, sizeof( Session ) );
+
+    for ( ULONG i = 0; i + 1 < sizeof( Session.Name ) && Name[ i ] != '\0'; i++ )
+    {
+        Session.Name[ i ] = Name[ i ];
+    }
+
+    Session.Weight = static_cast< LONG >( SESSION_DEFAULT_WEIGHT );
+    Session.Share = static_cast< LONG >( SESSION_SHARE_FULL );
+
+    return static_cast< LONG >( Pool->SessionCount++ );
+}
+
+NTSTATUS mw::SetSession( POOL* Pool, const SESSION_REQUEST& Request )
+{
+    if ( Request.Session >= Pool->SessionCount || Request.Weight > SESSION_MAX_WEIGHT )
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    auto& Session = Pool->Sessions[ Request.Session ];
+
+    Session.Quota = Request.Quota;
+
+    if ( Request.Quota.MaxRingEvents == 0 )
+    {
+        InterlockedExchange( &Session.OverRingQuota, 0 );
+    }
+
+    /* Shares follow on the next manager period. */
+    InterlockedExchange( &Session.Weight, static_cast< LONG >( Request.Weight ? Request.Weight : SESSION_DEFAULT_WEIGHT ) );
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS mw::SetWatchPriority( POOL* Pool, const PRIORITY_REQUEST& Request )
+{
+    if ( Request.Watch >= Pool->WatchCount || Request.Priority >= PriorityCount )
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    const auto& Watch = Pool->Watches[ Request.Watch ];
+
+    for ( ULONG i = 0; i < Pool->WatchCount; i++ )
+    {
+        auto& Other = Pool->Watches[ i ];
+
+        if ( &Other == &Watch || ( Watch.FanIn && Other.FanIn == Watch.FanIn ) )
+        {
+            InterlockedExchange( &Other.Priority, static_cast< LONG >( Request.Priority ) );
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+mw::WATCH* mw::AddWatch( POOL* Pool, ULONG Session, ULONG_PTR Address, ULONG Group, volatile LONG64* WriteCount )
+{
+    if ( Pool->WatchCount >= MAX_WATCHES || Session >= Pool->SessionCount || !AdmitWatches( Pool->Sessions[ Session ], 1lu ) )
+    {
+        return nullptr;
+    }
+
+    auto& Watch = Pool->Watches[ Pool->WatchCount ];
+
+    memset( &Watch, 0, sizeof( Watch ) );
+
+    Watch.Id = Pool->WatchCount;
+    Watch.Session = Session;
+    Watch.Priority = PriorityNormal;
+    Watch.Group = Group;
+    Watch.Address = Address;
+    Watch.WriteCount = WriteCount;
+    Watch.LastValue = *reinterpret_cast< volatile ULONG64* >( Address );
+    Watch.LastWrite = __rdtsc ( );
+    Watch.Owner = -1;
+    Watch.MigrateTo = -1;
+
+    /* Don't count writes that happened before the watch existed as missed. */
+    Watch.Events = WriteCount ? static_cast< ULONG64 >( *WriteCount ) : 0llu;
+    Watch.EventsAtTick = Watch.Events;
+
+    Pool->WatchCount++;
+    Pool->Sessions[ Session ].Watches++;
+
+    return &Watch;
+}
+
+mw::WATCH* mw::AddReplicatedWatch(
+    POOL* Pool,
+    ULONG Session,
+    ULONG_PTR Address,
+    ULONG Group,
+    volatile LONG64* WriteCount,
+    ULONG Replicas
+)
+{
+    /* Every replica needs a core of its own. */
+    if ( Replicas == 0 || Replicas > MAX_REPLICAS || Replicas > WATCHER_CORE_BUDGET )
+    {
+        return nullptr;
+    }
+
+    if ( Pool->FanInCount >= MAX_FAN_INS || Pool->WatchCount + Replicas > MAX_WATCHES || Session >= Pool->SessionCount )
+    {
+        return nullptr;
+    }
+
+    /* All replicas or none. */
+    if ( !AdmitWatches( Pool->Sessions[ Session ], Replicas ) )
+    {
+        return nullptr;
+    }
+
+    auto& FanIn = Pool->FanIns[ Pool->FanInCount++ ];
+
+    memset( &FanIn, 0, sizeof( FanIn ) );
+
+    FanIn.Replicas = Replicas;
+
+    WATCH* Primary = nullptr;
+
+    for ( ULONG k = 0; k < Replicas; k++ )
+    {
+        /* Replicas are placed apart from each other, so only the primary can be part of a group. */
+        const auto Watch = AddWatch( Pool, Session, Address, k == 0 ? Group : NO_GROUP, k == 0 ? WriteCount : nullptr );
+
+        Watch->FanIn = &FanIn;
+        Watch->Replica = k;
+        Watch->Stagger = NsToCycles( k * REPLICA_STAGGER_NS );
+
+        if ( k == 0 )
+        {
+            Primary = Watch;
+        }
+    }
+
+    FanIn.Last[ 0 ] = static_cast< LONG64 >( Primary->LastValue );
+    FanIn.Last[ 1 ] = static_cast< LONG64 >( Primary->LastWrite );
+    FanIn.Accepted = static_cast< LONG64 >( Primary->Events );
+
+    return Primary;
+}
+
+VOID mw::MigrateWatch( POOL* Pool, WATCH* Watch, ULONG To )
+{
+    const auto Owner = ReadNoFence( &Watch->Owner );
+
+    if ( Owner < 0 || Owner == static_cast< LONG >( To ) )
+    {
+        return;
+    }
+
+    /* Already on its way somewhere. */
+    if ( InterlockedCompareExchange( &Watch->MigrateTo, static_cast< LONG >( To ), -1 ) != -1 )
+    {
+        return;
+    }
+
+    auto& Source = Pool->Watchers[ Owner ];
+    auto& Target = Pool->Watchers[ To ];
+
+    const auto Realtime = ReadNoFence( &Watch->Priority ) == PriorityRealtime ? 1lu : 0lu;
+
+    Source.OwnedWatches--;
+    Source.RealtimeWatches -= min( Source.RealtimeWatches, Realtime );
+    Source.Load -= ( Source.Load >= Watch->Rate ) ? Watch->Rate : Source.Load;
+
+    Target.OwnedWatches++;
+    Target.RealtimeWatches += Realtime;
+    Target.Load += Watch->Rate;
+
+    KickWatcher( &Source );
+}
+
+VOID mw::KickWatcher( MONITOR_CONTEXT* Watcher )
+{
+    /*
+     * `Pending` must be visible before `Armed` is sampled: the watcher publishes `Armed` before arming the monitor and
+     * checks `Pending` right after, so either it sees the flag or we see the line it's about to park on.
+     */
+    InterlockedExchange( &Watcher->Pending, 1 );
+
+    KeSetEvent( &Watcher->Wake, IO_NO_INCREMENT, false );
+
+    const auto Armed = ReadPointerAcquire( &Watcher->Armed );
+
+    if ( Armed )
+    {
+        /*
+         * An atomic no-op store is enough to trigger the monitor without disturbing the value,
+         * even if a producer writes to the same location concurrently.
+         */
+        InterlockedOr64( static_cast< volatile LONG64* >( Armed ), 0 );
+    }
+}
+
+VOID mw::WriteTestSlot( POOL* Pool, ULONG Index, ULONG64 Value )
+{
+    auto& Slot = TestSlots[ Index ];
+
+    *Slot.Value = Value;
+    InterlockedIncrement64( Slot.Writes );
+
+    SignalWatchers( Pool, reinterpret_cast< ULONG_PTR >( Slot.Value ) );
+}
+
+mw::CHANNEL* mw::AddChannel( POOL* Pool, SLOT_POOL* Slots, ULONG Session, ULONG Group, ULONG PayloadSlots )
+{
+    if ( PayloadSlots == 0 || PayloadSlots > MAX_CHANNEL_SLOTS || Pool->ChannelCount >= MAX_CHANNELS )
+    {
+        return nullptr;
+    }
+
+    const auto Doorbell = static_cast< volatile LONG64* >( AllocateSlot( Slots ) );
+
+    if ( !Doorbell )
+    {
+        return nullptr;
+    }
+
+    auto& Channel = Pool->Channels[ Pool->ChannelCount ];
+
+    memset( &Channel, 0, sizeof( Channel ) );
+
+    Channel.Index = Pool->ChannelCount;
+    Channel.Slots = PayloadSlots;
+    Channel.Session = Session;
+    Channel.Doorbell = Doorbell;
+
+    const auto Watch = AddWatch( Pool, Session, reinterpret_cast< ULONG_PTR >( Doorbell ), Group, &Channel.Rung );
+
+    if ( !Watch )
+    {
+        FreeSlot( Slots, const_cast< LONG64* >( Doorbell ) );
+        return nullptr;
+    }
+
+    Watch->Channel = &Channel;
+
+    Pool->ChannelCount++;
+
+    return &Channel;
+}
+
+bool mw::Publish( POOL* Pool, CHANNEL* Channel, ULONG Index, ULONG64 Value )
+{
+    auto& Slot = Channel->Payload[ Index ];
+
+    /* The version bump is a full barrier, the payload is visible before the slot is marked dirty. */
+    Slot.Value = Value;
+    InterlockedIncrement64( &Slot.Version );
+
+    InterlockedOr64( &Channel->Dirty, 1ll << Index );
+    InterlockedIncrement64( &Channel->Published );
+
+    /*
+     * Rung and not drained yet. The watcher clears `Pending` before it takes `Dirty`, so it's bound to see our bit.
+     */
+    if ( InterlockedExchange( &Channel->Pending, 1 ) != 0 )
+    {
+        return false;
+    }
+
+    InterlockedIncrement64( Channel->Doorbell );
+    InterlockedIncrement64( &Channel->Rung );
+
+    SignalWatchers( Pool, reinterpret_cast< ULONG_PTR >( Channel->Doorbell ) );
+
+    return true;
+}
+
+ULONG mw::ReadEvents( POOL* Pool, EVENT* Events, ULONG Capacity )
+{
+    ULONG Count = 0lu;
+
+    ExAcquireFastMutex( &Pool->ReadLock );
+
+    for ( ULONG i = 0; i < MAX_WATCHERS && Count < Capacity; i++ )
+    {
+        auto& Ring = Pool->Rings[ ( Pool->NextRing + i ) % MAX_WATCHERS ];
+
+        const auto Tail = Ring.Tail;
+        const auto Head = ReadAcquire64( &Ring.Head );
+
+        auto Available = static_cast< ULONG >( Head - Tail );
+
+        if ( Available > Capacity - Count )
+        {
+            Available = Capacity - Count;
+        }
+
+        /* At most two runs, the ring may wrap around once. */
+        for ( ULONG Copied = 0lu; Copied < Available; )
+        {
+            const auto Index = static_cast< ULONG >( ( Tail + Copied ) & ( EVENT_RING_SIZE - 1 ) );
+            const auto Run = min( Available - Copied, EVENT_RING_SIZE - Index );
+
+            memcpy( &Events[ Count + Copied ], &Ring.Events[ Index ], Run * sizeof( EVENT ) );
+
+            Copied += Run;
+        }
+
+        for ( ULONG j = 0; j < Available; j++ )
+        {
+            const auto Session = SessionOf( Pool, Events[ Count + j ] );
+
+            Ring.Read[ Session ]++;
+        }
+
+        WriteRelease64( &Ring.Tail, Tail + Available );
+
+        Count += Available;
+    }
+
+    Pool->NextRing = ( Pool->NextRing + 1 ) % MAX_WATCHERS;
+
+    ExReleaseFastMutex( &Pool->ReadLock );
+
+    return Count;
+}
+
+VOID mw::ScalePool( POOL* Pool )
+{
+    ReapWatchers( Pool, false );
+
+    /* Nothing moves while the system is going to sleep or waking up, watchers are all parked. */
+    if ( ReadNoFence( &Pool->Suspended ) != 0 )
+    {
+        return;
+    }
+
+    SampleRates( Pool );
+    ShareSessions( Pool );
+    PlaceWatches( Pool );
+    Grow( Pool );
+    Shrink( Pool );
+
+    if ( ++Pool->Ticks % REBALANCE_PERIODS == 0 )
+    {
+        Rebalance( Pool );
+    }
+
+    if ( Pool->Ticks % WATCHDOG_PERIODS == 0 )
+    {
+        Watchdog( Pool );
+    }
+}
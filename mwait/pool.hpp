@@ -0,0 +1,161 @@
+#pragma once
+
+#include "include.hpp"
+
+namespace mw
+{
+    /*
+     * Pool lifetime. `CreatePool` only allocates; watchers are started on demand by `ScalePool`.
+     */
+    NTSTATUS CreatePool( _Out_ POOL*& Pool );
+    VOID DestroyPool( _In_ POOL* Pool );
+
+    /*
+     * Processor hot-add and sleep/resume notifications, see system.cxx. Must be unregistered before `DestroyPool`.
+     */
+    NTSTATUS RegisterSystemCallbacks( _In_ POOL* Pool );
+    VOID UnregisterSystemCallbacks( _In_ POOL* Pool );
+
+    /*
+     * Creates a session with the default weight and no quotas, returns its index or -1 once there are `MAX_SESSIONS`.
+     * `CreatePool` creates `DRIVER_SESSION`. Sessions have to be created before the pool manager starts.
+     */
+    LONG AddSession( _In_ POOL* Pool, _In_z_ const char* Name );
+
+    /*
+     * Applies an `IOCTL_SET_SESSION`. Quotas only apply from then on: nothing a session already holds is taken away.
+     */
+    NTSTATUS SetSession( _In_ POOL* Pool, _In_ const SESSION_REQUEST& Request );
+
+    /*
+     * Registers a watch on behalf of `Session`. It stays unassigned until the next `ScalePool` places it on a watcher.
+     * Returns null if the pool is full or the session is at its watch quota.
+     */
+    WATCH* AddWatch(
+        _In_ POOL* Pool,
+        _In_ ULONG Session,
+        _In_ ULONG_PTR Address,
+        _In_ ULONG Group,
+        _In_opt_ volatile LONG64* WriteCount
+    );
+
+    /*
+     * Registers a critical watch served by `Replicas` watchers on distinct cores, whose detections are merged by a fan-in
+     * so each store is reported once. Returns replica 0, which carries the group and write count. Same rules as `AddWatch`.
+     */
+    WATCH* AddReplicatedWatch(
+        _In_ POOL* Pool,
+        _In_ ULONG Session,
+        _In_ ULONG_PTR Address,
+        _In_ ULONG Group,
+        _In_opt_ volatile LONG64* WriteCount,
+        _In_ ULONG Replicas
+    );
+
+    /*
+     * Applies an `IOCTL_SET_PRIORITY`, to every replica of a critical watch. The watch stays where it is until the pool
+     * manager gets to it: `Grow` splits realtime watches off shared watchers, `PlaceWatches` only sees new ones.
+     */
+    NTSTATUS SetWatchPriority( _In_ POOL* Pool, _In_ const PRIORITY_REQUEST& Request );
+
+    /*
+     * Asks the current owner of `Watch` to hand it over to watcher `To`. The hand-off itself happens on the owning
+     * watcher the next time it wakes up, so until then the watch keeps being served by its old owner.
+     */
+    VOID MigrateWatch( _In_ POOL* Pool, _In_ WATCH* Watch, _In_ ULONG To );
+
+    /*
+     * Gets a watcher to look at its inbox and control flags, wherever it's currently parked.
+     */
+    VOID KickWatcher( _In_ MONITOR_CONTEXT* Watcher );
+
+    /*
+     * Creates a publish channel whose doorbell is a slot taken from `Slots` and watched like any other watch.
+     * Returns null if either pool is full or the session is at its watch quota.
+     */
+    CHANNEL* AddChannel( _In_ POOL* Pool, _In_ SLOT_POOL* Slots, _In_ ULONG Session, _In_ ULONG Group, _In_ ULONG PayloadSlots );
+
+    /*
+     * Stores `Value` to payload slot `Index`, bumps its version and marks it dirty, then rings the channel's doorbell
+     * unless a ring is already pending. Returns whether it rang. Safe to call from several producers at once, at any
+     * IRQL up to DISPATCH_LEVEL.
+     */
+    bool Publish( _In_ POOL* Pool, _In_ CHANNEL* Channel, _In_ ULONG Index, _In_ ULONG64 Value );
+
+    /*
+     * Stores `Value` to a test slot and counts the write. With `BackendEvent` it also signals whichever watchers hold a
+     * watch on the slot, since they don't see the store otherwise until their wait times out.
+     */
+    VOID WriteTestSlot( _In_ POOL* Pool, _In_ ULONG Index, _In_ ULONG64 Value );
+
+    /*
+     * Moves up to `Capacity` detected events out of the watcher rings, returns how many were copied.
+     * Must be called at PASSIVE_LEVEL or APC_LEVEL.
+     */
+    ULONG ReadEvents( _In_ POOL* Pool, _Out_writes_( Capacity ) EVENT* Events, _In_ ULONG Capacity );
+
+    /*
+     * One pool manager period: reap exited watchers, sample event rates, place new watches and grow or shrink the pool.
+     * Every few periods it also rebalances and checks watcher heartbeats.
+     * Must only ever be called from a single thread at a time.
+     */
+    VOID ScalePool( _In_ POOL* Pool );
+
+    /*
+     * Watch targets, see slots.cxx. Slots come zeroed, `AllocateSlot` returns null once the pool is exhausted.
+     * Must be called at PASSIVE_LEVEL or APC_LEVEL.
+     */
+    NTSTATUS CreateSlots( _Out_ SLOT_POOL*& Slots );
+    VOID DestroySlots( _In_ SLOT_POOL* Slots );
+    PVOID AllocateSlot( _In_ SLOT_POOL* Slots );
+    VOID FreeSlot( _In_ SLOT_POOL* Slots, _In_ PVOID Slot );
+
+    /*
+     * Trace replay through the load generator, see replay.cxx.
+     */
+    NTSTATUS CreateReplay( _Out_ REPLAY*& Replay );
+    VOID DestroyReplay( _In_ REPLAY* Replay );
+
+    /*
+     * Applies `Flags`, queues as many of `Writes` as there is room for and fills in `Status`. Fails without queuing
+     * anything if a write targets a slot that doesn't exist. Must be called at PASSIVE_LEVEL or APC_LEVEL.
+     */
+    NTSTATUS QueueReplay(
+        _In_ REPLAY* Replay,
+        _In_ ULONG Flags,
+        _In_reads_( Count ) const REPLAY_WRITE* Writes,
+        _In_ ULONG Count,
+        _Out_ REPLAY_STATUS& Status
+    );
+
+    /*
+     * Worker side: plays every queued write due within `REPLAY_SPIN_NS` to the test slots of `Pool`, spinning until
+     * each one is due. Returns false when there's nothing due that soon and the caller may sleep. Must only ever be
+     * called from a single thread.
+     */
+    bool PlayReplay( _In_ POOL* Pool, _In_ REPLAY* Replay );
+
+    /*
+     * One-way latency probes, see probe.cxx. `ControlProbes` applies `PROBE_FLAG_*` and `ReportProbes` fills in as much
+     * of a `PROBE_REPORT` as fits in `Length` bytes, returning how many it wrote. Both at PASSIVE_LEVEL or APC_LEVEL.
+     */
+    VOID ControlProbes( _In_ POOL* Pool, _In_ ULONG Flags );
+    SIZE_T ReportProbes( _In_ POOL* Pool, _Out_writes_bytes_( Length ) PROBE_REPORT* Report, _In_ SIZE_T Length );
+
+    /*
+     * Worker side: writes one probe to every test slot, waiting for the echo where one is due. Must only ever be called
+     * from a single thread.
+     */
+    VOID WriteProbes( _In_ POOL* Pool );
+
+    /*
+     * Watcher side: a watch saw `Value` at `Detected`. Echoes it if asked to and `Answer` says this detection is the
+     * one reported, and records its latency. Ignores anything that isn't a probe.
+     */
+    VOID RecordProbe( _In_ MONITOR_CONTEXT* Watcher, _In_ ULONG64 Value, _In_ ULONG64 Detected, _In_ bool Answer );
+
+    /*
+     * Watcher thread routine, see watcher.cxx.
+     */
+    VOID Monitor( _In_ VOID* Context );
+}
@@ -0,0 +1,272 @@
+#include "pool.hpp"
+
+namespace
+{
+    constexpr ULONG64 PROBE_TSC_MASK = ( 1llu << mw::PROBE_TSC_BITS ) - 1;
+    constexpr ULONG64 ECHO_TSC_MASK = ( 1llu << mw::ECHO_TSC_BITS ) - 1;
+
+    /* Treats the low `Bits` of `Value` as a two's complement number. */
+    LONG64 SignExtend( const ULONG64 Value, const ULONG Bits )
+    {
+        const auto Shift = 64lu - Bits;
+
+        return static_cast< LONG64 >( Value << Shift ) >> Shift;
+    }
+
+    VOID Count( ULONG64 ( &Histogram )[ mw::PROBE_BUCKETS ], const ULONG64 Cycles )
+    {
+        ULONG Bucket = 0lu;
+        _BitScanReverse64( &Bucket, Cycles | 1 );
+
+        Histogram[ min( Bucket, mw::PROBE_BUCKETS - 1 ) ]++;
+    }
+
+    /*
+     * Finds the writer slot of `Processor`, claiming a free one the first time. Returns -1 once every slot belongs to
+     * some other processor, probes from that processor then can't be told apart and aren't written at all.
+     */
+    LONG WriterSlot( mw::POOL* Pool, const ULONG Processor )
+    {
+        const auto Tag = static_cast< LONG >( Processor + 1 );
+
+        for ( ULONG i = 0; i < mw::PROBE_MAX_WRITERS; i++ )
+        {
+            const auto Owner = InterlockedCompareExchange( &Pool->ProbeWriters[ i ], Tag, 0 );
+
+            if ( Owner == 0 || Owner == Tag )
+            {
+                return static_cast< LONG >( i );
+            }
+        }
+
+        return -1;
+    }
+
+    /*
+     * Spins until the watcher echoes probe `Sequence`, or the timeout runs out. Stale echoes are told apart by their
+     * sequence number. Of a replicated watch only the replica whose detection is reported answers, the others would
+     * store their own index and TSC and skew the round trip by however much later they saw the probe.
+     */
+    bool WaitForEcho( mw::POOL* Pool, const ULONG64 Sequence, ULONG64& Echo, ULONG64& Received )
+    {
+        const auto Deadline = __rdtsc ( ) + mw::NsToCycles( mw::PROBE_ECHO_TIMEOUT_NS );
+
+        for ( ;; )
+        {
+            Echo = static_cast< ULONG64 >( ReadAcquire64( Pool->ProbeEcho ) );
+            Received = __rdtsc ( );
+
+            if ( ( Echo >> mw::ECHO_SEQUENCE_SHIFT ) == Sequence )
+            {
+                return true;
+            }
+
+            if ( Received >= Deadline )
+            {
+                return false;
+            }
+
+            YieldProcessor( );
+        }
+    }
+}
+
+VOID mw::ControlProbes( POOL* Pool, ULONG Flags )
+{
+    if ( Flags & ( PROBE_FLAG_START | PROBE_FLAG_STOP ) )
+    {
+        InterlockedExchange( &Pool->Probing, 0 );
+    }
+
+    if ( Flags & PROBE_FLAG_START )
+    {
+        /* A probe already in flight may still land in the fresh statistics, it's as valid as any other. */
+        memset( Pool->ProbePairs, 0, sizeof( Pool->ProbePairs ) );
+
+        Pool->Probes = 0llu;
+        Pool->EchoTimeouts = 0llu;
+
+        InterlockedExchange( &Pool->Probing, 1 );
+    }
+}
+
+SIZE_T mw::ReportProbes( POOL* Pool, PROBE_REPORT* Report, SIZE_T Length )
+{
+    const auto Header = FIELD_OFFSET( PROBE_REPORT, Pair );
+
+    if ( Length < Header )
+    {
+        return 0;
+    }
+
+    memset( Report, 0, Header );
+
+    Report->Active = static_cast< ULONG >( ReadAcquire( &Pool->Probing ) );
+    Report->TscPerMicrosecond = Cpu.TscPerMicrosecond;
+    Report->Probes = Pool->Probes;
+    Report->EchoTimeouts = Pool->EchoTimeouts;
+
+    /* A free watcher's column is stale, it's cleared when the slot is next started, maybe on another processor. */
+    for ( const auto& Writer : Pool->ProbePairs )
+    {
+        for ( ULONG j = 0; j < MAX_WATCHERS; j++ )
+        {
+            const auto& Pair = Writer[ j ];
+
+            Report->Pairs += ( Pool->Watchers[ j ].State != WatcherFree && ( Pair.Samples || Pair.RoundTrips ) ) ? 1lu : 0lu;
+        }
+    }
+
+    if ( Length < ProbeReportSize( Report->Pairs ) )
+    {
+        return Header;
+    }
+
+    auto Entry = Report->Pair;
+
+    for ( ULONG i = 0; i < PROBE_MAX_WRITERS; i++ )
+    {
+        for ( ULONG j = 0; j < MAX_WATCHERS; j++ )
+        {
+            const auto& Pair = Pool->ProbePairs[ i ][ j ];
+
+            /* Pairs that became active since they were counted have to wait for the next report. */
+            if ( Pool->Watchers[ j ].State == WatcherFree || !( Pair.Samples || Pair.RoundTrips ) ||
+                 Entry == &Report->Pair[ Report->Pairs ] )
+            {
+                continue;
+            }
+
+            memcpy( Entry, &Pair, sizeof( Pair ) );
+
+            Entry->Writer = static_cast< ULONG >( Pool->ProbeWriters[ i ] - 1 );
+            Entry->Watcher = Pool->Watchers[ j ].Processor;
+
+            Entry++;
+        }
+    }
+
+    return ProbeReportSize( Report->Pairs );
+}
+
+VOID mw::WriteProbes( POOL* Pool )
+{
+    const auto Writer = WriterSlot( Pool, KeGetCurrentProcessorNumber( ) );
+
+    if ( Writer < 0 )
+    {
+        return;
+    }
+
+    for ( ULONG i = 0; i < TEST_WATCH_COUNT; i++ )
+    {
+        const auto Sequence = ++Pool->ProbeSequence & PROBE_SEQUENCE_MASK;
+
+        /* Never on sequence 0, which is what the echo slot reads before anyone stored to it. */
+        const auto Echo = ( Sequence % PROBE_ECHO_EVERY ) == PROBE_ECHO_EVERY - 1;
+
+        const auto Sent = __rdtsc ( );
+
+        WriteTestSlot( Pool, i, PROBE_MARKER |
+                                ( Echo ? PROBE_ECHO : 0llu ) |
+                                ( static_cast< ULONG64 >( Writer ) << PROBE_WRITER_SHIFT ) |
+                                ( Sequence << PROBE_SEQUENCE_SHIFT ) |
+                                ( Sent & PROBE_TSC_MASK ) );
+
+        Pool->Probes++;
+
+        if ( !Echo )
+        {
+            continue;
+        }
+
+        ULONG64 Reply = 0llu;
+        ULONG64 Received = 0llu;
+
+        if ( !WaitForEcho( Pool, Sequence, Reply, Received ) )
+        {
+            Pool->EchoTimeouts++;
+            continue;
+        }
+
+        const auto Watcher = ( Reply >> ECHO_WATCHER_SHIFT ) & 0xff;
+
+        if ( Watcher >= MAX_WATCHERS )
+        {
+            continue;
+        }
+
+        /*
+         * If both legs took equally long the watcher stored the echo halfway through the round trip, so whatever its TSC
+         * read beyond the writer's midpoint is skew. Only the low bits of the watcher's TSC made it into the echo, the
+         * difference is taken within them.
+         */
+        const auto Rtt = Received - Sent;
+        const auto Midpoint = Sent + Rtt / 2;
+        const auto Skew = SignExtend( ( Reply - Midpoint ) & ECHO_TSC_MASK, ECHO_TSC_BITS );
+
+        auto& Pair = Pool->ProbePairs[ Writer ][ Watcher ];
+
+        if ( Pair.RoundTrips == 0 || Rtt < Pair.RttMin )
+        {
+            Pair.RttMin = Rtt;
+            WriteRelease64( &Pair.Skew, Skew );
+        }
+
+        Pair.HalfRttSum += Rtt / 2;
+        Count( Pair.HalfRtt, Rtt / 2 );
+
+        /* Last, the watcher only corrects its samples once there's a skew to correct them with. */
+        WriteRelease64( reinterpret_cast< volatile LONG64* >( &Pair.RoundTrips ), static_cast< LONG64 >( Pair.RoundTrips + 1 ) );
+    }
+}
+
+VOID mw::RecordProbe( MONITOR_CONTEXT* Watcher, ULONG64 Value, ULONG64 Detected, bool Answer )
+{
+    const auto Pool = Watcher->Pool;
+
+    if ( !( Value & PROBE_MARKER ) || !ReadNoFence( &Pool->Probing ) )
+    {
+        return;
+    }
+
+    const auto Sequence = ( Value >> PROBE_SEQUENCE_SHIFT ) & PROBE_SEQUENCE_MASK;
+
+    /* Before anything else, whatever runs in between lengthens the round trip. */
+    if ( ( Value & PROBE_ECHO ) && Answer )
+    {
+        WriteRelease64( Pool->ProbeEcho, static_cast< LONG64 >(
+            ( Sequence << ECHO_SEQUENCE_SHIFT ) |
+            ( static_cast< ULONG64 >( Watcher->Index ) << ECHO_WATCHER_SHIFT ) |
+            ( __rdtsc ( ) & ECHO_TSC_MASK ) ) );
+    }
+
+    auto& Pair = Pool->ProbePairs[ ( Value >> PROBE_WRITER_SHIFT ) & ( PROBE_MAX_WRITERS - 1 ) ][ Watcher->Index ];
+
+    const auto Calibrated = ReadAcquire64( reinterpret_cast< volatile LONG64* >( &Pair.RoundTrips ) ) != 0;
+
+    /* Negative when the watcher's TSC runs behind the writer's by more than the latency, which the skew corrects. */
+    const auto Raw = SignExtend( ( Detected - Value ) & PROBE_TSC_MASK, PROBE_TSC_BITS );
+
+    auto Latency = Raw - ( Calibrated ? ReadNoFence64( &Pair.Skew ) : 0ll );
+
+    if ( !Calibrated )
+    {
+        Pair.Uncorrected++;
+    }
+
+    if ( Latency < 0 )
+    {
+        Pair.Negative++;
+        Latency = 0;
+    }
+
+    const auto Cycles = static_cast< ULONG64 >( Latency );
+
+    Pair.Min = ( Pair.Samples == 0 || Cycles < Pair.Min ) ? Cycles : Pair.Min;
+    Pair.Max = max( Pair.Max, Cycles );
+    Pair.Sum += Cycles;
+    Pair.Samples++;
+
+    Count( Pair.OneWay, Cycles );
+}
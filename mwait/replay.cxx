@@ -0,0 +1,166 @@
+#include "pool.hpp"
+
+namespace
+{
+    constexpr ULONG REPLAY_TAG = 'pRwM';
+
+    /*
+     * Brings the worker's side in line with the latest start or stop.
+     */
+    VOID CatchUp( mw::REPLAY* Replay )
+    {
+        const auto Generation = ReadAcquire( &Replay->Generation );
+
+        if ( Generation == Replay->Seen )
+        {
+            return;
+        }
+
+        WriteRelease64( &Replay->Tail, ReadAcquire64( &Replay->Discard ) );
+
+        Replay->Seen = Generation;
+        Replay->Base = 0llu;
+        Replay->Played = 0llu;
+        Replay->LatenessSum = 0llu;
+        Replay->LatenessMax = 0llu;
+        Replay->LastDue = 0llu;
+        Replay->LastPlayed = 0llu;
+
+        memset( Replay->Lateness, 0, sizeof( Replay->Lateness ) );
+    }
+}
+
+NTSTATUS mw::CreateReplay( REPLAY*& Replay )
+{
+    Replay = static_cast< REPLAY* >( ExAllocatePool2( POOL_FLAG_NON_PAGED, sizeof( REPLAY ), REPLAY_TAG ) );
+
+    if ( !Replay )
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    ExInitializeFastMutex( &Replay->Lock );
+
+    return STATUS_SUCCESS;
+}
+
+VOID mw::DestroyReplay( REPLAY* Replay )
+{
+    ExFreePoolWithTag( Replay, REPLAY_TAG );
+}
+
+NTSTATUS mw::QueueReplay( REPLAY* Replay, ULONG Flags, const REPLAY_WRITE* Writes, ULONG Count, REPLAY_STATUS& Status )
+{
+    memset( &Status, 0, sizeof( Status ) );
+
+    for ( ULONG i = 0; i < Count; i++ )
+    {
+        if ( Writes[ i ].Slot >= TEST_WATCH_COUNT )
+        {
+            return STATUS_INVALID_PARAMETER;
+        }
+    }
+
+    ExAcquireFastMutex( &Replay->Lock );
+
+    auto Head = Replay->Head;
+
+    if ( Flags & ( REPLAY_FLAG_START | REPLAY_FLAG_STOP ) )
+    {
+        WriteRelease64( &Replay->Discard, Head );
+        InterlockedIncrement( &Replay->Generation );
+        InterlockedExchange( &Replay->Active, ( Flags & REPLAY_FLAG_STOP ) ? 0l : 1l );
+    }
+
+    /* Right after a start the worker may not have skipped the old writes yet, they still count against the room. */
+    const auto Free = REPLAY_QUEUE_SIZE - static_cast< ULONG >( Head - ReadAcquire64( &Replay->Tail ) );
+    const auto Accepted = ( Flags & REPLAY_FLAG_STOP ) ? 0lu : min( Count, Free );
+
+    /* At most two runs, the queue may wrap around once. */
+    for ( ULONG Copied = 0lu; Copied < Accepted; )
+    {
+        const auto Index = static_cast< ULONG >( ( Head + Copied ) & ( REPLAY_QUEUE_SIZE - 1 ) );
+        const auto Run = min( Accepted - Copied, REPLAY_QUEUE_SIZE - Index );
+
+        memcpy( &Replay->Writes[ Index ], &Writes[ Copied ], Run * sizeof( REPLAY_WRITE ) );
+
+        Copied += Run;
+    }
+
+    Head += Accepted;
+
+    WriteRelease64( &Replay->Head, Head );
+
+    ExReleaseFastMutex( &Replay->Lock );
+
+    Status.Slots = TEST_WATCH_COUNT;
+    Status.Accepted = Accepted;
+    Status.Queued = static_cast< ULONG64 >( Head - ReadAcquire64( &Replay->Tail ) );
+    Status.Capacity = REPLAY_QUEUE_SIZE;
+    Status.Played = Replay->Played;
+    Status.LatenessSum = Replay->LatenessSum;
+    Status.LatenessMax = Replay->LatenessMax;
+    Status.LastDue = Replay->LastDue;
+    Status.LastPlayed = Replay->LastPlayed;
+
+    memcpy( Status.Lateness, Replay->Lateness, sizeof( Status.Lateness ) );
+
+    return STATUS_SUCCESS;
+}
+
+bool mw::PlayReplay( POOL* Pool, REPLAY* Replay )
+{
+    CatchUp( Replay );
+
+    /* Only writes due before this are played in one go, so a dense trace can't keep the worker from seeing unload. */
+    const auto Horizon = __rdtsc ( ) + NsToCycles( REPLAY_SPIN_NS );
+
+    auto Tail = Replay->Tail;
+
+    for ( ;; )
+    {
+        if ( Tail == ReadAcquire64( &Replay->Head ) )
+        {
+            return false;
+        }
+
+        const auto& Write = Replay->Writes[ Tail & ( REPLAY_QUEUE_SIZE - 1 ) ];
+
+        if ( Replay->Base == 0llu )
+        {
+            Replay->Base = __rdtsc ( ) - Write.Offset;
+        }
+
+        const auto Due = Replay->Base + Write.Offset;
+
+        if ( Due > Horizon )
+        {
+            const auto Now = __rdtsc ( );
+
+            /* If the next write is close enough that sleeping could make it late, come straight back for it. */
+            return Due <= Now || Due - Now < NsToCycles( REPLAY_SPIN_NS );
+        }
+
+        while ( __rdtsc ( ) < Due )
+        {
+            _mm_pause ( );
+        }
+
+        WriteTestSlot( Pool, Write.Slot, ( Write.Flags & REPLAY_WRITE_TIMESTAMP ) ? __rdtsc ( ) : Write.Value );
+
+        const auto Played = __rdtsc ( );
+        const auto Lateness = Played - Due;
+
+        ULONG Bucket = 0lu;
+        _BitScanReverse64( &Bucket, Lateness | 1llu );
+
+        Replay->Lateness[ Bucket < REPLAY_LATENESS_BUCKETS ? Bucket : REPLAY_LATENESS_BUCKETS - 1 ]++;
+        Replay->LatenessSum += Lateness;
+        Replay->LatenessMax = max( Replay->LatenessMax, Lateness );
+        Replay->LastDue = Write.Offset;
+        Replay->LastPlayed = Played - Replay->Base;
+        Replay->Played++;
+
+        WriteRelease64( &Replay->Tail, ++Tail );
+    }
+}
@@ -0,0 +1,596 @@
+#pragma once
+
+/*
+ * Definitions shared between the driver and user-mode clients.
+ * Only basic Windows types may be used here since this header is included from both sides
+ * (`ntifs.h` in the driver, `windows.h` + `winioctl.h` in user-mode).
+ */
+
+namespace mw
+{
+    constexpr ULONG IOCTL_QUERY_STATS = CTL_CODE( FILE_DEVICE_UNKNOWN, 0x800, METHOD_BUFFERED, FILE_ANY_ACCESS );
+
+    /*
+     * Input: a single `ULONG64` with the new interrupt-off threshold, in TSC cycles.
+     */
+    constexpr ULONG IOCTL_SET_IRQ_THRESHOLD = CTL_CODE( FILE_DEVICE_UNKNOWN, 0x801, METHOD_BUFFERED, FILE_ANY_ACCESS );
+
+    /*
+     * Output: as many `EVENT` records as fit in the buffer, taken from every watcher's ring in turn. Records from one
+     * watcher are in detection order, records from different watchers are not ordered with respect to each other.
+     */
+    constexpr ULONG IOCTL_READ_EVENTS = CTL_CODE( FILE_DEVICE_UNKNOWN, 0x802, METHOD_BUFFERED, FILE_ANY_ACCESS );
+
+    /*
+     * Input: a `REPLAY_REQUEST` followed by `Count` `REPLAY_WRITE` records, queued for the load generator to play back
+     * to the test slots in place of its own writes. Only as many records as there is room for are taken.
+     * Output: a `REPLAY_STATUS`.
+     */
+    constexpr ULONG IOCTL_REPLAY = CTL_CODE( FILE_DEVICE_UNKNOWN, 0x803, METHOD_BUFFERED, FILE_ANY_ACCESS );
+
+    /* Drops whatever is still queued and starts a new timeline: the next write queued is played right away. */
+    constexpr ULONG REPLAY_FLAG_START = 1lu << 0;
+
+    /* Drops whatever is still queued and hands the test slots back to the load generator. */
+    constexpr ULONG REPLAY_FLAG_STOP = 1lu << 1;
+
+    /* Per write: store the TSC at which the write is made instead of `Value`, for measuring detection latency. */
+    constexpr ULONG REPLAY_WRITE_TIMESTAMP = 1lu << 0;
+
+    /*
+     * Bucket `i` counts writes played [2^i, 2^(i+1)) cycles after they were due, the last bucket absorbs the rest.
+     */
+    constexpr ULONG REPLAY_LATENESS_BUCKETS = 48lu;
+
+    struct REPLAY_WRITE
+    {
+        /* When to write, in TSC cycles of the driver's processor since the start of the timeline. */
+        ULONG64 Offset;
+
+        ULONG64 Value;
+        ULONG Slot;
+        ULONG Flags;
+    };
+
+    struct REPLAY_REQUEST
+    {
+        ULONG Flags;
+        ULONG Count;
+
+        REPLAY_WRITE Writes[ 1 ];
+    };
+
+    struct REPLAY_STATUS
+    {
+        /* Test slots a write may target. */
+        ULONG Slots;
+
+        /* Records taken from this request, and how many are still waiting to be played. */
+        ULONG Accepted;
+        ULONG64 Queued;
+        ULONG64 Capacity;
+
+        /*
+         * Since the last `REPLAY_FLAG_START`. Lateness is how long after its offset each write actually landed, in TSC
+         * cycles; `LastDue` and `LastPlayed` are the offset and actual time of the latest write, both on the timeline.
+         */
+        ULONG64 Played;
+        ULONG64 LatenessSum;
+        ULONG64 LatenessMax;
+        ULONG64 LastDue;
+        ULONG64 LastPlayed;
+        ULONG64 Lateness[ REPLAY_LATENESS_BUCKETS ];
+    };
+
+    /*
+     * Input: a `BACKEND_REQUEST`. Makes every watcher wait with the given backend instead of letting the governor
+     * choose, or hands the choice back to it with `BackendGovernor`. Fails if the processor doesn't support it.
+     */
+    constexpr ULONG IOCTL_SET_BACKEND = CTL_CODE( FILE_DEVICE_UNKNOWN, 0x804, METHOD_BUFFERED, FILE_ANY_ACCESS );
+
+    /*
+     * How watchers wait for a store. A watcher with several watches always scans them, whatever the backend.
+     */
+    enum BACKEND : ULONG
+    {
+        /* The governor picks a wait state per iteration from the table in `STATS`. */
+        BackendGovernor,
+
+        BackendSpin,
+        BackendMwait,
+        BackendUmwait,
+
+        /* AMD's `monitorx`/`mwaitx`. */
+        BackendMwaitx,
+
+        /* Interrupts stay enabled and the watcher blocks on an event the producer signals after storing. */
+        BackendEvent,
+
+        /*
+         * For when `monitor`/`mwait` are missing or trapped by a hypervisor. Polls every watch with plain reads and backs
+         * off exponentially between polls, with `pause` or, where the processor has WAITPKG, `tpause`.
+         */
+        BackendBackoff,
+
+        BackendCount
+    };
+
+    /* Measure how much of the time watchers spend waiting their core is still in C0, see `WATCHER_STATS`. */
+    constexpr ULONG BACKEND_FLAG_RESIDENCY = 1lu << 0;
+
+    /* `BackendBackoff` only: back off with `pause` even where `tpause` is available. */
+    constexpr ULONG BACKEND_FLAG_NO_TPAUSE = 1lu << 1;
+
+    struct BACKEND_REQUEST
+    {
+        ULONG Backend;
+        ULONG Flags;
+
+        /* `BackendBackoff` only: the longest gap between two polls in nanoseconds, 0 for the default. */
+        ULONG BackoffCeilingNs;
+        ULONG Reserved;
+    };
+
+    /*
+     * Input: a `PROBE_REQUEST`. Output: a `PROBE_REPORT` followed by `Pairs` `PROBE_PAIR_STATS`, or only the header if
+     * the output buffer is too small for them.
+     *
+     * While probing, the load generator writes its TSC and a sequence number to the test slots instead of its usual
+     * pattern, and the watchers turn every probe they detect into a one-way writer-to-detection latency.
+     */
+    constexpr ULONG IOCTL_PROBE = CTL_CODE( FILE_DEVICE_UNKNOWN, 0x805, METHOD_BUFFERED, FILE_ANY_ACCESS );
+
+    /* Clears the statistics and starts probing. */
+    constexpr ULONG PROBE_FLAG_START = 1lu << 0;
+
+    /* Stops probing, the statistics stay around until the next start. */
+    constexpr ULONG PROBE_FLAG_STOP = 1lu << 1;
+
+    /*
+     * Bucket `i` counts latencies of [2^i, 2^(i+1)) TSC cycles, bucket 0 also holds 0 and the last bucket the rest.
+     */
+    constexpr ULONG PROBE_BUCKETS = 48lu;
+
+    struct PROBE_REQUEST
+    {
+        ULONG Flags;
+        ULONG Reserved;
+    };
+
+    /*
+     * One writer processor and one watcher processor. TSCs of different processors need not agree, so every few probes
+     * the watcher echoes one back and the writer times the round trip. `Skew` is taken from the round trip with the
+     * shortest RTT and assumes both legs of it took equally long.
+     */
+    struct PROBE_PAIR_STATS
+    {
+        ULONG Writer;
+        ULONG Watcher;
+
+        /* Watcher TSC minus writer TSC, in cycles. */
+        LONG64 Skew;
+
+        /*
+         * Detection TSC minus probe TSC minus `Skew`. `Uncorrected` samples were taken before the pair's first round
+         * trip, `Negative` ones came out below 0 and were counted as 0, both point at a skew estimate that's off.
+         */
+        ULONG64 Samples;
+        ULONG64 Sum;
+        ULONG64 Min;
+        ULONG64 Max;
+        ULONG64 Uncorrected;
+        ULONG64 Negative;
+
+        /* Half of every round trip, the figure a round-trip measurement would report as the latency. */
+        ULONG64 RoundTrips;
+        ULONG64 RttMin;
+        ULONG64 HalfRttSum;
+
+        ULONG64 OneWay[ PROBE_BUCKETS ];
+        ULONG64 HalfRtt[ PROBE_BUCKETS ];
+    };
+
+    struct PROBE_REPORT
+    {
+        /* Whether probes are still being written. */
+        ULONG Active;
+        ULONG Pairs;
+
+        ULONG64 TscPerMicrosecond;
+
+        /* Since the last `PROBE_FLAG_START`: probes written, and echoes asked for that never came back. */
+        ULONG64 Probes;
+        ULONG64 EchoTimeouts;
+
+        PROBE_PAIR_STATS Pair[ 1 ];
+    };
+
+    inline SIZE_T ProbeReportSize( const ULONG Pairs )
+    {
+        return FIELD_OFFSET( PROBE_REPORT, Pair ) + Pairs * sizeof( PROBE_PAIR_STATS );
+    }
+
+    /*
+     * Input: a `LOG_REQUEST`, or nothing to only read the levels back. Output, if there's room: a `LOG_LEVELS`.
+     */
+    constexpr ULONG IOCTL_SET_LOG_LEVEL = CTL_CODE( FILE_DEVICE_UNKNOWN, 0x806, METHOD_BUFFERED, FILE_ANY_ACCESS );
+
+    /* What a message is about, every driver source file logs as one of these. */
+    enum LOG_SUBSYSTEM : ULONG
+    {
+        LogDriver,
+        LogCpu,
+        LogPool,
+        LogSystem,
+        LogWatcher,
+
+        LogSubsystemCount
+    };
+
+    /* `LOG_REQUEST::Subsystem` value that sets every subsystem at once. */
+    constexpr ULONG LOG_ALL_SUBSYSTEMS = 0xfffffffflu;
+
+    /* A subsystem logs every message at or below its level. */
+    enum LOG_LEVEL : ULONG
+    {
+        LogOff,
+        LogError,
+        LogInfo,
+
+        /* Includes messages from the watchers' detection path, one per store. */
+        LogVerbose
+    };
+
+    struct LOG_REQUEST
+    {
+        ULONG Subsystem;
+        ULONG Level;
+    };
+
+    struct LOG_LEVELS
+    {
+        ULONG Levels[ LogSubsystemCount ];
+    };
+
+    /*
+     * Input: a `SESSION_REQUEST`. Changes the weight and quotas of a session, see `SESSION_STATS`.
+     */
+    constexpr ULONG IOCTL_SET_SESSION = CTL_CODE( FILE_DEVICE_UNKNOWN, 0x807, METHOD_BUFFERED, FILE_ANY_ACCESS );
+
+    /*
+     * Every watch belongs to a session, which gets a weight and quotas. Session 0 is the driver's own load generator.
+     */
+    constexpr ULONG MAX_SESSIONS = 8lu;
+
+    /*
+     * Weights are relative. On a watcher shared between sessions, each session's watches are polled in proportion to
+     * its weight, the heaviest session's on every pass.
+     */
+    constexpr ULONG SESSION_DEFAULT_WEIGHT = 100lu;
+    constexpr ULONG SESSION_MAX_WEIGHT = 10000lu;
+
+    /* `SESSION_STATS::Share` of a session polled on every pass. */
+    constexpr ULONG SESSION_SHARE_FULL = 256lu;
+
+    /* 0 means unlimited. */
+    struct SESSION_QUOTA
+    {
+        /* Watches, every replica counting as one. Checked when a watch is added. */
+        ULONG MaxWatches;
+
+        /* Events waiting in the rings to be read. Past it the session's further events are dropped, not anyone else's. */
+        ULONG MaxRingEvents;
+
+        /*
+         * Detected events per pool manager period, summed over the session's watches. Past it the session's weight is
+         * scaled down by how far over it is, and the pool won't start watchers to make room for its watches.
+         */
+        ULONG64 MaxEventRate;
+    };
+
+    struct SESSION_REQUEST
+    {
+        ULONG Session;
+
+        /* Up to `SESSION_MAX_WEIGHT`, 0 for the default. */
+        ULONG Weight;
+
+        SESSION_QUOTA Quota;
+    };
+
+    struct SESSION_STATS
+    {
+        /* NUL-terminated. */
+        char Name[ 16 ];
+
+        ULONG Weight;
+
+        /* Out of `SESSION_SHARE_FULL`: the weight after throttling, relative to the heaviest session's. */
+        ULONG Share;
+
+        SESSION_QUOTA Quota;
+
+        /* Watches held, and ones refused for being past `MaxWatches`. */
+        ULONG Watches;
+        ULONG RejectedWatches;
+
+        ULONG64 Events;
+        ULONG64 Rate;
+
+        /* Manager periods spent past `MaxEventRate`. */
+        ULONG64 ThrottledPeriods;
+
+        /* Events in the rings right now, and ones dropped for being past `MaxRingEvents`. */
+        ULONG64 RingEvents;
+        ULONG64 RingDropped;
+    };
+
+    /*
+     * Input: a `PRIORITY_REQUEST`. Moves a watch to another priority class, the pool manager re-places it within a
+     * period or two.
+     */
+    constexpr ULONG IOCTL_SET_PRIORITY = CTL_CODE( FILE_DEVICE_UNKNOWN, 0x808, METHOD_BUFFERED, FILE_ANY_ACCESS );
+
+    /*
+     * Which latency tier a watch is served from. Watches start out `PriorityNormal`.
+     */
+    enum WATCH_PRIORITY : ULONG
+    {
+        /* A watcher of its own, parked on the watch's line, whenever there's a core for it. */
+        PriorityRealtime,
+
+        /* Shares watchers with other normal watches; the pool grows when they get busy. */
+        PriorityNormal,
+
+        /*
+         * Packed onto the shared watchers there are and polled on a fraction of their passes. Only gets a core started
+         * when none of them has room.
+         */
+        PriorityBackground,
+
+        PriorityCount
+    };
+
+    struct PRIORITY_REQUEST
+    {
+        /* `WATCH_STATS::Id`. Every replica of a critical watch follows replica 0. */
+        ULONG Watch;
+        ULONG Priority;
+    };
+
+    /* Reported by a replica other than replica 0 of a critical watch. */
+    constexpr USHORT EVENT_FLAG_REPLICA = 1u << 0;
+
+    /*
+     * Reported for a payload slot of a publish channel. `Watch` is then `ChannelWatchId` of the slot rather than a watch
+     * id, and `Previous` is the slot's version.
+     */
+    constexpr USHORT EVENT_FLAG_CHANNEL = 1u << 1;
+
+    constexpr ULONG CHANNEL_WATCH_BASE = 0x80000000lu;
+
+    /* Payload slots per channel, one bit each in its dirty bitmap. */
+    constexpr ULONG MAX_CHANNEL_SLOTS = 64lu;
+
+    inline ULONG ChannelWatchId( const ULONG Channel, const ULONG Slot )
+    {
+        return CHANNEL_WATCH_BASE | ( Channel << 8 ) | Slot;
+    }
+
+    /*
+     * One detected store.
+     */
+    struct EVENT
+    {
+        /* TSC of the detection, on the watcher's processor. */
+        ULONG64 Tsc;
+
+        ULONG64 Value;
+        ULONG64 Previous;
+
+        ULONG Watch;
+        USHORT Processor;
+        USHORT Flags;
+    };
+
+    static_assert( sizeof( EVENT ) == 32 );
+
+    /*
+     * Phases of a single watcher iteration, in the order they execute.
+     * `PhaseRearm` covers everything between the end of one iteration and arming the monitor on the next.
+     */
+    enum PHASE : ULONG
+    {
+        PhaseArm,
+        PhaseWait,
+        PhaseRead,
+        PhaseCompare,
+        PhaseEnqueue,
+        PhaseRearm,
+        PhaseCount
+    };
+
+    constexpr ULONG STATS_FLAG_CYCLE_ACCOUNTING = 1lu << 0;
+    constexpr ULONG STATS_FLAG_IRQ_PROFILING = 1lu << 1;
+
+    /* Running under a hypervisor, `STATS::Hypervisor` has its vendor signature. */
+    constexpr ULONG STATS_FLAG_HYPERVISOR = 1lu << 2;
+
+    /*
+     * Bucket `i` counts interrupt-off windows lasting [2^i, 2^(i+1)) cycles, the last bucket absorbs the rest.
+     */
+    constexpr ULONG IRQ_HISTOGRAM_BUCKETS = 48lu;
+
+    constexpr ULONG MAX_WAIT_STATES = 8lu;
+    constexpr ULONG MAX_REPLICAS = 4lu;
+
+    enum WAIT_STATE_KIND : ULONG
+    {
+        WaitStateSpin,
+        WaitStateMwait,
+        WaitStateUmwait,
+        WaitStateMwaitx
+    };
+
+    struct WAIT_STATE_INFO
+    {
+        ULONG Kind;
+        ULONG Hint;
+
+        /* TSC cycles. */
+        ULONG64 ExitLatency;
+        ULONG64 TargetResidency;
+    };
+
+    struct WATCHER_STATS
+    {
+        ULONG Index;
+        ULONG Processor;
+        LONG State;
+        ULONG WatchCount;
+
+        /* Set once the watchdog has declared the watcher stalled and taken its watches away. */
+        ULONG Stalled;
+        ULONG Reserved;
+
+        /* TSC of the watcher's last wake-up. */
+        ULONG64 Heartbeat;
+
+        /* Detected writes and writes known to have gone unnoticed, per pool manager period. */
+        ULONG64 Load;
+        ULONG64 MissRate;
+
+        ULONG64 Iterations;
+        ULONG64 Writes;
+
+        /* Events that didn't fit in the watcher's ring because nobody read them in time. */
+        ULONG64 EventsDropped;
+
+        /* Only populated when the driver was built with cycle accounting. */
+        ULONG64 PhaseCycles[ PhaseCount ];
+
+        /* Only populated when the driver was built with interrupt-off profiling. */
+        ULONG64 IrqOffThreshold;
+        ULONG64 IrqOffOverThreshold;
+        ULONG64 IrqOffMax;
+        ULONG64 IrqOffHistogram[ IRQ_HISTOGRAM_BUCKETS ];
+
+        /*
+         * TSC cycles spent waiting, and how many of them the core was in C0 according to `IA32_MPERF`. Only counted
+         * while `BACKEND_FLAG_RESIDENCY` is set and the processor has the counter.
+         */
+        ULONG64 WaitCycles;
+        ULONG64 WaitActiveCycles;
+    };
+
+    struct WATCH_STATS
+    {
+        ULONG Id;
+        ULONG Group;
+
+        /* Index of the owning watcher, -1 while unassigned. */
+        LONG Owner;
+
+        /* Replica index of a critical watch, 0 for ordinary watches. */
+        ULONG Replica;
+
+        ULONG64 Events;
+        ULONG64 Missed;
+        ULONG64 Rate;
+
+        /*
+         * Only populated on replica 0 of a critical watch. `Missed` counts writes none of the replicas saw,
+         * `MissedAlone` the ones replica 0 didn't see itself. `ReportedBy` tells which replica reported each
+         * store first.
+         */
+        ULONG Replicas;
+        ULONG Reserved;
+        ULONG64 MissedAlone;
+        ULONG64 FanInAccepted;
+        ULONG64 FanInDuplicates;
+        ULONG64 FanInLate;
+        ULONG64 ReportedBy[ MAX_REPLICAS ];
+
+        /*
+         * Governor accuracy. `Predictions` only counts the ones resolved by a detected write, each either a hit, too
+         * deep (the write came before the state's target residency) or too shallow. `StateSelections` counts every
+         * wait, spurious wake-ups included.
+         */
+        ULONG64 Predictions;
+        ULONG64 PredictionHits;
+        ULONG64 PredictedTooDeep;
+        ULONG64 PredictedTooShallow;
+
+        /* Indexed like `STATS::WaitStates`. */
+        ULONG64 StateSelections[ MAX_WAIT_STATES ];
+
+        /*
+         * Only populated on the doorbell watch of a publish channel: updates published, and how many of them found the
+         * doorbell already pending and didn't ring it again.
+         */
+        ULONG64 Published;
+        ULONG64 DoorbellsAvoided;
+
+        /* Index into `STATS::Sessions`. */
+        ULONG Session;
+
+        /* A `WATCH_PRIORITY`. */
+        ULONG Priority;
+    };
+
+    /*
+     * Output of `IOCTL_QUERY_STATS`, followed by `WatcherCount` watcher entries and then `WatchCount` watch entries.
+     * If the output buffer is too small only the header is filled in, so callers can size their buffer.
+     */
+    struct STATS
+    {
+        ULONG Flags;
+        ULONG WatcherCount;
+        ULONG WatchCount;
+
+        /* Watchers declared stalled by the watchdog since the driver was loaded. */
+        ULONG Stalls;
+
+        ULONG64 TscPerMicrosecond;
+
+        ULONG WaitStateCount;
+
+        /*
+         * The backend in use, and a bit per `BACKEND` this processor supports. Wait instructions that don't actually park
+         * (see `STATS_FLAG_HYPERVISOR`) count as unsupported. `DefaultBackend` is what the driver picked at load.
+         */
+        ULONG Backend;
+        ULONG Backends;
+        ULONG DefaultBackend;
+
+        /* NUL-terminated, empty on bare metal. */
+        char Hypervisor[ 16 ];
+
+        /*
+         * Watch slot allocation. Every slot takes `SlotStride` bytes, the largest monitor line rounded up to a power of
+         * two, which leaves `SlotsPerPage` of them to a page.
+         */
+        ULONG SlotStride;
+        ULONG SlotsPerPage;
+        ULONG SlotsUsed;
+        ULONG SlotCapacity;
+
+        ULONG SessionCount;
+        ULONG Reserved;
+        SESSION_STATS Sessions[ MAX_SESSIONS ];
+
+        WAIT_STATE_INFO WaitStates[ MAX_WAIT_STATES ];
+
+        WATCHER_STATS Watchers[ 1 ];
+    };
+
+    inline WATCH_STATS* GetWatchStats( STATS* Stats )
+    {
+        return reinterpret_cast< WATCH_STATS* >( &Stats->Watchers[ Stats->WatcherCount ] );
+    }
+
+    inline SIZE_T StatsSize( const ULONG WatcherCount, const ULONG WatchCount )
+    {
+        return FIELD_OFFSET( STATS, Watchers ) + WatcherCount * sizeof( WATCHER_STATS ) + WatchCount * sizeof( WATCH_STATS );
+    }
+}
@@ -0,0 +1,102 @@
+#include "pool.hpp"
+
+namespace
+{
+    constexpr auto LOG_SUBSYSTEM = mw::LogPool;
+
+    constexpr ULONG SLOT_TAG = 'lSwM';
+
+    /*
+     * A power of two so slots never straddle a page. CPUID leaf 5 is missing on some processors and reports nonsense
+     * under some hypervisors, the result is kept between a cache line and a page either way.
+     */
+    ULONG SlotStride( const mw::CPU_FEATURES& Features )
+    {
+        const auto Line = max( max( Features.SmallestMonitorLine, Features.LargestMonitorLine ), mw::SLOT_MIN_STRIDE );
+
+        ULONG Stride = mw::SLOT_MIN_STRIDE;
+
+        while ( Stride < Line && Stride < PAGE_SIZE )
+        {
+            Stride <<= 1;
+        }
+
+        return Stride;
+    }
+}
+
+NTSTATUS mw::CreateSlots( SLOT_POOL*& Slots )
+{
+    Slots = static_cast< SLOT_POOL* >( ExAllocatePool2( POOL_FLAG_NON_PAGED, sizeof( SLOT_POOL ), SLOT_TAG ) );
+
+    if ( !Slots )
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    /* Allocations of a page or more start on a page boundary. */
+    Slots->Base = static_cast< PUCHAR >( ExAllocatePool2( POOL_FLAG_NON_PAGED, SLOT_PAGES * PAGE_SIZE, SLOT_TAG ) );
+
+    if ( !Slots->Base )
+    {
+        ExFreePoolWithTag( Slots, SLOT_TAG );
+        Slots = nullptr;
+
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Slots->Stride = SlotStride( Cpu );
+    Slots->Capacity = SLOT_PAGES * PAGE_SIZE / Slots->Stride;
+
+    RtlInitializeBitMap( &Slots->Map, Slots->MapBits, Slots->Capacity );
+    RtlClearAllBits( &Slots->Map );
+
+    ExInitializeFastMutex( &Slots->Lock );
+
+    logmsg( "Slot stride: %lu bytes, %lu slots per page, %lu slots\n",
+            Slots->Stride,
+            PAGE_SIZE / Slots->Stride,
+            Slots->Capacity
+    );
+
+    return STATUS_SUCCESS;
+}
+
+VOID mw::DestroySlots( SLOT_POOL* Slots )
+{
+    ExFreePoolWithTag( Slots->Base, SLOT_TAG );
+    ExFreePoolWithTag( Slots, SLOT_TAG );
+}
+
+PVOID mw::AllocateSlot( SLOT_POOL* Slots )
+{
+    ExAcquireFastMutex( &Slots->Lock );
+
+    const auto Index = RtlFindClearBitsAndSet( &Slots->Map, 1lu, 0lu );
+
+    ExReleaseFastMutex( &Slots->Lock );
+
+    if ( Index == MAXULONG )
+    {
+        return nullptr;
+    }
+
+    const auto Slot = Slots->Base + static_cast< SIZE_T >( Index ) * Slots->Stride;
+
+    memset( Slot, 0, Slots->Stride );
+
+    return Slot;
+}
+
+VOID mw::FreeSlot( SLOT_POOL* Slots, PVOID Slot )
+{
+    const auto Offset = static_cast< SIZE_T >( static_cast< PUCHAR >( Slot ) - Slots->Base );
+
+    NT_ASSERT( Offset % Slots->Stride == 0 && Offset / Slots->Stride < Slots->Capacity );
+
+    ExAcquireFastMutex( &Slots->Lock );
+
+    RtlClearBit( &Slots->Map, static_cast< ULONG >( Offset / Slots->Stride ) );
+
+    ExReleaseFastMutex( &Slots->Lock );
+}
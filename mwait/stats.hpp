@@ -0,0 +1,118 @@
+#pragma once
+
+#include <ntifs.h>
+#include <intrin.h>
+
+#include "shared.hpp"
+
+namespace mw
+{
+    /*
+     * Per-watcher breakdown of where the cycles of each iteration go.
+     *
+     * `Lap` charges the cycles elapsed since the previous lap to the given phase, so the phases of an iteration
+     * must be lapped in order. The disabled specialisation is empty and every call compiles away.
+     */
+    template < bool Enabled >
+    struct CYCLE_ACCOUNT
+    {
+        ULONG64 Cycles[ PhaseCount ] = { };
+        ULONG64 Last = 0llu;
+
+        void Begin( )
+        {
+            Last = __rdtsc ( );
+        }
+
+        void Lap( const PHASE Phase )
+        {
+            const auto Now = __rdtsc ( );
+
+            Cycles[ Phase ] += Now - Last;
+            Last = Now;
+        }
+
+        void Export( WATCHER_STATS& Stats ) const
+        {
+            for ( ULONG i = 0; i < PhaseCount; i++ )
+            {
+                Stats.PhaseCycles[ i ] = Cycles[ i ];
+            }
+        }
+    };
+
+    template < >
+    struct CYCLE_ACCOUNT< false >
+    {
+        void Begin( ) { }
+        void Lap( const PHASE ) { }
+        void Export( WATCHER_STATS& ) const { }
+    };
+
+    /*
+     * Histogram of the time spent with interrupts disabled, sampled at `INTERRUPT_GUARD` entry and exit.
+     *
+     * `Threshold` may be changed from another thread at any time; windows are classified against whatever
+     * value was visible when they closed.
+     */
+    template < bool Enabled >
+    struct IRQ_PROFILE
+    {
+        ULONG64 Histogram[ IRQ_HISTOGRAM_BUCKETS ] = { };
+        ULONG64 OverThreshold = 0llu;
+        ULONG64 Max = 0llu;
+        volatile ULONG64 Threshold = 0llu;
+        ULONG64 Entered = 0llu;
+
+        void Enter( )
+        {
+            Entered = __rdtsc ( );
+        }
+
+        void Exit( )
+        {
+            const auto Duration = __rdtsc ( ) - Entered;
+
+            ULONG Bucket = 0lu;
+            _BitScanReverse64( &Bucket, Duration | 1llu );
+
+            Histogram[ Bucket < IRQ_HISTOGRAM_BUCKETS ? Bucket : IRQ_HISTOGRAM_BUCKETS - 1 ]++;
+
+            if ( Duration > Threshold )
+            {
+                OverThreshold++;
+            }
+
+            if ( Duration > Max )
+            {
+                Max = Duration;
+            }
+        }
+
+        void SetThreshold( const ULONG64 Cycles )
+        {
+            Threshold = Cycles;
+        }
+
+        void Export( WATCHER_STATS& Stats ) const
+        {
+            Stats.IrqOffThreshold = Threshold;
+            Stats.IrqOffOverThreshold = OverThreshold;
+            Stats.IrqOffMax = Max;
+
+            for ( ULONG i = 0; i < IRQ_HISTOGRAM_BUCKETS; i++ )
+            {
+                Stats.IrqOffHistogram[ i ] = Histogram[ i ];
+            }
+        }
+    };
+
+    template < >
+    struct IRQ_PROFILE< false >
+    {
+        void Enter( ) { }
+        void Exit( ) { }
+        void SetThreshold( const ULONG64 ) { }
+        void Export( WATCHER_STATS& ) const { }
+    };
+}
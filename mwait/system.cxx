@@ -0,0 +1,191 @@
+#include "pool.hpp"
+
+namespace
+{
+    constexpr auto LOG_SUBSYSTEM = mw::LogSystem;
+
+    UNICODE_STRING POWER_STATE_CALLBACK = RTL_CONSTANT_STRING( L"\\Callback\\PowerState" );
+
+    /*
+     * Called at PASSIVE_LEVEL once a hot-added processor is up. Windows never removes processors while running, so
+     * additions are all there is to track. Only group 0 is considered, watcher affinities are single-group masks.
+     */
+    VOID ProcessorChange( PVOID Context, PKE_PROCESSOR_CHANGE_NOTIFY_CONTEXT Change, PNTSTATUS OperationStatus )
+    {
+        UNREFERENCED_PARAMETER( OperationStatus );
+
+        const auto Pool = static_cast< mw::POOL* >( Context );
+
+        if ( Change->State != KeProcessorAddCompleteNotify || Change->ProcNumber.Group != 0 )
+        {
+            return;
+        }
+
+        const auto Mask = AFFINITY_MASK( Change->ProcNumber.Number ) & mw::WATCHER_HOTPLUG_AFFINITY;
+
+        if ( !Mask )
+        {
+            return;
+        }
+
+        const auto Previous = InterlockedOr64( &Pool->Eligible, static_cast< LONG64 >( Mask ) );
+
+        if ( ( static_cast< KAFFINITY >( Previous ) & Mask ) != 0 )
+        {
+            return;
+        }
+
+        /* The manager picks the new core up on its next period, as soon as there's load for it. */
+        const auto Budget = InterlockedIncrement( &Pool->CoreBudget );
+
+        logmsg( "Processor %lu added, core budget now %ld\n", Change->NtNumber, Budget );
+    }
+
+    /*
+     * Gets every watcher out of its wait state and waits until they're all parked with interrupts enabled.
+     */
+    VOID SuspendPool( mw::POOL* Pool )
+    {
+        InterlockedExchange( &Pool->Suspended, 1 );
+
+        for ( auto& Watcher : Pool->Watchers )
+        {
+            if ( Watcher.State != mw::WatcherFree )
+            {
+                mw::KickWatcher( &Watcher );
+            }
+        }
+
+        for ( ULONG Attempt = 0; Attempt < mw::SUSPEND_PARK_ATTEMPTS; Attempt++ )
+        {
+            bool Parked = true;
+
+            for ( auto& Watcher : Pool->Watchers )
+            {
+                if ( Watcher.State != mw::WatcherFree && ReadNoFence( &Watcher.Parked ) == 0 )
+                {
+                    Parked = false;
+                    break;
+                }
+            }
+
+            if ( Parked )
+            {
+                logmsg( "All watchers parked for sleep transition\n" );
+                return;
+            }
+
+            KeDelayExecutionThread( KernelMode, false, &mw::Sleep );
+        }
+
+        logmsg( "Watchers still not parked, letting the sleep transition go ahead\n" );
+    }
+
+    VOID ResumePool( mw::POOL* Pool )
+    {
+        /*
+         * The TSC may have restarted from a lower value, which would make every replica detection look older than the
+         * last one reported. Nothing is being reported while the watchers are parked.
+         */
+        for ( ULONG i = 0; i < Pool->FanInCount; i++ )
+        {
+            InterlockedExchange64( &Pool->FanIns[ i ].Last[ 1 ], 0 );
+        }
+
+        InterlockedExchange( &Pool->Suspended, 0 );
+
+        for ( auto& Watcher : Pool->Watchers )
+        {
+            if ( Watcher.State != mw::WatcherFree )
+            {
+                mw::KickWatcher( &Watcher );
+            }
+        }
+
+        logmsg( "Watchers resumed\n" );
+    }
+
+    /*
+     * `\Callback\PowerState` notifies with `PO_CB_SYSTEM_STATE_LOCK` at PASSIVE_LEVEL: `Argument2` is 0 right before the
+     * system leaves S0 and 1 once it's back.
+     */
+    VOID PowerStateChange( PVOID Context, PVOID Argument1, PVOID Argument2 )
+    {
+        const auto Pool = static_cast< mw::POOL* >( Context );
+
+        if ( Argument1 != PO_CB_SYSTEM_STATE_LOCK )
+        {
+            return;
+        }
+
+        if ( Argument2 == nullptr )
+        {
+            SuspendPool( Pool );
+        }
+        else
+        {
+            ResumePool( Pool );
+        }
+    }
+}
+
+NTSTATUS mw::RegisterSystemCallbacks( POOL* Pool )
+{
+    OBJECT_ATTRIBUTES Attributes;
+
+    InitializeObjectAttributes( &Attributes, &POWER_STATE_CALLBACK, OBJ_CASE_INSENSITIVE, nullptr, nullptr );
+
+    auto Status = ExCreateCallback( &Pool->PowerObject, &Attributes, false, true );
+
+    if ( !NT_SUCCESS( Status ) )
+    {
+        logerr( "Unable to open the power state callback: 0x%08x\n", Status );
+        return Status;
+    }
+
+    Pool->PowerCallback = ExRegisterCallback( Pool->PowerObject, PowerStateChange, Pool );
+
+    /*
+     * A watcher parked with interrupts disabled would hang any sleep transition, so this one isn't optional.
+     */
+    if ( !Pool->PowerCallback )
+    {
+        logerr( "Unable to register for power state changes\n" );
+
+        ObfDereferenceObject( Pool->PowerObject );
+        Pool->PowerObject = nullptr;
+
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    /* Without hot-add notifications the pool just stays on the processors present at load time. */
+    Pool->ProcessorCallback = KeRegisterProcessorChangeCallback( ProcessorChange, Pool, 0lu );
+
+    if ( !Pool->ProcessorCallback )
+    {
+        logerr( "Unable to register for processor changes\n" );
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VOID mw::UnregisterSystemCallbacks( POOL* Pool )
+{
+    if ( Pool->ProcessorCallback )
+    {
+        KeDeregisterProcessorChangeCallback( Pool->ProcessorCallback );
+        Pool->ProcessorCallback = nullptr;
+    }
+
+    if ( Pool->PowerCallback )
+    {
+        ExUnregisterCallback( Pool->PowerCallback );
+        Pool->PowerCallback = nullptr;
+    }
+
+    if ( Pool->PowerObject )
+    {
+        ObfDereferenceObject( Pool->PowerObject );
+        Pool->PowerObject = nullptr;
+    }
+}
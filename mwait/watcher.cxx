@@ -0,0 +1,818 @@
+#include "pool.hpp"
+
+namespace
+{
+    constexpr auto LOG_SUBSYSTEM = mw::LogWatcher;
+
+    /* Counts at a fixed rate, but only while the core is in C0. */
+    constexpr ULONG IA32_MPERF = 0xe7lu;
+
+    /*
+     * The profile is sampled inside the disabled region so the recorded window is exactly the time interrupts were off.
+     */
+    template < typename PROFILE >
+    struct INTERRUPT_GUARD
+    {
+        PROFILE& Profile;
+
+        INTERRUPT_GUARD( PROFILE& Profile ) : Profile( Profile )
+        {
+            _disable ( );
+            Profile.Enter( );
+        }
+
+        ~INTERRUPT_GUARD( )
+        {
+            Profile.Exit( );
+            _enable ( );
+        }
+    };
+
+    /*
+     * Takes in watches handed to us and hands over the ones the pool manager wants elsewhere.
+     * Runs with interrupts enabled, kicking the receiving watcher may need to signal an event.
+     */
+    VOID ProcessHandOffs( mw::MONITOR_CONTEXT* Watcher )
+    {
+        const auto Pool = Watcher->Pool;
+
+        for ( auto Entry = InterlockedFlushSList( &Watcher->Inbox ); Entry != nullptr; )
+        {
+            const auto Next = Entry->Next;
+            const auto Watch = CONTAINING_RECORD( Entry, mw::WATCH, HandOff );
+
+            if ( Watcher->WatchCount < mw::MAX_WATCHES_PER_WATCHER )
+            {
+                Watcher->Watches[ Watcher->WatchCount++ ] = Watch;
+            }
+            else
+            {
+                /* Give it back to the pool manager, it'll be placed again on the next period. */
+                logerr( "[%lu] No room for watch %lu\n", Watcher->Index, Watch->Id );
+                InterlockedExchange( &Watch->Owner, -1 );
+            }
+
+            Entry = Next;
+        }
+
+        for ( ULONG i = 0; i < Watcher->WatchCount; )
+        {
+            const auto Watch = Watcher->Watches[ i ];
+            const auto To = InterlockedExchange( &Watch->MigrateTo, -1 );
+
+            if ( To < 0 || To == static_cast< LONG >( Watcher->Index ) )
+            {
+                i++;
+                continue;
+            }
+
+            Watcher->Watches[ i ] = Watcher->Watches[ --Watcher->WatchCount ];
+
+            /*
+             * `LastValue` goes along with the watch, so a write landing while it's in flight is picked up by the
+             * new owner on its first look instead of being lost, and nothing is ever reported twice.
+             */
+            auto& Target = Pool->Watchers[ To ];
+
+            /* The watchdog gave up on the target meanwhile, let the pool manager place the watch again. */
+            if ( ReadNoFence( &Target.Stalled ) != 0 )
+            {
+                InterlockedExchange( &Watch->Owner, -1 );
+                continue;
+            }
+
+            InterlockedExchange( &Watch->Owner, To );
+            InterlockedPushEntrySList( &Target.Inbox, &Watch->HandOff );
+
+            mw::KickWatcher( &Target );
+        }
+    }
+
+    /*
+     * Sleep transitions need every processor to take an IPI, which a watcher waiting with interrupts disabled never would.
+     * Wait with interrupts enabled until the system is back in S0, then re-arm from a clean slate: the TSC may have been
+     * reset, so the time since the last write and any outstanding prediction are meaningless now. `LastValue` is kept,
+     * a store that happened while asleep is reported on the first look.
+     */
+    VOID Suspend( mw::MONITOR_CONTEXT* Watcher )
+    {
+        const auto Pool = Watcher->Pool;
+
+        InterlockedExchange( &Watcher->Parked, 1 );
+
+        logmsg( "[%lu] Parked for sleep transition\n", Watcher->Index );
+
+        while ( ReadNoFence( &Pool->Suspended ) != 0 && ReadNoFence( &Watcher->Stop ) == 0 )
+        {
+            KeWaitForSingleObject( &Watcher->Wake, Executive, KernelMode, false, nullptr );
+        }
+
+        KeSetSystemAffinityThreadEx( AFFINITY_MASK( Watcher->Processor ) );
+
+        const auto Now = __rdtsc ( );
+
+        for ( ULONG i = 0; i < Watcher->WatchCount; i++ )
+        {
+            const auto Watch = Watcher->Watches[ i ];
+
+            Watch->LastWrite = Now;
+            Watch->Governor.Pending = false;
+        }
+
+        InterlockedExchange( &Watcher->Parked, 0 );
+
+        Watcher->Cycles.Begin( );
+    }
+
+    /*
+     * Publishes the line we're about to park on so `KickWatcher` can reach us. Only needs the fence when it changes,
+     * otherwise the kicker is guaranteed to already see it.
+     */
+    VOID Arm( mw::MONITOR_CONTEXT* Watcher, PVOID Address )
+    {
+        if ( Watcher->Armed != Address )
+        {
+            InterlockedExchangePointer( &Watcher->Armed, Address );
+        }
+    }
+
+    /*
+     * Nothing to wait for if we were kicked or the value moved since we last looked, which also covers stores that
+     * landed between the previous read and arming the monitor.
+     */
+    bool ShouldPark( const mw::MONITOR_CONTEXT* Watcher, const mw::WATCH* Watch )
+    {
+        return ReadNoFence( &Watcher->Pending ) == 0 &&
+               *reinterpret_cast< volatile ULONG64* >( Watch->Address ) == Watch->LastValue;
+    }
+
+    /*
+     * Replicas of a critical watch all wake up on the same store. Holding back the later ones keeps their re-arm windows
+     * apart, so a store landing while one of them re-arms is still caught by another.
+     */
+    VOID Stagger( const mw::WATCH* Watch )
+    {
+        if ( Watch->Stagger == 0 )
+        {
+            return;
+        }
+
+        const auto Woke = __rdtsc ( );
+
+        while ( __rdtsc ( ) - Woke < Watch->Stagger )
+        {
+            _mm_pause ( );
+        }
+    }
+
+    /*
+     * A watcher with a single watch parks on it, as deep as its governor allows. A forced backend bypasses the governor
+     * and always parks in the shallowest state of its kind, so backends compare on the mechanism alone.
+     */
+    VOID WaitSingle( mw::MONITOR_CONTEXT* Watcher, mw::WATCH* Watch, const ULONG64 Start, const mw::BACKEND Backend )
+    {
+        auto& Cycles = Watcher->Cycles;
+
+        const auto Address = reinterpret_cast< void* >( Watch->Address );
+
+        mw::gov::WAIT_STATE State = { };
+        ULONG64 Idle = 0llu;
+
+        switch ( Backend )
+        {
+            case mw::BackendSpin:
+                State.Kind = mw::gov::WAIT_KIND::Spin;
+                break;
+
+            case mw::BackendMwait:
+                State.Kind = mw::gov::WAIT_KIND::Mwait;
+                break;
+
+            case mw::BackendUmwait:
+                State.Kind = mw::gov::WAIT_KIND::Umwait;
+                State.Hint = 1lu;
+                break;
+
+            case mw::BackendMwaitx:
+                State.Kind = mw::gov::WAIT_KIND::Mwaitx;
+                break;
+
+            default:
+            {
+                const auto Prediction = Watch->Governor.Predict( mw::WaitStates, Watcher->LatencyBudget, Start - Watch->LastWrite );
+
+                State = mw::WaitStates.States[ Prediction.State ];
+                Idle = Prediction.Idle;
+                break;
+            }
+        }
+
+        switch ( State.Kind )
+        {
+            case mw::gov::WAIT_KIND::Spin:
+            {
+                Cycles.Lap( mw::PhaseArm );
+
+                const auto SpinLimit = mw::NsToCycles( mw::SPIN_LIMIT_NS );
+
+                /*
+                 * The next write is expected sooner than any sleep state would pay off. Poll without writing to the line
+                 * so it stays shared with the producer, and give up after `SPIN_LIMIT_NS` so interrupts get serviced.
+                 */
+                while ( ShouldPark( Watcher, Watch ) && __rdtsc ( ) - Start < SpinLimit )
+                {
+                    _mm_pause ( );
+                }
+                break;
+            }
+
+            case mw::gov::WAIT_KIND::Umwait:
+                Arm( Watcher, Address );
+                _umonitor( Address );
+
+                Cycles.Lap( mw::PhaseArm );
+
+                /*
+                 * Unlike `mwait`, `umwait` takes a TSC deadline. Give the prediction some slack so an accurate guess
+                 * doesn't expire just before the write lands.
+                 */
+                if ( ShouldPark( Watcher, Watch ) )
+                {
+                    _umwait(
+                        State.Hint,
+                        Start + ( Idle != 0
+                                      ? Idle * 2
+                                      : mw::NsToCycles( mw::UMWAIT_DEFAULT_DEADLINE_NS ) )
+                    );
+                }
+                break;
+
+            case mw::gov::WAIT_KIND::Mwaitx:
+                Arm( Watcher, Address );
+                _mm_monitorx( Address, 0lu, 0lu );
+
+                Cycles.Lap( mw::PhaseArm );
+
+                /* AMD's flavour of `mwait` C1. No timer is armed, interrupts are off either way. */
+                if ( ShouldPark( Watcher, Watch ) )
+                {
+                    _mm_mwaitx( 0lu, 0lu, 0lu );
+                }
+                break;
+
+            case mw::gov::WAIT_KIND::Mwait:
+            default:
+                Arm( Watcher, Address );
+
+                /*
+                * According to the manual: "MONITOR performs the same segmentation and paging checks as a 1-byte read."
+                * Therefore, an attempt to monitor an invalid address will raise an exception.
+                * We are also dereferencing the monitored address in order to retrieve the data, which is always risky.
+                * However, since we disabled interrupts earlier faulting here would lead to BugCheck even with exception handling.
+                *
+                * Finally, the correct way of using this requires checking the caching policy for the monitored address/page.
+                * The manual is very pedantic about the fact we must only monitor addresses using the *write-back* policy type.
+                */
+                _mm_monitor(
+                    Address,
+                    0lu,
+                    0lu
+                );
+
+                Cycles.Lap( mw::PhaseArm );
+
+                /*
+                 * Wait for it to trigger whenever some instruction writes to the monitored address.
+                 * Note: `mwait` behaves very much like the halt instruction (`hlt`) as far as I can see. I am not aware of any way to distinguish between them.
+                 * This also means that the CPU we pinned this thread to will be unusable for the duration of the waiting as it will transition to a low-power state.
+                 *
+                 * Further, the waiting state may also exit early due to a variety of reasons, such as:
+                 *  1) Reset signal;
+                 *  2) Any unmasked interrupt including INTR, NMI, SMI, INIT; and
+                 *  3) Others not directly specified by the manual but alluded to by the wording.
+                 *
+                 * Reason 2) is why we disabled interrupts before arming the monitor hardware.
+                */
+                if ( ShouldPark( Watcher, Watch ) )
+                {
+                    _mm_mwait( 0lu, State.Hint );
+                }
+                break;
+        }
+
+        Stagger( Watch );
+    }
+
+    /*
+     * Whether a polling pass looks at `Watch` this time: each pass earns it its session's share, cut down further for
+     * background watches, and a poll costs `SESSION_SHARE_FULL`. At full share that's every pass, as if there were no
+     * sessions. The pass marks the watch `Due`, and only due watches are checked once the wait ends.
+     */
+    bool PollDue( mw::MONITOR_CONTEXT* Watcher, mw::WATCH* Watch )
+    {
+        auto Earned = static_cast< ULONG >( ReadNoFence( &Watcher->Pool->Sessions[ Watch->Session ].Share ) );
+
+        if ( ReadNoFence( &Watch->Priority ) == mw::PriorityBackground )
+        {
+            Earned = max( Earned >> mw::BACKGROUND_POLL_SHIFT, 1lu );
+        }
+
+        Watch->Credit += Earned;
+
+        if ( Watch->Credit < mw::SESSION_SHARE_FULL )
+        {
+            return false;
+        }
+
+        Watch->Credit -= mw::SESSION_SHARE_FULL;
+        return true;
+    }
+
+    /*
+     * The monitor can only be armed on one line, so a watcher sharing its core between several watches polls them
+     * instead, weighted by session. Reads only, the lines stay shared with their producers. Bounded by
+     * `SPIN_LIMIT_NS` like the spin state.
+     */
+    VOID WaitScan( mw::MONITOR_CONTEXT* Watcher, const ULONG64 Start )
+    {
+        Arm( Watcher, nullptr );
+
+        Watcher->Cycles.Lap( mw::PhaseArm );
+
+        const auto SpinLimit = mw::NsToCycles( mw::SPIN_LIMIT_NS );
+
+        for ( ;; )
+        {
+            for ( ULONG i = 0; i < Watcher->WatchCount; i++ )
+            {
+                const auto Watch = Watcher->Watches[ i ];
+
+                if ( !PollDue( Watcher, Watch ) )
+                {
+                    continue;
+                }
+
+                Watch->Due = true;
+
+                if ( *reinterpret_cast< volatile ULONG64* >( Watch->Address ) != Watch->LastValue )
+                {
+                    return;
+                }
+            }
+
+            if ( ReadNoFence( &Watcher->Pending ) != 0 || __rdtsc ( ) - Start >= SpinLimit )
+            {
+                return;
+            }
+
+            _mm_pause ( );
+        }
+    }
+
+    /*
+     * `BackendBackoff`: polls every watch that's due, then waits out a gap that doubles after each poll that saw
+     * nothing. Only ever reads the watched lines, so they stay shared with their producers and a store costs one
+     * invalidation. Bounded by `SPIN_LIMIT_NS` like the spin state.
+     */
+    VOID WaitBackoff( mw::MONITOR_CONTEXT* Watcher, const ULONG64 Start )
+    {
+        const auto Pool = Watcher->Pool;
+
+        Arm( Watcher, nullptr );
+
+        Watcher->Cycles.Lap( mw::PhaseArm );
+
+        const auto SpinLimit = mw::NsToCycles( mw::SPIN_LIMIT_NS );
+        const auto Ceiling = static_cast< ULONG64 >( ReadNoFence64( &Pool->BackoffCeiling ) );
+        const auto TpauseMin = ReadNoFence( &Pool->BackoffTpause ) != 0 ? mw::NsToCycles( mw::TPAUSE_MIN_NS ) : ~0llu;
+
+        auto Gap = mw::NsToCycles( mw::BACKOFF_FLOOR_NS );
+
+        for ( ;; )
+        {
+            for ( ULONG i = 0; i < Watcher->WatchCount; i++ )
+            {
+                const auto Watch = Watcher->Watches[ i ];
+
+                if ( !PollDue( Watcher, Watch ) )
+                {
+                    continue;
+                }
+
+                Watch->Due = true;
+
+                if ( *reinterpret_cast< volatile ULONG64* >( Watch->Address ) != Watch->LastValue )
+                {
+                    return;
+                }
+            }
+
+            const auto Now = __rdtsc ( );
+
+            if ( ReadNoFence( &Watcher->Pending ) != 0 || Now - Start >= SpinLimit )
+            {
+                return;
+            }
+
+            if ( Gap >= TpauseMin )
+            {
+                /* C0.1, the shallower of the two: the gap is already what we're prepared to be late by. */
+                _tpause( 1lu, Now + Gap );
+            }
+            else
+            {
+                while ( __rdtsc ( ) - Now < Gap )
+                {
+                    _mm_pause ( );
+                }
+            }
+
+            Gap = min( Gap * 2, Ceiling );
+        }
+    }
+
+    /*
+     * `BackendEvent`: interrupts stay enabled and the watcher blocks on `Wake`, which `WriteTestSlot` signals after every
+     * store. Bounded by a `Sleep` period so stores from producers that don't ring are still noticed, late.
+     */
+    VOID WaitEvent( mw::MONITOR_CONTEXT* Watcher )
+    {
+        Arm( Watcher, nullptr );
+
+        Watcher->Cycles.Lap( mw::PhaseArm );
+
+        for ( ULONG i = 0; i < Watcher->WatchCount; i++ )
+        {
+            const auto Watch = Watcher->Watches[ i ];
+
+            if ( *reinterpret_cast< volatile ULONG64* >( Watch->Address ) != Watch->LastValue )
+            {
+                return;
+            }
+        }
+
+        if ( ReadNoFence( &Watcher->Pending ) != 0 )
+        {
+            return;
+        }
+
+        KeWaitForSingleObject( &Watcher->Wake, Executive, KernelMode, false, &mw::Sleep );
+    }
+
+    /*
+     * Drops the event rather than waiting when the reader falls behind, the watcher can't afford to block. A session
+     * past its `MaxRingEvents` only has its own events dropped.
+     */
+    VOID PushEvent( mw::MONITOR_CONTEXT* Watcher, const ULONG Session, const mw::EVENT& Event )
+    {
+        auto& Ring = Watcher->Pool->Rings[ Watcher->Index ];
+
+        if ( ReadNoFence( &Watcher->Pool->Sessions[ Session ].OverRingQuota ) != 0 )
+        {
+            Ring.OverQuota[ Session ]++;
+            return;
+        }
+
+        const auto Head = Ring.Head;
+
+        if ( static_cast< ULONG64 >( Head - ReadAcquire64( &Ring.Tail ) ) >= mw::EVENT_RING_SIZE )
+        {
+            Ring.Dropped++;
+            return;
+        }
+
+        Ring.Events[ Head & ( mw::EVENT_RING_SIZE - 1 ) ] = Event;
+        Ring.Pushed[ Session ]++;
+
+        WriteRelease64( &Ring.Head, Head + 1 );
+    }
+
+    /*
+     * Lets a replica's detection through unless another replica already reported the same value, or a newer one.
+     * `Last` is read high half first: a torn read then pairs the newest value with an older TSC, which can only make
+     * the check more lenient, and the compare-exchange settles it.
+     */
+    bool MergeFanIn( mw::FAN_IN* FanIn, const mw::WATCH* Watch, const ULONG64 Value, const ULONG64 Tsc )
+    {
+        LONG64 Expected[ 2 ];
+
+        Expected[ 1 ] = ReadNoFence64( &FanIn->Last[ 1 ] );
+        Expected[ 0 ] = ReadNoFence64( &FanIn->Last[ 0 ] );
+
+        for ( ;; )
+        {
+            if ( static_cast< ULONG64 >( Expected[ 0 ] ) == Value )
+            {
+                InterlockedIncrement64( &FanIn->Duplicates );
+                return false;
+            }
+
+            if ( static_cast< ULONG64 >( Expected[ 1 ] ) > Tsc )
+            {
+                InterlockedIncrement64( &FanIn->Late );
+                return false;
+            }
+
+            if ( InterlockedCompareExchange128(
+                     FanIn->Last,
+                     static_cast< LONG64 >( Tsc ),
+                     static_cast< LONG64 >( Value ),
+                     Expected ) )
+            {
+                break;
+            }
+        }
+
+        InterlockedIncrement64( &FanIn->Accepted );
+        InterlockedIncrement64( &FanIn->AcceptedBy[ Watch->Replica ] );
+
+        return true;
+    }
+
+    /*
+     * The doorbell rang: report every payload slot published since the last drain, with its latest value. Clearing
+     * `Pending` first means a producer either sees it clear and rings again, or its dirty bit is already there for us.
+     */
+    VOID DrainChannel( mw::MONITOR_CONTEXT* Watcher, mw::CHANNEL* Channel, const ULONG64 Now )
+    {
+        InterlockedExchange( &Channel->Pending, 0 );
+
+        auto Dirty = static_cast< ULONG64 >( InterlockedExchange64( &Channel->Dirty, 0 ) );
+
+        while ( Dirty != 0 )
+        {
+            ULONG Index = 0lu;
+            _BitScanForward64( &Index, Dirty );
+
+            Dirty &= Dirty - 1;
+
+            const auto& Slot = Channel->Payload[ Index ];
+
+            const mw::EVENT Event = {
+                Now,
+                Slot.Value,
+                static_cast< ULONG64 >( Slot.Version ),
+                mw::ChannelWatchId( Channel->Index, Index ),
+                static_cast< USHORT >( Watcher->Processor ),
+                mw::EVENT_FLAG_CHANNEL
+            };
+
+            PushEvent( Watcher, Channel->Session, Event );
+        }
+    }
+
+    /*
+     * If we get here then one of two things happened:
+     *
+     *  1) A store occurred to the monitored address; or
+     *  2) The waiting state exited early.
+     *
+     *  Per the documentation there doesn't seem to be any way to identify what caused
+     *  the wait to expire. Due to this fact, we have to manually check whether the store occurred or not.
+     *
+     *  This implementation does not account for the fact that the same value may have been written to the monitored address.
+     *
+     *  I've only tested the previous assumptions on an AMD Ryzen 3 systems.
+     *
+     *  Interestingly, Intel with the instruction `umwait` appears to behave differently:
+     *
+     *  "By executing the umwait instruction, the core enters a light-weight sleep
+     *  mode, typically C0.1 or C0.2 [34]. There are now two cases
+     *  to distinguish: Core #X transiently writing or not writing to
+     *  the monitored cache line. If Core #X transiently writes to the
+     *  monitored shared cache line, Core #Y wakes up and contin-
+     *  ues execution with a cleared carry flag (CF = 0). If Core #X
+     *  does not write to the monitored shared cache line, Core #Y
+     *  sleeps until the maximum sleep time defined by the OS is
+     *  reached (cf. Section 3.3). In this case, the carry flag is set (CF
+     *  = 1) when Core #Y wakes up. Hence, with the carry flag, an
+     *  attacker has the architectural information whether there was
+     *  a microarchitectural event, i.e., a transient write."
+     */
+    VOID CheckWatch( mw::MONITOR_CONTEXT* Watcher, mw::WATCH* Watch, const ULONG64 Start )
+    {
+        auto& Cycles = Watcher->Cycles;
+
+        const auto Previous = Watch->LastValue;
+        const auto Current = *reinterpret_cast< volatile ULONG64* >( Watch->Address );
+
+        Cycles.Lap( mw::PhaseRead );
+
+        const auto Changed = ( Previous != Current );
+
+        /* Whether this detection is the one reported, always true unless another replica got there first. */
+        auto Report = Changed;
+
+        ULONG64 Now = 0llu;
+
+        if ( Changed )
+        {
+            Now = __rdtsc ( );
+
+            if ( Watch->FanIn )
+            {
+                Report = MergeFanIn( Watch->FanIn, Watch, Current, Now );
+            }
+
+            RecordProbe( Watcher, Current, Now, Report );
+
+            Watch->Governor.Observe( mw::WaitStates, Now - Watch->LastWrite, Now - Start );
+            Watch->LastWrite = Now;
+            Watch->LastValue = Current;
+        }
+
+        Cycles.Lap( mw::PhaseCompare );
+
+        if ( Changed )
+        {
+            Watch->Events++;
+            Watcher->Writes++;
+        }
+
+        if ( Report && Watch->Channel )
+        {
+            DrainChannel( Watcher, Watch->Channel, Now );
+
+            Cycles.Lap( mw::PhaseEnqueue );
+        }
+        else if ( Report )
+        {
+            const mw::EVENT Event = {
+                Now,
+                Current,
+                Previous,
+                Watch->Id,
+                static_cast< USHORT >( Watcher->Processor ),
+                static_cast< USHORT >( Watch->Replica != 0 ? mw::EVENT_FLAG_REPLICA : 0u )
+            };
+
+            PushEvent( Watcher, Watch->Session, Event );
+
+            logdbg( "[%lx] Store detected on %p: 0x%llx != 0x%llx | delta: %llu\n",
+                    KeGetCurrentProcessorNumber( ),
+                    Watch->Address,
+                    Previous,
+                    Current,
+                    __rdtsc ( ) - Start
+            );
+
+            Cycles.Lap( mw::PhaseEnqueue );
+        }
+    }
+
+    /*
+     * One wait followed by a look at every watch, or after a polling wait at those that came due during it. With
+     * residency measurement on, `IA32_MPERF` over the wait tells how much of it the core spent in C0; while an event
+     * wait blocks, whatever else runs on the processor counts as well.
+     */
+    VOID Iterate( mw::MONITOR_CONTEXT* Watcher, const mw::BACKEND Backend )
+    {
+        auto& Cycles = Watcher->Cycles;
+
+        Cycles.Lap( mw::PhaseRearm );
+
+        const auto Measure = ReadNoFence( &Watcher->Pool->MeasureResidency ) != 0;
+        const auto Active = Measure ? __readmsr( IA32_MPERF ) : 0llu;
+
+        const auto Start = __rdtsc ( );
+
+        if ( Backend == mw::BackendEvent )
+        {
+            WaitEvent( Watcher );
+        }
+        else if ( Backend == mw::BackendBackoff )
+        {
+            WaitBackoff( Watcher, Start );
+        }
+        else if ( Watcher->WatchCount == 1 )
+        {
+            WaitSingle( Watcher, Watcher->Watches[ 0 ], Start, Backend );
+        }
+        else
+        {
+            WaitScan( Watcher, Start );
+        }
+
+        /* A watch that hasn't earned a poll doesn't get read, compared or enqueued either, that's its share. */
+        const auto Polled = Backend == mw::BackendBackoff || ( Backend != mw::BackendEvent && Watcher->WatchCount != 1 );
+
+        if ( Measure )
+        {
+            Watcher->WaitCycles += __rdtsc ( ) - Start;
+            Watcher->WaitActiveCycles += __readmsr( IA32_MPERF ) - Active;
+        }
+
+        Cycles.Lap( mw::PhaseWait );
+
+        Watcher->Heartbeat = __rdtsc ( );
+        Watcher->Iterations++;
+
+        for ( ULONG i = 0; i < Watcher->WatchCount; i++ )
+        {
+            const auto Watch = Watcher->Watches[ i ];
+
+            if ( Polled && !Watch->Due )
+            {
+                continue;
+            }
+
+            Watch->Due = false;
+
+            CheckWatch( Watcher, Watch, Start );
+        }
+    }
+}
+
+VOID mw::Monitor( VOID* Context )
+{
+    const auto Watcher = static_cast< MONITOR_CONTEXT* >(
+        Context
+    );
+
+    /*
+     * `_mm_mwait` will halt execution, so every watcher gets a processor of its own, away from the manager and worker.
+     *  Ideally, we should check for IRQL before calling this, as it is only guaranteed the thread will migrate
+     *  to (one) of the target CPUs if at <= APC_LEVEL.
+     */
+    KeSetSystemAffinityThreadEx( AFFINITY_MASK( Watcher->Processor ) );
+
+    NT_ASSERT( KeGetCurrentProcessorNumber( ) == Watcher->Processor );
+
+    auto& Cycles = Watcher->Cycles;
+
+    Cycles.Begin( );
+
+    for ( ;; )
+    {
+        if ( ReadNoFence( &Watcher->Stalled ) != 0 )
+        {
+            break;
+        }
+
+        if ( InterlockedExchange( &Watcher->Pending, 0 ) != 0 )
+        {
+            ProcessHandOffs( Watcher );
+        }
+
+        if ( ReadNoFence( &Watcher->Stop ) != 0 )
+        {
+            break;
+        }
+
+        if ( ReadNoFence( &Watcher->Pool->Suspended ) != 0 )
+        {
+            Arm( Watcher, nullptr );
+            Suspend( Watcher );
+            continue;
+        }
+
+        if ( Watcher->WatchCount == 0 )
+        {
+            Arm( Watcher, nullptr );
+
+            KeWaitForSingleObject( &Watcher->Wake, Executive, KernelMode, false, nullptr );
+
+            Cycles.Begin( );
+            continue;
+        }
+
+        const auto Backend = static_cast< BACKEND >( ReadNoFence( &Watcher->Pool->Backend ) );
+
+        /* The only backend that blocks, it has to keep interrupts enabled. */
+        if ( Backend == BackendEvent )
+        {
+            Iterate( Watcher, Backend );
+            continue;
+        }
+
+        volatile INTERRUPT_GUARD _ { Watcher->IrqProfile };
+
+        Iterate( Watcher, Backend );
+    }
+
+    Arm( Watcher, nullptr );
+
+    if ( ReadNoFence( &Watcher->Stalled ) != 0 )
+    {
+        /* Our watches already belong to someone else. */
+        logmsg( "[%lu] Recovered after being declared stalled, exiting\n", Watcher->Index );
+    }
+    else
+    {
+        /*
+         * Anything still in our hands (or on its way to us) goes back to the pool manager to be placed again.
+         */
+        ProcessHandOffs( Watcher );
+
+        for ( ULONG i = 0; i < Watcher->WatchCount; i++ )
+        {
+            InterlockedExchange( &Watcher->Watches[ i ]->Owner, -1 );
+        }
+    }
+
+    Watcher->WatchCount = 0;
+
+    InterlockedExchange( &Watcher->Parked, 1 );
+
+    logmsg( "[%lu] Count identified writes: %llu\n", Watcher->Index, Watcher->Writes );
+}
@@ -0,0 +1,816 @@
+#include "../mwait/governor.hpp"
+#include "../mwlib/archive.hpp"
+#include "../mwlib/bench.hpp"
+#include "../mwlib/client.hpp"
+#include "../mwlib/filter.hpp"
+#include "../mwlib/series.hpp"
+#include "../mwlib/store.hpp"
+#include "../mwlib/trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Throughput of the consumer library's event kernels on synthetic events, for every instruction set the processor
+ * supports. Each case reports the best of `Repeats` runs.
+ *
+ * Series and archive compression, and how well the wait state governor would have predicted the writes, are also
+ * measured on a recorded trace when one is given, a file of raw `EVENT` records as returned by `IOCTL_READ_EVENTS`.
+ * With the driver loaded, the end-to-end suite measures how long its watchers take to detect the load generator's
+ * stores.
+ *
+ *     mwbench [--runs N] [--json results.json] [--label name] [--latency seconds] [trace file]
+ *
+ * Every suite runs `--runs` times and each run contributes one sample per metric to the JSON results, which
+ * `mwcompare` compares between two builds.
+ */
+namespace
+{
+    constexpr SIZE_T EVENT_COUNT = 1u << 22;
+    constexpr int Repeats = 9;
+
+    /*
+     * Filters run over one cache-resident batch, about what a single drain hands over, so they measure the kernel
+     * rather than memory bandwidth.
+     */
+    constexpr SIZE_T FILTER_BATCH = 1u << 14;
+    constexpr SIZE_T FILTER_PASSES = 256;
+
+    /* Events drained per poll by the end-to-end suite. */
+    constexpr SIZE_T LATENCY_DRAIN = 1u << 16;
+
+    mw::lib::BENCH_RESULTS Results;
+
+    std::vector< mw::EVENT > MakeEvents( )
+    {
+        std::mt19937_64 Random( 42 );
+
+        std::vector< mw::EVENT > Events( EVENT_COUNT );
+
+        ULONG64 Tsc = 0;
+
+        for ( auto& Event : Events )
+        {
+            Tsc += 100 + Random( ) % 1000;
+
+            Event.Tsc = Tsc;
+            Event.Watch = static_cast< ULONG >( Random( ) % 64 );
+            Event.Previous = Random( );
+
+            /* Mostly a few low bits flipping, like a counter or a flag word. */
+            Event.Value = Event.Previous ^ ( 1ull << ( Random( ) % 16 ) );
+            Event.Processor = static_cast< USHORT >( Random( ) % 4 );
+            Event.Flags = 0;
+        }
+
+        return Events;
+    }
+
+    /*
+     * What watched locations typically look like: counters bumped at a steady pace, flag words with a bit or two
+     * flipping, and the odd pointer-sized value changing wholesale.
+     */
+    std::vector< mw::EVENT > MakeTrace( )
+    {
+        constexpr ULONG WATCHES = 16;
+
+        std::mt19937_64 Random( 7 );
+
+        ULONG64 Next[ WATCHES ];
+        ULONG64 Period[ WATCHES ];
+        ULONG64 Value[ WATCHES ];
+
+        for ( ULONG w = 0; w < WATCHES; w++ )
+        {
+            Period[ w ] = 2000 + Random( ) % 50000;
+            Next[ w ] = Random( ) % Period[ w ];
+            Value[ w ] = ( w % 4 == 3 ) ? Random( ) : Random( ) % 4096;
+        }
+
+        std::vector< mw::EVENT > Events( EVENT_COUNT );
+
+        for ( auto& Event : Events )
+        {
+            ULONG Watch = 0;
+
+            for ( ULONG w = 1; w < WATCHES; w++ )
+            {
+                Watch = ( Next[ w ] < Next[ Watch ] ) ? w : Watch;
+            }
+
+            Event.Tsc = Next[ Watch ];
+            Event.Watch = Watch;
+            Event.Previous = Value[ Watch ];
+            Event.Processor = static_cast< USHORT >( Watch % 4 );
+            Event.Flags = 0;
+
+            switch ( Watch % 4 )
+            {
+                case 0:
+                    Value[ Watch ]++;
+                    break;
+                case 1:
+                    Value[ Watch ] ^= 1ull << ( Random( ) % 8 );
+                    break;
+                case 2:
+                    Value[ Watch ] += ( Random( ) % 8 == 0 ) ? 1 : 0;
+                    break;
+                default:
+                    Value[ Watch ] = Random( );
+                    break;
+            }
+
+            Event.Value = Value[ Watch ];
+
+            /* Mostly on schedule, sometimes late by a few hundred cycles. */
+            Next[ Watch ] += Period[ Watch ] + ( ( Random( ) % 4 == 0 ) ? Random( ) % 512 : 0 );
+        }
+
+        return Events;
+    }
+
+    bool LoadTrace( const char* Path, std::vector< mw::EVENT >& Events )
+    {
+        const auto File = std::fopen( Path, "rb" );
+
+        if ( !File )
+        {
+            return false;
+        }
+
+        mw::EVENT Event;
+
+        while ( std::fread( &Event, sizeof( Event ), 1, File ) == 1 )
+        {
+            Events.push_back( Event );
+        }
+
+        std::fclose( File );
+
+        return !Events.empty( );
+    }
+
+    template < typename RUN >
+    double BestSeconds( RUN&& Run )
+    {
+        auto Best = 1e30;
+
+        for ( int r = 0; r < Repeats; r++ )
+        {
+            const auto Start = std::chrono::steady_clock::now( );
+
+            Run( );
+
+            const auto Seconds = std::chrono::duration< double >( std::chrono::steady_clock::now( ) - Start ).count( );
+
+            Best = ( Seconds < Best ) ? Seconds : Best;
+        }
+
+        return Best;
+    }
+
+    void BenchFilter( const char* Name, const std::vector< mw::EVENT >& Events, const mw::lib::EVENT_FILTER& Filter )
+    {
+        std::vector< mw::EVENT > Out( FILTER_BATCH );
+
+        SIZE_T Reference = ~SIZE_T( 0 );
+
+        for ( const auto Isa : { mw::lib::ISA::Scalar, mw::lib::ISA::Avx2, mw::lib::ISA::Avx512 } )
+        {
+            if ( !mw::lib::Supports( Isa ) )
+            {
+                continue;
+            }
+
+            SIZE_T Kept = 0;
+
+            const auto Seconds = BestSeconds( [ & ] {
+                for ( SIZE_T Pass = 0; Pass < FILTER_PASSES; Pass++ )
+                {
+                    Kept = mw::lib::FilterEvents( Events.data( ), FILTER_BATCH, Filter, Out.data( ), Isa );
+                }
+            } );
+
+            const auto Total = FILTER_BATCH * FILTER_PASSES;
+
+            if ( Reference == ~SIZE_T( 0 ) )
+            {
+                Reference = Kept;
+            }
+
+            std::printf( "filter %-10s %-7s %8.1f Mevents/s %6.2f GB/s  kept %5.1f%%%s\n",
+                         Name,
+                         mw::lib::IsaName( Isa ),
+                         Total / Seconds / 1e6,
+                         Total * sizeof( mw::EVENT ) / Seconds / 1e9,
+                         100.0 * Kept / FILTER_BATCH,
+                         Kept == Reference ? "" : "  MISMATCH"
+            );
+
+            Results.Record( "micro", std::string( "filter " ) + Name + " " + mw::lib::IsaName( Isa ), "Mevents/s", true, Total / Seconds / 1e6 );
+        }
+    }
+
+    void BenchStore( const std::vector< mw::EVENT >& Events )
+    {
+        mw::lib::EVENT_STORE Store( Events.size( ) );
+
+        const auto AppendSeconds = BestSeconds( [ & ] {
+            Store.Append( Events.data( ), Events.size( ) );
+        } );
+
+        std::printf( "store  append             %8.1f Mevents/s\n", Events.size( ) / AppendSeconds / 1e6 );
+
+        Results.Record( "micro", "store append", "Mevents/s", true, Events.size( ) / AppendSeconds / 1e6 );
+
+        mw::lib::QUERY Query;
+
+        Query.Watch = 7;
+        Query.From = Events[ Events.size( ) / 4 ].Tsc;
+        Query.To = Events[ Events.size( ) * 3 / 4 ].Tsc;
+
+        auto Reference = mw::lib::kernels::EMPTY_AGGREGATE;
+
+        for ( const auto Isa : { mw::lib::ISA::Scalar, mw::lib::ISA::Avx2, mw::lib::ISA::Avx512 } )
+        {
+            if ( !mw::lib::Supports( Isa ) )
+            {
+                continue;
+            }
+
+            mw::lib::kernels::AGGREGATE Result = { };
+
+            const auto QuerySeconds = BestSeconds( [ & ] {
+                Result = Store.Aggregate( Query, Isa );
+            } );
+
+            if ( Isa == mw::lib::ISA::Scalar )
+            {
+                Reference = Result;
+            }
+
+            const auto Same = Result.Count == Reference.Count && Result.Sum == Reference.Sum && Result.Min == Reference.Min &&
+                              Result.Max == Reference.Max;
+
+            std::printf( "store  aggregate %-7s  %8.3f ms over %zu events, %llu matched%s\n",
+                         mw::lib::IsaName( Isa ),
+                         QuerySeconds * 1e3,
+                         Store.Size( ),
+                         static_cast< unsigned long long >( Result.Count ),
+                         Same ? "" : "  MISMATCH"
+            );
+
+            Results.Record( "micro", std::string( "store aggregate " ) + mw::lib::IsaName( Isa ), "ms", false, QuerySeconds * 1e3 );
+        }
+    }
+
+    /*
+     * Splits the trace into one (TSC, value) stream per watch, which is how traces store them.
+     */
+    void BenchSeries( const char* Name, const std::vector< mw::EVENT >& Events )
+    {
+        struct STREAM
+        {
+            std::vector< ULONG64 > Tsc;
+            std::vector< ULONG64 > Values;
+            std::vector< ULONG64 > Words;
+        };
+
+        std::map< ULONG, STREAM > Streams;
+
+        for ( const auto& Event : Events )
+        {
+            auto& Stream = Streams[ Event.Watch ];
+
+            Stream.Tsc.push_back( Event.Tsc );
+            Stream.Values.push_back( Event.Value );
+        }
+
+        const auto EncodeSeconds = BestSeconds( [ & ] {
+            for ( auto& [ Watch, Stream ] : Streams )
+            {
+                mw::lib::EncodeSeries( Stream.Tsc.data( ), Stream.Values.data( ), Stream.Tsc.size( ), Stream.Words );
+            }
+        } );
+
+        std::vector< ULONG64 > Tsc( Events.size( ) );
+        std::vector< ULONG64 > Values( Events.size( ) );
+
+        auto Intact = true;
+
+        const auto DecodeSeconds = BestSeconds( [ & ] {
+            for ( auto& [ Watch, Stream ] : Streams )
+            {
+                const auto Count = Stream.Tsc.size( );
+
+                Intact &= mw::lib::DecodeSeries( Stream.Words.data( ), Stream.Words.size( ), Count, Tsc.data( ), Values.data( ) ) == Count &&
+                          std::memcmp( Tsc.data( ), Stream.Tsc.data( ), Count * sizeof( ULONG64 ) ) == 0 &&
+                          std::memcmp( Values.data( ), Stream.Values.data( ), Count * sizeof( ULONG64 ) ) == 0;
+            }
+        } );
+
+        SIZE_T Bytes = 0;
+
+        for ( const auto& [ Watch, Stream ] : Streams )
+        {
+            Bytes += Stream.Words.size( ) * sizeof( ULONG64 );
+        }
+
+        std::printf( "series %-10s %zu watches, %5.2f bytes/event, %5.1fx smaller than TSC + value  encode %6.1f Mevents/s  decode %6.1f Mevents/s%s\n",
+                     Name,
+                     Streams.size( ),
+                     static_cast< double >( Bytes ) / Events.size( ),
+                     static_cast< double >( Events.size( ) * 2 * sizeof( ULONG64 ) ) / Bytes,
+                     Events.size( ) / EncodeSeconds / 1e6,
+                     Events.size( ) / DecodeSeconds / 1e6,
+                     Intact ? "" : "  MISMATCH"
+        );
+
+        Results.Record( "micro", std::string( "series " ) + Name + " encode", "Mevents/s", true, Events.size( ) / EncodeSeconds / 1e6 );
+        Results.Record( "micro", std::string( "series " ) + Name + " decode", "Mevents/s", true, Events.size( ) / DecodeSeconds / 1e6 );
+    }
+
+    /*
+     * Archives the trace as chunks of raw events and reads it all back, with a single thread and with one per
+     * processor.
+     */
+    void BenchArchive( const char* Name, const std::vector< mw::EVENT >& Events )
+    {
+        constexpr SIZE_T CHUNK_EVENTS = 1u << 16;
+        constexpr auto PATH = "mwbench.mwa";
+
+        for ( const auto Threads : { 1u, 0u } )
+        {
+            if ( Threads == 0 && std::thread::hardware_concurrency( ) <= 1 )
+            {
+                continue;
+            }
+
+            mw::lib::THREAD_POOL Pool( Threads );
+
+            ULONG64 Raw = 0;
+            ULONG64 Stored = 0;
+
+            const auto WriteSeconds = BestSeconds( [ & ] {
+                std::remove( PATH );
+
+                mw::lib::ARCHIVE_WRITER Writer( Pool );
+
+                Writer.Open( PATH );
+
+                for ( SIZE_T i = 0; i < Events.size( ); i += CHUNK_EVENTS )
+                {
+                    const auto Count = ( Events.size( ) - i < CHUNK_EVENTS ) ? ( Events.size( ) - i ) : CHUNK_EVENTS;
+                    const auto Bytes = reinterpret_cast< const unsigned char* >( &Events[ i ] );
+
+                    Writer.Write( Events[ i ].Tsc, Events[ i + Count - 1 ].Tsc, { Bytes, Bytes + Count * sizeof( mw::EVENT ) } );
+                }
+
+                Writer.Close( );
+
+                Raw = Writer.RawBytes( );
+                Stored = Writer.StoredBytes( );
+            } );
+
+            mw::lib::ARCHIVE_READER Reader( Pool );
+
+            std::vector< std::vector< unsigned char > > Chunks;
+
+            auto Intact = Reader.Open( PATH );
+
+            const auto ReadSeconds = BestSeconds( [ & ] {
+                Intact &= Reader.Read( 0, ~0ull, Chunks );
+            } );
+
+            SIZE_T Offset = 0;
+
+            for ( const auto& Chunk : Chunks )
+            {
+                Intact &= Offset + Chunk.size( ) <= Raw &&
+                          std::memcmp( Chunk.data( ), reinterpret_cast< const unsigned char* >( Events.data( ) ) + Offset, Chunk.size( ) ) == 0;
+                Offset += Chunk.size( );
+            }
+
+            Reader.Close( );
+            std::remove( PATH );
+
+            std::printf( "archive %-9s %2u threads  %5.1fx smaller  write %7.1f MB/s  read %7.1f MB/s%s\n",
+                         Name,
+                         Pool.Size( ),
+                         static_cast< double >( Raw ) / Stored,
+                         Raw / WriteSeconds / 1e6,
+                         Raw / ReadSeconds / 1e6,
+                         Intact && Offset == Raw ? "" : "  MISMATCH"
+            );
+
+            const auto Case = std::string( "archive " ) + Name + " " + std::to_string( Pool.Size( ) ) + " threads";
+
+            Results.Record( "micro", Case + " write", "MB/s", true, Raw / WriteSeconds / 1e6 );
+            Results.Record( "micro", Case + " read", "MB/s", true, Raw / ReadSeconds / 1e6 );
+        }
+    }
+
+    ULONG64 MeasureTscPerMicrosecond( )
+    {
+        const auto Start = std::chrono::steady_clock::now( );
+        const auto TscStart = mw::lib::ReadTsc( );
+
+        while ( std::chrono::steady_clock::now( ) - Start < std::chrono::milliseconds( 50 ) )
+        {
+        }
+
+        const auto Micro = std::chrono::duration< double, std::micro >( std::chrono::steady_clock::now( ) - Start ).count( );
+
+        return static_cast< ULONG64 >( ( mw::lib::ReadTsc( ) - TscStart ) / Micro );
+    }
+
+    /*
+     * Streams events stamped at append time to a trace file in drain-sized batches, as fast as the disk takes them.
+     */
+    void BenchTrace( const std::vector< mw::EVENT >& Events, const mw::lib::SYNC_POLICY Sync, const char* Name )
+    {
+        constexpr SIZE_T BATCH = 1024;
+        constexpr SIZE_T PASSES = 4;
+        constexpr auto PATH = "mwbench.trace";
+
+        mw::lib::TRACE_OPTIONS Options;
+
+        Options.Sync = Sync;
+        Options.TscPerMicrosecond = MeasureTscPerMicrosecond( );
+
+        mw::lib::TRACE_WRITER Writer;
+
+        if ( !Writer.Open( PATH, Options ) )
+        {
+            std::printf( "trace  unable to create %s\n", PATH );
+            return;
+        }
+
+        std::vector< mw::EVENT > Batch( BATCH );
+
+        auto Ok = true;
+
+        for ( SIZE_T Pass = 0; Pass < PASSES; Pass++ )
+        {
+            for ( SIZE_T i = 0; i + BATCH <= Events.size( ); i += BATCH )
+            {
+                std::memcpy( Batch.data( ), &Events[ i ], BATCH * sizeof( mw::EVENT ) );
+
+                const auto Now = mw::lib::ReadTsc( );
+
+                for ( auto& Event : Batch )
+                {
+                    Event.Tsc = Now;
+                }
+
+                Ok &= Writer.Append( Batch.data( ), Batch.size( ) );
+            }
+        }
+
+        Ok &= Writer.Close( );
+
+        const auto Stats = Writer.Stats( );
+
+        std::remove( PATH );
+
+        /* Sustained is the events' raw size over the whole run, writing is what actually went to disk while writing. */
+        std::printf( "trace  %-8s %-8s %7.1f MB/s sustained %7.1f MB/s writing %5.1fx packed  %llu stalls %7.1f ms  delay %8.1f us mean %8.1f us max%s\n",
+                     Stats.Direct ? "direct" : "buffered",
+                     Name,
+                     Stats.RawBytes / Stats.ElapsedSeconds / 1e6,
+                     Stats.Bytes / Stats.WriteSeconds / 1e6,
+                     Stats.Bytes ? static_cast< double >( Stats.RawBytes ) / Stats.Bytes : 0.0,
+                     static_cast< unsigned long long >( Stats.Stalls ),
+                     Stats.StallSeconds * 1e3,
+                     Stats.DelayMeanMicroseconds,
+                     Stats.DelayMaxMicroseconds,
+                     Ok ? "" : "  FAILED"
+        );
+
+        if ( Ok )
+        {
+            Results.Record( "micro", std::string( "trace " ) + Name + " sustained", "MB/s", true, Stats.RawBytes / Stats.ElapsedSeconds / 1e6 );
+        }
+    }
+
+    /*
+     * Replays each watch's intervals between writes through its own `GOVERNOR`, the way a dedicated watcher parks
+     * right after handling a write, and reports how often it picked the state the actual interval called for. The
+     * table is the driver's full list of wait states as if all of them parked, and wake-ups without a write, which the
+     * governor doesn't score, don't happen here.
+     */
+    void BenchGovernor( const char* Name, const std::vector< mw::EVENT >& Events )
+    {
+        const auto TscPerMicrosecond = MeasureTscPerMicrosecond( );
+        const auto Cycles = [ TscPerMicrosecond ]( const ULONG64 Ns ) { return Ns * TscPerMicrosecond / 1000; };
+
+        mw::gov::STATE_TABLE Table = { };
+
+        for ( const auto& Template : mw::gov::WAIT_STATE_TEMPLATES )
+        {
+            mw::gov::AddState( Table, Template, Cycles( Template.ExitLatencyNs ), Cycles( Template.TargetResidencyNs ) );
+        }
+
+        std::map< ULONG, std::vector< ULONG64 > > Writes;
+
+        for ( const auto& Event : Events )
+        {
+            Writes[ Event.Watch ].push_back( Event.Tsc );
+        }
+
+        mw::gov::ACCURACY Total = { };
+
+        for ( auto& [ Watch, Tsc ] : Writes )
+        {
+            std::sort( Tsc.begin( ), Tsc.end( ) );
+
+            mw::gov::GOVERNOR Governor = { };
+
+            for ( SIZE_T i = 1; i < Tsc.size( ); i++ )
+            {
+                const auto Interval = Tsc[ i ] - Tsc[ i - 1 ];
+
+                Governor.Predict( Table, Cycles( mw::gov::LATENCY_BUDGET_NS ), 0 );
+                Governor.Observe( Table, Interval, Interval );
+            }
+
+            Total.Predictions += Governor.Accuracy.Predictions;
+            Total.Hits += Governor.Accuracy.Hits;
+            Total.TooDeep += Governor.Accuracy.TooDeep;
+            Total.TooShallow += Governor.Accuracy.TooShallow;
+        }
+
+        const auto Percent = [ & ]( const ULONG64 Count ) {
+            return Total.Predictions ? 100.0 * Count / Total.Predictions : 0.0;
+        };
+
+        std::printf( "governor %-10s %zu watches, %llu predictions  hit %5.1f%%  too deep %5.1f%%  too shallow %5.1f%%\n",
+                     Name,
+                     Writes.size( ),
+                     static_cast< unsigned long long >( Total.Predictions ),
+                     Percent( Total.Hits ),
+                     Percent( Total.TooDeep ),
+                     Percent( Total.TooShallow )
+        );
+
+        Results.Record( "micro", std::string( "governor " ) + Name + " hits", "%", true, Percent( Total.Hits ) );
+        Results.Record( "micro", std::string( "governor " ) + Name + " too deep", "%", false, Percent( Total.TooDeep ) );
+        Results.Record( "micro", std::string( "governor " ) + Name + " too shallow", "%", false, Percent( Total.TooShallow ) );
+    }
+
+    /*
+     * Sums detected and missed stores over every watch.
+     */
+    struct DETECTIONS
+    {
+        ULONG64 Events;
+        ULONG64 Missed;
+
+        /* Publish channels only. */
+        ULONG64 Published;
+        ULONG64 DoorbellsAvoided;
+    };
+
+    bool CountDetections( mw::lib::DEVICE& Device, DETECTIONS& Counts )
+    {
+        std::vector< unsigned char > Buffer;
+
+        if ( !Device.QueryStats( Buffer ) )
+        {
+            return false;
+        }
+
+        const auto Stats = reinterpret_cast< mw::STATS* >( Buffer.data( ) );
+        const auto Watches = mw::GetWatchStats( Stats );
+
+        Counts = { };
+
+        for ( ULONG i = 0; i < Stats->WatchCount; i++ )
+        {
+            Counts.Events += Watches[ i ].Events;
+            Counts.Missed += Watches[ i ].Missed;
+            Counts.Published += Watches[ i ].Published;
+            Counts.DoorbellsAvoided += Watches[ i ].DoorbellsAvoided;
+        }
+
+        return true;
+    }
+
+    /*
+     * The load generator stores the TSC it writes at, so an event's own TSC minus its value is how long the watchers
+     * took to see the store. Values that can't be such a TSC (a trace being replayed) are left out.
+     */
+    void BenchLatency( const double Seconds )
+    {
+        mw::lib::DEVICE Device;
+
+        DETECTIONS Before;
+
+        if ( !Device.Open( ) || !CountDetections( Device, Before ) )
+        {
+            std::printf( "latency  driver not loaded, skipped\n" );
+            return;
+        }
+
+        std::vector< unsigned char > Buffer;
+
+        Device.QueryStats( Buffer );
+
+        const auto TscPerMicrosecond = reinterpret_cast< const mw::STATS* >( Buffer.data( ) )->TscPerMicrosecond;
+
+        std::vector< mw::EVENT > Events;
+        std::vector< double > Latency;
+
+        /* Whatever is buffered already was detected before this run. */
+        Device.ReadEvents( Events, LATENCY_DRAIN );
+
+        const auto Deadline = std::chrono::steady_clock::now( ) + std::chrono::duration< double >( Seconds );
+
+        while ( std::chrono::steady_clock::now( ) < Deadline && TscPerMicrosecond )
+        {
+            if ( !Device.ReadEvents( Events, LATENCY_DRAIN ) )
+            {
+                break;
+            }
+
+            for ( const auto& Event : Events )
+            {
+                if ( Event.Tsc >= Event.Value && Event.Tsc - Event.Value < TscPerMicrosecond * 1000000 )
+                {
+                    Latency.push_back( static_cast< double >( Event.Tsc - Event.Value ) / TscPerMicrosecond );
+                }
+            }
+
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        }
+
+        DETECTIONS After = Before;
+
+        CountDetections( Device, After );
+
+        if ( Latency.empty( ) )
+        {
+            std::printf( "latency  no stores detected in %.1f s\n", Seconds );
+            return;
+        }
+
+        std::sort( Latency.begin( ), Latency.end( ) );
+
+        const auto At = [ &Latency ]( const double Quantile ) {
+            return Latency[ static_cast< SIZE_T >( Quantile * ( Latency.size( ) - 1 ) ) ];
+        };
+
+        const auto Detected = After.Events - Before.Events;
+        const auto Missed = After.Missed - Before.Missed;
+        const auto Published = After.Published - Before.Published;
+        const auto Avoided = After.DoorbellsAvoided - Before.DoorbellsAvoided;
+        const auto MissRate = ( Detected + Missed ) ? 100.0 * Missed / ( Detected + Missed ) : 0.0;
+
+        std::printf( "latency  %zu stores  p50 %8.2f us  p99 %8.2f us  p99.9 %8.2f us  max %8.2f us  missed %.3f%%\n",
+                     Latency.size( ),
+                     At( 0.5 ),
+                     At( 0.99 ),
+                     At( 0.999 ),
+                     Latency.back( ),
+                     MissRate
+        );
+
+        Results.Record( "e2e", "detection p50", "us", false, At( 0.5 ) );
+        Results.Record( "e2e", "detection p99", "us", false, At( 0.99 ) );
+        Results.Record( "e2e", "detection p99.9", "us", false, At( 0.999 ) );
+        Results.Record( "e2e", "missed", "%", false, MissRate );
+
+        if ( Published != 0 )
+        {
+            std::printf( "publish  %llu updates, %llu doorbell(s) avoided (%.1f%%)\n",
+                         static_cast< unsigned long long >( Published ),
+                         static_cast< unsigned long long >( Avoided ),
+                         100.0 * Avoided / Published
+            );
+
+            Results.Record( "e2e", "doorbells avoided", "%", true, 100.0 * Avoided / Published );
+        }
+    }
+}
+
+int main( int argc, char** argv )
+{
+    ULONG Runs = 1;
+    double LatencySeconds = 5.0;
+    const char* JsonPath = nullptr;
+    const char* TracePath = nullptr;
+
+    Results.Label = "unnamed";
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const std::string Option = argv[ i ];
+        const auto HasValue = i + 1 < argc;
+
+        if ( Option == "--runs" && HasValue )
+        {
+            Runs = static_cast< ULONG >( std::max( 1, std::atoi( argv[ ++i ] ) ) );
+        }
+        else if ( Option == "--json" && HasValue )
+        {
+            JsonPath = argv[ ++i ];
+        }
+        else if ( Option == "--label" && HasValue )
+        {
+            Results.Label = argv[ ++i ];
+        }
+        else if ( Option == "--latency" && HasValue )
+        {
+            LatencySeconds = std::atof( argv[ ++i ] );
+        }
+        else if ( Option.rfind( "--", 0 ) != 0 && !TracePath )
+        {
+            TracePath = argv[ i ];
+        }
+        else
+        {
+            std::printf( "Usage: %s [--runs N] [--json results.json] [--label name] [--latency seconds] [trace file]\n", argv[ 0 ] );
+            return 1;
+        }
+    }
+
+    Results.Isa = mw::lib::IsaName( mw::lib::BestIsa( ) );
+    Results.Runs = Runs;
+
+    const auto Events = MakeEvents( );
+    const auto Trace = MakeTrace( );
+
+    std::vector< mw::EVENT > Recorded;
+
+    if ( TracePath && !LoadTrace( TracePath, Recorded ) )
+    {
+        std::printf( "Unable to read events from %s\n", TracePath );
+        return 1;
+    }
+
+    mw::lib::EVENT_FILTER Watches;
+    Watches.Watches = 0x0101010101010101ull;
+
+    mw::lib::EVENT_FILTER Range;
+    Range.MinValue = 0;
+    Range.MaxValue = ~0ull / 2;
+
+    mw::lib::EVENT_FILTER Changed;
+    Changed.ChangedBits = 0xff;
+
+    mw::lib::EVENT_FILTER All;
+    All.Watches = 0x00000000ffffffffull;
+    All.MaxValue = ~0ull / 2;
+    All.ChangedBits = 0xff;
+
+    for ( ULONG Run = 0; Run < Runs; Run++ )
+    {
+        if ( Runs > 1 )
+        {
+            std::printf( "run %u/%u\n", Run + 1, Runs );
+        }
+
+        BenchFilter( "watches", Events, Watches );
+        BenchFilter( "range", Events, Range );
+        BenchFilter( "changed", Events, Changed );
+        BenchFilter( "combined", Events, All );
+
+        BenchStore( Events );
+
+        BenchTrace( Events, mw::lib::SYNC_POLICY::Never, "no sync" );
+        BenchTrace( Events, mw::lib::SYNC_POLICY::Periodic, "periodic" );
+        BenchTrace( Events, mw::lib::SYNC_POLICY::EveryBlock, "every" );
+
+        BenchSeries( "synthetic", Trace );
+        BenchArchive( "synthetic", Trace );
+        BenchGovernor( "synthetic", Trace );
+
+        if ( !Recorded.empty( ) )
+        {
+            BenchSeries( "recorded", Recorded );
+            BenchArchive( "recorded", Recorded );
+            BenchGovernor( "recorded", Recorded );
+        }
+
+        if ( LatencySeconds > 0 )
+        {
+            BenchLatency( LatencySeconds );
+        }
+    }
+
+    if ( JsonPath && !mw::lib::SaveResults( JsonPath, Results ) )
+    {
+        std::printf( "Unable to write %s\n", JsonPath );
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "../mwlib/compare.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/*
+ * Compares the results `mwbench --json` wrote for two builds and fails if any metric regressed significantly, so it
+ * can gate a change in CI.
+ *
+ *     mwcompare [--alpha 0.05] [--min-change 2] <baseline.json> <candidate.json>
+ *
+ * Exits with 0 if nothing regressed, 1 if something did, and 2 if the results couldn't be read.
+ */
+int main( int argc, char** argv )
+{
+    mw::lib::COMPARE_OPTIONS Options;
+
+    std::vector< const char* > Paths;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const std::string Option = argv[ i ];
+        const auto HasValue = i + 1 < argc;
+
+        if ( Option == "--alpha" && HasValue )
+        {
+            Options.Alpha = std::atof( argv[ ++i ] );
+        }
+        else if ( Option == "--min-change" && HasValue )
+        {
+            Options.MinChange = std::atof( argv[ ++i ] ) / 100.0;
+        }
+        else if ( Option.rfind( "--", 0 ) != 0 )
+        {
+            Paths.push_back( argv[ i ] );
+        }
+        else
+        {
+            Paths.clear( );
+            break;
+        }
+    }
+
+    if ( Paths.size( ) != 2 || !( Options.Alpha > 0 && Options.Alpha < 1 ) )
+    {
+        std::fprintf( stderr, "Usage: %s [--alpha 0.05] [--min-change percent] <baseline.json> <candidate.json>\n", argv[ 0 ] );
+        return 2;
+    }
+
+    mw::lib::BENCH_RESULTS Baseline;
+    mw::lib::BENCH_RESULTS Candidate;
+
+    for ( const auto& [ Path, Results ] : { std::pair{ Paths[ 0 ], &Baseline }, std::pair{ Paths[ 1 ], &Candidate } } )
+    {
+        if ( !mw::lib::LoadResults( Path, *Results ) )
+        {
+            std::fprintf( stderr, "Unable to read results from %s\n", Path );
+            return 2;
+        }
+    }
+
+    std::printf( "baseline  %s (%s, %u runs)\ncandidate %s (%s, %u runs)\n\n",
+                 Baseline.Label.c_str( ),
+                 Baseline.Isa.c_str( ),
+                 Baseline.Runs,
+                 Candidate.Label.c_str( ),
+                 Candidate.Isa.c_str( ),
+                 Candidate.Runs
+    );
+
+    if ( Baseline.Isa != Candidate.Isa )
+    {
+        std::printf( "warning: the two builds ran on processors with different instruction sets\n\n" );
+    }
+
+    std::vector< mw::lib::COMPARISON > Comparisons;
+
+    mw::lib::CompareResults( Baseline, Candidate, Options, Comparisons );
+
+    std::printf( "%-5s %-38s %-10s %12s %12s %9s %21s %8s  %s\n",
+                 "suite", "metric", "unit", "baseline", "candidate", "change", "interval", "p", "verdict" );
+
+    ULONG Regressions = 0;
+
+    for ( const auto& Entry : Comparisons )
+    {
+        const auto Metric = Entry.Baseline ? Entry.Baseline : Entry.Candidate;
+
+        if ( Entry.Verdict == mw::lib::VERDICT::Missing )
+        {
+            std::printf( "%-5s %-38s %-10s %12s %12s %9s %21s %8s  %s in %s\n",
+                         Metric->Suite.c_str( ),
+                         Metric->Name.c_str( ),
+                         Metric->Unit.c_str( ),
+                         "", "", "", "", "",
+                         mw::lib::VerdictName( Entry.Verdict ),
+                         Entry.Baseline ? "candidate" : "baseline"
+            );
+            continue;
+        }
+
+        char Interval[ 32 ];
+
+        std::snprintf( Interval, sizeof( Interval ), "[%+.2f%%, %+.2f%%]", Entry.Low * 100.0, Entry.High * 100.0 );
+
+        std::printf( "%-5s %-38s %-10s %12.3f %12.3f %+8.2f%% %21s %8.4f  %s\n",
+                     Metric->Suite.c_str( ),
+                     Metric->Name.c_str( ),
+                     Metric->Unit.c_str( ),
+                     Entry.BaselineMedian,
+                     Entry.CandidateMedian,
+                     Entry.Change * 100.0,
+                     Interval,
+                     Entry.P,
+                     mw::lib::VerdictName( Entry.Verdict )
+        );
+
+        Regressions += ( Entry.Verdict == mw::lib::VERDICT::Regressed ) ? 1 : 0;
+    }
+
+    std::printf( "\n%u regression(s)\n", Regressions );
+
+    return Regressions ? 1 : 0;
+}
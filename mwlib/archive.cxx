@@ -0,0 +1,344 @@
+#include "archive.hpp"
+#include "lz.hpp"
+
+#include <array>
+
+#if defined( _WIN32 )
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    static_assert( sizeof( mw::lib::CHUNK_HEADER ) == 40 );
+
+    /* Archives easily outgrow what `long` offsets reach on Windows. */
+    bool Seek( std::FILE* File, const ULONG64 Offset, const int Origin )
+    {
+#if defined( _WIN32 )
+        return _fseeki64( File, static_cast< __int64 >( Offset ), Origin ) == 0;
+#else
+        return fseeko( File, static_cast< off_t >( Offset ), Origin ) == 0;
+#endif
+    }
+
+    ULONG64 Tell( std::FILE* File )
+    {
+#if defined( _WIN32 )
+        return static_cast< ULONG64 >( _ftelli64( File ) );
+#else
+        return static_cast< ULONG64 >( ftello( File ) );
+#endif
+    }
+
+    bool Truncate( std::FILE* File, const ULONG64 Size )
+    {
+        if ( std::fflush( File ) != 0 )
+        {
+            return false;
+        }
+
+#if defined( _WIN32 )
+        return _chsize_s( _fileno( File ), static_cast< __int64 >( Size ) ) == 0;
+#else
+        return ftruncate( fileno( File ), static_cast< off_t >( Size ) ) == 0;
+#endif
+    }
+
+    constexpr auto CRC_TABLE = [ ] {
+        std::array< ULONG, 256 > Table = { };
+
+        for ( ULONG i = 0; i < 256; i++ )
+        {
+            auto Crc = i;
+
+            for ( int Bit = 0; Bit < 8; Bit++ )
+            {
+                Crc = ( Crc >> 1 ) ^ ( ( Crc & 1 ) ? 0xedb88320u : 0 );
+            }
+
+            Table[ i ] = Crc;
+        }
+
+        return Table;
+    }( );
+
+    /*
+     * Plain CRC-32. LZ decoding only notices a corrupted match or length, not a corrupted literal.
+     */
+    ULONG Checksum( const std::vector< unsigned char >& Data )
+    {
+        ULONG Crc = ~0u;
+
+        for ( const auto Byte : Data )
+        {
+            Crc = CRC_TABLE[ ( Crc ^ Byte ) & 0xff ] ^ ( Crc >> 8 );
+        }
+
+        return ~Crc;
+    }
+
+    /*
+     * Indexes the chunks from the start of the file up to the first one that isn't all there, and returns in `Valid`
+     * where that one starts.
+     */
+    bool ScanChunks( std::FILE* File, std::vector< mw::lib::CHUNK_INFO >& Index, ULONG64& Valid )
+    {
+        if ( !Seek( File, 0, SEEK_END ) )
+        {
+            return false;
+        }
+
+        const auto End = Tell( File );
+
+        Valid = 0;
+
+        while ( Valid + sizeof( mw::lib::CHUNK_HEADER ) <= End )
+        {
+            mw::lib::CHUNK_INFO Chunk;
+
+            if ( !Seek( File, Valid, SEEK_SET ) || std::fread( &Chunk.Header, sizeof( Chunk.Header ), 1, File ) != 1 )
+            {
+                return false;
+            }
+
+            Chunk.Offset = Valid + sizeof( mw::lib::CHUNK_HEADER );
+
+            if ( Chunk.Header.Magic != mw::lib::ARCHIVE_MAGIC || Chunk.Offset + Chunk.Header.StoredSize > End )
+            {
+                break;
+            }
+
+            Index.push_back( Chunk );
+            Valid = Chunk.Offset + Chunk.Header.StoredSize;
+        }
+
+        return true;
+    }
+
+    struct DECODED
+    {
+        bool Ok;
+        std::vector< unsigned char > Data;
+    };
+}
+
+mw::lib::ARCHIVE_WRITER::ARCHIVE_WRITER( THREAD_POOL& Pool ) : Pool( Pool )
+{
+}
+
+mw::lib::ARCHIVE_WRITER::~ARCHIVE_WRITER( )
+{
+    Close( );
+}
+
+bool mw::lib::ARCHIVE_WRITER::Open( const char* Path )
+{
+    Close( );
+
+    Failed = false;
+    Raw = 0;
+    Stored = 0;
+
+    /* Creates the file without truncating it, then reopens it for reading the headers and cutting it short. */
+    File = std::fopen( Path, "ab" );
+
+    if ( !File || std::fclose( File ) != 0 || !( File = std::fopen( Path, "r+b" ) ) )
+    {
+        File = nullptr;
+        return false;
+    }
+
+    std::vector< CHUNK_INFO > Index;
+    ULONG64 Valid;
+
+    /* Appending behind a torn chunk would have its stored size swallow the next header. */
+    if ( !ScanChunks( File, Index, Valid ) || !Truncate( File, Valid ) || !Seek( File, Valid, SEEK_SET ) )
+    {
+        std::fclose( File );
+        File = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+bool mw::lib::ARCHIVE_WRITER::Write( ULONG64 First, ULONG64 Last, std::vector< unsigned char > Data )
+{
+    if ( !File || Data.size( ) > ~0u )
+    {
+        return false;
+    }
+
+    while ( InFlight.size( ) >= 2 * Pool.Size( ) )
+    {
+        Retire( );
+    }
+
+    InFlight.push_back( Pool.Submit( [ First, Last, Raw = std::move( Data ) ]( ) mutable {
+        PENDING Chunk;
+
+        Chunk.Header = { ARCHIVE_MAGIC, 0, static_cast< ULONG >( Raw.size( ) ), 0, First, Last, 0, 0 };
+        Chunk.Data.resize( lz::CompressBound( Raw.size( ) ) );
+
+        const auto Size = lz::Compress( Raw.data( ), Raw.size( ), Chunk.Data.data( ), Chunk.Data.size( ) );
+
+        if ( Size != 0 && Size < Raw.size( ) )
+        {
+            Chunk.Header.Flags = CHUNK_COMPRESSED;
+            Chunk.Data.resize( Size );
+        }
+        else
+        {
+            Chunk.Data = std::move( Raw );
+        }
+
+        Chunk.Header.StoredSize = static_cast< ULONG >( Chunk.Data.size( ) );
+        Chunk.Header.Checksum = Checksum( Chunk.Data );
+
+        return Chunk;
+    } ) );
+
+    return !Failed;
+}
+
+void mw::lib::ARCHIVE_WRITER::Retire( )
+{
+    const auto Chunk = InFlight.front( ).get( );
+
+    InFlight.pop_front( );
+
+    if ( Failed )
+    {
+        return;
+    }
+
+    if ( std::fwrite( &Chunk.Header, sizeof( Chunk.Header ), 1, File ) != 1 ||
+         ( !Chunk.Data.empty( ) && std::fwrite( Chunk.Data.data( ), Chunk.Data.size( ), 1, File ) != 1 ) )
+    {
+        Failed = true;
+        return;
+    }
+
+    Raw += Chunk.Header.RawSize;
+    Stored += sizeof( Chunk.Header ) + Chunk.Header.StoredSize;
+}
+
+bool mw::lib::ARCHIVE_WRITER::Close( )
+{
+    while ( !InFlight.empty( ) )
+    {
+        Retire( );
+    }
+
+    if ( File )
+    {
+        Failed |= std::fclose( File ) != 0;
+        File = nullptr;
+    }
+
+    return !Failed;
+}
+
+mw::lib::ARCHIVE_READER::ARCHIVE_READER( THREAD_POOL& Pool ) : Pool( Pool )
+{
+}
+
+mw::lib::ARCHIVE_READER::~ARCHIVE_READER( )
+{
+    Close( );
+}
+
+bool mw::lib::ARCHIVE_READER::Open( const char* Path )
+{
+    Close( );
+
+    File = std::fopen( Path, "rb" );
+
+    ULONG64 Valid;
+
+    if ( !File || !ScanChunks( File, Index, Valid ) )
+    {
+        Close( );
+        return false;
+    }
+
+    return true;
+}
+
+void mw::lib::ARCHIVE_READER::Close( )
+{
+    if ( File )
+    {
+        std::fclose( File );
+        File = nullptr;
+    }
+
+    Index.clear( );
+}
+
+bool mw::lib::ARCHIVE_READER::Read( ULONG64 From, ULONG64 To, std::vector< std::vector< unsigned char > >& Out )
+{
+    Out.clear( );
+
+    if ( !File )
+    {
+        return false;
+    }
+
+    std::vector< std::future< DECODED > > Pending;
+
+    auto Ok = true;
+
+    for ( const auto& Chunk : Index )
+    {
+        if ( Chunk.Header.Last < From || Chunk.Header.First > To )
+        {
+            continue;
+        }
+
+        std::vector< unsigned char > Data( Chunk.Header.StoredSize );
+
+        if ( !Seek( File, Chunk.Offset, SEEK_SET ) || ( !Data.empty( ) && std::fread( Data.data( ), Data.size( ), 1, File ) != 1 ) )
+        {
+            Ok = false;
+            break;
+        }
+
+        Pending.push_back( Pool.Submit( [ Header = Chunk.Header, Data = std::move( Data ) ]( ) mutable {
+            if ( Checksum( Data ) != Header.Checksum )
+            {
+                return DECODED{ false, { } };
+            }
+
+            if ( !( Header.Flags & CHUNK_COMPRESSED ) )
+            {
+                return DECODED{ Data.size( ) == Header.RawSize, std::move( Data ) };
+            }
+
+            DECODED Decoded{ false, std::vector< unsigned char >( Header.RawSize ) };
+
+            Decoded.Ok = lz::Decompress( Data.data( ), Data.size( ), Decoded.Data.data( ), Decoded.Data.size( ) );
+
+            return Decoded;
+        } ) );
+    }
+
+    /* Everything submitted has to be waited for either way, the lambdas own the buffers. */
+    for ( auto& Future : Pending )
+    {
+        auto Decoded = Future.get( );
+
+        Ok &= Decoded.Ok;
+
+        Out.push_back( std::move( Decoded.Data ) );
+    }
+
+    if ( !Ok )
+    {
+        Out.clear( );
+    }
+
+    return Ok;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "platform.hpp"
+#include "threads.hpp"
+
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <vector>
+
+/*
+ * Long-term storage for trace chunks: every chunk is compressed with the built-in LZ codec on a thread pool and
+ * appended to a file behind a small header. The header keeps the chunk's key range (normally the TSC span of its
+ * events) uncompressed, so readers skip what a query doesn't cover without decompressing it, and decompress the rest
+ * in parallel.
+ *
+ * A file is just a sequence of chunks. Whatever a crashed writer left half written at the end is ignored by readers
+ * and cut off by the next writer to open the file, and a checksum of the stored bytes catches chunks damaged after the
+ * fact.
+ */
+namespace mw::lib
+{
+    /* "MWA2", archives from before chunks had a checksum read as empty. */
+    constexpr ULONG ARCHIVE_MAGIC = 0x3241574d;
+
+    /* Without it the chunk is stored as is, because compressing didn't make it any smaller. */
+    constexpr ULONG CHUNK_COMPRESSED = 1;
+
+    struct CHUNK_HEADER
+    {
+        ULONG Magic;
+        ULONG Flags;
+        ULONG RawSize;
+        ULONG StoredSize;
+        ULONG64 First;
+        ULONG64 Last;
+
+        /* CRC-32 of the `StoredSize` bytes that follow. */
+        ULONG Checksum;
+        ULONG Reserved;
+    };
+
+    struct CHUNK_INFO
+    {
+        CHUNK_HEADER Header;
+
+        /* Of the stored data, right behind the header. */
+        ULONG64 Offset;
+    };
+
+    class ARCHIVE_WRITER
+    {
+    public:
+        explicit ARCHIVE_WRITER( THREAD_POOL& Pool );
+        ~ARCHIVE_WRITER( );
+
+        ARCHIVE_WRITER( const ARCHIVE_WRITER& ) = delete;
+        ARCHIVE_WRITER& operator=( const ARCHIVE_WRITER& ) = delete;
+
+        /*
+         * Creates `Path`, or appends to it if it already exists, after cutting off any chunk left incomplete.
+         */
+        bool Open( const char* Path );
+
+        /*
+         * Queues `Data` for compression. Chunks end up in the file in the order they're written; this only blocks when
+         * the pool falls behind by more than a couple of chunks per thread.
+         */
+        bool Write( ULONG64 First, ULONG64 Last, std::vector< unsigned char > Data );
+
+        /*
+         * Waits for everything queued and closes the file. False if anything along the way failed.
+         */
+        bool Close( );
+
+        ULONG64 RawBytes( ) const
+        {
+            return Raw;
+        }
+
+        ULONG64 StoredBytes( ) const
+        {
+            return Stored;
+        }
+
+    private:
+        struct PENDING
+        {
+            CHUNK_HEADER Header;
+            std::vector< unsigned char > Data;
+        };
+
+        /*
+         * Waits for the oldest chunk in flight and writes it out.
+         */
+        void Retire( );
+
+        THREAD_POOL& Pool;
+
+        std::FILE* File = nullptr;
+        std::deque< std::future< PENDING > > InFlight;
+        bool Failed = false;
+
+        ULONG64 Raw = 0;
+        ULONG64 Stored = 0;
+    };
+
+    class ARCHIVE_READER
+    {
+    public:
+        explicit ARCHIVE_READER( THREAD_POOL& Pool );
+        ~ARCHIVE_READER( );
+
+        ARCHIVE_READER( const ARCHIVE_READER& ) = delete;
+        ARCHIVE_READER& operator=( const ARCHIVE_READER& ) = delete;
+
+        /*
+         * Opens `Path` and indexes its chunks by their headers alone.
+         */
+        bool Open( const char* Path );
+        void Close( );
+
+        const std::vector< CHUNK_INFO >& Chunks( ) const
+        {
+            return Index;
+        }
+
+        /*
+         * Replaces the contents of `Out` with every chunk whose key range overlaps `[From, To]`, in file order.
+         * Chunks are read one after the other and decompressed in parallel as they come in.
+         */
+        bool Read( ULONG64 From, ULONG64 To, std::vector< std::vector< unsigned char > >& Out );
+
+    private:
+        THREAD_POOL& Pool;
+
+        std::FILE* File = nullptr;
+        std::vector< CHUNK_INFO > Index;
+    };
+}
@@ -0,0 +1,482 @@
+#include "bench.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    void WriteString( std::FILE* File, const std::string& Text )
+    {
+        std::fputc( '"', File );
+
+        for ( const auto Char : Text )
+        {
+            if ( Char == '"' || Char == '\\' )
+            {
+                std::fputc( '\\', File );
+                std::fputc( Char, File );
+            }
+            else if ( static_cast< unsigned char >( Char ) < 0x20 )
+            {
+                std::fprintf( File, "\\u%04x", static_cast< unsigned int >( Char ) );
+            }
+            else
+            {
+                std::fputc( Char, File );
+            }
+        }
+
+        std::fputc( '"', File );
+    }
+
+    /*
+     * Just enough JSON to read results back: objects, arrays, strings, numbers and booleans, with anything it isn't
+     * looking for skipped over.
+     */
+    class PARSER
+    {
+    public:
+        explicit PARSER( const std::string& Text )
+            : Text( Text )
+        {
+        }
+
+        bool Peek( const char Char )
+        {
+            SkipSpace( );
+            return At < Text.size( ) && Text[ At ] == Char;
+        }
+
+        bool Take( const char Char )
+        {
+            if ( !Peek( Char ) )
+            {
+                return false;
+            }
+
+            At++;
+            return true;
+        }
+
+        bool String( std::string& Out )
+        {
+            Out.clear( );
+
+            if ( !Take( '"' ) )
+            {
+                return false;
+            }
+
+            while ( At < Text.size( ) )
+            {
+                const auto Char = Text[ At++ ];
+
+                if ( Char == '"' )
+                {
+                    return true;
+                }
+
+                if ( Char != '\\' )
+                {
+                    Out.push_back( Char );
+                    continue;
+                }
+
+                if ( At >= Text.size( ) )
+                {
+                    return false;
+                }
+
+                const auto Escaped = Text[ At++ ];
+
+                switch ( Escaped )
+                {
+                    case 'n': Out.push_back( '\n' ); break;
+                    case 't': Out.push_back( '\t' ); break;
+                    case 'r': Out.push_back( '\r' ); break;
+                    case 'b': Out.push_back( '\b' ); break;
+                    case 'f': Out.push_back( '\f' ); break;
+
+                    case 'u':
+                    {
+                        /* Only ever written for control characters, anything wider is kept as '?'. */
+                        if ( At + 4 > Text.size( ) )
+                        {
+                            return false;
+                        }
+
+                        const auto Code = std::strtoul( Text.substr( At, 4 ).c_str( ), nullptr, 16 );
+
+                        Out.push_back( Code < 0x80 ? static_cast< char >( Code ) : '?' );
+                        At += 4;
+                        break;
+                    }
+
+                    default: Out.push_back( Escaped ); break;
+                }
+            }
+
+            return false;
+        }
+
+        bool Number( double& Out )
+        {
+            SkipSpace( );
+
+            const auto Start = Text.c_str( ) + At;
+            char* End = nullptr;
+
+            Out = std::strtod( Start, &End );
+
+            if ( End == Start )
+            {
+                return false;
+            }
+
+            At += static_cast< SIZE_T >( End - Start );
+            return true;
+        }
+
+        bool Boolean( bool& Out )
+        {
+            SkipSpace( );
+
+            if ( Text.compare( At, 4, "true" ) == 0 )
+            {
+                Out = true;
+                At += 4;
+                return true;
+            }
+
+            if ( Text.compare( At, 5, "false" ) == 0 )
+            {
+                Out = false;
+                At += 5;
+                return true;
+            }
+
+            return false;
+        }
+
+        bool Skip( )
+        {
+            SkipSpace( );
+
+            if ( At >= Text.size( ) )
+            {
+                return false;
+            }
+
+            std::string Ignored;
+            double Number = 0;
+
+            switch ( Text[ At ] )
+            {
+                case '"':
+                    return String( Ignored );
+
+                case '{':
+                case '[':
+                {
+                    const auto Close = ( Text[ At++ ] == '{' ) ? '}' : ']';
+
+                    if ( Take( Close ) )
+                    {
+                        return true;
+                    }
+
+                    do
+                    {
+                        if ( Close == '}' && !( String( Ignored ) && Take( ':' ) ) )
+                        {
+                            return false;
+                        }
+
+                        if ( !Skip( ) )
+                        {
+                            return false;
+                        }
+                    }
+                    while ( Take( ',' ) );
+
+                    return Take( Close );
+                }
+
+                case 't':
+                case 'f':
+                {
+                    bool Value = false;
+                    return Boolean( Value );
+                }
+
+                case 'n':
+                    if ( Text.compare( At, 4, "null" ) != 0 )
+                    {
+                        return false;
+                    }
+
+                    At += 4;
+                    return true;
+
+                default:
+                    return this->Number( Number );
+            }
+        }
+
+        bool End( )
+        {
+            SkipSpace( );
+            return At == Text.size( );
+        }
+
+    private:
+        void SkipSpace( )
+        {
+            while ( At < Text.size( ) && ( Text[ At ] == ' ' || Text[ At ] == '\t' || Text[ At ] == '\n' || Text[ At ] == '\r' ) )
+            {
+                At++;
+            }
+        }
+
+        const std::string& Text;
+        SIZE_T At = 0;
+    };
+
+    bool ParseMetric( PARSER& Parser, mw::lib::BENCH_METRIC& Metric )
+    {
+        if ( !Parser.Take( '{' ) )
+        {
+            return false;
+        }
+
+        if ( Parser.Take( '}' ) )
+        {
+            return true;
+        }
+
+        do
+        {
+            std::string Key;
+
+            if ( !Parser.String( Key ) || !Parser.Take( ':' ) )
+            {
+                return false;
+            }
+
+            auto Ok = true;
+
+            if ( Key == "suite" )
+            {
+                Ok = Parser.String( Metric.Suite );
+            }
+            else if ( Key == "name" )
+            {
+                Ok = Parser.String( Metric.Name );
+            }
+            else if ( Key == "unit" )
+            {
+                Ok = Parser.String( Metric.Unit );
+            }
+            else if ( Key == "higher_is_better" )
+            {
+                Ok = Parser.Boolean( Metric.HigherIsBetter );
+            }
+            else if ( Key == "samples" )
+            {
+                Ok = Parser.Take( '[' );
+
+                if ( Ok && !Parser.Take( ']' ) )
+                {
+                    do
+                    {
+                        double Sample = 0;
+
+                        Ok = Parser.Number( Sample );
+                        Metric.Samples.push_back( Sample );
+                    }
+                    while ( Ok && Parser.Take( ',' ) );
+
+                    Ok = Ok && Parser.Take( ']' );
+                }
+            }
+            else
+            {
+                Ok = Parser.Skip( );
+            }
+
+            if ( !Ok )
+            {
+                return false;
+            }
+        }
+        while ( Parser.Take( ',' ) );
+
+        return Parser.Take( '}' );
+    }
+}
+
+void mw::lib::BENCH_RESULTS::Record( const char* Suite, const std::string& Name, const char* Unit, bool HigherIsBetter, double Value )
+{
+    /* A run that measured nothing (a zero-length interval, a case that didn't run) has no sample to give. */
+    if ( !std::isfinite( Value ) )
+    {
+        return;
+    }
+
+    for ( auto& Metric : Metrics )
+    {
+        if ( Metric.Suite == Suite && Metric.Name == Name )
+        {
+            Metric.Samples.push_back( Value );
+            return;
+        }
+    }
+
+    Metrics.push_back( { Suite, Name, Unit, HigherIsBetter, { Value } } );
+}
+
+const mw::lib::BENCH_METRIC* mw::lib::BENCH_RESULTS::Find( const std::string& Suite, const std::string& Name ) const
+{
+    for ( const auto& Metric : Metrics )
+    {
+        if ( Metric.Suite == Suite && Metric.Name == Name )
+        {
+            return &Metric;
+        }
+    }
+
+    return nullptr;
+}
+
+bool mw::lib::SaveResults( const char* Path, const BENCH_RESULTS& Results )
+{
+    const auto File = std::fopen( Path, "w" );
+
+    if ( !File )
+    {
+        return false;
+    }
+
+    std::fprintf( File, "{\n  \"label\": " );
+    WriteString( File, Results.Label );
+    std::fprintf( File, ",\n  \"isa\": " );
+    WriteString( File, Results.Isa );
+    std::fprintf( File, ",\n  \"runs\": %u,\n  \"metrics\": [", Results.Runs );
+
+    for ( SIZE_T i = 0; i < Results.Metrics.size( ); i++ )
+    {
+        const auto& Metric = Results.Metrics[ i ];
+
+        std::fprintf( File, "%s\n    { \"suite\": ", i ? "," : "" );
+        WriteString( File, Metric.Suite );
+        std::fprintf( File, ", \"name\": " );
+        WriteString( File, Metric.Name );
+        std::fprintf( File, ", \"unit\": " );
+        WriteString( File, Metric.Unit );
+        std::fprintf( File, ", \"higher_is_better\": %s, \"samples\": [", Metric.HigherIsBetter ? "true" : "false" );
+
+        for ( SIZE_T j = 0; j < Metric.Samples.size( ); j++ )
+        {
+            std::fprintf( File, "%s %.17g", j ? "," : "", Metric.Samples[ j ] );
+        }
+
+        std::fprintf( File, " ] }" );
+    }
+
+    std::fprintf( File, "\n  ]\n}\n" );
+
+    const auto Ok = !std::ferror( File );
+
+    return ( std::fclose( File ) == 0 ) && Ok;
+}
+
+bool mw::lib::LoadResults( const char* Path, BENCH_RESULTS& Results )
+{
+    Results = { };
+
+    const auto File = std::fopen( Path, "rb" );
+
+    if ( !File )
+    {
+        return false;
+    }
+
+    std::string Text;
+    char Chunk[ 4096 ];
+
+    for ( SIZE_T Read; ( Read = std::fread( Chunk, 1, sizeof( Chunk ), File ) ) != 0; )
+    {
+        Text.append( Chunk, Read );
+    }
+
+    std::fclose( File );
+
+    PARSER Parser( Text );
+
+    if ( !Parser.Take( '{' ) )
+    {
+        return false;
+    }
+
+    if ( Parser.Take( '}' ) )
+    {
+        return Parser.End( );
+    }
+
+    do
+    {
+        std::string Key;
+
+        if ( !Parser.String( Key ) || !Parser.Take( ':' ) )
+        {
+            return false;
+        }
+
+        auto Ok = true;
+
+        if ( Key == "label" )
+        {
+            Ok = Parser.String( Results.Label );
+        }
+        else if ( Key == "isa" )
+        {
+            Ok = Parser.String( Results.Isa );
+        }
+        else if ( Key == "runs" )
+        {
+            double Runs = 0;
+
+            Ok = Parser.Number( Runs );
+            Results.Runs = static_cast< ULONG >( Runs );
+        }
+        else if ( Key == "metrics" )
+        {
+            Ok = Parser.Take( '[' );
+
+            if ( Ok && !Parser.Take( ']' ) )
+            {
+                do
+                {
+                    Results.Metrics.emplace_back( );
+                    Ok = ParseMetric( Parser, Results.Metrics.back( ) );
+                }
+                while ( Ok && Parser.Take( ',' ) );
+
+                Ok = Ok && Parser.Take( ']' );
+            }
+        }
+        else
+        {
+            Ok = Parser.Skip( );
+        }
+
+        if ( !Ok )
+        {
+            return false;
+        }
+    }
+    while ( Parser.Take( ',' ) );
+
+    return Parser.Take( '}' ) && Parser.End( );
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "platform.hpp"
+
+#include <string>
+#include <vector>
+
+/*
+ * Benchmark results as `mwbench` stores them and `mwcompare` reads them back: every metric keeps one sample per run,
+ * so two builds can be compared on their distributions rather than on a single number each.
+ *
+ *     {
+ *       "label": "...", "isa": "avx2", "runs": 5,
+ *       "metrics": [
+ *         { "suite": "micro", "name": "filter watches avx2", "unit": "Mevents/s", "higher_is_better": true,
+ *           "samples": [ 812.4, 809.9, ... ] },
+ *         ...
+ *       ]
+ *     }
+ */
+namespace mw::lib
+{
+    struct BENCH_METRIC
+    {
+        std::string Suite;
+        std::string Name;
+        std::string Unit;
+        bool HigherIsBetter;
+
+        std::vector< double > Samples;
+    };
+
+    struct BENCH_RESULTS
+    {
+        std::string Label;
+        std::string Isa;
+        ULONG Runs = 0;
+
+        std::vector< BENCH_METRIC > Metrics;
+
+        /*
+         * Adds a sample to the metric, creating it the first time it's seen.
+         */
+        void Record( const char* Suite, const std::string& Name, const char* Unit, bool HigherIsBetter, double Value );
+
+        const BENCH_METRIC* Find( const std::string& Suite, const std::string& Name ) const;
+    };
+
+    bool SaveResults( const char* Path, const BENCH_RESULTS& Results );
+
+    /*
+     * Only understands what `SaveResults` writes, plus whitespace and fields it doesn't know about.
+     */
+    bool LoadResults( const char* Path, BENCH_RESULTS& Results );
+}
@@ -0,0 +1,219 @@
+#include "client.hpp"
+
+#include <cstring>
+
+mw::lib::DEVICE::~DEVICE( )
+{
+    Close( );
+}
+
+#if defined( _WIN32 )
+
+bool mw::lib::DEVICE::Open( )
+{
+    Close( );
+
+    Handle = CreateFileW( L"\\\\.\\Mwait", GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr );
+
+    return Handle != INVALID_HANDLE_VALUE;
+}
+
+void mw::lib::DEVICE::Close( )
+{
+    if ( Handle != INVALID_HANDLE_VALUE )
+    {
+        CloseHandle( Handle );
+        Handle = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool mw::lib::DEVICE::Control( ULONG Code, const void* Input, ULONG InputLength, void* Output, ULONG OutputLength, ULONG* Returned )
+{
+    DWORD Bytes = 0;
+
+    const auto Ok = DeviceIoControl(
+        Handle,
+        Code,
+        const_cast< void* >( Input ),
+        InputLength,
+        Output,
+        OutputLength,
+        &Bytes,
+        nullptr
+    );
+
+    if ( Returned )
+    {
+        *Returned = Bytes;
+    }
+
+    return Ok != FALSE;
+}
+
+#else
+
+bool mw::lib::DEVICE::Open( )
+{
+    return false;
+}
+
+void mw::lib::DEVICE::Close( )
+{
+}
+
+bool mw::lib::DEVICE::Control( ULONG, const void*, ULONG, void*, ULONG, ULONG* )
+{
+    return false;
+}
+
+#endif
+
+bool mw::lib::DEVICE::ReadEvents( std::vector< EVENT >& Events, SIZE_T Capacity )
+{
+    Events.resize( Capacity );
+
+    ULONG Returned = 0;
+
+    if ( !Control( IOCTL_READ_EVENTS, nullptr, 0, Events.data( ), static_cast< ULONG >( Capacity * sizeof( EVENT ) ), &Returned ) )
+    {
+        Events.clear( );
+        return false;
+    }
+
+    Events.resize( Returned / sizeof( EVENT ) );
+
+    return true;
+}
+
+bool mw::lib::DEVICE::QueryStats( std::vector< unsigned char >& Buffer )
+{
+    /* Watchers and watches can come and go between the two calls, so retry until the size sticks. */
+    for ( ;; )
+    {
+        if ( Buffer.size( ) < FIELD_OFFSET( STATS, Watchers ) )
+        {
+            Buffer.resize( FIELD_OFFSET( STATS, Watchers ) );
+        }
+
+        ULONG Returned = 0;
+
+        if ( !Control( IOCTL_QUERY_STATS, nullptr, 0, Buffer.data( ), static_cast< ULONG >( Buffer.size( ) ), &Returned ) )
+        {
+            return false;
+        }
+
+        const auto Stats = reinterpret_cast< const STATS* >( Buffer.data( ) );
+        const auto Required = StatsSize( Stats->WatcherCount, Stats->WatchCount );
+
+        if ( Required <= Returned )
+        {
+            Buffer.resize( Returned );
+            return true;
+        }
+
+        Buffer.resize( Required );
+    }
+}
+
+bool mw::lib::DEVICE::Replay( ULONG Flags, const REPLAY_WRITE* Writes, ULONG Count, REPLAY_STATUS& Status )
+{
+    std::vector< unsigned char > Request( FIELD_OFFSET( REPLAY_REQUEST, Writes ) + Count * sizeof( REPLAY_WRITE ) );
+
+    const auto Header = reinterpret_cast< REPLAY_REQUEST* >( Request.data( ) );
+
+    Header->Flags = Flags;
+    Header->Count = Count;
+
+    if ( Count != 0 )
+    {
+        std::memcpy( Request.data( ) + FIELD_OFFSET( REPLAY_REQUEST, Writes ), Writes, Count * sizeof( REPLAY_WRITE ) );
+    }
+
+    Status = { };
+
+    ULONG Returned = 0;
+
+    const auto Ok = Control(
+        IOCTL_REPLAY,
+        Request.data( ),
+        static_cast< ULONG >( Request.size( ) ),
+        &Status,
+        sizeof( Status ),
+        &Returned
+    );
+
+    return Ok && Returned == sizeof( Status );
+}
+
+bool mw::lib::DEVICE::SetBackend( BACKEND Backend, ULONG Flags, ULONG BackoffCeilingNs )
+{
+    const BACKEND_REQUEST Request = { static_cast< ULONG >( Backend ), Flags, BackoffCeilingNs, 0 };
+
+    return Control( IOCTL_SET_BACKEND, &Request, sizeof( Request ), nullptr, 0, nullptr );
+}
+
+bool mw::lib::DEVICE::Probe( ULONG Flags, std::vector< unsigned char >& Report )
+{
+    /* Pairs can become active between the two calls, so retry until the size sticks. Only the first call carries flags. */
+    for ( ;; )
+    {
+        if ( Report.size( ) < FIELD_OFFSET( PROBE_REPORT, Pair ) )
+        {
+            Report.resize( FIELD_OFFSET( PROBE_REPORT, Pair ) );
+        }
+
+        const PROBE_REQUEST Request = { Flags, 0 };
+
+        ULONG Returned = 0;
+
+        if ( !Control( IOCTL_PROBE, &Request, sizeof( Request ), Report.data( ), static_cast< ULONG >( Report.size( ) ), &Returned ) )
+        {
+            return false;
+        }
+
+        Flags = 0;
+
+        const auto Header = reinterpret_cast< const PROBE_REPORT* >( Report.data( ) );
+        const auto Required = ProbeReportSize( Header->Pairs );
+
+        if ( Required <= Returned )
+        {
+            Report.resize( Returned );
+            return true;
+        }
+
+        Report.resize( Required );
+    }
+}
+
+bool mw::lib::DEVICE::SetLogLevel( ULONG Subsystem, LOG_LEVEL Level, LOG_LEVELS& Levels )
+{
+    const LOG_REQUEST Request = { Subsystem, static_cast< ULONG >( Level ) };
+
+    ULONG Returned = 0;
+
+    const auto Ok = Control( IOCTL_SET_LOG_LEVEL, &Request, sizeof( Request ), &Levels, sizeof( Levels ), &Returned );
+
+    return Ok && Returned == sizeof( Levels );
+}
+
+bool mw::lib::DEVICE::QueryLogLevels( LOG_LEVELS& Levels )
+{
+    ULONG Returned = 0;
+
+    const auto Ok = Control( IOCTL_SET_LOG_LEVEL, nullptr, 0, &Levels, sizeof( Levels ), &Returned );
+
+    return Ok && Returned == sizeof( Levels );
+}
+
+bool mw::lib::DEVICE::SetSession( const SESSION_REQUEST& Request )
+{
+    return Control( IOCTL_SET_SESSION, &Request, sizeof( Request ), nullptr, 0, nullptr );
+}
+
+bool mw::lib::DEVICE::SetWatchPriority( ULONG Watch, WATCH_PRIORITY Priority )
+{
+    const PRIORITY_REQUEST Request = { Watch, static_cast< ULONG >( Priority ) };
+
+    return Control( IOCTL_SET_PRIORITY, &Request, sizeof( Request ), nullptr, 0, nullptr );
+}
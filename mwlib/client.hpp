@@ -0,0 +1,74 @@
+#pragma once
+
+#include "platform.hpp"
+
+#include <vector>
+
+/*
+ * Connection to the driver's control device. Only available on Windows, elsewhere `Open` always fails.
+ */
+namespace mw::lib
+{
+    class DEVICE
+    {
+    public:
+        DEVICE( ) = default;
+        ~DEVICE( );
+
+        DEVICE( const DEVICE& ) = delete;
+        DEVICE& operator=( const DEVICE& ) = delete;
+
+        bool Open( );
+        void Close( );
+
+        /*
+         * Replaces the contents of `Events` with whatever the driver has buffered, up to `Capacity` events.
+         */
+        bool ReadEvents( std::vector< EVENT >& Events, SIZE_T Capacity );
+
+        /*
+         * `Buffer` is resized to whatever the driver needs and ends up holding a complete `STATS`.
+         */
+        bool QueryStats( std::vector< unsigned char >& Buffer );
+
+        /*
+         * Sends one `IOCTL_REPLAY`, `Status.Accepted` says how many of `Writes` were queued.
+         */
+        bool Replay( ULONG Flags, const REPLAY_WRITE* Writes, ULONG Count, REPLAY_STATUS& Status );
+
+        /*
+         * Fails if the processor doesn't support `Backend`, see `STATS::Backends`. `BackoffCeilingNs` only applies to
+         * `BackendBackoff`, 0 keeps the driver's default.
+         */
+        bool SetBackend( BACKEND Backend, ULONG Flags, ULONG BackoffCeilingNs = 0 );
+
+        /*
+         * Sends `IOCTL_PROBE` with `Flags` once, then `Report` is resized until it holds a complete `PROBE_REPORT`.
+         */
+        bool Probe( ULONG Flags, std::vector< unsigned char >& Report );
+
+        /*
+         * Sets the driver's log level for one `LOG_SUBSYSTEM`, or all of them with `LOG_ALL_SUBSYSTEMS`, and reads back
+         * the levels in effect. `QueryLogLevels` only reads them.
+         */
+        bool SetLogLevel( ULONG Subsystem, LOG_LEVEL Level, LOG_LEVELS& Levels );
+        bool QueryLogLevels( LOG_LEVELS& Levels );
+
+        /*
+         * Changes the weight and quotas of a session, see `STATS::Sessions` for which sessions exist.
+         */
+        bool SetSession( const SESSION_REQUEST& Request );
+
+        /*
+         * Moves watch `Watch`, a `WATCH_STATS::Id`, to another priority class.
+         */
+        bool SetWatchPriority( ULONG Watch, WATCH_PRIORITY Priority );
+
+        bool Control( ULONG Code, const void* Input, ULONG InputLength, void* Output, ULONG OutputLength, ULONG* Returned );
+
+    private:
+#if defined( _WIN32 )
+        HANDLE Handle = INVALID_HANDLE_VALUE;
+#endif
+    };
+}
@@ -0,0 +1,217 @@
+#include "compare.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+double mw::lib::Median( std::vector< double > Samples )
+{
+    if ( Samples.empty( ) )
+    {
+        return 0.0;
+    }
+
+    const auto Middle = Samples.size( ) / 2;
+
+    std::nth_element( Samples.begin( ), Samples.begin( ) + Middle, Samples.end( ) );
+
+    if ( Samples.size( ) % 2 )
+    {
+        return Samples[ Middle ];
+    }
+
+    const auto Upper = Samples[ Middle ];
+    const auto Lower = *std::max_element( Samples.begin( ), Samples.begin( ) + Middle );
+
+    return ( Lower + Upper ) / 2;
+}
+
+double mw::lib::MannWhitneyP( const std::vector< double >& A, const std::vector< double >& B )
+{
+    const auto N1 = static_cast< double >( A.size( ) );
+    const auto N2 = static_cast< double >( B.size( ) );
+
+    if ( A.empty( ) || B.empty( ) )
+    {
+        return 1.0;
+    }
+
+    struct SAMPLE
+    {
+        double Value;
+        bool First;
+    };
+
+    std::vector< SAMPLE > All;
+
+    for ( const auto Value : A )
+    {
+        All.push_back( { Value, true } );
+    }
+
+    for ( const auto Value : B )
+    {
+        All.push_back( { Value, false } );
+    }
+
+    std::sort( All.begin( ), All.end( ), []( const SAMPLE& L, const SAMPLE& R ) {
+        return L.Value < R.Value;
+    } );
+
+    /* Tied values share the average of the ranks they span. */
+    double RankSum = 0;
+    double TieTerm = 0;
+
+    for ( SIZE_T i = 0; i < All.size( ); )
+    {
+        auto j = i;
+
+        while ( j < All.size( ) && All[ j ].Value == All[ i ].Value )
+        {
+            j++;
+        }
+
+        const auto Rank = ( i + 1 + j ) / 2.0;
+        const auto Ties = static_cast< double >( j - i );
+
+        for ( auto k = i; k < j; k++ )
+        {
+            RankSum += All[ k ].First ? Rank : 0.0;
+        }
+
+        TieTerm += Ties * Ties * Ties - Ties;
+
+        i = j;
+    }
+
+    const auto N = N1 + N2;
+    const auto U = RankSum - N1 * ( N1 + 1 ) / 2;
+    const auto Mean = N1 * N2 / 2;
+    const auto Variance = N1 * N2 / 12 * ( ( N + 1 ) - TieTerm / ( N * ( N - 1 ) ) );
+
+    if ( Variance <= 0 )
+    {
+        return 1.0;
+    }
+
+    /* With continuity correction. */
+    const auto Z = std::max( std::fabs( U - Mean ) - 0.5, 0.0 ) / std::sqrt( Variance );
+
+    return std::erfc( Z / std::sqrt( 2.0 ) );
+}
+
+void mw::lib::BootstrapChange( const std::vector< double >& A, const std::vector< double >& B, ULONG Resamples, double Alpha, double& Low, double& High )
+{
+    Low = High = 0.0;
+
+    if ( A.empty( ) || B.empty( ) || Resamples == 0 )
+    {
+        return;
+    }
+
+    std::mt19937_64 Random( 42 );
+
+    std::vector< double > Changes;
+    std::vector< double > ResampledA( A.size( ) );
+    std::vector< double > ResampledB( B.size( ) );
+
+    Changes.reserve( Resamples );
+
+    for ( ULONG r = 0; r < Resamples; r++ )
+    {
+        for ( auto& Value : ResampledA )
+        {
+            Value = A[ Random( ) % A.size( ) ];
+        }
+
+        for ( auto& Value : ResampledB )
+        {
+            Value = B[ Random( ) % B.size( ) ];
+        }
+
+        const auto Base = Median( ResampledA );
+
+        if ( Base != 0 )
+        {
+            Changes.push_back( Median( ResampledB ) / Base - 1.0 );
+        }
+    }
+
+    if ( Changes.empty( ) )
+    {
+        return;
+    }
+
+    std::sort( Changes.begin( ), Changes.end( ) );
+
+    const auto At = [ &Changes ]( const double Quantile ) {
+        const auto Index = static_cast< SIZE_T >( Quantile * ( Changes.size( ) - 1 ) + 0.5 );
+        return Changes[ std::min( Index, Changes.size( ) - 1 ) ];
+    };
+
+    Low = At( Alpha / 2 );
+    High = At( 1 - Alpha / 2 );
+}
+
+void mw::lib::CompareResults( const BENCH_RESULTS& Baseline, const BENCH_RESULTS& Candidate, const COMPARE_OPTIONS& Options, std::vector< COMPARISON >& Comparisons )
+{
+    Comparisons.clear( );
+
+    const auto Compare = [ & ]( const BENCH_METRIC* Before, const BENCH_METRIC* After ) {
+        COMPARISON Entry = { };
+
+        Entry.Baseline = Before;
+        Entry.Candidate = After;
+        Entry.P = 1.0;
+        Entry.Verdict = VERDICT::Missing;
+
+        if ( !Before || !After || Before->Samples.empty( ) || After->Samples.empty( ) )
+        {
+            Comparisons.push_back( Entry );
+            return;
+        }
+
+        Entry.BaselineMedian = Median( Before->Samples );
+        Entry.CandidateMedian = Median( After->Samples );
+        Entry.Change = Entry.BaselineMedian != 0 ? Entry.CandidateMedian / Entry.BaselineMedian - 1.0 : 0.0;
+        Entry.P = MannWhitneyP( Before->Samples, After->Samples );
+
+        BootstrapChange( Before->Samples, After->Samples, Options.Resamples, Options.Alpha, Entry.Low, Entry.High );
+
+        const auto Significant = Entry.P < Options.Alpha &&
+                                 ( Entry.Low > 0 || Entry.High < 0 ) &&
+                                 std::fabs( Entry.Change ) >= Options.MinChange;
+
+        const auto Worse = Before->HigherIsBetter ? ( Entry.Change < 0 ) : ( Entry.Change > 0 );
+
+        Entry.Verdict = !Significant ? VERDICT::Unchanged : ( Worse ? VERDICT::Regressed : VERDICT::Improved );
+
+        Comparisons.push_back( Entry );
+    };
+
+    for ( const auto& Metric : Baseline.Metrics )
+    {
+        Compare( &Metric, Candidate.Find( Metric.Suite, Metric.Name ) );
+    }
+
+    for ( const auto& Metric : Candidate.Metrics )
+    {
+        if ( !Baseline.Find( Metric.Suite, Metric.Name ) )
+        {
+            Compare( nullptr, &Metric );
+        }
+    }
+}
+
+const char* mw::lib::VerdictName( VERDICT Verdict )
+{
+    switch ( Verdict )
+    {
+        case VERDICT::Unchanged: return "unchanged";
+        case VERDICT::Improved: return "improved";
+        case VERDICT::Regressed: return "REGRESSED";
+        case VERDICT::Missing: return "missing";
+    }
+
+    return "?";
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "bench.hpp"
+
+#include <vector>
+
+/*
+ * Decides whether a benchmark metric got worse between two builds. Both conditions have to hold for a change to count:
+ *
+ *   - the two sets of samples differ according to a two-sided Mann-Whitney U test, which makes no assumption about
+ *     how run times are distributed (they are usually skewed, with a long tail of disturbed runs);
+ *   - a bootstrap confidence interval of the relative change in medians excludes 0 and the change itself is at least
+ *     `MinChange`, so trivially small but consistent shifts don't fail the gate.
+ *
+ * With 5 runs per build the smallest p-value the U test can give is about 0.01; with 3 or fewer nothing is ever
+ * significant at the default level, use more runs for a tighter gate.
+ */
+namespace mw::lib
+{
+    enum class VERDICT
+    {
+        Unchanged,
+        Improved,
+        Regressed,
+
+        /* Only in one of the two result sets, or without samples. */
+        Missing
+    };
+
+    struct COMPARE_OPTIONS
+    {
+        double Alpha = 0.05;
+        double MinChange = 0.02;
+        ULONG Resamples = 2000;
+    };
+
+    struct COMPARISON
+    {
+        /* Either may be null for `Missing`. */
+        const BENCH_METRIC* Baseline;
+        const BENCH_METRIC* Candidate;
+
+        double BaselineMedian;
+        double CandidateMedian;
+
+        /* Candidate over baseline minus 1, with its confidence interval at level 1 - `Alpha`. */
+        double Change;
+        double Low;
+        double High;
+
+        double P;
+
+        VERDICT Verdict;
+    };
+
+    double Median( std::vector< double > Samples );
+
+    /*
+     * Two-sided p-value, from the normal approximation with ties corrected for. 1 if either side has no samples.
+     */
+    double MannWhitneyP( const std::vector< double >& A, const std::vector< double >& B );
+
+    /*
+     * Percentile interval of median(B) / median(A) - 1 over `Resamples` resamples of both sides. Deterministic, the
+     * generator is seeded the same way every time.
+     */
+    void BootstrapChange( const std::vector< double >& A, const std::vector< double >& B, ULONG Resamples, double Alpha, double& Low, double& High );
+
+    /*
+     * One entry per metric in either result set, baseline order first.
+     */
+    void CompareResults( const BENCH_RESULTS& Baseline, const BENCH_RESULTS& Candidate, const COMPARE_OPTIONS& Options, std::vector< COMPARISON >& Comparisons );
+
+    const char* VerdictName( VERDICT Verdict );
+}
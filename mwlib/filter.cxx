@@ -0,0 +1,218 @@
+#include "filter.hpp"
+
+#include <bit>
+#include <cstring>
+
+#if MW_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    using mw::lib::EVENT_FILTER;
+
+    static_assert( offsetof( mw::EVENT, Value ) == 8 && offsetof( mw::EVENT, Previous ) == 16 &&
+                   offsetof( mw::EVENT, Watch ) == 24 );
+
+    /*
+     * Every event is stored, only the output position decides whether it stays. In place this is safe since the
+     * output never gets ahead of the input.
+     */
+    SIZE_T FilterScalar( const mw::EVENT* Events, const SIZE_T Count, const EVENT_FILTER& Filter, mw::EVENT* Out )
+    {
+        SIZE_T Kept = 0;
+
+        for ( SIZE_T i = 0; i < Count; i++ )
+        {
+            const auto Event = Events[ i ];
+
+            Out[ Kept ] = Event;
+            Kept += Filter.Matches( Event );
+        }
+
+        return Kept;
+    }
+
+#if MW_X86
+    /*
+     * Each event is exactly one 256-bit register. Four of them at a time are transposed into value, previous and watch
+     * columns, two such groups make a batch of 8.
+     */
+    MW_TARGET_AVX2
+    SIZE_T FilterAvx2( const mw::EVENT* Events, const SIZE_T Count, const EVENT_FILTER& Filter, mw::EVENT* Out )
+    {
+        const auto Sign = _mm256_set1_epi64x( static_cast< long long >( 1ull << 63 ) );
+        const auto Base = _mm256_set1_epi64x( static_cast< long long >( Filter.MinValue ) );
+        const auto Limit = _mm256_xor_si256(
+            _mm256_set1_epi64x( static_cast< long long >( Filter.MaxValue - Filter.MinValue ) ),
+            Sign
+        );
+
+        const auto Watches = _mm256_set1_epi64x( static_cast< long long >( Filter.Watches ) );
+        const auto Changed = _mm256_set1_epi64x( static_cast< long long >( Filter.ChangedBits ) );
+        const auto One = _mm256_set1_epi64x( 1 );
+        const auto IdMask = _mm256_set1_epi64x( 0xffffffffll );
+        const auto Zero = _mm256_setzero_si256( );
+
+        const auto AnyChange = Filter.ChangedBits != 0;
+
+        SIZE_T Kept = 0;
+        SIZE_T i = 0;
+
+        for ( ; i + 8 <= Count; i += 8 )
+        {
+            for ( SIZE_T Group = i; Group < i + 8; Group += 4 )
+            {
+                const auto Row0 = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( &Events[ Group ] ) );
+                const auto Row1 = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( &Events[ Group + 1 ] ) );
+                const auto Row2 = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( &Events[ Group + 2 ] ) );
+                const auto Row3 = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( &Events[ Group + 3 ] ) );
+
+                const auto Low01 = _mm256_unpacklo_epi64( Row0, Row1 );
+                const auto High01 = _mm256_unpackhi_epi64( Row0, Row1 );
+                const auto Low23 = _mm256_unpacklo_epi64( Row2, Row3 );
+                const auto High23 = _mm256_unpackhi_epi64( Row2, Row3 );
+
+                const auto Value = _mm256_permute2x128_si256( High01, High23, 0x20 );
+                const auto Previous = _mm256_permute2x128_si256( Low01, Low23, 0x31 );
+                const auto Watch = _mm256_and_si256( _mm256_permute2x128_si256( High01, High23, 0x31 ), IdMask );
+
+                /* Shifting by 64 or more yields 0, so out of range ids drop out on their own. */
+                const auto Member = _mm256_cmpeq_epi64( _mm256_and_si256( _mm256_sllv_epi64( One, Watch ), Watches ), Zero );
+                const auto Outside = _mm256_cmpgt_epi64( _mm256_xor_si256( _mm256_sub_epi64( Value, Base ), Sign ), Limit );
+
+                auto Reject = _mm256_or_si256( Member, Outside );
+
+                if ( AnyChange )
+                {
+                    const auto Flipped = _mm256_and_si256( _mm256_xor_si256( Value, Previous ), Changed );
+
+                    Reject = _mm256_or_si256( Reject, _mm256_cmpeq_epi64( Flipped, Zero ) );
+                }
+
+                const auto Keep = static_cast< unsigned int >( ~_mm256_movemask_pd( _mm256_castsi256_pd( Reject ) ) & 0xf );
+
+                if ( Keep == 0 )
+                {
+                    continue;
+                }
+
+                _mm256_storeu_si256( reinterpret_cast< __m256i* >( &Out[ Kept ] ), Row0 );
+                Kept += Keep & 1;
+                _mm256_storeu_si256( reinterpret_cast< __m256i* >( &Out[ Kept ] ), Row1 );
+                Kept += ( Keep >> 1 ) & 1;
+                _mm256_storeu_si256( reinterpret_cast< __m256i* >( &Out[ Kept ] ), Row2 );
+                Kept += ( Keep >> 2 ) & 1;
+                _mm256_storeu_si256( reinterpret_cast< __m256i* >( &Out[ Kept ] ), Row3 );
+                Kept += Keep >> 3;
+            }
+        }
+
+        return Kept + FilterScalar( Events + i, Count - i, Filter, Out + Kept );
+    }
+
+    /*
+     * One field of the 8 events held by four 512-bit rows, `Index` picks it out of a pair of rows.
+     */
+    MW_TARGET_AVX512
+    inline __m512i Column( const __m512i Index, const __m512i Row0, const __m512i Row1, const __m512i Row2, const __m512i Row3 )
+    {
+        return _mm512_shuffle_i64x2(
+            _mm512_permutex2var_epi64( Row0, Index, Row1 ),
+            _mm512_permutex2var_epi64( Row2, Index, Row3 ),
+            0x44
+        );
+    }
+
+    /*
+     * Each 512-bit load holds two events. Four loads are transposed into 8-lane value, previous and watch columns, two
+     * such halves make a batch of 16.
+     */
+    MW_TARGET_AVX512
+    SIZE_T FilterAvx512( const mw::EVENT* Events, const SIZE_T Count, const EVENT_FILTER& Filter, mw::EVENT* Out )
+    {
+        /* Picks field `f` of the four events held by two rows: qwords f, f + 4, then f + 8, f + 12 of the second. */
+        const auto ValueIndex = _mm512_set_epi64( 13, 9, 5, 1, 13, 9, 5, 1 );
+        const auto PreviousIndex = _mm512_set_epi64( 14, 10, 6, 2, 14, 10, 6, 2 );
+        const auto WatchIndex = _mm512_set_epi64( 15, 11, 7, 3, 15, 11, 7, 3 );
+
+        const auto Base = _mm512_set1_epi64( static_cast< long long >( Filter.MinValue ) );
+        const auto Width = _mm512_set1_epi64( static_cast< long long >( Filter.MaxValue - Filter.MinValue ) );
+        const auto Watches = _mm512_set1_epi64( static_cast< long long >( Filter.Watches ) );
+        const auto Changed = _mm512_set1_epi64( static_cast< long long >( Filter.ChangedBits ) );
+        const auto One = _mm512_set1_epi64( 1 );
+        const auto IdMask = _mm512_set1_epi64( 0xffffffffll );
+
+        const auto AnyChange = Filter.ChangedBits != 0;
+
+        SIZE_T Kept = 0;
+        SIZE_T i = 0;
+
+        for ( ; i + 16 <= Count; i += 16 )
+        {
+            for ( SIZE_T Half = i; Half < i + 16; Half += 8 )
+            {
+                const auto Row0 = _mm512_loadu_si512( &Events[ Half ] );
+                const auto Row1 = _mm512_loadu_si512( &Events[ Half + 2 ] );
+                const auto Row2 = _mm512_loadu_si512( &Events[ Half + 4 ] );
+                const auto Row3 = _mm512_loadu_si512( &Events[ Half + 6 ] );
+
+                const auto Value = Column( ValueIndex, Row0, Row1, Row2, Row3 );
+                const auto Watch = _mm512_and_si512( Column( WatchIndex, Row0, Row1, Row2, Row3 ), IdMask );
+
+                auto Keep = _mm512_test_epi64_mask( _mm512_sllv_epi64( One, Watch ), Watches );
+
+                Keep = _mm512_mask_cmple_epu64_mask( Keep, _mm512_sub_epi64( Value, Base ), Width );
+
+                if ( AnyChange )
+                {
+                    const auto Previous = Column( PreviousIndex, Row0, Row1, Row2, Row3 );
+
+                    Keep = _mm512_mask_test_epi64_mask( Keep, _mm512_xor_si512( Value, Previous ), Changed );
+                }
+
+                if ( Keep == 0 )
+                {
+                    continue;
+                }
+
+                const __m512i Rows[ ] = { Row0, Row1, Row2, Row3 };
+
+                for ( int k = 0; k < 4; k++ )
+                {
+                    _mm256_storeu_si256( reinterpret_cast< __m256i* >( &Out[ Kept ] ), _mm512_castsi512_si256( Rows[ k ] ) );
+                    Kept += ( Keep >> ( 2 * k ) ) & 1;
+                    _mm256_storeu_si256( reinterpret_cast< __m256i* >( &Out[ Kept ] ), _mm512_extracti64x4_epi64( Rows[ k ], 1 ) );
+                    Kept += ( Keep >> ( 2 * k + 1 ) ) & 1;
+                }
+            }
+        }
+
+        return Kept + FilterScalar( Events + i, Count - i, Filter, Out + Kept );
+    }
+#endif
+}
+
+SIZE_T mw::lib::FilterEvents( const EVENT* Events, SIZE_T Count, const EVENT_FILTER& Filter, EVENT* Out )
+{
+    return FilterEvents( Events, Count, Filter, Out, BestIsa( ) );
+}
+
+SIZE_T mw::lib::FilterEvents( const EVENT* Events, SIZE_T Count, const EVENT_FILTER& Filter, EVENT* Out, ISA Isa )
+{
+#if MW_X86
+    if ( Isa == ISA::Avx512 && Simd.Avx512 )
+    {
+        return FilterAvx512( Events, Count, Filter, Out );
+    }
+
+    if ( Isa != ISA::Scalar && Simd.Avx2 )
+    {
+        return FilterAvx2( Events, Count, Filter, Out );
+    }
+#else
+    ( void )Isa;
+#endif
+
+    return FilterScalar( Events, Count, Filter, Out );
+}
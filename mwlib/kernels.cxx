@@ -0,0 +1,417 @@
+#include "kernels.hpp"
+
+#include <bit>
+
+#if MW_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    using mw::lib::kernels::AGGREGATE;
+
+    void RangeMask64Scalar( const ULONG64* Column, const SIZE_T Count, const ULONG64 Low, const ULONG64 High, ULONG64* Mask )
+    {
+        /* One unsigned compare per row: values below `Low` wrap around to huge offsets. */
+        const auto Width = High - Low;
+
+        for ( SIZE_T i = 0; i < Count; i += 64 )
+        {
+            const auto Rows = ( Count - i < 64 ) ? ( Count - i ) : 64;
+
+            ULONG64 Word = 0;
+
+            for ( SIZE_T j = 0; j < Rows; j++ )
+            {
+                Word |= static_cast< ULONG64 >( Column[ i + j ] - Low <= Width ) << j;
+            }
+
+            Mask[ i / 64 ] = Word;
+        }
+    }
+
+    void EqualMask32Scalar( const ULONG* Column, const SIZE_T Count, const ULONG Value, ULONG64* Mask )
+    {
+        for ( SIZE_T i = 0; i < Count; i += 64 )
+        {
+            const auto Rows = ( Count - i < 64 ) ? ( Count - i ) : 64;
+
+            ULONG64 Word = 0;
+
+            for ( SIZE_T j = 0; j < Rows; j++ )
+            {
+                Word |= static_cast< ULONG64 >( Column[ i + j ] == Value ) << j;
+            }
+
+            Mask[ i / 64 ] = Word;
+        }
+    }
+
+    void Aggregate64Scalar( const ULONG64* Column, const ULONG64* Mask, const SIZE_T Count, AGGREGATE& Result )
+    {
+        for ( SIZE_T w = 0; w < mw::lib::kernels::MaskWords( Count ); w++ )
+        {
+            for ( auto Word = Mask[ w ]; Word != 0; Word &= Word - 1 )
+            {
+                const auto Value = Column[ w * 64 + std::countr_zero( Word ) ];
+
+                Result.Count++;
+                Result.Sum += Value;
+                Result.Min = ( Value < Result.Min ) ? Value : Result.Min;
+                Result.Max = ( Value > Result.Max ) ? Value : Result.Max;
+            }
+        }
+    }
+
+#if MW_X86
+    /*
+     * AVX2 has no unsigned 64-bit compare, flipping the sign bit turns it into a signed one.
+     */
+    MW_TARGET_AVX2
+    void RangeMask64Avx2( const ULONG64* Column, const SIZE_T Count, const ULONG64 Low, const ULONG64 High, ULONG64* Mask )
+    {
+        const auto Sign = _mm256_set1_epi64x( static_cast< long long >( 1ull << 63 ) );
+        const auto Base = _mm256_set1_epi64x( static_cast< long long >( Low ) );
+        const auto Limit = _mm256_xor_si256( _mm256_set1_epi64x( static_cast< long long >( High - Low ) ), Sign );
+
+        const auto Full = Count & ~SIZE_T( 63 );
+
+        for ( SIZE_T i = 0; i < Full; i += 64 )
+        {
+            ULONG64 Word = 0;
+
+            for ( SIZE_T j = 0; j < 64; j += 4 )
+            {
+                const auto Values = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( &Column[ i + j ] ) );
+                const auto Offset = _mm256_xor_si256( _mm256_sub_epi64( Values, Base ), Sign );
+                const auto Outside = _mm256_cmpgt_epi64( Offset, Limit );
+
+                const auto Bits = static_cast< ULONG64 >( ~_mm256_movemask_pd( _mm256_castsi256_pd( Outside ) ) & 0xf );
+
+                Word |= Bits << j;
+            }
+
+            Mask[ i / 64 ] = Word;
+        }
+
+        if ( Full != Count )
+        {
+            RangeMask64Scalar( Column + Full, Count - Full, Low, High, Mask + Full / 64 );
+        }
+    }
+
+    MW_TARGET_AVX512
+    void RangeMask64Avx512( const ULONG64* Column, const SIZE_T Count, const ULONG64 Low, const ULONG64 High, ULONG64* Mask )
+    {
+        const auto Base = _mm512_set1_epi64( static_cast< long long >( Low ) );
+        const auto Width = _mm512_set1_epi64( static_cast< long long >( High - Low ) );
+
+        for ( SIZE_T i = 0; i < Count; i += 64 )
+        {
+            ULONG64 Word = 0;
+
+            for ( SIZE_T j = 0; j < 64 && i + j < Count; j += 8 )
+            {
+                const auto Remaining = Count - i - j;
+                const auto Load = static_cast< __mmask8 >( Remaining >= 8 ? 0xff : ( 1u << Remaining ) - 1 );
+
+                const auto Values = _mm512_maskz_loadu_epi64( Load, &Column[ i + j ] );
+                const auto Inside = _mm512_mask_cmple_epu64_mask( Load, _mm512_sub_epi64( Values, Base ), Width );
+
+                Word |= static_cast< ULONG64 >( Inside ) << j;
+            }
+
+            Mask[ i / 64 ] = Word;
+        }
+    }
+
+    MW_TARGET_AVX2
+    void EqualMask32Avx2( const ULONG* Column, const SIZE_T Count, const ULONG Value, ULONG64* Mask )
+    {
+        const auto Needle = _mm256_set1_epi32( static_cast< int >( Value ) );
+
+        const auto Full = Count & ~SIZE_T( 63 );
+
+        for ( SIZE_T i = 0; i < Full; i += 64 )
+        {
+            ULONG64 Word = 0;
+
+            for ( SIZE_T j = 0; j < 64; j += 8 )
+            {
+                const auto Values = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( &Column[ i + j ] ) );
+                const auto Equal = _mm256_cmpeq_epi32( Values, Needle );
+
+                Word |= static_cast< ULONG64 >( _mm256_movemask_ps( _mm256_castsi256_ps( Equal ) ) & 0xff ) << j;
+            }
+
+            Mask[ i / 64 ] = Word;
+        }
+
+        if ( Full != Count )
+        {
+            EqualMask32Scalar( Column + Full, Count - Full, Value, Mask + Full / 64 );
+        }
+    }
+
+    MW_TARGET_AVX512
+    void EqualMask32Avx512( const ULONG* Column, const SIZE_T Count, const ULONG Value, ULONG64* Mask )
+    {
+        const auto Needle = _mm512_set1_epi32( static_cast< int >( Value ) );
+
+        for ( SIZE_T i = 0; i < Count; i += 64 )
+        {
+            ULONG64 Word = 0;
+
+            for ( SIZE_T j = 0; j < 64 && i + j < Count; j += 16 )
+            {
+                const auto Remaining = Count - i - j;
+                const auto Load = static_cast< __mmask16 >( Remaining >= 16 ? 0xffff : ( 1u << Remaining ) - 1 );
+
+                const auto Values = _mm512_maskz_loadu_epi32( Load, &Column[ i + j ] );
+
+                Word |= static_cast< ULONG64 >( _mm512_mask_cmpeq_epi32_mask( Load, Values, Needle ) ) << j;
+            }
+
+            Mask[ i / 64 ] = Word;
+        }
+    }
+
+    /*
+     * Expands 4 mask bits into 4 all-ones or all-zeroes 64-bit lanes.
+     */
+    MW_TARGET_AVX2
+    __m256i Lanes4( const ULONG64 Bits )
+    {
+        const auto Select = _mm256_set_epi64x( 8, 4, 2, 1 );
+
+        return _mm256_cmpeq_epi64( _mm256_and_si256( _mm256_set1_epi64x( static_cast< long long >( Bits ) ), Select ), Select );
+    }
+
+    MW_TARGET_AVX2
+    void Aggregate64Avx2( const ULONG64* Column, const ULONG64* Mask, const SIZE_T Count, AGGREGATE& Result )
+    {
+        const auto Sign = _mm256_set1_epi64x( static_cast< long long >( 1ull << 63 ) );
+
+        /* Min and max are tracked sign-flipped so signed compares order them as unsigned. */
+        auto Sum = _mm256_setzero_si256( );
+        auto Min = _mm256_set1_epi64x( static_cast< long long >( ~0ull ^ ( 1ull << 63 ) ) );
+        auto Max = _mm256_set1_epi64x( static_cast< long long >( 1ull << 63 ) );
+
+        const auto Full = Count & ~SIZE_T( 63 );
+
+        for ( SIZE_T i = 0; i < Full; i += 64 )
+        {
+            const auto Word = Mask[ i / 64 ];
+
+            if ( Word == 0 )
+            {
+                continue;
+            }
+
+            Result.Count += std::popcount( Word );
+
+            for ( SIZE_T j = 0; j < 64; j += 4 )
+            {
+                const auto Bits = ( Word >> j ) & 0xf;
+
+                if ( Bits == 0 )
+                {
+                    continue;
+                }
+
+                const auto Selected = Lanes4( Bits );
+                const auto Values = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( &Column[ i + j ] ) );
+                const auto Flipped = _mm256_xor_si256( Values, Sign );
+
+                Sum = _mm256_add_epi64( Sum, _mm256_and_si256( Values, Selected ) );
+
+                const auto Lower = _mm256_and_si256( Selected, _mm256_cmpgt_epi64( Min, Flipped ) );
+                const auto Higher = _mm256_and_si256( Selected, _mm256_cmpgt_epi64( Flipped, Max ) );
+
+                Min = _mm256_blendv_epi8( Min, Flipped, Lower );
+                Max = _mm256_blendv_epi8( Max, Flipped, Higher );
+            }
+        }
+
+        alignas( 32 ) ULONG64 Sums[ 4 ], Mins[ 4 ], Maxs[ 4 ];
+
+        _mm256_store_si256( reinterpret_cast< __m256i* >( Sums ), Sum );
+        _mm256_store_si256( reinterpret_cast< __m256i* >( Mins ), _mm256_xor_si256( Min, Sign ) );
+        _mm256_store_si256( reinterpret_cast< __m256i* >( Maxs ), _mm256_xor_si256( Max, Sign ) );
+
+        for ( int k = 0; k < 4; k++ )
+        {
+            Result.Sum += Sums[ k ];
+            Result.Min = ( Mins[ k ] < Result.Min ) ? Mins[ k ] : Result.Min;
+            Result.Max = ( Maxs[ k ] > Result.Max ) ? Maxs[ k ] : Result.Max;
+        }
+
+        if ( Full != Count )
+        {
+            Aggregate64Scalar( Column + Full, Mask + Full / 64, Count - Full, Result );
+        }
+    }
+
+    MW_TARGET_AVX512
+    void Aggregate64Avx512( const ULONG64* Column, const ULONG64* Mask, const SIZE_T Count, AGGREGATE& Result )
+    {
+        auto Sum = _mm512_setzero_si512( );
+        auto Min = _mm512_set1_epi64( -1ll );
+        auto Max = _mm512_setzero_si512( );
+
+        for ( SIZE_T i = 0; i < Count; i += 8 )
+        {
+            const auto Selected = static_cast< __mmask8 >( Mask[ i / 64 ] >> ( i % 64 ) );
+
+            if ( Selected == 0 )
+            {
+                continue;
+            }
+
+            const auto Values = _mm512_maskz_loadu_epi64( Selected, &Column[ i ] );
+
+            Sum = _mm512_add_epi64( Sum, Values );
+            Min = _mm512_mask_min_epu64( Min, Selected, Min, Values );
+            Max = _mm512_mask_max_epu64( Max, Selected, Max, Values );
+
+            Result.Count += std::popcount( static_cast< unsigned int >( Selected ) );
+        }
+
+        Result.Sum += static_cast< ULONG64 >( _mm512_reduce_add_epi64( Sum ) );
+
+        const auto BlockMin = static_cast< ULONG64 >( _mm512_reduce_min_epu64( Min ) );
+        const auto BlockMax = static_cast< ULONG64 >( _mm512_reduce_max_epu64( Max ) );
+
+        Result.Min = ( BlockMin < Result.Min ) ? BlockMin : Result.Min;
+        Result.Max = ( BlockMax > Result.Max ) ? BlockMax : Result.Max;
+    }
+#endif
+}
+
+void mw::lib::kernels::RangeMask64( const ULONG64* Column, SIZE_T Count, ULONG64 Low, ULONG64 High, ULONG64* Mask )
+{
+    RangeMask64( Column, Count, Low, High, Mask, BestIsa( ) );
+}
+
+void mw::lib::kernels::RangeMask64( const ULONG64* Column, SIZE_T Count, ULONG64 Low, ULONG64 High, ULONG64* Mask, ISA Isa )
+{
+    if ( Low > High )
+    {
+        for ( SIZE_T w = 0; w < MaskWords( Count ); w++ )
+        {
+            Mask[ w ] = 0;
+        }
+
+        return;
+    }
+
+#if MW_X86
+    if ( Isa == ISA::Avx512 && Simd.Avx512 )
+    {
+        return RangeMask64Avx512( Column, Count, Low, High, Mask );
+    }
+
+    if ( Isa != ISA::Scalar && Simd.Avx2 )
+    {
+        return RangeMask64Avx2( Column, Count, Low, High, Mask );
+    }
+#else
+    ( void )Isa;
+#endif
+
+    RangeMask64Scalar( Column, Count, Low, High, Mask );
+}
+
+void mw::lib::kernels::EqualMask32( const ULONG* Column, SIZE_T Count, ULONG Value, ULONG64* Mask )
+{
+    EqualMask32( Column, Count, Value, Mask, BestIsa( ) );
+}
+
+void mw::lib::kernels::EqualMask32( const ULONG* Column, SIZE_T Count, ULONG Value, ULONG64* Mask, ISA Isa )
+{
+#if MW_X86
+    if ( Isa == ISA::Avx512 && Simd.Avx512 )
+    {
+        return EqualMask32Avx512( Column, Count, Value, Mask );
+    }
+
+    if ( Isa != ISA::Scalar && Simd.Avx2 )
+    {
+        return EqualMask32Avx2( Column, Count, Value, Mask );
+    }
+#else
+    ( void )Isa;
+#endif
+
+    EqualMask32Scalar( Column, Count, Value, Mask );
+}
+
+bool mw::lib::kernels::AndMask( ULONG64* Mask, const ULONG64* Other, SIZE_T Words )
+{
+    ULONG64 Any = 0;
+
+    for ( SIZE_T w = 0; w < Words; w++ )
+    {
+        Mask[ w ] &= Other[ w ];
+        Any |= Mask[ w ];
+    }
+
+    return Any != 0;
+}
+
+void mw::lib::kernels::FillMask( ULONG64* Mask, SIZE_T Count )
+{
+    for ( SIZE_T w = 0; w < Count / 64; w++ )
+    {
+        Mask[ w ] = ~0ull;
+    }
+
+    if ( Count % 64 != 0 )
+    {
+        Mask[ Count / 64 ] = ( 1ull << ( Count % 64 ) ) - 1;
+    }
+}
+
+SIZE_T mw::lib::kernels::CountMask( const ULONG64* Mask, SIZE_T Words )
+{
+    SIZE_T Count = 0;
+
+    for ( SIZE_T w = 0; w < Words; w++ )
+    {
+        Count += std::popcount( Mask[ w ] );
+    }
+
+    return Count;
+}
+
+void mw::lib::kernels::AGGREGATE::Merge( const AGGREGATE& Other )
+{
+    Count += Other.Count;
+    Sum += Other.Sum;
+    Min = ( Other.Min < Min ) ? Other.Min : Min;
+    Max = ( Other.Max > Max ) ? Other.Max : Max;
+}
+
+void mw::lib::kernels::Aggregate64( const ULONG64* Column, const ULONG64* Mask, SIZE_T Count, AGGREGATE& Result )
+{
+    Aggregate64( Column, Mask, Count, Result, BestIsa( ) );
+}
+
+void mw::lib::kernels::Aggregate64( const ULONG64* Column, const ULONG64* Mask, SIZE_T Count, AGGREGATE& Result, ISA Isa )
+{
+#if MW_X86
+    if ( Isa == ISA::Avx512 && Simd.Avx512 )
+    {
+        return Aggregate64Avx512( Column, Mask, Count, Result );
+    }
+
+    if ( Isa != ISA::Scalar && Simd.Avx2 )
+    {
+        return Aggregate64Avx2( Column, Mask, Count, Result );
+    }
+#else
+    ( void )Isa;
+#endif
+
+    Aggregate64Scalar( Column, Mask, Count, Result );
+}
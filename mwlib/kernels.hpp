@@ -0,0 +1,55 @@
+#pragma once
+
+#include "simd.hpp"
+
+/*
+ * Filter and aggregate kernels over single columns. Filters produce selection masks, one bit per row, bit `i % 64` of
+ * word `i / 64`; bits past `Count` in the last word are always clear. Each kernel picks AVX-512, AVX2 or scalar code
+ * at runtime, or the best the processor supports up to a given `ISA`.
+ */
+namespace mw::lib::kernels
+{
+    constexpr SIZE_T MaskWords( const SIZE_T Count )
+    {
+        return ( Count + 63 ) / 64;
+    }
+
+    /*
+     * Selects rows with `Low <= Column[ i ] <= High`.
+     */
+    void RangeMask64( const ULONG64* Column, SIZE_T Count, ULONG64 Low, ULONG64 High, ULONG64* Mask );
+    void RangeMask64( const ULONG64* Column, SIZE_T Count, ULONG64 Low, ULONG64 High, ULONG64* Mask, ISA Isa );
+
+    /*
+     * Selects rows with `Column[ i ] == Value`.
+     */
+    void EqualMask32( const ULONG* Column, SIZE_T Count, ULONG Value, ULONG64* Mask );
+    void EqualMask32( const ULONG* Column, SIZE_T Count, ULONG Value, ULONG64* Mask, ISA Isa );
+
+    /*
+     * `Mask &= Other`, returns whether any bit is left set.
+     */
+    bool AndMask( ULONG64* Mask, const ULONG64* Other, SIZE_T Words );
+
+    void FillMask( ULONG64* Mask, SIZE_T Count );
+
+    SIZE_T CountMask( const ULONG64* Mask, SIZE_T Words );
+
+    struct AGGREGATE
+    {
+        ULONG64 Count;
+        ULONG64 Sum;
+        ULONG64 Min;
+        ULONG64 Max;
+
+        void Merge( const AGGREGATE& Other );
+    };
+
+    constexpr AGGREGATE EMPTY_AGGREGATE = { 0, 0, ~0ull, 0 };
+
+    /*
+     * Count, wrapping sum, min and max of the selected rows, merged into `Result`.
+     */
+    void Aggregate64( const ULONG64* Column, const ULONG64* Mask, SIZE_T Count, AGGREGATE& Result );
+    void Aggregate64( const ULONG64* Column, const ULONG64* Mask, SIZE_T Count, AGGREGATE& Result, ISA Isa );
+}
@@ -0,0 +1,330 @@
+#include "lz.hpp"
+
+#include <bit>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    constexpr SIZE_T MIN_MATCH = 4;
+    constexpr SIZE_T MAX_OFFSET = 0xffff;
+
+    /* The last match has to start this far from the end and leave this many literals, which keeps the scan simple. */
+    constexpr SIZE_T MATCH_LIMIT = 12;
+    constexpr SIZE_T LAST_LITERALS = 5;
+
+    constexpr unsigned int HASH_BITS = 14;
+
+    /* Every 2^SKIP_SHIFT bytes without a match, the scan steps one byte further. */
+    constexpr unsigned int SKIP_SHIFT = 6;
+
+    using BYTE = unsigned char;
+
+    ULONG Read32( const BYTE* At )
+    {
+        ULONG Value;
+        std::memcpy( &Value, At, sizeof( Value ) );
+        return Value;
+    }
+
+    ULONG64 Read64( const BYTE* At )
+    {
+        ULONG64 Value;
+        std::memcpy( &Value, At, sizeof( Value ) );
+        return Value;
+    }
+
+    ULONG Hash( const ULONG Sequence )
+    {
+        return ( Sequence * 2654435761u ) >> ( 32 - HASH_BITS );
+    }
+
+    /*
+     * Bytes from `Left` equal to those from `Right`, stopping at `End` on the `Left` side.
+     */
+    SIZE_T CommonLength( const BYTE* Left, const BYTE* Right, const BYTE* End )
+    {
+        const auto Start = Left;
+
+        while ( Left + 8 <= End )
+        {
+            const auto Difference = Read64( Left ) ^ Read64( Right );
+
+            if ( Difference )
+            {
+                /* Bytes are compared in memory order, which is the low end of a little endian load. */
+                return Left - Start + ( std::countr_zero( Difference ) >> 3 );
+            }
+
+            Left += 8;
+            Right += 8;
+        }
+
+        while ( Left < End && *Left == *Right )
+        {
+            Left++;
+            Right++;
+        }
+
+        return Left - Start;
+    }
+
+    class OUTPUT
+    {
+    public:
+        OUTPUT( BYTE* Begin, const SIZE_T Capacity ) : Begin( Begin ), At( Begin ), End( Begin + Capacity )
+        {
+        }
+
+        bool Length( SIZE_T Value )
+        {
+            for ( ; Value >= 255; Value -= 255 )
+            {
+                if ( !Byte( 255 ) )
+                {
+                    return false;
+                }
+            }
+
+            return Byte( static_cast< BYTE >( Value ) );
+        }
+
+        bool Byte( const BYTE Value )
+        {
+            if ( At == End )
+            {
+                return false;
+            }
+
+            *At++ = Value;
+            return true;
+        }
+
+        bool Copy( const BYTE* From, const SIZE_T Size )
+        {
+            if ( static_cast< SIZE_T >( End - At ) < Size )
+            {
+                return false;
+            }
+
+            if ( Size )
+            {
+                std::memcpy( At, From, Size );
+                At += Size;
+            }
+
+            return true;
+        }
+
+        SIZE_T Size( ) const
+        {
+            return At - Begin;
+        }
+
+    private:
+        BYTE* Begin;
+        BYTE* At;
+        BYTE* End;
+    };
+
+    /*
+     * One sequence; `Match` of 0 only for the literals closing the block.
+     */
+    bool Emit( OUTPUT& Out, const BYTE* Literals, const SIZE_T LiteralCount, const SIZE_T Offset, const SIZE_T Match )
+    {
+        const auto MatchCode = Match ? Match - MIN_MATCH : 0;
+
+        const auto Token = static_cast< BYTE >( ( ( LiteralCount < 15 ) ? LiteralCount : 15 ) << 4 | ( ( MatchCode < 15 ) ? MatchCode : 15 ) );
+
+        if ( !Out.Byte( Token ) )
+        {
+            return false;
+        }
+
+        if ( LiteralCount >= 15 && !Out.Length( LiteralCount - 15 ) )
+        {
+            return false;
+        }
+
+        if ( !Out.Copy( Literals, LiteralCount ) )
+        {
+            return false;
+        }
+
+        if ( !Match )
+        {
+            return true;
+        }
+
+        if ( !Out.Byte( static_cast< BYTE >( Offset ) ) || !Out.Byte( static_cast< BYTE >( Offset >> 8 ) ) )
+        {
+            return false;
+        }
+
+        return MatchCode < 15 || Out.Length( MatchCode - 15 );
+    }
+}
+
+SIZE_T mw::lib::lz::Compress( const void* Input, SIZE_T Size, void* Output, SIZE_T Capacity )
+{
+    const auto In = static_cast< const BYTE* >( Input );
+
+    OUTPUT Out( static_cast< BYTE* >( Output ), Capacity );
+
+    SIZE_T Anchor = 0;
+
+    if ( Size > MATCH_LIMIT )
+    {
+        /* Positions of the last 4-byte sequence seen for each hash, 0 doubles as "none" and is checked like any other. */
+        const auto Table = std::make_unique< ULONG[ ] >( SIZE_T( 1 ) << HASH_BITS );
+
+        const auto Limit = Size - MATCH_LIMIT;
+        const auto MatchEnd = In + Size - LAST_LITERALS;
+
+        SIZE_T At = 1;
+
+        while ( At < Limit )
+        {
+            const auto Sequence = Read32( In + At );
+            const auto Slot = Hash( Sequence );
+            auto Candidate = static_cast< SIZE_T >( Table[ Slot ] );
+
+            Table[ Slot ] = static_cast< ULONG >( At );
+
+            if ( Candidate >= At || At - Candidate > MAX_OFFSET || Read32( In + Candidate ) != Sequence )
+            {
+                At += 1 + ( ( At - Anchor ) >> SKIP_SHIFT );
+                continue;
+            }
+
+            /* Matches often start a little earlier than where the hash found them. */
+            while ( At > Anchor && Candidate > 0 && In[ At - 1 ] == In[ Candidate - 1 ] )
+            {
+                At--;
+                Candidate--;
+            }
+
+            const auto Match = MIN_MATCH + CommonLength( In + At + MIN_MATCH, In + Candidate + MIN_MATCH, MatchEnd );
+
+            if ( !Emit( Out, In + Anchor, At - Anchor, At - Candidate, Match ) )
+            {
+                return 0;
+            }
+
+            At += Match;
+            Anchor = At;
+
+            if ( At < Limit )
+            {
+                Table[ Hash( Read32( In + At - 2 ) ) ] = static_cast< ULONG >( At - 2 );
+            }
+        }
+    }
+
+    if ( !Emit( Out, In + Anchor, Size - Anchor, 0, 0 ) )
+    {
+        return 0;
+    }
+
+    return Out.Size( );
+}
+
+bool mw::lib::lz::Decompress( const void* Input, SIZE_T Size, void* Output, SIZE_T RawSize )
+{
+    auto In = static_cast< const BYTE* >( Input );
+    const auto InEnd = In + Size;
+
+    const auto Begin = static_cast< BYTE* >( Output );
+    auto Out = Begin;
+    const auto OutEnd = Begin + RawSize;
+
+    const auto ReadLength = [ & ]( SIZE_T& Length ) {
+        for ( ;; )
+        {
+            if ( In == InEnd )
+            {
+                return false;
+            }
+
+            const auto Extra = *In++;
+
+            Length += Extra;
+
+            if ( Extra != 255 )
+            {
+                return true;
+            }
+        }
+    };
+
+    while ( In < InEnd )
+    {
+        const auto Token = *In++;
+
+        SIZE_T Literals = Token >> 4;
+
+        if ( Literals == 15 && !ReadLength( Literals ) )
+        {
+            return false;
+        }
+
+        if ( static_cast< SIZE_T >( InEnd - In ) < Literals || static_cast< SIZE_T >( OutEnd - Out ) < Literals )
+        {
+            return false;
+        }
+
+        if ( Literals )
+        {
+            std::memcpy( Out, In, Literals );
+            In += Literals;
+            Out += Literals;
+        }
+
+        if ( In == InEnd )
+        {
+            break;
+        }
+
+        if ( InEnd - In < 2 )
+        {
+            return false;
+        }
+
+        const auto Offset = static_cast< SIZE_T >( In[ 0 ] ) | static_cast< SIZE_T >( In[ 1 ] ) << 8;
+
+        In += 2;
+
+        SIZE_T Match = Token & 15;
+
+        if ( Match == 15 && !ReadLength( Match ) )
+        {
+            return false;
+        }
+
+        Match += MIN_MATCH;
+
+        if ( Offset == 0 || Offset > static_cast< SIZE_T >( Out - Begin ) || static_cast< SIZE_T >( OutEnd - Out ) < Match )
+        {
+            return false;
+        }
+
+        const auto From = Out - Offset;
+
+        if ( Offset >= Match )
+        {
+            std::memcpy( Out, From, Match );
+        }
+        else
+        {
+            /* Overlapping, the match repeats its last `Offset` bytes. */
+            for ( SIZE_T i = 0; i < Match; i++ )
+            {
+                Out[ i ] = From[ i ];
+            }
+        }
+
+        Out += Match;
+    }
+
+    return Out == OutEnd;
+}
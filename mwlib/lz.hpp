@@ -0,0 +1,29 @@
+#pragma once
+
+#include "platform.hpp"
+
+/*
+ * Byte-oriented LZ77 block codec in the spirit of LZ4, so archives need no external library on any platform.
+ *
+ * A block is a run of sequences: a token with the literal length in its high nibble and the match length - 4 in its
+ * low nibble, longer lengths continued in extra bytes of 255, the literals, then a 16-bit little endian offset back
+ * into the output. The last sequence has literals only. Blocks are self-contained, any of them decodes on its own.
+ */
+namespace mw::lib::lz
+{
+    constexpr SIZE_T CompressBound( const SIZE_T Size )
+    {
+        return Size + Size / 255 + 16;
+    }
+
+    /*
+     * Returns the compressed size, or 0 if it doesn't fit in `Capacity`. `CompressBound( Size )` always fits.
+     */
+    SIZE_T Compress( const void* Input, SIZE_T Size, void* Output, SIZE_T Capacity );
+
+    /*
+     * Succeeds only if `Input` is a well-formed block that decodes to exactly `RawSize` bytes. Never reads or writes
+     * out of bounds, whatever `Input` holds.
+     */
+    bool Decompress( const void* Input, SIZE_T Size, void* Output, SIZE_T RawSize );
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+/*
+ * Lets the consumer library use the driver's shared definitions outside of the Windows headers as well,
+ * so everything that doesn't talk to the device builds and runs on Linux too.
+ */
+
+#if defined( _WIN32 )
+
+#include <windows.h>
+#include <winioctl.h>
+
+#else
+
+#include <cstddef>
+#include <cstdint>
+
+using ULONG = std::uint32_t;
+using LONG = std::int32_t;
+using USHORT = std::uint16_t;
+using ULONG64 = std::uint64_t;
+using LONG64 = std::int64_t;
+using SIZE_T = std::size_t;
+
+#define FILE_DEVICE_UNKNOWN 0x00000022
+#define METHOD_BUFFERED 0
+#define FILE_ANY_ACCESS 0
+#define CTL_CODE( DeviceType, Function, Method, Access ) \
+    ( ( ( DeviceType ) << 16 ) | ( ( Access ) << 14 ) | ( ( Function ) << 2 ) | ( Method ) )
+
+#define FIELD_OFFSET( type, field ) offsetof( type, field )
+
+#endif
+
+#if defined( _M_X64 ) || defined( __x86_64__ )
+#define MW_X86 1
+#else
+#define MW_X86 0
+#endif
+
+#include "../mwait/shared.hpp"
@@ -0,0 +1,79 @@
+#include "probe.hpp"
+
+namespace
+{
+    /* Fills in everything but the mean, minimum and maximum. */
+    void Percentiles( const ULONG64 ( &Histogram )[ mw::PROBE_BUCKETS ], const double Micro, mw::lib::LATENCY_SUMMARY& Summary )
+    {
+        ULONG64 Seen = 0;
+
+        for ( ULONG Bucket = 0; Bucket < mw::PROBE_BUCKETS; Bucket++ )
+        {
+            const auto Count = Histogram[ Bucket ];
+
+            if ( Count == 0 )
+            {
+                continue;
+            }
+
+            const auto Before = Seen;
+
+            Seen += Count;
+
+            /* Bucket 0 also holds latencies of 0. */
+            const auto Floor = Bucket ? static_cast< double >( 1ull << Bucket ) * Micro : 0.0;
+
+            if ( Before * 100 < Summary.Samples * 50 && Seen * 100 >= Summary.Samples * 50 )
+            {
+                Summary.P50Microseconds = Floor;
+            }
+
+            if ( Before * 100 < Summary.Samples * 99 && Seen * 100 >= Summary.Samples * 99 )
+            {
+                Summary.P99Microseconds = Floor;
+            }
+
+            Summary.MaxMicroseconds = static_cast< double >( 2ull << Bucket ) * Micro;
+        }
+    }
+}
+
+mw::lib::PROBE_SUMMARY mw::lib::SummarizeProbes( const PROBE_PAIR_STATS& Pair, ULONG64 TscPerMicrosecond )
+{
+    PROBE_SUMMARY Result = { };
+
+    Result.Writer = Pair.Writer;
+    Result.Watcher = Pair.Watcher;
+    Result.OneWay.Samples = Pair.Samples;
+    Result.HalfRtt.Samples = Pair.RoundTrips;
+
+    if ( TscPerMicrosecond == 0 )
+    {
+        return Result;
+    }
+
+    const auto Micro = 1.0 / TscPerMicrosecond;
+
+    Result.SkewMicroseconds = Pair.Skew * Micro;
+
+    if ( Pair.Samples != 0 )
+    {
+        Percentiles( Pair.OneWay, Micro, Result.OneWay );
+
+        Result.OneWay.MinMicroseconds = Pair.Min * Micro;
+        Result.OneWay.MeanMicroseconds = static_cast< double >( Pair.Sum ) / Pair.Samples * Micro;
+        Result.OneWay.MaxMicroseconds = Pair.Max * Micro;
+        Result.Uncorrected = static_cast< double >( Pair.Uncorrected ) / Pair.Samples;
+        Result.Negative = static_cast< double >( Pair.Negative ) / Pair.Samples;
+    }
+
+    if ( Pair.RoundTrips != 0 )
+    {
+        Percentiles( Pair.HalfRtt, Micro, Result.HalfRtt );
+
+        Result.HalfRtt.MinMicroseconds = Pair.RttMin / 2 * Micro;
+        Result.HalfRtt.MeanMicroseconds = static_cast< double >( Pair.HalfRttSum ) / Pair.RoundTrips * Micro;
+    }
+
+    return Result;
+}
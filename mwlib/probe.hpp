@@ -0,0 +1,41 @@
+#pragma once
+
+#include "platform.hpp"
+
+/*
+ * Reads the per writer/watcher pair figures of `IOCTL_PROBE` back in microseconds, one-way latency next to half the
+ * round trip so the two measurements can be compared directly.
+ */
+namespace mw::lib
+{
+    struct LATENCY_SUMMARY
+    {
+        ULONG64 Samples;
+
+        /* Percentiles are the lower bound of their power-of-two bucket, mean and extremes are exact. */
+        double MinMicroseconds;
+        double MeanMicroseconds;
+        double P50Microseconds;
+        double P99Microseconds;
+        double MaxMicroseconds;
+    };
+
+    struct PROBE_SUMMARY
+    {
+        ULONG Writer;
+        ULONG Watcher;
+
+        double SkewMicroseconds;
+
+        LATENCY_SUMMARY OneWay;
+
+        /* No maximum is kept for round trips, `MaxMicroseconds` is the upper bound of the highest bucket. */
+        LATENCY_SUMMARY HalfRtt;
+
+        /* Shares of one-way samples taken before the first round trip, and of ones the skew pushed below 0. */
+        double Uncorrected;
+        double Negative;
+    };
+
+    PROBE_SUMMARY SummarizeProbes( const PROBE_PAIR_STATS& Pair, ULONG64 TscPerMicrosecond );
+}
@@ -0,0 +1,139 @@
+#include "replay.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+void mw::lib::ScheduleReplay(
+    const std::vector< EVENT >& Events,
+    ULONG64 SourceTscPerMicrosecond,
+    ULONG64 TargetTscPerMicrosecond,
+    double Speed,
+    ULONG Slots,
+    REPLAY_SCHEDULE& Schedule
+)
+{
+    Schedule.Writes.clear( );
+    Schedule.SlotWatches.clear( );
+    Schedule.Watches = 0;
+    Schedule.Span = 0;
+
+    if ( Events.empty( ) || Slots == 0 )
+    {
+        return;
+    }
+
+    /* A trace that doesn't know its TSC rate is taken to come from this host. */
+    if ( SourceTscPerMicrosecond == 0 )
+    {
+        SourceTscPerMicrosecond = TargetTscPerMicrosecond;
+    }
+
+    const auto Scale = ( SourceTscPerMicrosecond && TargetTscPerMicrosecond && Speed > 0 )
+        ? static_cast< double >( TargetTscPerMicrosecond ) / SourceTscPerMicrosecond / Speed
+        : 1.0;
+
+    std::vector< SIZE_T > Order( Events.size( ) );
+
+    for ( SIZE_T i = 0; i < Order.size( ); i++ )
+    {
+        Order[ i ] = i;
+    }
+
+    /* Stable, so writes detected at the same TSC keep the order they were drained in. */
+    std::stable_sort( Order.begin( ), Order.end( ), [ &Events ]( const SIZE_T A, const SIZE_T B ) {
+        return Events[ A ].Tsc < Events[ B ].Tsc;
+    } );
+
+    std::unordered_map< ULONG, ULONG > SlotOf;
+
+    const auto First = Events[ Order.front( ) ].Tsc;
+
+    Schedule.Writes.resize( Order.size( ) );
+
+    for ( SIZE_T i = 0; i < Order.size( ); i++ )
+    {
+        const auto& Event = Events[ Order[ i ] ];
+
+        auto Slot = SlotOf.find( Event.Watch );
+
+        if ( Slot == SlotOf.end( ) )
+        {
+            Slot = SlotOf.emplace( Event.Watch, Schedule.Watches % Slots ).first;
+
+            if ( Schedule.Watches < Slots )
+            {
+                Schedule.SlotWatches.push_back( Event.Watch );
+            }
+
+            Schedule.Watches++;
+        }
+
+        auto& Write = Schedule.Writes[ i ];
+
+        Write.Offset = static_cast< ULONG64 >( ( Event.Tsc - First ) * Scale );
+        Write.Value = Event.Value;
+        Write.Slot = Slot->second;
+        Write.Flags = 0;
+    }
+
+    Schedule.Span = Schedule.Writes.back( ).Offset;
+}
+
+mw::lib::REPLAY_FIDELITY mw::lib::Fidelity( const REPLAY_STATUS& Status, ULONG64 TscPerMicrosecond )
+{
+    REPLAY_FIDELITY Result = { };
+
+    Result.Played = Status.Played;
+
+    if ( Status.Played == 0 || TscPerMicrosecond == 0 )
+    {
+        return Result;
+    }
+
+    const auto Micro = [ TscPerMicrosecond ]( const double Cycles ) {
+        return Cycles / TscPerMicrosecond;
+    };
+
+    Result.IntendedSeconds = Micro( static_cast< double >( Status.LastDue ) ) / 1e6;
+    Result.ActualSeconds = Micro( static_cast< double >( Status.LastPlayed ) ) / 1e6;
+    Result.MeanMicroseconds = Micro( static_cast< double >( Status.LatenessSum ) / Status.Played );
+    Result.MaxMicroseconds = Micro( static_cast< double >( Status.LatenessMax ) );
+
+    ULONG64 Seen = 0;
+
+    for ( ULONG Bucket = 0; Bucket < REPLAY_LATENESS_BUCKETS; Bucket++ )
+    {
+        const auto Count = Status.Lateness[ Bucket ];
+
+        if ( Count == 0 )
+        {
+            continue;
+        }
+
+        const auto Before = Seen;
+
+        Seen += Count;
+
+        /* Bucket 0 also holds writes that were right on time. */
+        const auto Floor = Micro( Bucket ? static_cast< double >( 1ull << Bucket ) : 0.0 );
+        const auto Ceiling = Micro( static_cast< double >( 2ull << Bucket ) );
+
+        if ( Before * 100 < Status.Played * 50 && Seen * 100 >= Status.Played * 50 )
+        {
+            Result.P50Microseconds = Floor;
+        }
+
+        if ( Before * 100 < Status.Played * 99 && Seen * 100 >= Status.Played * 99 )
+        {
+            Result.P99Microseconds = Floor;
+        }
+
+        const auto Share = static_cast< double >( Count ) / Status.Played;
+
+        Result.Within1us += ( Ceiling <= 1.0 ) ? Share : 0.0;
+        Result.Within10us += ( Ceiling <= 10.0 ) ? Share : 0.0;
+        Result.Within100us += ( Ceiling <= 100.0 ) ? Share : 0.0;
+    }
+
+    return Result;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "platform.hpp"
+
+#include <vector>
+
+/*
+ * Turns a recorded trace into writes for the driver's load generator to replay with the original timing, and reads
+ * back how closely it kept to it.
+ *
+ * Detections stand in for the writes that caused them: each event becomes a write of its value, at its offset from
+ * the first event. Offsets are rescaled from the capture host's TSC to the replay host's and divided by the speed-up.
+ * Watches are mapped onto the driver's test slots in order of first appearance, wrapping around if there are more.
+ */
+namespace mw::lib
+{
+    struct REPLAY_SCHEDULE
+    {
+        std::vector< REPLAY_WRITE > Writes;
+
+        /* Distinct watches in the trace, and the watch each slot was given first. */
+        ULONG Watches;
+        std::vector< ULONG > SlotWatches;
+
+        /* From the first write to the last, on the replay timeline. */
+        ULONG64 Span;
+    };
+
+    /*
+     * `Events` don't have to be in order, drains from different watchers never are. `Speed` above 1 compresses gaps.
+     */
+    void ScheduleReplay(
+        const std::vector< EVENT >& Events,
+        ULONG64 SourceTscPerMicrosecond,
+        ULONG64 TargetTscPerMicrosecond,
+        double Speed,
+        ULONG Slots,
+        REPLAY_SCHEDULE& Schedule
+    );
+
+    struct REPLAY_FIDELITY
+    {
+        ULONG64 Played;
+
+        /* How long the last write played should have taken to get to, and how long it actually took. */
+        double IntendedSeconds;
+        double ActualSeconds;
+
+        /* Lateness of individual writes, percentiles are the lower bound of their power-of-two bucket. */
+        double MeanMicroseconds;
+        double P50Microseconds;
+        double P99Microseconds;
+        double MaxMicroseconds;
+
+        /* Share of writes known to have landed within 1us, 10us and 100us of when they were due, by whole buckets. */
+        double Within1us;
+        double Within10us;
+        double Within100us;
+    };
+
+    REPLAY_FIDELITY Fidelity( const REPLAY_STATUS& Status, ULONG64 TscPerMicrosecond );
+}
@@ -0,0 +1,286 @@
+#include "series.hpp"
+
+#include <bit>
+#include <utility>
+
+namespace
+{
+    /*
+     * Delta-of-delta classes: a prefix of up to four 1 bits ended by a 0, then the zigzagged difference in that many
+     * bits. TSC deltas are in cycles, so the classes are much wider than Gorilla's second-based ones.
+     */
+    constexpr unsigned int DOD_PREFIX[ ] = { 1, 2, 3, 4, 4 };
+    constexpr unsigned int DOD_BITS[ ] = { 0, 8, 16, 32, 64 };
+
+    /* Leading zero count and meaningful bit count - 1 of a new XOR window. */
+    constexpr unsigned int WINDOW_FIELD = 6;
+
+    ULONG64 ZigZag( const ULONG64 Value )
+    {
+        return ( Value << 1 ) ^ static_cast< ULONG64 >( static_cast< LONG64 >( Value ) >> 63 );
+    }
+
+    ULONG64 UnZigZag( const ULONG64 Value )
+    {
+        return ( Value >> 1 ) ^ ( 0 - ( Value & 1 ) );
+    }
+
+    unsigned int DodClass( const ULONG64 ZigZagged )
+    {
+        if ( ZigZagged == 0 )
+        {
+            return 0;
+        }
+
+        if ( ZigZagged < ( 1ull << 8 ) )
+        {
+            return 1;
+        }
+
+        if ( ZigZagged < ( 1ull << 16 ) )
+        {
+            return 2;
+        }
+
+        return ( ZigZagged < ( 1ull << 32 ) ) ? 3 : 4;
+    }
+}
+
+mw::lib::SERIES_ENCODER::SERIES_ENCODER( std::vector< ULONG64 >&& Storage )
+{
+    Writer.Words = std::move( Storage );
+    Writer.Words.clear( );
+}
+
+void mw::lib::SERIES_ENCODER::Append( ULONG64 Tsc, ULONG64 Value )
+{
+    if ( Events++ == 0 )
+    {
+        Writer.Write( Tsc, 64 );
+        Writer.Write( Value, 64 );
+
+        LastTsc = Tsc;
+        LastValue = Value;
+
+        return;
+    }
+
+    /* Wrapping arithmetic, so out of order timestamps from different processors still round-trip. */
+    const auto Delta = Tsc - LastTsc;
+    const auto Dod = ZigZag( Delta - LastDelta );
+    const auto Class = DodClass( Dod );
+
+    /* The prefix is `Class` ones followed by a zero, except for the widest class which has no room for one. */
+    const auto Prefix = ( Class == 4 ) ? 0xfull : ( ( ( 1ull << Class ) - 1 ) << 1 );
+
+    Writer.Write( Prefix, DOD_PREFIX[ Class ] );
+
+    if ( Class != 0 )
+    {
+        Writer.Write( Dod, DOD_BITS[ Class ] );
+    }
+
+    LastTsc = Tsc;
+    LastDelta = Delta;
+
+    const auto Xor = Value ^ LastValue;
+
+    LastValue = Value;
+
+    if ( Xor == 0 )
+    {
+        Writer.Write( 0, 1 );
+        return;
+    }
+
+    const auto NewLead = static_cast< unsigned int >( std::countl_zero( Xor ) );
+    const auto NewTrail = static_cast< unsigned int >( std::countr_zero( Xor ) );
+
+    if ( Lead != 64 && NewLead >= Lead && NewTrail >= Trail )
+    {
+        Writer.Write( 0b10, 2 );
+        Writer.Write( Xor >> Trail, 64 - Lead - Trail );
+        return;
+    }
+
+    const auto Meaningful = 64 - NewLead - NewTrail;
+
+    Writer.Write( ( 0b11ull << ( 2 * WINDOW_FIELD ) ) | ( NewLead << WINDOW_FIELD ) | ( Meaningful - 1 ), 2 + 2 * WINDOW_FIELD );
+    Writer.Write( Xor >> NewTrail, Meaningful );
+
+    Lead = NewLead;
+    Trail = NewTrail;
+}
+
+const std::vector< ULONG64 >& mw::lib::SERIES_ENCODER::Finish( )
+{
+    Writer.Flush( );
+
+    return Writer.Words;
+}
+
+std::vector< ULONG64 > mw::lib::SERIES_ENCODER::Release( )
+{
+    Writer.Flush( );
+
+    auto Words = std::move( Writer.Words );
+
+    Reset( );
+
+    return Words;
+}
+
+void mw::lib::SERIES_ENCODER::Reset( )
+{
+    *this = { };
+}
+
+mw::lib::SERIES_DECODER::SERIES_DECODER( const ULONG64* Words, SIZE_T WordCount, SIZE_T Count )
+    : Reader( Words, WordCount ), Remaining( Count )
+{
+}
+
+bool mw::lib::SERIES_DECODER::Next( ULONG64& Tsc, ULONG64& Value )
+{
+    if ( Remaining == 0 )
+    {
+        return false;
+    }
+
+    if ( !Started )
+    {
+        LastTsc = Reader.Read( 64 );
+        LastValue = Reader.Read( 64 );
+        Started = true;
+    }
+    else
+    {
+        /* Most events fit in one peek, `Bits` holds `Available` of the upcoming bits at the top. */
+        auto Bits = Reader.Peek( );
+        auto Available = 64u;
+
+        const auto Ones = static_cast< unsigned int >( std::countl_one( Bits ) );
+        const auto Class = ( Ones < 4 ) ? Ones : 4;
+
+        ULONG64 Dod = 0;
+
+        if ( Class == 4 )
+        {
+            Reader.Skip( DOD_PREFIX[ Class ] );
+            Dod = Reader.Read( 64 );
+            Bits = Reader.Peek( );
+        }
+        else
+        {
+            const auto Used = DOD_PREFIX[ Class ] + DOD_BITS[ Class ];
+
+            if ( Class != 0 )
+            {
+                Dod = ( Bits << DOD_PREFIX[ Class ] ) >> ( 64 - DOD_BITS[ Class ] );
+            }
+
+            Reader.Skip( Used );
+            Bits <<= Used;
+            Available -= Used;
+        }
+
+        LastDelta += UnZigZag( Dod );
+        LastTsc += LastDelta;
+
+        /* At least 28 bits are left either way, enough for any value header. */
+        if ( ( Bits >> 63 ) == 0 )
+        {
+            Reader.Skip( 1 );
+        }
+        else if ( ( Bits >> 62 ) == 0b10 )
+        {
+            /* Reusing a window before there is one only happens in a corrupt stream. */
+            if ( Lead == 64 )
+            {
+                Remaining = 0;
+                return false;
+            }
+
+            const auto Width = 64 - Lead - Trail;
+
+            Reader.Skip( 2 );
+
+            if ( 2 + Width <= Available )
+            {
+                LastValue ^= ( ( Bits << 2 ) >> ( 64 - Width ) ) << Trail;
+                Reader.Skip( Width );
+            }
+            else
+            {
+                LastValue ^= Reader.Read( Width ) << Trail;
+            }
+        }
+        else
+        {
+            constexpr auto Header = 2 + 2 * WINDOW_FIELD;
+
+            const auto NewLead = static_cast< unsigned int >( Bits >> ( 64 - 2 - WINDOW_FIELD ) ) & 63;
+            const auto Meaningful = ( static_cast< unsigned int >( Bits >> ( 64 - Header ) ) & 63 ) + 1;
+
+            if ( NewLead + Meaningful > 64 )
+            {
+                Remaining = 0;
+                return false;
+            }
+
+            Lead = NewLead;
+            Trail = 64 - NewLead - Meaningful;
+
+            Reader.Skip( Header );
+
+            if ( Header + Meaningful <= Available )
+            {
+                LastValue ^= ( ( Bits << Header ) >> ( 64 - Meaningful ) ) << Trail;
+                Reader.Skip( Meaningful );
+            }
+            else
+            {
+                LastValue ^= Reader.Read( Meaningful ) << Trail;
+            }
+        }
+    }
+
+    if ( !Reader.Valid( ) )
+    {
+        Remaining = 0;
+        return false;
+    }
+
+    Remaining--;
+
+    Tsc = LastTsc;
+    Value = LastValue;
+
+    return true;
+}
+
+void mw::lib::EncodeSeries( const ULONG64* Tsc, const ULONG64* Values, SIZE_T Count, std::vector< ULONG64 >& Words )
+{
+    SERIES_ENCODER Encoder( std::move( Words ) );
+
+    for ( SIZE_T i = 0; i < Count; i++ )
+    {
+        Encoder.Append( Tsc[ i ], Values[ i ] );
+    }
+
+    Words = Encoder.Release( );
+}
+
+SIZE_T mw::lib::DecodeSeries( const ULONG64* Words, SIZE_T WordCount, SIZE_T Count, ULONG64* Tsc, ULONG64* Values )
+{
+    SERIES_DECODER Decoder( Words, WordCount, Count );
+
+    SIZE_T i = 0;
+
+    while ( i < Count && Decoder.Next( Tsc[ i ], Values[ i ] ) )
+    {
+        i++;
+    }
+
+    return i;
+}
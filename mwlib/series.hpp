@@ -0,0 +1,212 @@
+#pragma once
+
+#include "platform.hpp"
+
+#include <vector>
+
+/*
+ * Compression of one watch's (TSC, value) stream, after Facebook's Gorilla.
+ *
+ * Timestamps are stored as the zigzagged difference between consecutive deltas, which is 0 or tiny for writes that
+ * come at a steady pace. Values are XORed with the previous one: an unchanged value costs a single bit, and only the
+ * bits between the first and the last one that flipped are stored, reusing the previous window when they fit in it.
+ *
+ * Bits are packed most significant first into 64-bit words. The number of events isn't part of the stream, whoever
+ * stores it keeps that next to the words.
+ */
+namespace mw::lib
+{
+    class BIT_WRITER
+    {
+    public:
+        /*
+         * Appends the low `Bits` bits of `Value`, `Bits` from 1 to 64. Bits above those must be clear.
+         */
+        void Write( const ULONG64 Value, const unsigned int Bits )
+        {
+            if ( Bits < Free )
+            {
+                Pending |= Value << ( Free - Bits );
+                Free -= Bits;
+                return;
+            }
+
+            const auto Spill = Bits - Free;
+
+            Words.push_back( Pending | ( Value >> Spill ) );
+
+            Pending = Spill ? ( Value << ( 64 - Spill ) ) : 0;
+            Free = 64 - Spill;
+        }
+
+        /*
+         * Appends the partly filled last word. Nothing may be written after this until `Reset`.
+         */
+        void Flush( )
+        {
+            if ( Free != 64 )
+            {
+                Words.push_back( Pending );
+                Pending = 0;
+                Free = 64;
+            }
+        }
+
+        SIZE_T Bits( ) const
+        {
+            return Words.size( ) * 64 + ( 64 - Free );
+        }
+
+        void Reset( )
+        {
+            Words.clear( );
+            Pending = 0;
+            Free = 64;
+        }
+
+        std::vector< ULONG64 > Words;
+
+    private:
+        ULONG64 Pending = 0;
+        unsigned int Free = 64;
+    };
+
+    class BIT_READER
+    {
+    public:
+        BIT_READER( const ULONG64* Words, const SIZE_T Count ) : Words( Words ), Count( Count )
+        {
+        }
+
+        /*
+         * The next 64 bits without consuming them, zero past the end of the stream.
+         */
+        ULONG64 Peek( ) const
+        {
+            const auto Word = Position / 64;
+            const auto Offset = Position % 64;
+
+            const auto High = ( Word < Count ) ? Words[ Word ] : 0;
+            const auto Low = ( Offset && Word + 1 < Count ) ? Words[ Word + 1 ] : 0;
+
+            return Offset ? ( ( High << Offset ) | ( Low >> ( 64 - Offset ) ) ) : High;
+        }
+
+        void Skip( const unsigned int Bits )
+        {
+            Position += Bits;
+        }
+
+        /*
+         * `Bits` from 1 to 64.
+         */
+        ULONG64 Read( const unsigned int Bits )
+        {
+            const auto Value = Peek( ) >> ( 64 - Bits );
+
+            Position += Bits;
+
+            return Value;
+        }
+
+        /*
+         * Whether everything read so far was actually in the stream.
+         */
+        bool Valid( ) const
+        {
+            return Position <= Count * 64;
+        }
+
+    private:
+        const ULONG64* Words;
+        SIZE_T Count;
+        SIZE_T Position = 0;
+    };
+
+    class SERIES_ENCODER
+    {
+    public:
+        SERIES_ENCODER( ) = default;
+
+        /*
+         * Encodes into `Storage`, whose contents are dropped but whose capacity is kept.
+         */
+        explicit SERIES_ENCODER( std::vector< ULONG64 >&& Storage );
+
+        void Append( ULONG64 Tsc, ULONG64 Value );
+
+        /*
+         * Completes the stream; `Words( )` is final afterwards and nothing more may be appended until `Reset`.
+         */
+        const std::vector< ULONG64 >& Finish( );
+
+        /*
+         * Completes the stream and hands its words over, leaving the encoder empty.
+         */
+        std::vector< ULONG64 > Release( );
+
+        const std::vector< ULONG64 >& Words( ) const
+        {
+            return Writer.Words;
+        }
+
+        SIZE_T Count( ) const
+        {
+            return Events;
+        }
+
+        SIZE_T Bits( ) const
+        {
+            return Writer.Bits( );
+        }
+
+        void Reset( );
+
+    private:
+        BIT_WRITER Writer;
+
+        SIZE_T Events = 0;
+
+        ULONG64 LastTsc = 0;
+        ULONG64 LastDelta = 0;
+        ULONG64 LastValue = 0;
+
+        /* Window of meaningful bits of the last stored XOR, `Lead` of 64 until there is one. */
+        unsigned int Lead = 64;
+        unsigned int Trail = 0;
+    };
+
+    class SERIES_DECODER
+    {
+    public:
+        /*
+         * `Count` is the number of events that were appended to the encoder.
+         */
+        SERIES_DECODER( const ULONG64* Words, SIZE_T WordCount, SIZE_T Count );
+
+        /*
+         * False once all `Count` events were returned, or if the stream turns out to be truncated.
+         */
+        bool Next( ULONG64& Tsc, ULONG64& Value );
+
+    private:
+        BIT_READER Reader;
+
+        SIZE_T Remaining;
+        bool Started = false;
+
+        ULONG64 LastTsc = 0;
+        ULONG64 LastDelta = 0;
+        ULONG64 LastValue = 0;
+
+        unsigned int Lead = 64;
+        unsigned int Trail = 0;
+    };
+
+    /*
+     * Whole-stream versions of the above. `Encode` replaces the contents of `Words`, reusing its storage, `Decode` returns how many events it
+     * could decode, which is less than `Count` only for a truncated stream.
+     */
+    void EncodeSeries( const ULONG64* Tsc, const ULONG64* Values, SIZE_T Count, std::vector< ULONG64 >& Words );
+    SIZE_T DecodeSeries( const ULONG64* Words, SIZE_T WordCount, SIZE_T Count, ULONG64* Tsc, ULONG64* Values );
+}
@@ -0,0 +1,95 @@
+#include "simd.hpp"
+
+#if MW_X86
+#if defined( _MSC_VER ) && !defined( __clang__ )
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace
+{
+#if MW_X86
+    void Cpuid( const int Leaf, const int SubLeaf, int ( &Registers )[ 4 ] )
+    {
+#if defined( _MSC_VER ) && !defined( __clang__ )
+        __cpuidex( Registers, Leaf, SubLeaf );
+#else
+        unsigned int a, b, c, d;
+
+        __cpuid_count( Leaf, SubLeaf, a, b, c, d );
+
+        Registers[ 0 ] = static_cast< int >( a );
+        Registers[ 1 ] = static_cast< int >( b );
+        Registers[ 2 ] = static_cast< int >( c );
+        Registers[ 3 ] = static_cast< int >( d );
+#endif
+    }
+
+    unsigned long long Xgetbv( )
+    {
+#if defined( _MSC_VER ) && !defined( __clang__ )
+        return _xgetbv( 0 );
+#else
+        unsigned int Low, High;
+
+        __asm__ volatile( "xgetbv" : "=a"( Low ), "=d"( High ) : "c"( 0 ) );
+
+        return ( static_cast< unsigned long long >( High ) << 32 ) | Low;
+#endif
+    }
+#endif
+}
+
+mw::lib::SIMD_FEATURES mw::lib::DetectSimd( )
+{
+    SIMD_FEATURES Features = { };
+
+#if MW_X86
+    int Registers[ 4 ];
+
+    Cpuid( 0, 0, Registers );
+
+    if ( Registers[ 0 ] < 7 )
+    {
+        return Features;
+    }
+
+    Cpuid( 1, 0, Registers );
+
+    /* OSXSAVE and AVX. */
+    if ( ( Registers[ 2 ] & ( 1 << 27 ) ) == 0 || ( Registers[ 2 ] & ( 1 << 28 ) ) == 0 )
+    {
+        return Features;
+    }
+
+    const auto Xcr0 = Xgetbv( );
+
+    /* XMM and YMM state, then opmask and both halves of ZMM state. */
+    const auto YmmEnabled = ( Xcr0 & 0x06 ) == 0x06;
+    const auto ZmmEnabled = ( Xcr0 & 0xe6 ) == 0xe6;
+
+    Cpuid( 7, 0, Registers );
+
+    const auto Ebx = static_cast< unsigned int >( Registers[ 1 ] );
+
+    Features.Avx2 = YmmEnabled && ( Ebx & ( 1u << 5 ) ) != 0;
+
+    /* F, BW and VL. */
+    Features.Avx512 = Features.Avx2 && ZmmEnabled && ( Ebx & ( 1u << 16 ) ) != 0 && ( Ebx & ( 1u << 30 ) ) != 0 &&
+                      ( Ebx & ( 1u << 31 ) ) != 0;
+#endif
+
+    return Features;
+}
+
+ULONG64 mw::lib::ReadTsc( )
+{
+#if MW_X86
+    return __rdtsc( );
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "platform.hpp"
+
+/*
+ * Vector kernels are compiled for their instruction set function by function and picked at runtime,
+ * so the library itself still runs on any x64 processor (and builds on ARM64, scalar only).
+ */
+#if MW_X86 && ( defined( __GNUC__ ) || defined( __clang__ ) )
+#define MW_TARGET_AVX2 __attribute__( ( target( "avx2,popcnt,bmi" ) ) )
+#define MW_TARGET_AVX512 __attribute__( ( target( "avx512f,avx512bw,avx512vl,popcnt,bmi" ) ) )
+#else
+#define MW_TARGET_AVX2
+#define MW_TARGET_AVX512
+#endif
+
+namespace mw::lib
+{
+    struct SIMD_FEATURES
+    {
+        bool Avx2;
+
+        /* AVX-512 F, BW and VL. */
+        bool Avx512;
+    };
+
+    /*
+     * Checks both the processor and that the OS saves the wider register state.
+     */
+    SIMD_FEATURES DetectSimd( );
+
+    inline const SIMD_FEATURES Simd = DetectSimd( );
+
+    /*
+     * The same time stamp counter the driver stamps events with, 0 on processors without one.
+     */
+    ULONG64 ReadTsc( );
+
+    /*
+     * Lets benchmarks pin a kernel to one instruction set; everything else uses `BestIsa`.
+     */
+    enum class ISA
+    {
+        Scalar,
+        Avx2,
+        Avx512
+    };
+
+    inline bool Supports( const ISA Isa )
+    {
+        return Isa == ISA::Scalar || ( Isa == ISA::Avx2 && Simd.Avx2 ) || ( Isa == ISA::Avx512 && Simd.Avx512 );
+    }
+
+    inline ISA BestIsa( )
+    {
+        return Simd.Avx512 ? ISA::Avx512 : Simd.Avx2 ? ISA::Avx2 : ISA::Scalar;
+    }
+
+    inline const char* IsaName( const ISA Isa )
+    {
+        return Isa == ISA::Avx512 ? "avx512" : Isa == ISA::Avx2 ? "avx2" : "scalar";
+    }
+}
@@ -0,0 +1,190 @@
+#include "store.hpp"
+
+#include <bit>
+
+void mw::lib::BLOCK::Clear( )
+{
+    Count = 0;
+    MinTsc = ~0ull;
+    MaxTsc = 0;
+    MinValue = ~0ull;
+    MaxValue = 0;
+    Watches = 0;
+}
+
+mw::lib::EVENT_STORE::EVENT_STORE( SIZE_T Capacity )
+{
+    const auto Count = ( Capacity + BLOCK_EVENTS - 1 ) / BLOCK_EVENTS;
+
+    Blocks.resize( Count ? Count : 1 );
+
+    for ( auto& Block : Blocks )
+    {
+        Block = std::make_unique< BLOCK >( );
+        Block->Clear( );
+    }
+}
+
+void mw::lib::EVENT_STORE::Append( const EVENT* Events, SIZE_T Count )
+{
+    for ( SIZE_T i = 0; i < Count; )
+    {
+        if ( Used == 0 || Blocks[ ( First + Used - 1 ) % Blocks.size( ) ]->Count == BLOCK_EVENTS )
+        {
+            if ( Used == Blocks.size( ) )
+            {
+                /* Full, the oldest block becomes the newest. */
+                First = ( First + 1 ) % Blocks.size( );
+                Used--;
+            }
+
+            Blocks[ ( First + Used ) % Blocks.size( ) ]->Clear( );
+            Used++;
+        }
+
+        auto& Block = *Blocks[ ( First + Used - 1 ) % Blocks.size( ) ];
+
+        const auto Run = ( Count - i < BLOCK_EVENTS - Block.Count ) ? ( Count - i ) : ( BLOCK_EVENTS - Block.Count );
+
+        /* Rows to columns, with the zone map kept up to date along the way. */
+        for ( SIZE_T j = 0; j < Run; j++ )
+        {
+            const auto& Event = Events[ i + j ];
+            const auto Row = Block.Count + j;
+
+            Block.Tsc[ Row ] = Event.Tsc;
+            Block.Value[ Row ] = Event.Value;
+            Block.Previous[ Row ] = Event.Previous;
+            Block.Watch[ Row ] = Event.Watch;
+            Block.Processor[ Row ] = Event.Processor;
+            Block.Flags[ Row ] = Event.Flags;
+
+            Block.MinTsc = ( Event.Tsc < Block.MinTsc ) ? Event.Tsc : Block.MinTsc;
+            Block.MaxTsc = ( Event.Tsc > Block.MaxTsc ) ? Event.Tsc : Block.MaxTsc;
+            Block.MinValue = ( Event.Value < Block.MinValue ) ? Event.Value : Block.MinValue;
+            Block.MaxValue = ( Event.Value > Block.MaxValue ) ? Event.Value : Block.MaxValue;
+            Block.Watches |= 1ull << ( Event.Watch % 64 );
+        }
+
+        Block.Count += Run;
+        i += Run;
+    }
+}
+
+SIZE_T mw::lib::EVENT_STORE::Size( ) const
+{
+    return Used ? ( Used - 1 ) * BLOCK_EVENTS + At( Used - 1 ).Count : 0;
+}
+
+const mw::lib::BLOCK& mw::lib::EVENT_STORE::At( SIZE_T Age ) const
+{
+    return *Blocks[ ( First + Age ) % Blocks.size( ) ];
+}
+
+bool mw::lib::EVENT_STORE::Match( const BLOCK& Block, const QUERY& Query, ULONG64* Mask, ISA Isa ) const
+{
+    const auto Skip = Block.Count == 0 || Block.MaxTsc < Query.From || Block.MinTsc > Query.To ||
+                      Block.MaxValue < Query.MinValue || Block.MinValue > Query.MaxValue ||
+                      ( Query.Watch != ANY_WATCH && ( Block.Watches & ( 1ull << ( Query.Watch % 64 ) ) ) == 0 );
+
+    Scanned++;
+
+    if ( Skip )
+    {
+        Skipped++;
+        return false;
+    }
+
+    const auto Words = kernels::MaskWords( Block.Count );
+
+    const auto AllTsc = Block.MinTsc >= Query.From && Block.MaxTsc <= Query.To;
+    const auto AllValues = Block.MinValue >= Query.MinValue && Block.MaxValue <= Query.MaxValue;
+
+    if ( AllTsc )
+    {
+        kernels::FillMask( Mask, Block.Count );
+    }
+    else
+    {
+        kernels::RangeMask64( Block.Tsc, Block.Count, Query.From, Query.To, Mask, Isa );
+    }
+
+    ULONG64 Other[ kernels::MaskWords( BLOCK_EVENTS ) ];
+
+    if ( !AllValues )
+    {
+        kernels::RangeMask64( Block.Value, Block.Count, Query.MinValue, Query.MaxValue, Other, Isa );
+
+        if ( !kernels::AndMask( Mask, Other, Words ) )
+        {
+            return false;
+        }
+    }
+
+    if ( Query.Watch != ANY_WATCH )
+    {
+        kernels::EqualMask32( Block.Watch, Block.Count, Query.Watch, Other, Isa );
+
+        if ( !kernels::AndMask( Mask, Other, Words ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+SIZE_T mw::lib::EVENT_STORE::Select( const QUERY& Query, std::vector< ULONG64 >& Tsc, std::vector< ULONG64 >& Values ) const
+{
+    ULONG64 Mask[ kernels::MaskWords( BLOCK_EVENTS ) ];
+
+    const auto Before = Values.size( );
+    const auto Isa = BestIsa( );
+
+    for ( SIZE_T Age = 0; Age < Used; Age++ )
+    {
+        const auto& Block = At( Age );
+
+        if ( !Match( Block, Query, Mask, Isa ) )
+        {
+            continue;
+        }
+
+        for ( SIZE_T w = 0; w < kernels::MaskWords( Block.Count ); w++ )
+        {
+            for ( auto Word = Mask[ w ]; Word != 0; Word &= Word - 1 )
+            {
+                const auto Row = w * 64 + std::countr_zero( Word );
+
+                Tsc.push_back( Block.Tsc[ Row ] );
+                Values.push_back( Block.Value[ Row ] );
+            }
+        }
+    }
+
+    return Values.size( ) - Before;
+}
+
+mw::lib::kernels::AGGREGATE mw::lib::EVENT_STORE::Aggregate( const QUERY& Query ) const
+{
+    return Aggregate( Query, BestIsa( ) );
+}
+
+mw::lib::kernels::AGGREGATE mw::lib::EVENT_STORE::Aggregate( const QUERY& Query, ISA Isa ) const
+{
+    ULONG64 Mask[ kernels::MaskWords( BLOCK_EVENTS ) ];
+
+    auto Result = kernels::EMPTY_AGGREGATE;
+
+    for ( SIZE_T Age = 0; Age < Used; Age++ )
+    {
+        const auto& Block = At( Age );
+
+        if ( Match( Block, Query, Mask, Isa ) )
+        {
+            kernels::Aggregate64( Block.Value, Mask, Block.Count, Result, Isa );
+        }
+    }
+
+    return Result;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "kernels.hpp"
+
+#include <memory>
+#include <vector>
+
+/*
+ * Recent events kept column by column, so a query only touches the fields it filters or aggregates on.
+ *
+ * Events are appended into fixed-size blocks; once `Capacity` is reached the oldest block is recycled. Every block keeps
+ * the min/max of its TSC and value columns and a bitmap of the watches in it, which lets queries skip whole blocks
+ * without looking at a single row.
+ */
+namespace mw::lib
+{
+    constexpr SIZE_T BLOCK_EVENTS = 4096;
+
+    constexpr ULONG ANY_WATCH = ~0u;
+
+    /*
+     * All bounds are inclusive. The default query matches everything.
+     */
+    struct QUERY
+    {
+        ULONG Watch = ANY_WATCH;
+
+        ULONG64 From = 0;
+        ULONG64 To = ~0ull;
+
+        ULONG64 MinValue = 0;
+        ULONG64 MaxValue = ~0ull;
+    };
+
+    struct BLOCK
+    {
+        alignas( 64 ) ULONG64 Tsc[ BLOCK_EVENTS ];
+        alignas( 64 ) ULONG64 Value[ BLOCK_EVENTS ];
+        alignas( 64 ) ULONG64 Previous[ BLOCK_EVENTS ];
+        alignas( 64 ) ULONG Watch[ BLOCK_EVENTS ];
+        alignas( 64 ) USHORT Processor[ BLOCK_EVENTS ];
+        alignas( 64 ) USHORT Flags[ BLOCK_EVENTS ];
+
+        SIZE_T Count;
+
+        ULONG64 MinTsc;
+        ULONG64 MaxTsc;
+        ULONG64 MinValue;
+        ULONG64 MaxValue;
+
+        /* Bit `Watch % 64` for every watch with an event in the block. */
+        ULONG64 Watches;
+
+        void Clear( );
+    };
+
+    class EVENT_STORE
+    {
+    public:
+        /*
+         * `Capacity` is in events and rounded up to whole blocks.
+         */
+        explicit EVENT_STORE( SIZE_T Capacity );
+
+        void Append( const EVENT* Events, SIZE_T Count );
+
+        SIZE_T Size( ) const;
+
+        /*
+         * Appends the TSC and value of every matching event to `Tsc` and `Values`, oldest block first.
+         * Returns how many were added.
+         */
+        SIZE_T Select( const QUERY& Query, std::vector< ULONG64 >& Tsc, std::vector< ULONG64 >& Values ) const;
+
+        /*
+         * Count, sum, min and max of the values of the matching events.
+         */
+        kernels::AGGREGATE Aggregate( const QUERY& Query ) const;
+        kernels::AGGREGATE Aggregate( const QUERY& Query, ISA Isa ) const;
+
+        /*
+         * Blocks looked at and blocks skipped thanks to their min/max, over the lifetime of the store.
+         */
+        SIZE_T BlocksScanned( ) const
+        {
+            return Scanned;
+        }
+
+        SIZE_T BlocksSkipped( ) const
+        {
+            return Skipped;
+        }
+
+    private:
+        const BLOCK& At( SIZE_T Age ) const;
+
+        /*
+         * Fills `Mask` with the rows of `Block` matching `Query`, returns false when none do.
+         */
+        bool Match( const BLOCK& Block, const QUERY& Query, ULONG64* Mask, ISA Isa ) const;
+
+        std::vector< std::unique_ptr< BLOCK > > Blocks;
+
+        /* Ring of blocks: `First` is the oldest, `Used` of them hold events, the last one may be partly filled. */
+        SIZE_T First = 0;
+        SIZE_T Used = 0;
+
+        mutable SIZE_T Scanned = 0;
+        mutable SIZE_T Skipped = 0;
+    };
+}
@@ -0,0 +1,66 @@
+#include "threads.hpp"
+
+mw::lib::THREAD_POOL::THREAD_POOL( unsigned int Threads )
+{
+    if ( Threads == 0 )
+    {
+        Threads = std::thread::hardware_concurrency( );
+    }
+
+    Threads = Threads ? Threads : 1;
+
+    for ( unsigned int i = 0; i < Threads; i++ )
+    {
+        this->Threads.emplace_back( [ this ] { Run( ); } );
+    }
+}
+
+mw::lib::THREAD_POOL::~THREAD_POOL( )
+{
+    {
+        std::lock_guard< std::mutex > Guard( Lock );
+        Stopping = true;
+    }
+
+    Wake.notify_all( );
+
+    for ( auto& Thread : Threads )
+    {
+        Thread.join( );
+    }
+}
+
+void mw::lib::THREAD_POOL::Enqueue( std::function< void( ) > Work )
+{
+    {
+        std::lock_guard< std::mutex > Guard( Lock );
+        Queue.push_back( std::move( Work ) );
+    }
+
+    Wake.notify_one( );
+}
+
+void mw::lib::THREAD_POOL::Run( )
+{
+    for ( ;; )
+    {
+        std::function< void( ) > Work;
+
+        {
+            std::unique_lock< std::mutex > Guard( Lock );
+
+            Wake.wait( Guard, [ this ] { return Stopping || !Queue.empty( ); } );
+
+            /* Only stop once the queue is drained, callers may still be waiting on futures. */
+            if ( Queue.empty( ) )
+            {
+                return;
+            }
+
+            Work = std::move( Queue.front( ) );
+            Queue.pop_front( );
+        }
+
+        Work( );
+    }
+}
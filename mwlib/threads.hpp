@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of worker threads taking submitted work in submission order. Used for compression and decompression,
+ * which is pure computation, so there's no point in more threads than processors.
+ */
+namespace mw::lib
+{
+    class THREAD_POOL
+    {
+    public:
+        /*
+         * 0 threads means one per processor.
+         */
+        explicit THREAD_POOL( unsigned int Threads = 0 );
+
+        /*
+         * Finishes everything already submitted before returning.
+         */
+        ~THREAD_POOL( );
+
+        THREAD_POOL( const THREAD_POOL& ) = delete;
+        THREAD_POOL& operator=( const THREAD_POOL& ) = delete;
+
+        template < typename WORK >
+        auto Submit( WORK&& Work ) -> std::future< decltype( Work( ) ) >
+        {
+            using RESULT = decltype( Work( ) );
+
+            auto Task = std::make_shared< std::packaged_task< RESULT( ) > >( std::forward< WORK >( Work ) );
+            auto Future = Task->get_future( );
+
+            Enqueue( [ Task ] { ( *Task )( ); } );
+
+            return Future;
+        }
+
+        unsigned int Size( ) const
+        {
+            return static_cast< unsigned int >( Threads.size( ) );
+        }
+
+    private:
+        void Enqueue( std::function< void( ) > Work );
+        void Run( );
+
+        std::vector< std::thread > Threads;
+
+        std::mutex Lock;
+        std::condition_variable Wake;
+        std::deque< std::function< void( ) > > Queue;
+        bool Stopping = false;
+    };
+}
@@ -0,0 +1,818 @@
+#include "trace.hpp"
+#include "lz.hpp"
+#include "series.hpp"
+#include "simd.hpp"
+
+#include <cstring>
+#include <new>
+#include <unordered_map>
+
+#if !defined( _WIN32 )
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    static_assert( sizeof( mw::lib::TRACE_HEADER ) == 64 );
+
+    using CLOCK = std::chrono::steady_clock;
+
+    double Seconds( const CLOCK::duration Duration )
+    {
+        return std::chrono::duration< double >( Duration ).count( );
+    }
+
+    bool Seek( std::FILE* File, const ULONG64 Offset )
+    {
+#if defined( _WIN32 )
+        return _fseeki64( File, static_cast< __int64 >( Offset ), SEEK_SET ) == 0;
+#else
+        return fseeko( File, static_cast< off_t >( Offset ), SEEK_SET ) == 0;
+#endif
+    }
+
+    ULONG64 FileSize( std::FILE* File )
+    {
+#if defined( _WIN32 )
+        return ( _fseeki64( File, 0, SEEK_END ) == 0 ) ? static_cast< ULONG64 >( _ftelli64( File ) ) : 0;
+#else
+        return ( fseeko( File, 0, SEEK_END ) == 0 ) ? static_cast< ULONG64 >( ftello( File ) ) : 0;
+#endif
+    }
+
+    /*
+     * A packed payload, before LZ, is the stream count, a `STREAM` per watch, the stream of every event in append
+     * order, each stream's series words, then the columns the series don't carry: `Previous` XORed with the value the
+     * watch's previous event in the block had, which is 0 unless a write went unnoticed, the processors and the flags.
+     */
+    struct STREAM
+    {
+        ULONG Watch;
+        ULONG Events;
+        ULONG Words;
+        ULONG Reserved;
+    };
+
+    /* Stream indices are 16 bits, a block with more watches than that is written raw. */
+    constexpr SIZE_T MAX_STREAMS = 0xffff;
+
+    template < typename T >
+    void Put( std::vector< unsigned char >& Payload, const T* Data, const SIZE_T Count )
+    {
+        const auto At = Payload.size( );
+
+        Payload.resize( At + Count * sizeof( T ) );
+
+        if ( Count != 0 )
+        {
+            std::memcpy( Payload.data( ) + At, Data, Count * sizeof( T ) );
+        }
+    }
+
+    template < typename T >
+    bool Take( const unsigned char*& At, const unsigned char* End, T* Data, const SIZE_T Count )
+    {
+        if ( static_cast< SIZE_T >( End - At ) / sizeof( T ) < Count )
+        {
+            return false;
+        }
+
+        if ( Count != 0 )
+        {
+            std::memcpy( Data, At, Count * sizeof( T ) );
+        }
+
+        At += Count * sizeof( T );
+
+        return true;
+    }
+
+    bool PackEvents( const mw::EVENT* Events, const SIZE_T Count, std::vector< unsigned char >& Payload )
+    {
+        std::unordered_map< ULONG, USHORT > Index;
+        std::vector< STREAM > Streams;
+        std::vector< ULONG64 > LastValue;
+
+        std::vector< USHORT > Order( Count );
+        std::vector< ULONG64 > Previous( Count );
+        std::vector< USHORT > Processors( Count );
+        std::vector< USHORT > Flags( Count );
+
+        for ( SIZE_T i = 0; i < Count; i++ )
+        {
+            const auto& Event = Events[ i ];
+
+            auto Found = Index.find( Event.Watch );
+
+            if ( Found == Index.end( ) )
+            {
+                if ( Streams.size( ) == MAX_STREAMS )
+                {
+                    return false;
+                }
+
+                Found = Index.emplace( Event.Watch, static_cast< USHORT >( Streams.size( ) ) ).first;
+
+                Streams.push_back( { Event.Watch, 0, 0, 0 } );
+                LastValue.push_back( 0 );
+            }
+
+            const auto Stream = Found->second;
+
+            Order[ i ] = Stream;
+            Previous[ i ] = Event.Previous ^ LastValue[ Stream ];
+            Processors[ i ] = Event.Processor;
+            Flags[ i ] = Event.Flags;
+
+            LastValue[ Stream ] = Event.Value;
+            Streams[ Stream ].Events++;
+        }
+
+        std::vector< mw::lib::SERIES_ENCODER > Encoders( Streams.size( ) );
+
+        for ( SIZE_T i = 0; i < Count; i++ )
+        {
+            Encoders[ Order[ i ] ].Append( Events[ i ].Tsc, Events[ i ].Value );
+        }
+
+        for ( SIZE_T i = 0; i < Streams.size( ); i++ )
+        {
+            Streams[ i ].Words = static_cast< ULONG >( Encoders[ i ].Finish( ).size( ) );
+        }
+
+        const auto StreamCount = static_cast< ULONG >( Streams.size( ) );
+
+        Payload.clear( );
+
+        Put( Payload, &StreamCount, 1 );
+        Put( Payload, Streams.data( ), Streams.size( ) );
+        Put( Payload, Order.data( ), Count );
+
+        for ( const auto& Encoder : Encoders )
+        {
+            Put( Payload, Encoder.Words( ).data( ), Encoder.Words( ).size( ) );
+        }
+
+        Put( Payload, Previous.data( ), Count );
+        Put( Payload, Processors.data( ), Count );
+        Put( Payload, Flags.data( ), Count );
+
+        return true;
+    }
+
+    /*
+     * Appends the `Count` events of a packed payload to `Events`, nothing if the payload doesn't hold exactly those.
+     */
+    bool UnpackEvents( const unsigned char* Payload, const SIZE_T Size, const SIZE_T Count, std::vector< mw::EVENT >& Events )
+    {
+        auto At = Payload;
+        const auto End = Payload + Size;
+
+        ULONG StreamCount;
+
+        if ( !Take( At, End, &StreamCount, 1 ) || StreamCount > MAX_STREAMS )
+        {
+            return false;
+        }
+
+        std::vector< STREAM > Streams( StreamCount );
+        std::vector< USHORT > Order( Count );
+
+        if ( !Take( At, End, Streams.data( ), StreamCount ) || !Take( At, End, Order.data( ), Count ) )
+        {
+            return false;
+        }
+
+        /* Every stream's events end up next to each other, starting at `Start`. */
+        std::vector< SIZE_T > Start( StreamCount );
+        std::vector< ULONG64 > Tsc( Count );
+        std::vector< ULONG64 > Values( Count );
+        std::vector< ULONG64 > Words;
+
+        SIZE_T Decoded = 0;
+
+        for ( ULONG i = 0; i < StreamCount; i++ )
+        {
+            const auto& Stream = Streams[ i ];
+
+            if ( Stream.Events > Count - Decoded )
+            {
+                return false;
+            }
+
+            Words.resize( Stream.Words );
+            Start[ i ] = Decoded;
+
+            if ( !Take( At, End, Words.data( ), Words.size( ) ) ||
+                 mw::lib::DecodeSeries( Words.data( ), Words.size( ), Stream.Events, &Tsc[ Decoded ], &Values[ Decoded ] ) != Stream.Events )
+            {
+                return false;
+            }
+
+            Decoded += Stream.Events;
+        }
+
+        std::vector< ULONG64 > Previous( Count );
+        std::vector< USHORT > Processors( Count );
+        std::vector< USHORT > Flags( Count );
+
+        if ( Decoded != Count || !Take( At, End, Previous.data( ), Count ) || !Take( At, End, Processors.data( ), Count ) ||
+             !Take( At, End, Flags.data( ), Count ) || At != End )
+        {
+            return false;
+        }
+
+        std::vector< mw::EVENT > Unpacked( Count );
+        std::vector< ULONG64 > LastValue( StreamCount );
+
+        for ( SIZE_T i = 0; i < Count; i++ )
+        {
+            const auto Stream = Order[ i ];
+
+            if ( Stream >= StreamCount || Streams[ Stream ].Events == 0 )
+            {
+                return false;
+            }
+
+            const auto From = Start[ Stream ]++;
+
+            Streams[ Stream ].Events--;
+
+            Unpacked[ i ] = { Tsc[ From ], Values[ From ], Previous[ i ] ^ LastValue[ Stream ], Streams[ Stream ].Watch, Processors[ i ], Flags[ i ] };
+
+            LastValue[ Stream ] = Values[ From ];
+        }
+
+        Events.insert( Events.end( ), Unpacked.begin( ), Unpacked.end( ) );
+
+        return true;
+    }
+}
+
+mw::lib::TRACE_WRITER::~TRACE_WRITER( )
+{
+    Close( );
+}
+
+bool mw::lib::TRACE_WRITER::Open( const char* Path, const TRACE_OPTIONS& Options )
+{
+    Close( );
+
+    this->Options = Options;
+
+    auto& Size = this->Options.BlockSize;
+
+    Size = ( Size + TRACE_ALIGNMENT - 1 ) / TRACE_ALIGNMENT * TRACE_ALIGNMENT;
+    Size = ( Size < TRACE_ALIGNMENT ) ? TRACE_ALIGNMENT : Size;
+
+    if ( Size > ~0u )
+    {
+        return false;
+    }
+
+    if ( this->Options.Buffers < 2 )
+    {
+        this->Options.Buffers = 2;
+    }
+
+    Totals = { };
+
+    if ( CreateTrace( Path, this->Options.Direct ) )
+    {
+        Totals.Direct = this->Options.Direct;
+    }
+    else if ( !this->Options.Direct || !CreateTrace( Path, false ) )
+    {
+        return false;
+    }
+
+    for ( SIZE_T i = 0; i < this->Options.Buffers; i++ )
+    {
+        Storage.push_back( static_cast< unsigned char* >( ::operator new( Size, std::align_val_t( TRACE_ALIGNMENT ) ) ) );
+    }
+
+    if ( this->Options.Compress )
+    {
+        Packed = static_cast< unsigned char* >( ::operator new( Size, std::align_val_t( TRACE_ALIGNMENT ) ) );
+    }
+
+    Free.assign( Storage.begin( ) + 1, Storage.end( ) );
+    Full.clear( );
+
+    Current = { Storage[ 0 ], 0, ~0ull, 0, { } };
+    Sequence = 0;
+    Stopping = false;
+    Failed = false;
+    DelaySum = 0;
+    DelaySamples = 0;
+    Opened = CLOCK::now( );
+    LastSync = Opened;
+    Offset = 0;
+
+    Writer = std::thread( [ this ] { Run( ); } );
+
+    return true;
+}
+
+bool mw::lib::TRACE_WRITER::Append( const EVENT* Events, SIZE_T Count )
+{
+    if ( Storage.empty( ) )
+    {
+        return false;
+    }
+
+    const auto Capacity = BlockEvents( Options.BlockSize );
+
+    while ( Count != 0 )
+    {
+        if ( Current.Events == 0 )
+        {
+            Current.Started = CLOCK::now( );
+        }
+
+        const auto Room = Capacity - Current.Events;
+        const auto Batch = ( Count < Room ) ? Count : Room;
+
+        auto Out = reinterpret_cast< EVENT* >( Current.Data + sizeof( TRACE_HEADER ) ) + Current.Events;
+
+        for ( SIZE_T i = 0; i < Batch; i++ )
+        {
+            Out[ i ] = Events[ i ];
+
+            Current.MinTsc = ( Events[ i ].Tsc < Current.MinTsc ) ? Events[ i ].Tsc : Current.MinTsc;
+            Current.MaxTsc = ( Events[ i ].Tsc > Current.MaxTsc ) ? Events[ i ].Tsc : Current.MaxTsc;
+        }
+
+        Current.Events += Batch;
+        Events += Batch;
+        Count -= Batch;
+
+        if ( Current.Events == Capacity )
+        {
+            Submit( );
+        }
+    }
+
+    if ( Options.MaxDelay.count( ) != 0 && Current.Events != 0 && CLOCK::now( ) - Current.Started >= Options.MaxDelay )
+    {
+        Submit( );
+    }
+
+    std::lock_guard< std::mutex > Guard( Lock );
+
+    return !Failed;
+}
+
+bool mw::lib::TRACE_WRITER::Flush( )
+{
+    if ( Storage.empty( ) )
+    {
+        return false;
+    }
+
+    if ( Current.Events != 0 )
+    {
+        Submit( );
+    }
+
+    std::lock_guard< std::mutex > Guard( Lock );
+
+    return !Failed;
+}
+
+void mw::lib::TRACE_WRITER::Submit( )
+{
+    TRACE_HEADER Header = { };
+
+    Header.Magic = TRACE_MAGIC;
+    Header.BlockSize = static_cast< ULONG >( Options.BlockSize );
+    Header.Sequence = Sequence++;
+    Header.Events = static_cast< ULONG >( Current.Events );
+    Header.FirstTsc = Current.MinTsc;
+    Header.LastTsc = Current.MaxTsc;
+    Header.TscPerMicrosecond = Options.TscPerMicrosecond;
+    Header.Stored = static_cast< ULONG >( Options.BlockSize );
+
+    std::memcpy( Current.Data, &Header, sizeof( Header ) );
+
+    const auto Used = sizeof( TRACE_HEADER ) + Current.Events * sizeof( EVENT );
+
+    std::memset( Current.Data + Used, 0, Options.BlockSize - Used );
+
+    std::unique_lock< std::mutex > Guard( Lock );
+
+    Full.push_back( Current );
+    Wake.notify_all( );
+
+    if ( Free.empty( ) )
+    {
+        const auto Start = CLOCK::now( );
+
+        Wake.wait( Guard, [ this ] { return !Free.empty( ); } );
+
+        Totals.Stalls++;
+        Totals.StallSeconds += Seconds( CLOCK::now( ) - Start );
+    }
+
+    Current = { Free.front( ), 0, ~0ull, 0, { } };
+    Free.pop_front( );
+}
+
+void mw::lib::TRACE_WRITER::Run( )
+{
+    for ( ;; )
+    {
+        BUFFER Buffer;
+
+        {
+            std::unique_lock< std::mutex > Guard( Lock );
+
+            Wake.wait( Guard, [ this ] { return Stopping || !Full.empty( ); } );
+
+            if ( Full.empty( ) )
+            {
+                return;
+            }
+
+            Buffer = Full.front( );
+            Full.pop_front( );
+        }
+
+        TRACE_HEADER Header;
+
+        std::memcpy( &Header, Buffer.Data, sizeof( Header ) );
+
+        const auto Start = CLOCK::now( );
+        const auto Stored = Packed ? Pack( Buffer.Data, Header ) : 0;
+
+        auto Ok = Stored ? WriteAt( Packed, Stored, Offset ) : WriteAt( Buffer.Data, Options.BlockSize, Offset );
+
+        Offset += Stored ? Stored : Options.BlockSize;
+
+        auto Synced = false;
+
+        if ( Ok && ( Options.Sync == SYNC_POLICY::EveryBlock ||
+                     ( Options.Sync == SYNC_POLICY::Periodic && CLOCK::now( ) - LastSync >= Options.SyncInterval ) ) )
+        {
+            Ok = SyncTrace( );
+            Synced = true;
+            LastSync = CLOCK::now( );
+        }
+
+        const auto Done = ReadTsc( );
+        const auto Elapsed = Seconds( CLOCK::now( ) - Start );
+
+        std::lock_guard< std::mutex > Guard( Lock );
+
+        if ( Ok )
+        {
+            Totals.Blocks++;
+            Totals.Events += Header.Events;
+            Totals.Bytes += Stored ? Stored : Options.BlockSize;
+            Totals.RawBytes += Options.BlockSize;
+            Totals.PackedBlocks += ( Stored != 0 );
+            Totals.Syncs += Synced;
+
+            /* Events can come from any processor, a slightly skewed TSC could put the oldest one in the future. */
+            if ( Options.TscPerMicrosecond != 0 && Done != 0 && Done > Header.FirstTsc )
+            {
+                const auto Delay = static_cast< double >( Done - Header.FirstTsc ) / Options.TscPerMicrosecond;
+
+                DelaySum += Delay;
+                DelaySamples++;
+                Totals.DelayMaxMicroseconds = ( Delay > Totals.DelayMaxMicroseconds ) ? Delay : Totals.DelayMaxMicroseconds;
+            }
+        }
+        else
+        {
+            Failed = true;
+        }
+
+        Totals.WriteSeconds += Elapsed;
+
+        Free.push_back( Buffer.Data );
+        Wake.notify_all( );
+    }
+}
+
+SIZE_T mw::lib::TRACE_WRITER::Pack( const unsigned char* Block, TRACE_HEADER& Header )
+{
+    const auto Events = reinterpret_cast< const EVENT* >( Block + sizeof( TRACE_HEADER ) );
+
+    if ( !PackEvents( Events, Header.Events, Payload ) || Payload.size( ) > ~0u )
+    {
+        return 0;
+    }
+
+    const auto Size = lz::Compress( Payload.data( ), Payload.size( ), Packed + sizeof( TRACE_HEADER ),
+                                    Options.BlockSize - sizeof( TRACE_HEADER ) );
+
+    const auto Stored = ( sizeof( TRACE_HEADER ) + Size + TRACE_ALIGNMENT - 1 ) / TRACE_ALIGNMENT * TRACE_ALIGNMENT;
+
+    if ( Size == 0 || Stored >= Options.BlockSize )
+    {
+        return 0;
+    }
+
+    Header.Flags |= TRACE_FLAG_PACKED;
+    Header.Stored = static_cast< ULONG >( Stored );
+    Header.Packed = static_cast< ULONG >( Size );
+    Header.Unpacked = static_cast< ULONG >( Payload.size( ) );
+
+    std::memcpy( Packed, &Header, sizeof( Header ) );
+    std::memset( Packed + sizeof( TRACE_HEADER ) + Size, 0, Stored - sizeof( TRACE_HEADER ) - Size );
+
+    return Stored;
+}
+
+bool mw::lib::TRACE_WRITER::Close( )
+{
+    if ( Storage.empty( ) )
+    {
+        std::lock_guard< std::mutex > Guard( Lock );
+        return !Failed;
+    }
+
+    if ( Current.Events != 0 )
+    {
+        Submit( );
+    }
+
+    {
+        std::lock_guard< std::mutex > Guard( Lock );
+        Stopping = true;
+    }
+
+    Wake.notify_all( );
+    Writer.join( );
+
+    if ( Options.Sync != SYNC_POLICY::Never && !Failed )
+    {
+        Failed = !SyncTrace( );
+        Totals.Syncs++;
+    }
+
+    CloseTrace( );
+
+    for ( const auto Data : Storage )
+    {
+        ::operator delete( Data, std::align_val_t( TRACE_ALIGNMENT ) );
+    }
+
+    if ( Packed )
+    {
+        ::operator delete( Packed, std::align_val_t( TRACE_ALIGNMENT ) );
+        Packed = nullptr;
+    }
+
+    Storage.clear( );
+    Free.clear( );
+    Current = { };
+    Closed = CLOCK::now( );
+
+    return !Failed;
+}
+
+mw::lib::TRACE_STATS mw::lib::TRACE_WRITER::Stats( ) const
+{
+    std::lock_guard< std::mutex > Guard( Lock );
+
+    auto Stats = Totals;
+
+    Stats.ElapsedSeconds = Seconds( ( Storage.empty( ) ? Closed : CLOCK::now( ) ) - Opened );
+    Stats.DelayMeanMicroseconds = DelaySamples ? DelaySum / DelaySamples : 0;
+
+    return Stats;
+}
+
+mw::lib::TRACE_READER::~TRACE_READER( )
+{
+    Close( );
+}
+
+bool mw::lib::TRACE_READER::Open( const char* Path, bool FromEnd )
+{
+    Close( );
+
+    File = std::fopen( Path, "rb" );
+
+    if ( !File )
+    {
+        return false;
+    }
+
+    BlockSize = 0;
+    TscRate = 0;
+    Next = 0;
+    Offset = 0;
+    SkipExisting = FromEnd;
+
+    Learn( );
+
+    return true;
+}
+
+void mw::lib::TRACE_READER::Close( )
+{
+    if ( File )
+    {
+        std::fclose( File );
+        File = nullptr;
+    }
+}
+
+/*
+ * The block size is only known once the first block is there.
+ */
+bool mw::lib::TRACE_READER::Learn( )
+{
+    if ( BlockSize != 0 )
+    {
+        return true;
+    }
+
+    TRACE_HEADER Header;
+
+    if ( !Seek( File, 0 ) || std::fread( &Header, sizeof( Header ), 1, File ) != 1 || Header.Magic != TRACE_MAGIC ||
+         Header.BlockSize < TRACE_ALIGNMENT || Header.BlockSize % TRACE_ALIGNMENT != 0 )
+    {
+        return false;
+    }
+
+    BlockSize = Header.BlockSize;
+    TscRate = Header.TscPerMicrosecond;
+
+    Block.resize( BlockSize );
+
+    if ( SkipExisting )
+    {
+        const auto Size = FileSize( File );
+
+        ULONG Stored;
+
+        while ( Complete( Size, Header, Stored ) )
+        {
+            Offset += Stored;
+            Next++;
+        }
+    }
+
+    return true;
+}
+
+bool mw::lib::TRACE_READER::Complete( const ULONG64 Size, TRACE_HEADER& Header, ULONG& Stored )
+{
+    if ( Size < Offset + sizeof( Header ) || !Seek( File, Offset ) || std::fread( &Header, sizeof( Header ), 1, File ) != 1 )
+    {
+        return false;
+    }
+
+    /* Traces from before packing leave `Stored` at 0, every block of theirs is `BlockSize`. */
+    Stored = Header.Stored ? Header.Stored : BlockSize;
+
+    /* The writer extends the file a block at a time, anything else means it isn't all there yet. */
+    return Header.Magic == TRACE_MAGIC && Header.Sequence == Next && Stored >= sizeof( Header ) && Stored <= BlockSize &&
+           Stored % TRACE_ALIGNMENT == 0 && Offset + Stored <= Size;
+}
+
+SIZE_T mw::lib::TRACE_READER::Read( std::vector< EVENT >& Events )
+{
+    if ( !File || !Learn( ) )
+    {
+        return 0;
+    }
+
+    /* A stream at end of file stays there until told otherwise, even when the file grows. */
+    std::clearerr( File );
+
+    const auto Size = FileSize( File );
+    const auto Before = Events.size( );
+
+    TRACE_HEADER Header;
+    ULONG Stored;
+
+    for ( ; Complete( Size, Header, Stored ); Offset += Stored, Next++ )
+    {
+        const auto Data = Block.data( ) + sizeof( TRACE_HEADER );
+
+        if ( std::fread( Data, Stored - sizeof( TRACE_HEADER ), 1, File ) != 1 || Header.Events > BlockEvents( BlockSize ) )
+        {
+            break;
+        }
+
+        if ( Header.Flags & TRACE_FLAG_PACKED )
+        {
+            Payload.resize( Header.Unpacked );
+
+            if ( Header.Packed > Stored - sizeof( TRACE_HEADER ) ||
+                 !lz::Decompress( Data, Header.Packed, Payload.data( ), Payload.size( ) ) ||
+                 !UnpackEvents( Payload.data( ), Payload.size( ), Header.Events, Events ) )
+            {
+                break;
+            }
+        }
+        else
+        {
+            const auto First = reinterpret_cast< const EVENT* >( Data );
+
+            Events.insert( Events.end( ), First, First + Header.Events );
+        }
+    }
+
+    return Events.size( ) - Before;
+}
+
+#if defined( _WIN32 )
+
+bool mw::lib::TRACE_WRITER::CreateTrace( const char* Path, bool Direct )
+{
+    /* Readers following the file while it grows need to be able to open it. */
+    File = CreateFileA(
+        Path,
+        GENERIC_WRITE,
+        FILE_SHARE_READ,
+        nullptr,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | ( Direct ? FILE_FLAG_NO_BUFFERING : 0 ),
+        nullptr
+    );
+
+    return File != INVALID_HANDLE_VALUE;
+}
+
+bool mw::lib::TRACE_WRITER::WriteAt( const unsigned char* Data, SIZE_T Size, ULONG64 Offset )
+{
+    OVERLAPPED Overlapped = { };
+
+    Overlapped.Offset = static_cast< DWORD >( Offset );
+    Overlapped.OffsetHigh = static_cast< DWORD >( Offset >> 32 );
+
+    DWORD Written = 0;
+
+    return ::WriteFile( File, Data, static_cast< DWORD >( Size ), &Written, &Overlapped ) && Written == Size;
+}
+
+bool mw::lib::TRACE_WRITER::SyncTrace( )
+{
+    return FlushFileBuffers( File ) != FALSE;
+}
+
+void mw::lib::TRACE_WRITER::CloseTrace( )
+{
+    if ( File != INVALID_HANDLE_VALUE )
+    {
+        CloseHandle( File );
+        File = INVALID_HANDLE_VALUE;
+    }
+}
+
+#else
+
+bool mw::lib::TRACE_WRITER::CreateTrace( const char* Path, bool Direct )
+{
+    File = open( Path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | ( Direct ? O_DIRECT : 0 ), 0644 );
+
+    return File != -1;
+}
+
+bool mw::lib::TRACE_WRITER::WriteAt( const unsigned char* Data, SIZE_T Size, ULONG64 Offset )
+{
+    while ( Size != 0 )
+    {
+        const auto Written = pwrite( File, Data, Size, static_cast< off_t >( Offset ) );
+
+        if ( Written < 0 && errno == EINTR )
+        {
+            continue;
+        }
+
+        if ( Written <= 0 )
+        {
+            return false;
+        }
+
+        Data += Written;
+        Size -= Written;
+        Offset += Written;
+    }
+
+    return true;
+}
+
+bool mw::lib::TRACE_WRITER::SyncTrace( )
+{
+    return fdatasync( File ) == 0;
+}
+
+void mw::lib::TRACE_WRITER::CloseTrace( )
+{
+    if ( File != -1 )
+    {
+        close( File );
+        File = -1;
+    }
+}
+
+#endif
@@ -0,0 +1,276 @@
+#pragma once
+
+#include "platform.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Streams drained events to disk without going through the page cache, which otherwise flushes in bursts that show
+ * up as latency jitter on the capture host.
+ *
+ * Events are copied into large aligned buffers; a full buffer goes to a background thread that writes it with direct
+ * I/O (`O_DIRECT`, `FILE_FLAG_NO_BUFFERING`) while the next one fills. Each buffer becomes one block of the trace file:
+ * a `TRACE_HEADER` followed by either raw `EVENT` records or, with `TRACE_FLAG_PACKED`, the events split into one
+ * `SERIES_ENCODER` stream per watch and compressed with `lz::Compress`, zero padded to `TRACE_ALIGNMENT`. Blocks follow
+ * each other and every header says how much of the file its block takes, so readers can follow a growing file without
+ * any index.
+ */
+namespace mw::lib
+{
+    /* "MWTR" */
+    constexpr ULONG TRACE_MAGIC = 0x5254574d;
+
+    /* Direct I/O needs buffers, offsets and sizes aligned to the sector size, this covers 512 byte and 4K sectors. */
+    constexpr SIZE_T TRACE_ALIGNMENT = 4096;
+
+    /* The block holds a compressed payload of `Packed` bytes, `Unpacked` once decompressed. */
+    constexpr ULONG TRACE_FLAG_PACKED = 1u << 0;
+
+    struct TRACE_HEADER
+    {
+        ULONG Magic;
+
+        /* Largest a block of this file can take, and what every raw block takes. */
+        ULONG BlockSize;
+
+        ULONG64 Sequence;
+        ULONG Events;
+        ULONG Flags;
+        ULONG64 FirstTsc;
+        ULONG64 LastTsc;
+
+        /* As reported by the driver at capture time, 0 if unknown. */
+        ULONG64 TscPerMicrosecond;
+
+        /* Bytes of the file this block takes, header and padding included. 0 in traces older than packing, meaning `BlockSize`. */
+        ULONG Stored;
+
+        ULONG Packed;
+        ULONG Unpacked;
+        ULONG Reserved;
+    };
+
+    static_assert( sizeof( TRACE_HEADER ) % sizeof( EVENT ) == 0 );
+
+    constexpr SIZE_T BlockEvents( const SIZE_T BlockSize )
+    {
+        return ( BlockSize - sizeof( TRACE_HEADER ) ) / sizeof( EVENT );
+    }
+
+    enum class SYNC_POLICY
+    {
+        /* Leave it to the OS. */
+        Never,
+
+        /* After every block, nothing acknowledged is ever lost. */
+        EveryBlock,
+
+        /* At most once per `SyncInterval`. */
+        Periodic
+    };
+
+    struct TRACE_OPTIONS
+    {
+        /* Rounded up to `TRACE_ALIGNMENT`. */
+        SIZE_T BlockSize = 1u << 20;
+
+        /* At least 2: one filling while the others are being written. */
+        SIZE_T Buffers = 2;
+
+        /* Falls back to buffered writes, and says so in the stats, where the file system doesn't support it. */
+        bool Direct = true;
+
+        /* Packs blocks on the writer thread, a block that wouldn't get any smaller is written raw. */
+        bool Compress = true;
+
+        SYNC_POLICY Sync = SYNC_POLICY::Periodic;
+        std::chrono::milliseconds SyncInterval{ 1000 };
+
+        /* A partly filled buffer is written anyway once its oldest event has waited this long, 0 to wait until full. */
+        std::chrono::milliseconds MaxDelay{ 100 };
+
+        /* Lets the writer measure how long events took to reach the disk, 0 to skip that. */
+        ULONG64 TscPerMicrosecond = 0;
+    };
+
+    struct TRACE_STATS
+    {
+        bool Direct;
+
+        ULONG64 Blocks;
+        ULONG64 Events;
+        ULONG64 Bytes;
+        ULONG64 Syncs;
+
+        /* Blocks written packed, and what all blocks would have taken raw. */
+        ULONG64 PackedBlocks;
+        ULONG64 RawBytes;
+
+        /* Time spent in write and sync calls, and since the file was opened. */
+        double WriteSeconds;
+        double ElapsedSeconds;
+
+        /* Times `Append` had to wait for a buffer because the disk fell behind, and for how long in total. */
+        ULONG64 Stalls;
+        double StallSeconds;
+
+        /* From an event's capture to its block being written, for the oldest event of each block. */
+        double DelayMeanMicroseconds;
+        double DelayMaxMicroseconds;
+    };
+
+    class TRACE_WRITER
+    {
+    public:
+        TRACE_WRITER( ) = default;
+        ~TRACE_WRITER( );
+
+        TRACE_WRITER( const TRACE_WRITER& ) = delete;
+        TRACE_WRITER& operator=( const TRACE_WRITER& ) = delete;
+
+        /*
+         * Creates or truncates `Path`.
+         */
+        bool Open( const char* Path, const TRACE_OPTIONS& Options = { } );
+
+        /*
+         * Only blocks when every buffer is waiting to be written. Calling it with no events still hands over a partly
+         * filled buffer that has been waiting longer than `MaxDelay`.
+         */
+        bool Append( const EVENT* Events, SIZE_T Count );
+
+        /*
+         * Hands over the buffer being filled, even if only partly.
+         */
+        bool Flush( );
+
+        /*
+         * Writes everything, syncs unless the policy is `Never`, and closes the file. False if any write failed.
+         */
+        bool Close( );
+
+        TRACE_STATS Stats( ) const;
+
+    private:
+        struct BUFFER
+        {
+            unsigned char* Data;
+            SIZE_T Events;
+            ULONG64 MinTsc;
+            ULONG64 MaxTsc;
+
+            /* When the first event was copied in. */
+            std::chrono::steady_clock::time_point Started;
+        };
+
+        void Submit( );
+        void Run( );
+
+        /*
+         * Packs the raw block in `Block` into `Packed`, returns how much of the file it takes then, or 0 to write it raw.
+         */
+        SIZE_T Pack( const unsigned char* Block, TRACE_HEADER& Header );
+
+        bool CreateTrace( const char* Path, bool Direct );
+        bool WriteAt( const unsigned char* Data, SIZE_T Size, ULONG64 Offset );
+        bool SyncTrace( );
+        void CloseTrace( );
+
+        TRACE_OPTIONS Options;
+
+#if defined( _WIN32 )
+        HANDLE File = INVALID_HANDLE_VALUE;
+#else
+        int File = -1;
+#endif
+
+        std::vector< unsigned char* > Storage;
+
+        /* Only ever touched by the thread calling `Append`. */
+        BUFFER Current = { };
+        ULONG64 Sequence = 0;
+
+        std::thread Writer;
+
+        mutable std::mutex Lock;
+        std::condition_variable Wake;
+        std::deque< BUFFER > Full;
+        std::deque< unsigned char* > Free;
+        bool Stopping = false;
+        bool Failed = false;
+
+        TRACE_STATS Totals = { };
+        double DelaySum = 0;
+        ULONG64 DelaySamples = 0;
+        std::chrono::steady_clock::time_point Opened;
+        std::chrono::steady_clock::time_point Closed;
+
+        /* Only ever touched by the writer thread. */
+        std::chrono::steady_clock::time_point LastSync;
+        unsigned char* Packed = nullptr;
+        std::vector< unsigned char > Payload;
+        ULONG64 Offset = 0;
+    };
+
+    /*
+     * Reads a trace file block by block, also while it's still being written: a block only counts once all of it is
+     * there, and `Read` simply returns nothing until the next one is.
+     */
+    class TRACE_READER
+    {
+    public:
+        TRACE_READER( ) = default;
+        ~TRACE_READER( );
+
+        TRACE_READER( const TRACE_READER& ) = delete;
+        TRACE_READER& operator=( const TRACE_READER& ) = delete;
+
+        /*
+         * With `FromEnd`, blocks already in the file are skipped and only what gets written from now on is read.
+         */
+        bool Open( const char* Path, bool FromEnd = false );
+        void Close( );
+
+        /*
+         * Appends the events of every complete block not read yet to `Events`, returns how many.
+         */
+        SIZE_T Read( std::vector< EVENT >& Events );
+
+        /*
+         * Taken from the first block, 0 until there is one.
+         */
+        ULONG64 TscPerMicrosecond( ) const
+        {
+            return TscRate;
+        }
+
+        ULONG64 Blocks( ) const
+        {
+            return Next;
+        }
+
+    private:
+        bool Learn( );
+
+        /*
+         * Reads the header of the block at `Offset`, false unless all of the block is in the first `Size` bytes.
+         */
+        bool Complete( ULONG64 Size, TRACE_HEADER& Header, ULONG& Stored );
+
+        std::FILE* File = nullptr;
+        std::vector< unsigned char > Block;
+        std::vector< unsigned char > Payload;
+
+        ULONG BlockSize = 0;
+        ULONG64 TscRate = 0;
+        ULONG64 Next = 0;
+        ULONG64 Offset = 0;
+        bool SkipExisting = false;
+    };
+}
@@ -0,0 +1,163 @@
+#include "window.hpp"
+
+#include <cstring>
+
+mw::lib::WATCH_WINDOWS::WATCH_WINDOWS( ULONG64 TscPerMicrosecond, ULONG Slots )
+    : TscPerMicrosecond( TscPerMicrosecond ), SlotCount( Slots ? Slots : 1 )
+{
+}
+
+mw::lib::WATCH_WINDOWS::WATCH& mw::lib::WATCH_WINDOWS::At( ULONG Watch )
+{
+    Watch = ( Watch < MAX_TRACKED_WATCHES ) ? Watch : OTHER_WATCHES;
+
+    if ( Watch >= Watches.size( ) )
+    {
+        Watches.resize( Watch + 1 );
+    }
+
+    auto& Entry = Watches[ Watch ];
+
+    if ( !Entry.Seen )
+    {
+        Entry = { };
+        Entry.Seen = true;
+        Entry.Slots.resize( SlotCount );
+    }
+
+    return Entry;
+}
+
+void mw::lib::WATCH_WINDOWS::Add( const EVENT* Events, SIZE_T Count, ULONG64 Now )
+{
+    for ( SIZE_T i = 0; i < Count; i++ )
+    {
+        const auto& Event = Events[ i ];
+
+        auto& Watch = At( Event.Watch );
+        auto& Slot = Watch.Slots[ Current ];
+
+        Watch.Total++;
+        Slot.Count++;
+        Watch.Window.Count++;
+
+        /* Drains aren't ordered across watchers, only keep the newest value. */
+        if ( Event.Tsc >= Watch.LastTsc )
+        {
+            Watch.LastTsc = Event.Tsc;
+            Watch.LastValue = Event.Value;
+        }
+
+        if ( Now != 0 )
+        {
+            const auto Bin = LatencyBin( ( Now > Event.Tsc ) ? ( Now - Event.Tsc ) : 0 );
+
+            Slot.Latency[ Bin ]++;
+            Watch.Window.Latency[ Bin ]++;
+        }
+    }
+}
+
+void mw::lib::WATCH_WINDOWS::Advance( )
+{
+    Current = ( Current + 1 ) % SlotCount;
+    Filled = ( Filled < SlotCount ) ? Filled + 1 : SlotCount;
+
+    /* The slot about to be reused is the oldest one, take it out of the window. */
+    for ( auto& Watch : Watches )
+    {
+        if ( !Watch.Seen )
+        {
+            continue;
+        }
+
+        auto& Oldest = Watch.Slots[ Current ];
+
+        if ( Oldest.Count == 0 )
+        {
+            continue;
+        }
+
+        Watch.Window.Count -= Oldest.Count;
+
+        for ( ULONG Bin = 0; Bin < LATENCY_BINS; Bin++ )
+        {
+            Watch.Window.Latency[ Bin ] -= Oldest.Latency[ Bin ];
+        }
+
+        std::memset( &Oldest, 0, sizeof( Oldest ) );
+    }
+}
+
+void mw::lib::WATCH_WINDOWS::Summarize( std::vector< WINDOW_SUMMARY >& Summary, double PeriodSeconds ) const
+{
+    Summary.clear( );
+
+    /* The current slot has only just started when this runs right after `Advance`. */
+    const auto Seconds = ( Filled > 1 ? Filled - 1 : 1 ) * PeriodSeconds;
+
+    const auto Micro = [ this ]( const ULONG Bin ) {
+        return TscPerMicrosecond ? static_cast< double >( LatencyBinFloor( Bin ) ) / TscPerMicrosecond : 0.0;
+    };
+
+    for ( ULONG Id = 0; Id < Watches.size( ); Id++ )
+    {
+        const auto& Watch = Watches[ Id ];
+
+        if ( !Watch.Seen )
+        {
+            continue;
+        }
+
+        WINDOW_SUMMARY Entry = { };
+
+        Entry.Watch = Id;
+        Entry.Rate = Watch.Window.Count / Seconds;
+        Entry.Total = Watch.Total;
+        Entry.LastValue = Watch.LastValue;
+        Entry.LastTsc = Watch.LastTsc;
+
+        ULONG64 Samples = 0;
+
+        for ( const auto Count : Watch.Window.Latency )
+        {
+            Samples += Count;
+        }
+
+        ULONG64 Seen = 0;
+
+        for ( ULONG Bin = 0; Bin < LATENCY_BINS && Samples != 0; Bin++ )
+        {
+            const auto Count = Watch.Window.Latency[ Bin ];
+
+            if ( Count == 0 )
+            {
+                continue;
+            }
+
+            /* First bin reaching each quantile. */
+            const auto Before = Seen;
+
+            Seen += Count;
+
+            if ( Before * 100 < Samples * 50 && Seen * 100 >= Samples * 50 )
+            {
+                Entry.P50 = Micro( Bin );
+            }
+
+            if ( Before * 100 < Samples * 90 && Seen * 100 >= Samples * 90 )
+            {
+                Entry.P90 = Micro( Bin );
+            }
+
+            if ( Before * 100 < Samples * 99 && Seen * 100 >= Samples * 99 )
+            {
+                Entry.P99 = Micro( Bin );
+            }
+
+            Entry.Max = Micro( Bin );
+        }
+
+        Summary.push_back( Entry );
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "platform.hpp"
+
+#include <bit>
+#include <vector>
+
+/*
+ * Per-watch sliding-window statistics over a live event stream, kept up to date incrementally: every event costs a
+ * few increments, and moving the window on drops the oldest slot by subtracting it, so nothing is ever rescanned.
+ *
+ * Latency is how long an event took from detection to being handed to `Add`, kept in log-linear histograms with four
+ * bins per power of two, which bounds percentile error to 25%.
+ */
+namespace mw::lib
+{
+    constexpr ULONG LATENCY_BINS = 256;
+
+    /* Watch ids at or above this are counted together under `OTHER_WATCHES`. */
+    constexpr ULONG MAX_TRACKED_WATCHES = 4096;
+    constexpr ULONG OTHER_WATCHES = MAX_TRACKED_WATCHES;
+
+    inline ULONG LatencyBin( const ULONG64 Cycles )
+    {
+        if ( Cycles < 4 )
+        {
+            return static_cast< ULONG >( Cycles );
+        }
+
+        const auto Log2 = static_cast< ULONG >( std::bit_width( Cycles ) ) - 1;
+
+        return ( Log2 - 1 ) * 4 + static_cast< ULONG >( ( Cycles >> ( Log2 - 2 ) ) & 3 );
+    }
+
+    /*
+     * Smallest latency that lands in `Bin`.
+     */
+    inline ULONG64 LatencyBinFloor( const ULONG Bin )
+    {
+        if ( Bin < 4 )
+        {
+            return Bin;
+        }
+
+        return ( 4ull + Bin % 4 ) << ( Bin / 4 - 1 );
+    }
+
+    struct WINDOW_SUMMARY
+    {
+        ULONG Watch;
+
+        /* Events per second over the window, and since the start. */
+        double Rate;
+        ULONG64 Total;
+
+        ULONG64 LastValue;
+        ULONG64 LastTsc;
+
+        /* Over the window, in microseconds. All 0 if there were no events in it. */
+        double P50;
+        double P90;
+        double P99;
+        double Max;
+    };
+
+    class WATCH_WINDOWS
+    {
+    public:
+        /*
+         * `Slots` periods of `Advance` make up the window.
+         */
+        WATCH_WINDOWS( ULONG64 TscPerMicrosecond, ULONG Slots );
+
+        /*
+         * `Now` is the TSC at which the events were handed over, 0 to leave them out of the latency figures.
+         */
+        void Add( const EVENT* Events, SIZE_T Count, ULONG64 Now );
+
+        /*
+         * Closes the current slot; called once per period, normally a second.
+         */
+        void Advance( );
+
+        /*
+         * Every watch seen so far, in id order. `PeriodSeconds` is the time between calls to `Advance`.
+         */
+        void Summarize( std::vector< WINDOW_SUMMARY >& Summary, double PeriodSeconds = 1.0 ) const;
+
+    private:
+        struct SLOT
+        {
+            ULONG64 Count;
+            ULONG Latency[ LATENCY_BINS ];
+        };
+
+        struct WATCH
+        {
+            bool Seen;
+
+            ULONG64 Total;
+            ULONG64 LastValue;
+            ULONG64 LastTsc;
+
+            /* Sum of all slots, the oldest is subtracted when it goes out of the window. */
+            SLOT Window;
+            std::vector< SLOT > Slots;
+        };
+
+        WATCH& At( ULONG Watch );
+
+        ULONG64 TscPerMicrosecond;
+        ULONG SlotCount;
+
+        /* Slot events are currently added to; slots older than `Filled` periods are still empty. */
+        ULONG Current = 0;
+        ULONG Filled = 1;
+
+        std::vector< WATCH > Watches;
+    };
+}
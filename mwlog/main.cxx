@@ -0,0 +1,90 @@
+#include "../mwlib/client.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+/*
+ * Shows or changes the driver's log levels without reloading it.
+ *
+ *     mwlog                                            shows the level of every subsystem
+ *     mwlog <subsystem|all> <off|error|info|verbose>   sets one subsystem, or all of them
+ *
+ * `verbose` on the watcher subsystem logs every detected store, which slows detection down noticeably.
+ */
+namespace
+{
+    constexpr const char* SUBSYSTEM_NAMES[ ] = { "driver", "cpu", "pool", "system", "watcher" };
+    constexpr const char* LEVEL_NAMES[ ] = { "off", "error", "info", "verbose" };
+
+    static_assert( sizeof( SUBSYSTEM_NAMES ) / sizeof( SUBSYSTEM_NAMES[ 0 ] ) == mw::LogSubsystemCount );
+    static_assert( sizeof( LEVEL_NAMES ) / sizeof( LEVEL_NAMES[ 0 ] ) == mw::LogVerbose + 1 );
+
+    /* Index of `Name` in `Names`, or `Count` if it isn't there. */
+    template < ULONG Count >
+    ULONG Find( const char* const ( &Names )[ Count ], const char* Name )
+    {
+        for ( ULONG i = 0; i < Count; i++ )
+        {
+            if ( std::strcmp( Names[ i ], Name ) == 0 )
+            {
+                return i;
+            }
+        }
+
+        return Count;
+    }
+}
+
+int main( int argc, char** argv )
+{
+    if ( argc != 1 && argc != 3 )
+    {
+        std::fprintf( stderr, "Usage: %s [<subsystem|all> <off|error|info|verbose>]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    mw::lib::DEVICE Device;
+
+    if ( !Device.Open( ) )
+    {
+        std::fprintf( stderr, "Unable to open the driver, is it loaded?\n" );
+        return 1;
+    }
+
+    mw::LOG_LEVELS Levels = { };
+
+    if ( argc == 1 )
+    {
+        if ( !Device.QueryLogLevels( Levels ) )
+        {
+            std::fprintf( stderr, "The driver doesn't support log levels\n" );
+            return 1;
+        }
+    }
+    else
+    {
+        const auto Subsystem = std::strcmp( argv[ 1 ], "all" ) == 0 ? mw::LOG_ALL_SUBSYSTEMS : Find( SUBSYSTEM_NAMES, argv[ 1 ] );
+        const auto Level = Find( LEVEL_NAMES, argv[ 2 ] );
+
+        if ( Subsystem == mw::LogSubsystemCount || Level > mw::LogVerbose )
+        {
+            std::fprintf( stderr, "Unknown subsystem or level\n" );
+            return 1;
+        }
+
+        if ( !Device.SetLogLevel( Subsystem, static_cast< mw::LOG_LEVEL >( Level ), Levels ) )
+        {
+            std::fprintf( stderr, "Setting the log level failed\n" );
+            return 1;
+        }
+    }
+
+    for ( ULONG i = 0; i < mw::LogSubsystemCount; i++ )
+    {
+        const auto Level = Levels.Levels[ i ];
+
+        std::printf( "%-8s %s\n", SUBSYSTEM_NAMES[ i ], Level <= mw::LogVerbose ? LEVEL_NAMES[ Level ] : "?" );
+    }
+
+    return 0;
+}
@@ -0,0 +1,557 @@
+#include "../mwlib/client.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined( _WIN32 )
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*
+ * Runs the same workload against every wait backend the processor supports and prints one row per backend, so they
+ * can be compared on the machine at hand rather than from datasheets.
+ *
+ *     mwmatrix [--rate writes/s] [--slots N] [--seconds N] [--noise-cpu N | --no-noise] [--noise-duty percent]
+ *              [--backoff-ceiling ns]
+ *
+ * The workload is a Poisson stream of `--rate` writes per second to each of `--slots` test slots, played by the load
+ * generator through `IOCTL_REPLAY`. Every write stores the TSC it was made at, so an event's TSC minus its value is
+ * the detection latency. The stream is generated once and played unchanged for every backend.
+ *
+ * Meanwhile a noise thread does a fixed amount of integer work per iteration on `--noise-cpu`, by default the
+ * hyperthread sibling of the first watcher's processor, busy for `--noise-duty` percent of every millisecond. Its
+ * throughput under each backend shows what the watcher costs whoever shares its core.
+ *
+ * Where the processor has WAITPKG the backoff backend runs twice, once backing off with `pause` only and once with
+ * `tpause`.
+ */
+namespace
+{
+    constexpr SIZE_T REPLAY_BATCH = 4096;
+    constexpr SIZE_T DRAIN = 1u << 16;
+
+    /* Time for every watcher to pick up a new backend and for the previous backend's writes to drain. */
+    constexpr auto SETTLE = std::chrono::milliseconds( 500 );
+
+    struct OPTIONS
+    {
+        double Rate = 1000.0;
+        ULONG Slots = 1;
+        double Seconds = 5.0;
+        int NoiseCpu = -1;
+        bool Noise = true;
+        double NoiseDuty = 100.0;
+        ULONG BackoffCeilingNs = 0;
+    };
+
+    struct SNAPSHOT
+    {
+        ULONG64 Events;
+        ULONG64 Missed;
+        ULONG64 WaitCycles;
+        ULONG64 WaitActiveCycles;
+    };
+
+    struct ROW
+    {
+        mw::BACKEND Backend;
+        ULONG Flags;
+        const char* Name;
+
+        SIZE_T Stores;
+        double P50;
+        double P99;
+        double P999;
+        double Max;
+        double MissRate;
+
+        /* Negative when the driver couldn't measure it. */
+        double Active;
+
+        /* Noise iterations per busy microsecond, 0 without a noise thread. */
+        double Noise;
+    };
+
+    const char* BackendName( const ULONG Backend )
+    {
+        switch ( Backend )
+        {
+            case mw::BackendGovernor: return "governor";
+            case mw::BackendSpin: return "spin";
+            case mw::BackendMwait: return "mwait";
+            case mw::BackendUmwait: return "umwait";
+            case mw::BackendMwaitx: return "mwaitx";
+            case mw::BackendEvent: return "event";
+            case mw::BackendBackoff: return "backoff";
+        }
+
+        return "?";
+    }
+
+    bool PinCurrentThread( const ULONG Processor )
+    {
+#if defined( _WIN32 )
+        return SetThreadAffinityMask( GetCurrentThread( ), 1ull << Processor ) != 0;
+#else
+        cpu_set_t Set;
+
+        CPU_ZERO( &Set );
+        CPU_SET( Processor, &Set );
+
+        return pthread_setaffinity_np( pthread_self( ), sizeof( Set ), &Set ) == 0;
+#endif
+    }
+
+    /* Keeps the noise thread's work from being optimised away. */
+    volatile ULONG64 NoiseResult;
+
+    /*
+     * Each iteration is a chain of dependent multiply-adds, so its throughput follows the execution resources the
+     * sibling leaves over and not memory.
+     */
+    void Noise( const ULONG Processor, const double Duty, const std::atomic< bool >& Stop, double& Throughput )
+    {
+        Throughput = 0;
+
+        if ( !PinCurrentThread( Processor ) )
+        {
+            return;
+        }
+
+        const auto Period = std::chrono::microseconds( 1000 );
+        const auto Busy = std::chrono::duration_cast< std::chrono::steady_clock::duration >( Period * Duty / 100.0 );
+
+        ULONG64 Iterations = 0;
+        ULONG64 Sink = 1;
+
+        std::chrono::steady_clock::duration Spent = { };
+
+        while ( !Stop )
+        {
+            const auto Start = std::chrono::steady_clock::now( );
+
+            while ( std::chrono::steady_clock::now( ) - Start < Busy )
+            {
+                for ( int i = 0; i < 256; i++ )
+                {
+                    Sink = Sink * 6364136223846793005ull + 1442695040888963407ull;
+                }
+
+                Iterations++;
+            }
+
+            Spent += std::chrono::steady_clock::now( ) - Start;
+
+            if ( Busy < Period )
+            {
+                std::this_thread::sleep_until( Start + Period );
+            }
+        }
+
+        const auto Micro = std::chrono::duration< double, std::micro >( Spent ).count( );
+
+        NoiseResult = Sink;
+
+        Throughput = Micro > 0 ? Iterations / Micro : 0;
+    }
+
+    bool Snapshot( mw::lib::DEVICE& Device, SNAPSHOT& Snap, std::vector< ULONG >* Processors = nullptr )
+    {
+        std::vector< unsigned char > Buffer;
+
+        if ( !Device.QueryStats( Buffer ) )
+        {
+            return false;
+        }
+
+        const auto Stats = reinterpret_cast< mw::STATS* >( Buffer.data( ) );
+        const auto Watches = mw::GetWatchStats( Stats );
+
+        Snap = { };
+
+        for ( ULONG i = 0; i < Stats->WatcherCount; i++ )
+        {
+            Snap.WaitCycles += Stats->Watchers[ i ].WaitCycles;
+            Snap.WaitActiveCycles += Stats->Watchers[ i ].WaitActiveCycles;
+
+            if ( Processors )
+            {
+                Processors->push_back( Stats->Watchers[ i ].Processor );
+            }
+        }
+
+        for ( ULONG i = 0; i < Stats->WatchCount; i++ )
+        {
+            Snap.Events += Watches[ i ].Events;
+            Snap.Missed += Watches[ i ].Missed;
+        }
+
+        return true;
+    }
+
+    /*
+     * Exponential gaps per slot, merged into one timeline. Seeded the same way every time so reruns play the same
+     * stream.
+     */
+    std::vector< mw::REPLAY_WRITE > MakeSchedule( const OPTIONS& Options, const ULONG64 TscPerMicrosecond )
+    {
+        std::mt19937_64 Random( 42 );
+        std::exponential_distribution< double > Gap( Options.Rate );
+
+        std::vector< mw::REPLAY_WRITE > Writes;
+
+        const auto Span = Options.Seconds * 1e6 * TscPerMicrosecond;
+
+        for ( ULONG Slot = 0; Slot < Options.Slots; Slot++ )
+        {
+            for ( auto At = Gap( Random ) * 1e6 * TscPerMicrosecond; At < Span; At += Gap( Random ) * 1e6 * TscPerMicrosecond )
+            {
+                Writes.push_back( { static_cast< ULONG64 >( At ), 0, Slot, mw::REPLAY_WRITE_TIMESTAMP } );
+            }
+        }
+
+        std::sort( Writes.begin( ), Writes.end( ), []( const mw::REPLAY_WRITE& A, const mw::REPLAY_WRITE& B ) {
+            return A.Offset < B.Offset;
+        } );
+
+        return Writes;
+    }
+
+    /*
+     * Plays the whole schedule once, collecting detection latencies as events come in.
+     */
+    bool Play( mw::lib::DEVICE& Device, const std::vector< mw::REPLAY_WRITE >& Writes, const ULONG64 TscPerMicrosecond, std::vector< double >& Latency )
+    {
+        std::vector< mw::EVENT > Events;
+
+        const auto Collect = [ & ]( ) {
+            Device.ReadEvents( Events, DRAIN );
+
+            for ( const auto& Event : Events )
+            {
+                if ( Event.Tsc >= Event.Value && Event.Tsc - Event.Value < TscPerMicrosecond * 1000000 )
+                {
+                    Latency.push_back( static_cast< double >( Event.Tsc - Event.Value ) / TscPerMicrosecond );
+                }
+            }
+        };
+
+        mw::REPLAY_STATUS Status;
+
+        SIZE_T Sent = 0;
+        auto Flags = mw::REPLAY_FLAG_START;
+
+        for ( ;; )
+        {
+            const auto Count = std::min( REPLAY_BATCH, Writes.size( ) - Sent );
+
+            if ( !Device.Replay( Flags, Writes.data( ) + Sent, static_cast< ULONG >( Count ), Status ) )
+            {
+                return false;
+            }
+
+            Flags = 0;
+            Sent += Status.Accepted;
+
+            Collect( );
+
+            if ( Sent == Writes.size( ) && Status.Queued == 0 )
+            {
+                break;
+            }
+
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        }
+
+        Device.Replay( mw::REPLAY_FLAG_STOP, nullptr, 0, Status );
+
+        /* The last stores may still be on their way through the rings. */
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+
+        Collect( );
+
+        return true;
+    }
+
+    bool Measure( mw::lib::DEVICE& Device, const OPTIONS& Options, const std::vector< mw::REPLAY_WRITE >& Writes, const ULONG64 TscPerMicrosecond, ROW& Row )
+    {
+        if ( !Device.SetBackend( Row.Backend, Row.Flags | mw::BACKEND_FLAG_RESIDENCY, Options.BackoffCeilingNs ) )
+        {
+            return false;
+        }
+
+        std::this_thread::sleep_for( SETTLE );
+
+        std::vector< mw::EVENT > Stale;
+
+        Device.ReadEvents( Stale, DRAIN );
+
+        SNAPSHOT Before;
+        SNAPSHOT After;
+
+        if ( !Snapshot( Device, Before ) )
+        {
+            return false;
+        }
+
+        std::atomic< bool > Stop = false;
+        std::thread NoiseThread;
+
+        if ( Options.Noise && Options.NoiseCpu >= 0 )
+        {
+            NoiseThread = std::thread( Noise, static_cast< ULONG >( Options.NoiseCpu ), Options.NoiseDuty, std::cref( Stop ), std::ref( Row.Noise ) );
+        }
+
+        std::vector< double > Latency;
+
+        const auto Ok = Play( Device, Writes, TscPerMicrosecond, Latency );
+
+        Stop = true;
+
+        if ( NoiseThread.joinable( ) )
+        {
+            NoiseThread.join( );
+        }
+
+        if ( !Ok || !Snapshot( Device, After ) )
+        {
+            return false;
+        }
+
+        std::sort( Latency.begin( ), Latency.end( ) );
+
+        const auto At = [ &Latency ]( const double Quantile ) {
+            return Latency.empty( ) ? 0.0 : Latency[ static_cast< SIZE_T >( Quantile * ( Latency.size( ) - 1 ) ) ];
+        };
+
+        const auto Detected = After.Events - Before.Events;
+        const auto Missed = After.Missed - Before.Missed;
+        const auto Waited = After.WaitCycles - Before.WaitCycles;
+
+        Row.Stores = Latency.size( );
+        Row.P50 = At( 0.5 );
+        Row.P99 = At( 0.99 );
+        Row.P999 = At( 0.999 );
+        Row.Max = Latency.empty( ) ? 0.0 : Latency.back( );
+        Row.MissRate = ( Detected + Missed ) ? 100.0 * Missed / ( Detected + Missed ) : 0.0;
+
+        /* `IA32_MPERF` and the TSC don't tick at exactly the same rate everywhere. */
+        Row.Active = Waited ? std::min( 100.0, 100.0 * ( After.WaitActiveCycles - Before.WaitActiveCycles ) / Waited ) : -1.0;
+
+        return true;
+    }
+}
+
+int main( int argc, char** argv )
+{
+    OPTIONS Options;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const std::string Option = argv[ i ];
+        const auto HasValue = i + 1 < argc;
+
+        if ( Option == "--rate" && HasValue )
+        {
+            Options.Rate = std::atof( argv[ ++i ] );
+        }
+        else if ( Option == "--slots" && HasValue )
+        {
+            Options.Slots = static_cast< ULONG >( std::max( 1, std::atoi( argv[ ++i ] ) ) );
+        }
+        else if ( Option == "--seconds" && HasValue )
+        {
+            Options.Seconds = std::atof( argv[ ++i ] );
+        }
+        else if ( Option == "--noise-cpu" && HasValue )
+        {
+            Options.NoiseCpu = std::atoi( argv[ ++i ] );
+        }
+        else if ( Option == "--no-noise" )
+        {
+            Options.Noise = false;
+        }
+        else if ( Option == "--noise-duty" && HasValue )
+        {
+            Options.NoiseDuty = std::clamp( std::atof( argv[ ++i ] ), 1.0, 100.0 );
+        }
+        else if ( Option == "--backoff-ceiling" && HasValue )
+        {
+            Options.BackoffCeilingNs = static_cast< ULONG >( std::max( 0, std::atoi( argv[ ++i ] ) ) );
+        }
+        else
+        {
+            Options.Rate = 0;
+            break;
+        }
+    }
+
+    if ( !( Options.Rate > 0 ) || !( Options.Seconds > 0 ) )
+    {
+        std::fprintf( stderr,
+                      "Usage: %s [--rate writes/s] [--slots N] [--seconds N] [--noise-cpu N | --no-noise] [--noise-duty percent] "
+                      "[--backoff-ceiling ns]\n",
+                      argv[ 0 ] );
+        return 1;
+    }
+
+    mw::lib::DEVICE Device;
+
+    if ( !Device.Open( ) )
+    {
+        std::fprintf( stderr, "Unable to open the driver, is it loaded?\n" );
+        return 1;
+    }
+
+    std::vector< unsigned char > Buffer;
+
+    if ( !Device.QueryStats( Buffer ) )
+    {
+        std::fprintf( stderr, "Querying the driver failed\n" );
+        return 1;
+    }
+
+    const auto Stats = reinterpret_cast< const mw::STATS* >( Buffer.data( ) );
+    const auto TscPerMicrosecond = Stats->TscPerMicrosecond;
+    const auto Backends = Stats->Backends;
+    const auto Previous = static_cast< mw::BACKEND >( Stats->Backend );
+
+    if ( Stats->Flags & mw::STATS_FLAG_HYPERVISOR )
+    {
+        std::printf( "running under a hypervisor (%.16s), driver default backend %s\n",
+                     Stats->Hypervisor,
+                     BackendName( Stats->DefaultBackend ) );
+    }
+
+    mw::REPLAY_STATUS Status;
+
+    if ( !Device.Replay( 0, nullptr, 0, Status ) || Backends == 0 )
+    {
+        std::fprintf( stderr, "The driver doesn't support replay or backend selection\n" );
+        return 1;
+    }
+
+    Options.Slots = std::min( Options.Slots, Status.Slots );
+
+    SNAPSHOT Ignored;
+    std::vector< ULONG > Processors;
+
+    Snapshot( Device, Ignored, &Processors );
+
+    /* Logical processors of a core are usually numbered next to each other. */
+    if ( Options.Noise && Options.NoiseCpu < 0 && !Processors.empty( ) )
+    {
+        Options.NoiseCpu = static_cast< int >( Processors.front( ) ^ 1u );
+    }
+
+    const auto Writes = MakeSchedule( Options, TscPerMicrosecond );
+
+    std::printf( "%zu writes over %.1f s to %u slot(s), noise %s",
+                 Writes.size( ),
+                 Options.Seconds,
+                 Options.Slots,
+                 ( Options.Noise && Options.NoiseCpu >= 0 ) ? "on processor " : "off"
+    );
+
+    if ( Options.Noise && Options.NoiseCpu >= 0 )
+    {
+        std::printf( "%d at %.0f%%", Options.NoiseCpu, Options.NoiseDuty );
+    }
+
+    std::printf( "\n\n" );
+
+    std::vector< ROW > Plan;
+
+    const auto Add = [ &Plan ]( const mw::BACKEND Backend, const ULONG Flags, const char* Name ) {
+        ROW Row = { };
+
+        Row.Backend = Backend;
+        Row.Flags = Flags;
+        Row.Name = Name;
+
+        Plan.push_back( Row );
+    };
+
+    for ( ULONG Backend = 0; Backend < mw::BackendCount; Backend++ )
+    {
+        if ( ( Backends & ( 1u << Backend ) ) == 0 )
+        {
+            continue;
+        }
+
+        Add( static_cast< mw::BACKEND >( Backend ), 0, BackendName( Backend ) );
+
+        /* The driver uses `tpause` for backing off whenever it can, the plain `pause` run has to ask for it. */
+        if ( Backend == mw::BackendBackoff && ( Backends & ( 1u << mw::BackendUmwait ) ) )
+        {
+            Plan.back( ).Flags = mw::BACKEND_FLAG_NO_TPAUSE;
+
+            Add( mw::BackendBackoff, 0, "tpause" );
+        }
+    }
+
+    std::vector< ROW > Rows;
+
+    for ( auto Row : Plan )
+    {
+        if ( !Measure( Device, Options, Writes, TscPerMicrosecond, Row ) )
+        {
+            std::fprintf( stderr, "%s: measuring failed\n", Row.Name );
+            continue;
+        }
+
+        Rows.push_back( Row );
+    }
+
+    /* Put back whatever was in use before, whatever happened above. */
+    Device.SetBackend( Previous, 0 );
+
+    double BestNoise = 0;
+
+    for ( const auto& Row : Rows )
+    {
+        BestNoise = std::max( BestNoise, Row.Noise );
+    }
+
+    std::printf( "%-9s %9s %10s %10s %10s %10s %8s %7s %9s\n",
+                 "backend", "stores", "p50 us", "p99 us", "p99.9 us", "max us", "missed", "C0", "sibling" );
+
+    for ( const auto& Row : Rows )
+    {
+        char Active[ 16 ] = "n/a";
+        char Sibling[ 16 ] = "n/a";
+
+        if ( Row.Active >= 0 )
+        {
+            std::snprintf( Active, sizeof( Active ), "%.1f%%", Row.Active );
+        }
+
+        /* Relative to the backend that left the sibling the most room. */
+        if ( BestNoise > 0 )
+        {
+            std::snprintf( Sibling, sizeof( Sibling ), "%+.1f%%", ( Row.Noise / BestNoise - 1.0 ) * 100.0 );
+        }
+
+        std::printf( "%-9s %9zu %10.2f %10.2f %10.2f %10.2f %7.3f%% %7s %9s\n",
+                     Row.Name,
+                     Row.Stores,
+                     Row.P50,
+                     Row.P99,
+                     Row.P999,
+                     Row.Max,
+                     Row.MissRate,
+                     Active,
+                     Sibling
+        );
+    }
+
+    return Rows.empty( ) ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+#include "../mwlib/client.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Shows or changes the priority class of the driver's watches.
+ *
+ *     mwprio                                            shows every watch, its class and where it's served
+ *     mwprio <watch> <realtime|normal|background>       moves a watch to another class
+ *
+ * A realtime watch gets a watcher of its own once the pool manager has had a period or two to move things around,
+ * provided the core budget allows.
+ */
+namespace
+{
+    constexpr const char* PRIORITY_NAMES[ ] = { "realtime", "normal", "background" };
+
+    static_assert( sizeof( PRIORITY_NAMES ) / sizeof( PRIORITY_NAMES[ 0 ] ) == mw::PriorityCount );
+
+    bool Show( mw::lib::DEVICE& Device )
+    {
+        std::vector< unsigned char > Buffer;
+
+        if ( !Device.QueryStats( Buffer ) )
+        {
+            std::fprintf( stderr, "Querying stats failed\n" );
+            return false;
+        }
+
+        const auto Stats = reinterpret_cast< mw::STATS* >( Buffer.data( ) );
+        const auto Watches = mw::GetWatchStats( Stats );
+
+        /* How many watches `Owner` serves, to tell dedicated watchers apart. */
+        const auto Sharing = [ & ]( const LONG Owner ) {
+            ULONG Count = 0;
+
+            for ( ULONG i = 0; i < Stats->WatchCount; i++ )
+            {
+                Count += ( Watches[ i ].Owner == Owner ) ? 1 : 0;
+            }
+
+            return Count;
+        };
+
+        std::printf( "%-6s %-10s %-8s %-8s %10s %10s\n", "watch", "class", "replica", "watcher", "rate", "missed" );
+
+        for ( ULONG i = 0; i < Stats->WatchCount; i++ )
+        {
+            const auto& Watch = Watches[ i ];
+
+            char Owner[ 16 ] = "-";
+
+            if ( Watch.Owner >= 0 )
+            {
+                std::snprintf( Owner, sizeof( Owner ), "%d%s", Watch.Owner, Sharing( Watch.Owner ) == 1 ? "" : "*" );
+            }
+
+            std::printf( "%-6u %-10s %-8u %-8s %10llu %10llu\n",
+                         Watch.Id,
+                         Watch.Priority < mw::PriorityCount ? PRIORITY_NAMES[ Watch.Priority ] : "?",
+                         Watch.Replica,
+                         Owner,
+                         static_cast< unsigned long long >( Watch.Rate ),
+                         static_cast< unsigned long long >( Watch.Missed ) );
+        }
+
+        std::printf( "* shared watcher\n" );
+
+        return true;
+    }
+}
+
+int main( int argc, char** argv )
+{
+    if ( argc != 1 && argc != 3 )
+    {
+        std::fprintf( stderr, "Usage: %s [<watch> <realtime|normal|background>]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    mw::lib::DEVICE Device;
+
+    if ( !Device.Open( ) )
+    {
+        std::fprintf( stderr, "Unable to open the driver, is it loaded?\n" );
+        return 1;
+    }
+
+    if ( argc == 3 )
+    {
+        ULONG Priority = 0;
+
+        while ( Priority < mw::PriorityCount && std::strcmp( PRIORITY_NAMES[ Priority ], argv[ 2 ] ) != 0 )
+        {
+            Priority++;
+        }
+
+        if ( Priority == mw::PriorityCount )
+        {
+            std::fprintf( stderr, "Unknown priority class\n" );
+            return 1;
+        }
+
+        const auto Watch = static_cast< ULONG >( std::strtoul( argv[ 1 ], nullptr, 0 ) );
+
+        if ( !Device.SetWatchPriority( Watch, static_cast< mw::WATCH_PRIORITY >( Priority ) ) )
+        {
+            std::fprintf( stderr, "Setting the priority failed, does watch %u exist?\n", Watch );
+            return 1;
+        }
+    }
+
+    return Show( Device ) ? 0 : 1;
+}
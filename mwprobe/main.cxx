@@ -0,0 +1,133 @@
+#include "../mwlib/client.hpp"
+#include "../mwlib/probe.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Measures one-way latency from the load generator's stores to their detection, per writer/watcher processor pair,
+ * next to half the round trip for the same pair.
+ *
+ *     mwprobe [--seconds N]
+ *
+ * While it runs the load generator writes probes instead of its usual pattern: its TSC and a sequence number in one
+ * store. Watchers subtract the probe's TSC from the one they detected it at and correct for the skew between the two
+ * processors' TSCs, which comes from echoing every few probes back and assuming both legs of the fastest round trip
+ * took equally long. Any asymmetry in that round trip, such as the watcher waking up from a deep wait state on the way
+ * out, ends up as skew. A large share of negative samples is the sign of that.
+ */
+namespace
+{
+    std::atomic< bool > Stop = false;
+
+    void Interrupted( int )
+    {
+        Stop = true;
+    }
+
+    void PrintLatency( const char* Name, const mw::lib::LATENCY_SUMMARY& Latency )
+    {
+        std::printf( "  %-8s %10llu %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+                     Name,
+                     static_cast< unsigned long long >( Latency.Samples ),
+                     Latency.MinMicroseconds,
+                     Latency.MeanMicroseconds,
+                     Latency.P50Microseconds,
+                     Latency.P99Microseconds,
+                     Latency.MaxMicroseconds
+        );
+    }
+}
+
+int main( int argc, char** argv )
+{
+    double Seconds = 10.0;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const std::string Option = argv[ i ];
+
+        if ( Option == "--seconds" && i + 1 < argc )
+        {
+            Seconds = std::atof( argv[ ++i ] );
+        }
+        else
+        {
+            Seconds = 0;
+            break;
+        }
+    }
+
+    if ( !( Seconds > 0 ) )
+    {
+        std::fprintf( stderr, "Usage: %s [--seconds N]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    mw::lib::DEVICE Device;
+
+    if ( !Device.Open( ) )
+    {
+        std::fprintf( stderr, "Unable to open the driver, is it loaded?\n" );
+        return 1;
+    }
+
+    std::vector< unsigned char > Report;
+
+    if ( !Device.Probe( mw::PROBE_FLAG_START, Report ) )
+    {
+        std::fprintf( stderr, "The driver doesn't support probes\n" );
+        return 1;
+    }
+
+    std::signal( SIGINT, Interrupted );
+
+    const auto End = std::chrono::steady_clock::now( ) + std::chrono::duration< double >( Seconds );
+
+    while ( !Stop && std::chrono::steady_clock::now( ) < End )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+    }
+
+    if ( !Device.Probe( mw::PROBE_FLAG_STOP, Report ) )
+    {
+        std::fprintf( stderr, "Reading the probe statistics failed\n" );
+        return 1;
+    }
+
+    const auto Header = reinterpret_cast< const mw::PROBE_REPORT* >( Report.data( ) );
+
+    std::printf( "%llu probes written, %llu echoes timed out, %u pair(s)\n\n",
+                 static_cast< unsigned long long >( Header->Probes ),
+                 static_cast< unsigned long long >( Header->EchoTimeouts ),
+                 Header->Pairs
+    );
+
+    for ( ULONG i = 0; i < Header->Pairs; i++ )
+    {
+        const auto Summary = mw::lib::SummarizeProbes( Header->Pair[ i ], Header->TscPerMicrosecond );
+
+        std::printf( "writer cpu %u -> watcher cpu %u, skew %+.3f us, %.2f%% uncorrected, %.2f%% negative\n",
+                     Summary.Writer,
+                     Summary.Watcher,
+                     Summary.SkewMicroseconds,
+                     Summary.Uncorrected * 100.0,
+                     Summary.Negative * 100.0
+        );
+
+        std::printf( "  %-8s %10s %9s %9s %9s %9s %9s\n", "us", "samples", "min", "mean", "p50", "p99", "max" );
+
+        PrintLatency( "one-way", Summary.OneWay );
+        PrintLatency( "rtt/2", Summary.HalfRtt );
+
+        std::printf( "\n" );
+    }
+
+    return 0;
+}
@@ -0,0 +1,201 @@
+#include "../mwlib/client.hpp"
+#include "../mwlib/replay.hpp"
+#include "../mwlib/trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+/*
+ * Replays a recorded trace against the driver's watchers: the load generator writes each recorded value to a test slot
+ * at its original time, optionally sped up, and reports how closely it kept to the schedule.
+ *
+ *     mwreplay <trace file> [speed-up]
+ */
+namespace
+{
+    /* Writes per request, the driver's queue holds `Capacity` of them. */
+    constexpr SIZE_T REPLAY_BATCH = 4096;
+
+    /* How long to wait when the queue was full. */
+    constexpr auto IDLE = std::chrono::milliseconds( 5 );
+
+    std::atomic< bool > Stop = false;
+
+    void Interrupted( int )
+    {
+        Stop = true;
+    }
+
+    void Report( const mw::REPLAY_STATUS& Status, const ULONG64 TscPerMicrosecond )
+    {
+        const auto Fidelity = mw::lib::Fidelity( Status, TscPerMicrosecond );
+
+        const auto Drift = Fidelity.IntendedSeconds > 0
+            ? ( Fidelity.ActualSeconds / Fidelity.IntendedSeconds - 1.0 ) * 100.0
+            : 0.0;
+
+        std::printf( "played %llu writes, %.3f s intended, %.3f s actual (%+.3f%%)\n",
+                     static_cast< unsigned long long >( Fidelity.Played ),
+                     Fidelity.IntendedSeconds,
+                     Fidelity.ActualSeconds,
+                     Drift
+        );
+
+        std::printf( "lateness: mean %.2f us, p50 %.2f us, p99 %.2f us, max %.2f us\n",
+                     Fidelity.MeanMicroseconds,
+                     Fidelity.P50Microseconds,
+                     Fidelity.P99Microseconds,
+                     Fidelity.MaxMicroseconds
+        );
+
+        std::printf( "on time: %.2f%% within 1 us, %.2f%% within 10 us, %.2f%% within 100 us\n",
+                     Fidelity.Within1us * 100.0,
+                     Fidelity.Within10us * 100.0,
+                     Fidelity.Within100us * 100.0
+        );
+    }
+}
+
+int main( int argc, char** argv )
+{
+    if ( argc < 2 )
+    {
+        std::fprintf( stderr, "Usage: %s <trace file> [speed-up]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    const auto Speed = ( argc > 2 ) ? std::atof( argv[ 2 ] ) : 1.0;
+
+    if ( !( Speed > 0 ) )
+    {
+        std::fprintf( stderr, "The speed-up has to be positive\n" );
+        return 1;
+    }
+
+    mw::lib::TRACE_READER Trace;
+
+    if ( !Trace.Open( argv[ 1 ] ) )
+    {
+        std::fprintf( stderr, "Unable to open %s\n", argv[ 1 ] );
+        return 1;
+    }
+
+    std::vector< mw::EVENT > Events;
+
+    while ( Trace.Read( Events ) != 0 )
+    {
+    }
+
+    mw::lib::DEVICE Device;
+
+    if ( !Device.Open( ) )
+    {
+        std::fprintf( stderr, "Unable to open the driver, is it loaded?\n" );
+        return 1;
+    }
+
+    std::vector< unsigned char > Stats;
+
+    if ( !Device.QueryStats( Stats ) )
+    {
+        std::fprintf( stderr, "Querying the driver failed\n" );
+        return 1;
+    }
+
+    const auto TscPerMicrosecond = reinterpret_cast< const mw::STATS* >( Stats.data( ) )->TscPerMicrosecond;
+
+    /* Nothing queued, only asks how many slots there are. */
+    mw::REPLAY_STATUS Status;
+
+    if ( !Device.Replay( 0, nullptr, 0, Status ) )
+    {
+        std::fprintf( stderr, "The driver doesn't support replay\n" );
+        return 1;
+    }
+
+    mw::lib::REPLAY_SCHEDULE Schedule;
+
+    mw::lib::ScheduleReplay( Events, Trace.TscPerMicrosecond( ), TscPerMicrosecond, Speed, Status.Slots, Schedule );
+
+    if ( Schedule.Writes.empty( ) )
+    {
+        std::fprintf( stderr, "%s has no events\n", argv[ 1 ] );
+        return 1;
+    }
+
+    std::printf( "%s: %zu writes from %u watch(es) onto %u slot(s), %.3f s at %.2fx\n",
+                 argv[ 1 ],
+                 Schedule.Writes.size( ),
+                 Schedule.Watches,
+                 Status.Slots,
+                 TscPerMicrosecond ? Schedule.Span / 1e6 / TscPerMicrosecond : 0.0,
+                 Speed
+    );
+
+    for ( ULONG Slot = 0; Slot < Schedule.SlotWatches.size( ); Slot++ )
+    {
+        std::printf( "  slot %u <- watch %u%s\n", Slot, Schedule.SlotWatches[ Slot ], Schedule.Watches > Status.Slots ? " and others" : "" );
+    }
+
+    std::signal( SIGINT, Interrupted );
+
+    SIZE_T Sent = 0;
+    auto Flags = mw::REPLAY_FLAG_START;
+    auto Next = std::chrono::steady_clock::now( ) + std::chrono::seconds( 1 );
+
+    /* Keep the queue topped up until everything is sent, then until everything is played. */
+    while ( !Stop )
+    {
+        const auto Count = std::min( REPLAY_BATCH, Schedule.Writes.size( ) - Sent );
+
+        if ( !Device.Replay( Flags, Schedule.Writes.data( ) + Sent, static_cast< ULONG >( Count ), Status ) )
+        {
+            std::fprintf( stderr, "Queuing writes failed\n" );
+            return 1;
+        }
+
+        Flags = 0;
+        Sent += Status.Accepted;
+
+        if ( Sent == Schedule.Writes.size( ) && Status.Queued == 0 )
+        {
+            break;
+        }
+
+        const auto Now = std::chrono::steady_clock::now( );
+
+        if ( Now >= Next )
+        {
+            std::printf( "%llu/%zu played, max lateness %.2f us\n",
+                         static_cast< unsigned long long >( Status.Played ),
+                         Schedule.Writes.size( ),
+                         TscPerMicrosecond ? static_cast< double >( Status.LatenessMax ) / TscPerMicrosecond : 0.0
+            );
+
+            std::fflush( stdout );
+
+            Next = Now + std::chrono::seconds( 1 );
+        }
+
+        if ( Sent == Schedule.Writes.size( ) || Status.Accepted < Count )
+        {
+            std::this_thread::sleep_for( IDLE );
+        }
+    }
+
+    /* Read the figures before stopping, stopping makes the load generator take over the slots again. */
+    auto Final = Status;
+
+    Device.Replay( 0, nullptr, 0, Final );
+    Device.Replay( mw::REPLAY_FLAG_STOP, nullptr, 0, Status );
+
+    Report( Final, TscPerMicrosecond );
+
+    return 0;
+}
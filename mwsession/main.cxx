@@ -0,0 +1,106 @@
+#include "../mwlib/client.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ * Shows or changes the sessions watches belong to.
+ *
+ *     mwsession                                                    shows every session
+ *     mwsession <session> <weight> [<watches> <ring> <rate>]       sets a weight, and quotas if given
+ *
+ * Quotas are maximum watches, events waiting in the rings and events per pool manager period, 0 for unlimited.
+ * Setting the weight alone clears a session's quotas.
+ */
+namespace
+{
+    bool Show( mw::lib::DEVICE& Device )
+    {
+        std::vector< unsigned char > Buffer;
+
+        if ( !Device.QueryStats( Buffer ) )
+        {
+            std::fprintf( stderr, "Querying stats failed\n" );
+            return false;
+        }
+
+        const auto Stats = reinterpret_cast< const mw::STATS* >( Buffer.data( ) );
+
+        std::printf( "%-3s %-16s %6s %6s %8s %8s %10s %10s %10s %10s %10s\n",
+                     "#", "name", "weight", "share", "watches", "refused", "rate", "throttled", "queued", "dropped", "events" );
+
+        for ( ULONG i = 0; i < Stats->SessionCount && i < mw::MAX_SESSIONS; i++ )
+        {
+            const auto& Session = Stats->Sessions[ i ];
+
+            std::printf( "%-3u %-16.16s %6u %5.1f%% %8u %8u %10llu %10llu %10llu %10llu %10llu\n",
+                         i,
+                         Session.Name,
+                         Session.Weight,
+                         100.0 * Session.Share / mw::SESSION_SHARE_FULL,
+                         Session.Watches,
+                         Session.RejectedWatches,
+                         static_cast< unsigned long long >( Session.Rate ),
+                         static_cast< unsigned long long >( Session.ThrottledPeriods ),
+                         static_cast< unsigned long long >( Session.RingEvents ),
+                         static_cast< unsigned long long >( Session.RingDropped ),
+                         static_cast< unsigned long long >( Session.Events ) );
+
+            if ( Session.Quota.MaxWatches || Session.Quota.MaxRingEvents || Session.Quota.MaxEventRate )
+            {
+                std::printf( "    quota: %u watches, %u queued, %llu per period\n",
+                             Session.Quota.MaxWatches,
+                             Session.Quota.MaxRingEvents,
+                             static_cast< unsigned long long >( Session.Quota.MaxEventRate ) );
+            }
+        }
+
+        return true;
+    }
+}
+
+int main( int argc, char** argv )
+{
+    if ( argc != 1 && argc != 3 && argc != 6 )
+    {
+        std::fprintf( stderr, "Usage: %s [<session> <weight> [<watches> <ring> <rate>]]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    mw::lib::DEVICE Device;
+
+    if ( !Device.Open( ) )
+    {
+        std::fprintf( stderr, "Unable to open the driver, is it loaded?\n" );
+        return 1;
+    }
+
+    if ( argc > 1 )
+    {
+        mw::SESSION_REQUEST Request = { };
+
+        Request.Session = std::strtoul( argv[ 1 ], nullptr, 0 );
+        Request.Weight = std::strtoul( argv[ 2 ], nullptr, 0 );
+
+        if ( argc == 6 )
+        {
+            Request.Quota.MaxWatches = std::strtoul( argv[ 3 ], nullptr, 0 );
+            Request.Quota.MaxRingEvents = std::strtoul( argv[ 4 ], nullptr, 0 );
+            Request.Quota.MaxEventRate = std::strtoull( argv[ 5 ], nullptr, 0 );
+        }
+
+        if ( Request.Weight > mw::SESSION_MAX_WEIGHT )
+        {
+            std::fprintf( stderr, "Weights go up to %u\n", mw::SESSION_MAX_WEIGHT );
+            return 1;
+        }
+
+        if ( !Device.SetSession( Request ) )
+        {
+            std::fprintf( stderr, "Setting the session failed, does it exist?\n" );
+            return 1;
+        }
+    }
+
+    return Show( Device ) ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+#include "../mwlib/client.hpp"
+#include "../mwlib/simd.hpp"
+#include "../mwlib/trace.hpp"
+#include "../mwlib/window.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+/*
+ * Live per-watch view of what the driver detects: rate, detection-to-display latency percentiles and the last value,
+ * over a sliding window, refreshed every second.
+ *
+ *     mwtail                 drains the driver's event rings
+ *     mwtail <trace file>    follows a trace file as it's being written
+ */
+namespace
+{
+    constexpr SIZE_T DRAIN_EVENTS = 1u << 16;
+    constexpr ULONG WINDOW_SECONDS = 10;
+
+    /* How long to wait when a poll came back empty. */
+    constexpr auto IDLE = std::chrono::milliseconds( 5 );
+
+    std::atomic< bool > Stop = false;
+
+    void Interrupted( int )
+    {
+        Stop = true;
+    }
+
+    ULONG64 MeasureTscPerMicrosecond( )
+    {
+        const auto Start = std::chrono::steady_clock::now( );
+        const auto TscStart = mw::lib::ReadTsc( );
+
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+
+        const auto Micro = std::chrono::duration< double, std::micro >( std::chrono::steady_clock::now( ) - Start ).count( );
+
+        return static_cast< ULONG64 >( ( mw::lib::ReadTsc( ) - TscStart ) / Micro );
+    }
+
+    void Render( const char* Source, const std::vector< mw::lib::WINDOW_SUMMARY >& Summary, const ULONG64 Total )
+    {
+        /* Home and clear, then one line per watch. */
+        std::printf( "\x1b[H\x1b[2J" );
+        std::printf( "%s  %llu events, last %u s\n\n", Source, static_cast< unsigned long long >( Total ), WINDOW_SECONDS );
+        std::printf( "%7s %12s %14s %18s %10s %10s %10s %10s\n", "watch", "events/s", "total", "last value", "p50 us", "p90 us", "p99 us", "max us" );
+
+        for ( const auto& Entry : Summary )
+        {
+            char Watch[ 16 ];
+
+            if ( Entry.Watch == mw::lib::OTHER_WATCHES )
+            {
+                std::snprintf( Watch, sizeof( Watch ), "other" );
+            }
+            else
+            {
+                std::snprintf( Watch, sizeof( Watch ), "%u", Entry.Watch );
+            }
+
+            std::printf( "%7s %12.0f %14llu %#18llx %10.1f %10.1f %10.1f %10.1f\n",
+                         Watch,
+                         Entry.Rate,
+                         static_cast< unsigned long long >( Entry.Total ),
+                         static_cast< unsigned long long >( Entry.LastValue ),
+                         Entry.P50,
+                         Entry.P90,
+                         Entry.P99,
+                         Entry.Max
+            );
+        }
+
+        std::fflush( stdout );
+    }
+}
+
+int main( int argc, char** argv )
+{
+    mw::lib::DEVICE Device;
+    mw::lib::TRACE_READER Trace;
+
+    const auto FromFile = argc > 1;
+
+    ULONG64 TscPerMicrosecond = 0;
+
+    if ( FromFile )
+    {
+        if ( !Trace.Open( argv[ 1 ], true ) )
+        {
+            std::fprintf( stderr, "Unable to open %s\n", argv[ 1 ] );
+            return 1;
+        }
+
+        TscPerMicrosecond = Trace.TscPerMicrosecond( );
+    }
+    else
+    {
+        if ( !Device.Open( ) )
+        {
+            std::fprintf( stderr, "Unable to open the driver, is it loaded?\n" );
+            return 1;
+        }
+
+        std::vector< unsigned char > Stats;
+
+        if ( Device.QueryStats( Stats ) )
+        {
+            TscPerMicrosecond = reinterpret_cast< const mw::STATS* >( Stats.data( ) )->TscPerMicrosecond;
+        }
+    }
+
+    if ( TscPerMicrosecond == 0 )
+    {
+        TscPerMicrosecond = MeasureTscPerMicrosecond( );
+    }
+
+    std::signal( SIGINT, Interrupted );
+
+    mw::lib::WATCH_WINDOWS Windows( TscPerMicrosecond, WINDOW_SECONDS + 1 );
+
+    std::vector< mw::EVENT > Events;
+    std::vector< mw::lib::WINDOW_SUMMARY > Summary;
+
+    ULONG64 Total = 0;
+
+    auto Next = std::chrono::steady_clock::now( ) + std::chrono::seconds( 1 );
+
+    while ( !Stop )
+    {
+        Events.clear( );
+
+        auto Ok = true;
+
+        if ( FromFile )
+        {
+            Trace.Read( Events );
+        }
+        else
+        {
+            Ok = Device.ReadEvents( Events, DRAIN_EVENTS );
+        }
+
+        if ( !Ok )
+        {
+            std::fprintf( stderr, "Reading events failed\n" );
+            return 1;
+        }
+
+        /* Events read from a file were captured a while ago, their latency includes the trip through the disk. */
+        Windows.Add( Events.data( ), Events.size( ), mw::lib::ReadTsc( ) );
+        Total += Events.size( );
+
+        const auto Now = std::chrono::steady_clock::now( );
+
+        if ( Now >= Next )
+        {
+            Windows.Advance( );
+            Windows.Summarize( Summary );
+
+            Render( FromFile ? argv[ 1 ] : "driver", Summary, Total );
+
+            Next = Now + std::chrono::seconds( 1 );
+        }
+
+        /* A full drain means there's more waiting. */
+        if ( Events.empty( ) || ( !FromFile && Events.size( ) < DRAIN_EVENTS / 2 ) )
+        {
+            std::this_thread::sleep_for( IDLE );
+        }
+    }
+
+    return 0;
+}